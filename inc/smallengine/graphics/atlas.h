@@ -0,0 +1,123 @@
+#ifndef __atlas_h__
+#define __atlas_h__
+
+/*
+ * atlas
+ *
+ * Many sprites packed into one large texture, so sprites drawn together share
+ * one canvas, one mask and one palette instead of an allocation each. Space is
+ * found with a skyline packer: the atlas keeps the height of the highest
+ * sprite along each run of columns and places each new sprite as low as it
+ * will go, so sprites can be added at any time. Adding returns a handle which
+ * gives the area of the sprite within the atlas texture, for use with the
+ * texture blits. Removed sprites leave a gap until the atlas is repacked,
+ * which places every sprite again tallest first (optionally into a new size)
+ * and keeps the handles. An atlas with no skyline, as loaded from a pack (see
+ * pack.h), is read only: it can be drawn but not changed.
+ */
+
+#include <smallengine/graphics/canvas.h>
+#include <smallengine/graphics/color.h>
+#include <smallengine/graphics/palette.h>
+#include <smallengine/graphics/texture.h>
+
+/*
+ * an area of the atlas texture, w and h are 0 for a handle that isn't in use
+ */
+struct atlas_rect {
+        int x;
+        int y;
+        int w;
+        int h;
+};
+
+/*
+ * a run of columns of the skyline and the height reached across them
+ */
+struct atlas_span {
+        int x;
+        int y;
+        int w;
+};
+
+struct atlas {
+        struct texture tex;             // every sprite, sharing the palette
+        int padding;                    // clear pixels kept between sprites
+        struct atlas_rect *rects;       // area of each sprite by handle
+        int count;                      // handles given out
+        int capacity;
+        struct atlas_span *skyline;     // left to right across the texture,
+                                        // NULL if the atlas is read only
+        int spans;
+};
+
+/*
+ * Creation and Destruction
+ */
+
+/*
+ * create an empty atlas of the given size, with room for colors palette
+ * entries. padding clear pixels are kept around each sprite so scaled drawing
+ * doesn't pick up its neighbours
+ */
+struct atlas atlas(int w, int h, int colors, int padding);
+
+/*
+ * free all memory used by an atlas, including its texture
+ */
+void atlas_destroy(struct atlas *a);
+
+/*
+ * Operations
+ */
+
+/*
+ * copy a canvas into the atlas, pixels matching trans are transparent (none
+ * are if trans is NULL). Returns the handle of the sprite, -1 if there is no
+ * room for it or its colors, in which case the atlas is unchanged
+ */
+int atlas_add_canvas(struct atlas *a, const struct canvas c,
+                     struct color *trans);
+
+/*
+ * copy a texture into the atlas as atlas_add_canvas, its transparent pixels
+ * stay transparent
+ */
+int atlas_add_texture(struct atlas *a, const struct texture tex);
+
+/*
+ * replace a sprite with a texture, keeping its handle. A sprite of the same
+ * size is drawn over the old one, otherwise it is placed in new space and the
+ * old space is a gap until the atlas is repacked. Returns 1 on success, 0 if
+ * there is no room for it or its colors, leaving the sprite unchanged
+ */
+int atlas_replace_texture(struct atlas *a, int handle,
+                          const struct texture tex);
+
+/*
+ * clear a sprite from the atlas and free its handle. Its space is only
+ * reused once the atlas is repacked
+ */
+void atlas_remove(struct atlas *a, int handle);
+
+/*
+ * place every sprite again, tallest first, in an atlas of the given size
+ * (which may be the current one). Handles keep referring to the same sprites.
+ * Returns 1 on success, 0 if they don't all fit, leaving the atlas unchanged
+ */
+int atlas_repack(struct atlas *a, int w, int h);
+
+/*
+ * return the area of a sprite in the atlas texture, all 0 for an invalid
+ * handle
+ */
+struct atlas_rect atlas_get_rect(const struct atlas a, int handle);
+
+/*
+ * blit a whole sprite to a canvas using the specified blending mode, as
+ * texture_blit_to_canvas with the sprite's area of the atlas texture
+ */
+void atlas_blit(const struct atlas a, int handle, struct canvas dst, int dsx,
+                int dsy, enum blit_mode mode);
+
+#endif // __atlas_h__
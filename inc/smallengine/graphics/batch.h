@@ -0,0 +1,122 @@
+#ifndef __batch_h__
+#define __batch_h__
+
+/*
+ * batch
+ *
+ * A buffer of draw commands (fills, canvas blits and texture sprites) that
+ * are recorded during a frame and drawn together. Each command has a layer
+ * and a depth, commands are drawn in order of layer, then depth, then the
+ * order they were added, so later commands appear on top. When drawn the
+ * commands are sorted, neighbouring commands that can share their setup are
+ * grouped and the destination is split into tiles which are drawn in
+ * parallel if worker threads are running (see job.h)
+ */
+
+#include <stdint.h>
+
+#include <smallengine/graphics/canvas.h>
+#include <smallengine/graphics/color.h>
+#include <smallengine/graphics/texture.h>
+
+#define BATCH_MAX_LAYER 0xff
+#define BATCH_MAX_DEPTH 0xffff
+
+enum batch_type {
+        BATCH_FILL,
+        BATCH_BLIT,
+        BATCH_SPRITE,
+        NUM_BATCH_TYPES
+};
+
+struct batch_cmd {
+        enum batch_type type;
+        enum blit_mode mode;
+        uint32_t key;           // layer and depth, drawn in ascending order
+        int x1, y1, x2, y2;     // destination area, inclusive
+        int sx, sy;             // source coordinate drawn at x1, y1
+        struct color color;     // fill color
+        struct canvas canvas;   // blit source
+        struct texture texture; // sprite source
+        struct color *colors;   // the sprite's palette converted to the
+                                // destination's color space while drawing,
+                                // NULL if it is drawn as it is
+};
+
+/*
+ * a command as it is drawn, after sorting and merging
+ */
+struct batch_item {
+        uint32_t cmd;           // index of the command
+        int x1, y1, x2, y2;     // area, grown when commands are merged
+};
+
+struct batch {
+        struct batch_cmd *cmds;
+        uint32_t *order;        // indices of cmds sorted by key
+        uint32_t *scratch;      // second buffer for sorting
+        struct batch_item *items;
+        int size;               // maximum number of commands
+        int count;              // commands recorded
+        int drawn;              // items left after merging in last draw
+};
+
+/*
+ * Creation and Destruction
+ */
+
+/*
+ * create a batch able to hold size commands
+ */
+struct batch batch(int size);
+
+/*
+ * free all memory used by a batch
+ */
+void batch_destroy(struct batch *b);
+
+/*
+ * Recording
+ * 
+ * each returns 1 if the command was recorded, 0 if the batch is full. Areas
+ * use inclusive coordinates as with canvas_blit, layers are clamped to
+ * 0-BATCH_MAX_LAYER and depths to 0-BATCH_MAX_DEPTH
+ */
+
+/*
+ * fill the area from (x1, y1) to (x2, y2) with a color
+ */
+int batch_fill(struct batch *b, int layer, int depth, int x1, int y1, 
+               int x2, int y2, struct color col, enum blit_mode mode);
+
+/*
+ * blit an area of a canvas, the canvas must not change until the batch is
+ * drawn
+ */
+int batch_blit(struct batch *b, int layer, int depth, struct canvas src,
+               int srx1, int sry1, int srx2, int sry2, int dsx, int dsy,
+               enum blit_mode mode);
+
+/*
+ * draw an area of a texture, transparent pixels are skipped
+ */
+int batch_sprite(struct batch *b, int layer, int depth, struct texture tex,
+                 int srx1, int sry1, int srx2, int sry2, int dsx, int dsy,
+                 enum blit_mode mode);
+
+/*
+ * Drawing
+ */
+
+/*
+ * sort, merge and draw every recorded command onto dst, the commands are kept
+ * so the same batch can be drawn again
+ */
+void batch_draw(struct batch *b, struct canvas dst);
+
+/*
+ * remove all commands, ready for the next frame
+ */
+void batch_clear(struct batch *b);
+
+#endif // __batch_h__
@@ -8,12 +8,32 @@
  * on provided by SDL) to be displayed. Can also output to BMP
  */
 
+#include <stdint.h>
+
 #include <smallengine/graphics/color.h>
 
+/*
+ * the most pixels an image loaded from a file may have, so its size in bytes
+ * (and the pixel count as an int) can't overflow
+ */
+#define CANVAS_MAX_PIXELS (1 << 26)
+
+/*
+ * the image data behind a canvas, private to the canvas module. Copies of a
+ * struct canvas made by assignment all refer to the same image, canvas_copy()
+ * creates a new image that shares its pixels with the original until one of
+ * them is written to (copy-on-write). The counts of images sharing pixels
+ * aren't atomic, so copies of one canvas mustn't be made or destroyed from
+ * different threads at the same time. An empty canvas ({0, 0, NULL}, as
+ * returned when a file can't be read) has no image, it can be passed to any
+ * canvas function, drawing on it does nothing and exporting it fails
+ */
+struct canvas_image;
+
 struct canvas {
         int w;
         int h;
-        struct color *pixels;
+        struct canvas_image *image;
 };
 
 enum blit_mode {
@@ -23,6 +43,25 @@ enum blit_mode {
         NUM_BLIT_MODES
 };
 
+/*
+ * ppm files hold pixels as text numbers or as bytes
+ */
+enum ppm_format {
+        PPM_ASCII,              // P3
+        PPM_BINARY,             // P6
+        NUM_PPM_FORMATS
+};
+
+/*
+ * filters used to build the reduced copies of a canvas for scaled drawing,
+ * see mipmap.h
+ */
+enum mip_filter {
+        MIP_BOX,                // average of each 2x2 block
+        MIP_KAISER,             // kaiser windowed sinc, sharper but slower
+        NUM_MIP_FILTERS
+};
+
 
 /*
  * Creation and Initialization
@@ -33,6 +72,91 @@ enum blit_mode {
  */
 struct canvas canvas(const int w, const int h);
 
+/*
+ * Create a canvas that draws on the pixels given rather than its own, such as
+ * those of a mapped file. They aren't freed with the canvas, so they must
+ * outlive it and every copy of it
+ */
+struct canvas canvas_from_pixels(struct color *pixels, const int w,
+                                 const int h);
+
+/*
+ * Create a duplicate of a canvas, this is O(1) as the pixels are shared and
+ * only cloned when either canvas is first written to
+ */
+struct canvas canvas_copy(const struct canvas c);
+
+/*
+ * Destruction
+ */
+
+/*
+ * release a canvas, the pixels are freed once no other canvas shares them
+ */
+void canvas_destroy(struct canvas *c);
+
+/*
+ * Pixel Access
+ */
+
+/*
+ * returns 1 if the canvas pixels are currently shared with another canvas
+ */
+int canvas_is_shared(const struct canvas c);
+
+/*
+ * return the pixels of the canvas for reading, row by row from the top left,
+ * the pointer is valid until the canvas is next written to
+ */
+const struct color *canvas_pixels(const struct canvas c);
+
+/*
+ * return the pixels of the canvas for writing, the pixels are cloned first if
+ * they are shared with another canvas
+ */
+struct color *canvas_pixels_writable(struct canvas c);
+
+/*
+ * return a count of the writes made to the canvas, anything built from the
+ * canvas is out of date once this changes
+ */
+uint32_t canvas_version(const struct canvas c);
+
+/*
+ * Color Spaces
+ *
+ * Canvases are COLOR_SRGB when created or loaded, which blends as values
+ * always have. A COLOR_LINEAR canvas blends correctly and is encoded to sRGB
+ * when exported or displayed. Anything drawn from a canvas, texture, sprite
+ * or indexed texture is converted from the space of its source (that of the
+ * canvas it was made from) to the destination's. Colors passed in directly,
+ * such as fills, primitives and vertex colors, are taken to be in the space
+ * of the canvas drawn on
+ */
+
+/*
+ * return the color space the canvas pixels are in, COLOR_SRGB unless changed
+ */
+enum color_space canvas_color_space(const struct canvas c);
+
+/*
+ * mark the canvas pixels as being in the given color space without changing
+ * them
+ */
+void canvas_set_color_space(struct canvas c, enum color_space space);
+
+/*
+ * convert the canvas pixels to the given color space
+ */
+void canvas_convert_color_space(struct canvas c, enum color_space space);
+
+/*
+ * return a copy of the canvas reduced by 2^level in each direction, built
+ * with the given filter. The copies are kept with the canvas and only rebuilt
+ * once the canvas has changed, the returned canvas must not be destroyed
+ */
+struct canvas canvas_mip(struct canvas c, int level, enum mip_filter filter);
+
 /*
  * Operations
  */
@@ -67,6 +191,34 @@ void canvas_fill(struct canvas canvas, struct color color);
  */
 void canvas_clear(struct canvas canvas);
 
+/*
+ * Spans
+ *
+ * Raw row operations that the canvas, batch and primitive drawing code is
+ * built on. They do no clipping or copy-on-write checks, dst must come from
+ * canvas_pixels_writable(), and they are safe to call from worker threads
+ */
+
+/*
+ * blend col into n pixels starting at dst according to the blit mode
+ */
+void canvas_fill_span(struct color *dst, struct color col, int n,
+                      enum blit_mode mode);
+
+/*
+ * blend n pixels from src into n pixels starting at dst
+ */
+void canvas_blend_span(struct color *dst, const struct color *src, int n,
+                       enum blit_mode mode);
+
+/*
+ * as canvas_blend_span, converting src from one color space to another on
+ * the way. Nothing is converted if the spaces are the same
+ */
+void canvas_blend_span_convert(struct color *dst, const struct color *src,
+                               int n, enum blit_mode mode,
+                               enum color_space from, enum color_space to);
+
 /*
  * Blitting
  */
@@ -81,6 +233,16 @@ void canvas_clear(struct canvas canvas);
 void canvas_blit(struct canvas src, int srx1, int sry1, int srx2, int sry2,
                  struct canvas dst, int dsx, int dsy, enum blit_mode mode);
 
+/*
+ * blit an area of one canvas to a differently sized area of another, the
+ * coordinates are inclusive as with canvas_blit. Areas drawn smaller than
+ * their source are read from the canvas's reduced copies so the cost is in
+ * proportion to the area drawn
+ */
+void canvas_blit_scaled(struct canvas src, int srx1, int sry1, int srx2, 
+                        int sry2, struct canvas dst, int dsx1, int dsy1, 
+                        int dsx2, int dsy2, enum blit_mode mode);
+
 /*
  * fills a canvas with red and white squared for testing purposes
  */
@@ -91,23 +253,62 @@ void canvas_test(struct canvas src);
  */
 
 /* 
- * Write the contents of a canvas to a ppm file - this is mostly
- * for testing and more robust, portable file i/o code should be
- * written for screenshots etc
+ * Write the contents of a canvas to a ppm file, either as text (P3) or
+ * binary (P6). The file is written a row at a time so the memory used only
+ * depends on the width of the canvas. Returns 1 on success, 0 otherwise
  */
-const int canvas_export_to_ppm(struct canvas c, const char *filename);
+const int canvas_export_to_ppm(struct canvas c, const char *filename,
+                               enum ppm_format format);
 
-/* 
- * Write the contents of a canvas to a bitmap file - this is mostly
- * for testing and more robust, portable file i/o code should be
- * written for screenshots etc
+/*
+ * Write the contents of a canvas to a bitmap file. Returns 1 on success, 0
+ * on failure. See capture.h for writing screenshots without waiting
  */
 const int canvas_export_to_bmp(struct canvas c, const char *filename);
 
 /*
- * Create a canvas from a bitmap file
+ * Write pixels already packed as COLOR_ARGB to a bitmap file, top row first.
+ * Files named .lz are compressed (see lz.h). Returns 1 on success, 0 on
+ * failure
+ */
+const int canvas_export_argb_to_bmp(const uint32_t *argb, int w, int h,
+                                    const char *filename);
+
+/*
+ * Create a canvas from an uncompressed 8, 24 or 32 bit bitmap file, stored
+ * either way up. The file is mapped rather than read and converted a row at
+ * a time, compressed files (see lz.h) are decompressed first. An empty canvas
+ * (0x0, which can still be passed to canvas_destroy) is returned if the file
+ * can't be read
  */
 struct canvas canvas_from_bmp(const char *filename);
 
+/*
+ * Create a canvas from a P3 or P6 ppm file, an empty canvas (0x0, which can
+ * still be passed to canvas_destroy) is returned if the file can't be read
+ */
+struct canvas canvas_from_ppm(const char *filename);
+
+/*
+ * Write the contents of a canvas to a QOI file. Rows are packed and encoded
+ * one at a time into a small buffer, so the memory used only depends on the
+ * width of the canvas. Opaque canvases are written with 3 channels, alpha is
+ * kept otherwise. Returns 1 on success, 0 on failure
+ */
+const int canvas_export_to_qoi(struct canvas c, const char *filename);
+
+/*
+ * Create a canvas from a QOI file. The file is mapped rather than read and
+ * decoded straight into the canvas, files marked as all linear give a linear
+ * canvas. An empty canvas (0x0) is returned if the file can't be read
+ */
+struct canvas canvas_from_qoi(const char *filename);
+
+/*
+ * Create a canvas from a .bmp, .ppm or .qoi file, chosen by the extension, an
+ * empty canvas (0x0) is returned if the file can't be read
+ */
+struct canvas canvas_from_file(const char *filename);
+
 #endif // __canvas_h__
 
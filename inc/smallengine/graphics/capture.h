@@ -0,0 +1,72 @@
+#ifndef __capture_h__
+#define __capture_h__
+
+/*
+ * capture
+ *
+ * Screenshots and frame captures written without holding up the frame. A
+ * capture only copies the frame into one of a fixed number of buffers, which
+ * are reused from frame to frame, and a background thread converts and writes
+ * it to a bitmap file while the game carries on. When every buffer is waiting
+ * to be written the policy decides whether the capture is dropped or waits
+ * for the writer to free one. Frames named .lz (shot.bmp.lz) are written as
+ * compressed bitmaps, see lz.h, which canvas_from_bmp reads back.
+ *
+ * Captures are made from one thread. If capture_init was never called frames
+ * are written straight away on that thread.
+ */
+
+#include <stdint.h>
+
+#include <smallengine/graphics/canvas.h>
+#include <smallengine/graphics/color.h>
+
+#define CAPTURE_MAX_FRAMES 64
+#define CAPTURE_PATH_SIZE 256
+
+enum capture_policy {
+        CAPTURE_DROP,           // skip frames while the queue is full
+        CAPTURE_BLOCK,          // wait for the writer, losing no frames
+        NUM_CAPTURE_POLICIES
+};
+
+/*
+ * start the writer thread with room for frames captures waiting to be
+ * written (up to CAPTURE_MAX_FRAMES). Returns 1 on success, 0 on failure
+ */
+int capture_init(int frames, enum capture_policy policy);
+
+/*
+ * write everything still queued, stop the writer thread and free the buffers
+ */
+void capture_quit(void);
+
+/*
+ * queue packed pixels of the given layout to be written, pitch is the number
+ * of pixels from the start of one row to the next. Returns 1 if the frame was
+ * queued (or written), 0 if it was dropped
+ */
+int capture_pixels(const uint32_t *pixels, int w, int h, int pitch,
+                   enum color_layout layout, const char *filename);
+
+/*
+ * queue the contents of a canvas to be written, as capture_pixels
+ */
+int capture_canvas(const struct canvas c, const char *filename);
+
+/*
+ * wait until every queued frame has been written
+ */
+void capture_flush(void);
+
+/*
+ * return the number of frames dropped because the queue was full
+ */
+int capture_dropped(void);
+
+/*
+ * return the number of frames that couldn't be written
+ */
+int capture_failed(void);
+
+#endif // __capture_h__
@@ -38,6 +38,41 @@ struct color {
         double a;
 };
 
+/*
+ * a compact color for accumulating light, each component is unsigned 4.12
+ * fixed point: COLOR16_ONE is 1.0 and values saturate just below 16.0, giving
+ * headroom above white at 8 bytes per pixel, see hdr.h
+ */
+#define COLOR16_ONE 4096
+#define COLOR16_MAX 0xffff
+
+struct color16 {
+        uint16_t r;
+        uint16_t g;
+        uint16_t b;
+        uint16_t a;
+};
+
+/*
+ * packed 32 bit pixel layouts colors can be converted to
+ */
+enum color_layout {
+        COLOR_RGBA,     // as color_to_RGBA, matching the SDL masks above
+        COLOR_ARGB,     // as color_to_ARGB, bitmap format
+        NUM_COLOR_LAYOUTS
+};
+
+/*
+ * how the r, g and b values of a color relate to light. sRGB values are as
+ * loaded from image files and sent to the display, blending them is quick but
+ * gamma incorrect, linear values are proportional to light
+ */
+enum color_space {
+        COLOR_SRGB,
+        COLOR_LINEAR,
+        NUM_COLOR_SPACES
+};
+
 /*
  * Creation and Initialization
  */
@@ -73,7 +108,8 @@ int color_equal(const struct color c1, const struct color c2);
  *range 0.0-1.0 */
 const struct color color_cap(const struct color c);
 
-/* return a ppm style string of the color (ie "255 0 128")*/
+/* return a ppm style string of the color (ie "255 0 128"), the string must be
+ * released with mem_free */
 char *color_to_ppm_string(const struct color c);
 
 /* return the color as a 32 bit integer ARGB (bitmap) format, alpha is
@@ -85,6 +121,42 @@ const uint32_t color_to_ARGB(struct color c);
  */
 const uint32_t color_to_RGBA(struct color c);
 
+/*
+ * convert n colors to packed 32 bit pixels in the given layout, giving the
+ * same values as color_to_RGBA/color_to_ARGB (components clamped to 0.0-1.0,
+ * alpha always 0xff). Used for whole rows or frames at a time
+ */
+void color_span_to_rgba32(const struct color *src, uint32_t *dst, int n,
+                          enum color_layout layout);
+
+/*
+ * convert n colors to packed 32 bit pixels as color_span_to_rgba32, the
+ * colors are linear and are encoded to sRGB on the way
+ */
+void color_span_to_srgb32(const struct color *src, uint32_t *dst, int n,
+                          enum color_layout layout);
+
+/*
+ * Color Spaces
+ *
+ * Conversions use lookup tables with interpolation in place of pow(), values
+ * outside 0.0-1.0 fall back to the exact curve. Alpha is left alone
+ */
+
+/* convert a single sRGB component to linear */
+double color_srgb_to_linear(const double v);
+
+/* convert a single linear component to sRGB */
+double color_linear_to_srgb(const double v);
+
+/* convert a color between color spaces */
+struct color color_convert(const struct color c, enum color_space from,
+                           enum color_space to);
+
+/* convert n colors between color spaces, dst and src may be the same */
+void color_span_convert(struct color *dst, const struct color *src, int n,
+                        enum color_space from, enum color_space to);
+
 /*
  * Operations
  */
@@ -103,5 +175,36 @@ const struct color color_scale(const struct color c, const double factor);
  * new colour, also known as the Hadamard Product or Schur Product */
 const struct color color_multiply(const struct color c1, const struct color c2);
 
+/*
+ * Fixed Point Colors
+ */
+
+/* convert a color to fixed point, components are clamped to 0.0-16.0 */
+struct color16 color16_from_color(const struct color c);
+
+/* convert a fixed point color back to doubles */
+struct color color16_to_color(const struct color16 c);
+
+/* add 2 fixed point colors, saturating, the result is opaque as color_add */
+struct color16 color16_add(const struct color16 c1, const struct color16 c2);
+
+/* multiply 2 fixed point colors, saturating, the result is opaque as
+ * color_multiply */
+struct color16 color16_multiply(const struct color16 c1, 
+                                const struct color16 c2);
+
+/*
+ * Video
+ */
+
+/*
+ * convert w x h packed pixels of the given layout (pitch pixels from one row
+ * to the next) to 8 bit BT.601 studio range Y'CbCr 4:2:0: a full size y
+ * plane and u and v planes of (w + 1) / 2 x (h + 1) / 2, each chroma sample
+ * the average of a 2x2 block
+ */
+void color_rgb32_to_yuv420(const uint32_t *src, int w, int h, int pitch,
+                           enum color_layout layout, uint8_t *y, uint8_t *u,
+                           uint8_t *v);
 
 #endif // __color_h__
@@ -0,0 +1,91 @@
+#ifndef __coverage_h__
+#define __coverage_h__
+
+/*
+ * coverage
+ *
+ * One bit per pixel saying whether it is opaque, row by row in 64 bit words,
+ * a 32nd of the size of a mask of ints. Runs of opaque pixels are found a
+ * word at a time by counting trailing zeros, so drawing can skip transparent
+ * areas almost for free and only visit the pixels that are seen. Textures
+ * keep one alongside their mask for blitting and hit testing, one can also be
+ * made from a canvas and a transparent color.
+ */
+
+#include <stdint.h>
+
+#include <smallengine/graphics/canvas.h>
+#include <smallengine/graphics/color.h>
+
+#define COVERAGE_WORD_BITS 64
+
+struct coverage {
+        int w;
+        int h;
+        int words;              // words per row, unused bits are always 0
+        uint64_t *bits;         // bit x % 64 of word x / 64 is pixel x
+};
+
+/*
+ * Creation and Destruction
+ */
+
+/*
+ * create a coverage mask with every pixel transparent
+ */
+struct coverage coverage(int w, int h);
+
+/*
+ * create a coverage mask from a mask of ints, negative values are transparent
+ * as in a texture's mask
+ */
+struct coverage coverage_from_mask(const int *mask, int w, int h);
+
+/*
+ * create a coverage mask from a canvas, pixels matching trans are
+ * transparent (none are if trans is NULL)
+ */
+struct coverage coverage_from_canvas(const struct canvas c,
+                                     struct color *trans);
+
+/*
+ * free all memory used by a coverage mask
+ */
+void coverage_destroy(struct coverage *cov);
+
+/*
+ * Operations
+ */
+
+/*
+ * set an inclusive area of the coverage from a mask of ints of the same
+ * width, negative values being transparent. For keeping the coverage of a
+ * texture up to date after changing its mask
+ */
+void coverage_update(struct coverage cov, const int *mask, int x1, int y1,
+                     int x2, int y2);
+
+/*
+ * mark one pixel as opaque or transparent
+ */
+void coverage_set(struct coverage cov, int x, int y, int opaque);
+
+/*
+ * return 1 if the pixel is opaque, 0 if it is transparent or outside the mask
+ */
+int coverage_test(const struct coverage cov, int x, int y);
+
+/*
+ * find the first run of opaque pixels in row y starting between x1 and x2
+ * inclusive. Returns its length cut short at x2 and stores where it starts
+ * in start, returns 0 if there are none
+ */
+int coverage_span(const struct coverage cov, int y, int x1, int x2,
+                  int *start);
+
+/*
+ * return the number of opaque pixels
+ */
+int coverage_count(const struct coverage cov);
+
+#endif // __coverage_h__
@@ -0,0 +1,99 @@
+#ifndef __hdr_h__
+#define __hdr_h__
+
+/*
+ * hdr
+ *
+ * Canvases of fixed point colors (see struct color16 in color.h) for drawing
+ * that adds up a lot of light, such as lights and particles drawn with
+ * BLIT_ADD. Values can go well above white without saturating at a quarter
+ * of the memory of a struct canvas, and blending is done with saturating
+ * integer arithmetic on several components at a time. The result is
+ * resolved to a canvas, or straight to packed pixels for display.
+ */
+
+#include <stdint.h>
+
+#include <smallengine/graphics/canvas.h>
+#include <smallengine/graphics/color.h>
+
+struct hdr_canvas {
+        int w;
+        int h;
+        struct color16 *pixels;         // row by row from the top left
+};
+
+/*
+ * Creation and Destruction
+ */
+
+/*
+ * create a new hdr canvas, every colour will be initialised to (0, 0, 0, 0)
+ */
+struct hdr_canvas hdr_canvas(const int w, const int h);
+
+/*
+ * create a hdr canvas holding the same image as a canvas, components are
+ * clamped to 0.0-16.0
+ */
+struct hdr_canvas hdr_canvas_from_canvas(const struct canvas c);
+
+/*
+ * free all memory used by a hdr canvas
+ */
+void hdr_canvas_destroy(struct hdr_canvas *hdr);
+
+/*
+ * Operations
+ */
+
+/*
+ * fill the hdr canvas with the color given
+ */
+void hdr_canvas_fill(struct hdr_canvas hdr, const struct color16 col);
+
+/*
+ * set every pixel in the hdr canvas to black (0, 0, 0)
+ */
+void hdr_canvas_clear(struct hdr_canvas hdr);
+
+/*
+ * blit an area of one hdr canvas to another using the specified blending
+ * mode, the coordinates are inclusive as with canvas_blit
+ */
+void hdr_canvas_blit(const struct hdr_canvas src, int srx1, int sry1,
+                     int srx2, int sry2, struct hdr_canvas dst, int dsx,
+                     int dsy, enum blit_mode mode);
+
+/*
+ * write the hdr canvas into the top left of a canvas, values above 1.0 are
+ * kept
+ */
+void hdr_canvas_resolve(const struct hdr_canvas src, struct canvas dst);
+
+/*
+ * Spans
+ *
+ * As the canvas spans, no clipping and safe to call from worker threads
+ */
+
+/*
+ * blend col into n pixels starting at dst according to the blit mode
+ */
+void hdr_fill_span(struct color16 *dst, const struct color16 col, int n,
+                   enum blit_mode mode);
+
+/*
+ * blend n pixels from src into n pixels starting at dst
+ */
+void hdr_blend_span(struct color16 *dst, const struct color16 *src, int n,
+                    enum blit_mode mode);
+
+/*
+ * convert n pixels to packed 32 bit pixels as color_span_to_rgba32, values
+ * above 1.0 are clamped to white
+ */
+void hdr_span_to_rgba32(const struct color16 *src, uint32_t *dst, int n,
+                        enum color_layout layout);
+
+#endif // __hdr_h__
@@ -0,0 +1,111 @@
+#ifndef __indexed_h__
+#define __indexed_h__
+
+/*
+ * indexed
+ *
+ * A compact form of texture for drawing sprites: one byte per pixel (two for
+ * palettes of more than 255 colors) holding an index into a palette, with the
+ * largest value meaning transparent, and no copy of the original canvas.
+ * Drawing maps a row of indices through the palette at a time, to a canvas or
+ * straight to packed 32 bit pixels using the palette's packed colors. As with
+ * textures, changing the palette recolors the sprite for free.
+ */
+
+#include <stdint.h>
+
+#include <smallengine/graphics/canvas.h>
+#include <smallengine/graphics/color.h>
+#include <smallengine/graphics/palette.h>
+#include <smallengine/graphics/texture.h>
+
+#define INDEXED_CLEAR_8 0xff            // transparent pixel, 8 bit indices
+#define INDEXED_CLEAR_16 0xffff         // transparent pixel, 16 bit indices
+
+struct indexed_texture {
+        int w;
+        int h;
+        int wide;               // 1 if the indices are 16 bit
+        void *indices;          // uint8_t or uint16_t, row by row
+        struct palette palette;
+        int owns_palette;       // 0 if the palette belongs to a texture
+        enum color_space space; // of the palette colors, as their source
+};
+
+/*
+ * Creation and Destruction
+ */
+
+/*
+ * create an indexed texture from a canvas, pixels matching trans are
+ * transparent (none are if trans is NULL). The canvas isn't kept
+ */
+struct indexed_texture indexed_texture_from_canvas(const struct canvas c,
+                                                   struct color *trans);
+
+/*
+ * create an indexed texture drawing the same as a texture, the palette is
+ * shared so changes to the texture's palette show in both
+ */
+struct indexed_texture indexed_texture_from_texture(const struct texture tex);
+
+/*
+ * create an indexed texture from a canvas using the nearest colors of an
+ * existing palette, such as the one the screen is drawn with. The palette is
+ * shared rather than copied, pixels matching trans are transparent
+ */
+struct indexed_texture indexed_texture_from_palette(const struct canvas c,
+                                                    const struct palette pal,
+                                                    struct color *trans);
+
+/*
+ * free all memory used by an indexed texture, a shared palette is left alone
+ */
+void indexed_texture_destroy(struct indexed_texture *it);
+
+/*
+ * Operations
+ */
+
+/*
+ * return the palette index at the given coordinate, -1 if the pixel is
+ * transparent or outside the texture
+ */
+int indexed_texture_read_index(const struct indexed_texture it, int x, int y);
+
+/*
+ * set every pixel of an indexed texture to the same index, INDEXED_CLEAR_8 or
+ * INDEXED_CLEAR_16 clears it
+ */
+void indexed_texture_fill(struct indexed_texture it, int index);
+
+/*
+ * blit an area of an indexed texture to a canvas using the specified blending
+ * mode, the coordinates are inclusive as with texture_blit_to_canvas
+ */
+void indexed_texture_blit(const struct indexed_texture it, int srx1, int sry1,
+                          int srx2, int sry2, struct canvas dst, int dsx,
+                          int dsy, enum blit_mode mode);
+
+/*
+ * copy the indices of an area of one indexed texture into another, skipping
+ * transparent pixels. No colors are looked up so both should index the same
+ * palette (see indexed_texture_from_palette), and both must have indices of
+ * the same size
+ */
+void indexed_texture_blit_indices(const struct indexed_texture it, int srx1,
+                                  int sry1, int srx2, int sry2,
+                                  struct indexed_texture dst, int dsx, int dsy);
+
+/*
+ * copy an area of an indexed texture to packed pixels (as color_to_RGBA),
+ * dst is dst_w x dst_h pixels with pitch pixels from one row to the next.
+ * Palettes of 15 colors or fewer are drawn 16 pixels at a time with SSSE3
+ * when the cpu has it
+ */
+void indexed_texture_blit_rgba32(const struct indexed_texture it, int srx1,
+                                 int sry1, int srx2, int sry2, uint32_t *dst,
+                                 int dst_w, int dst_h, int pitch, int dsx,
+                                 int dsy);
+
+#endif // __indexed_h__
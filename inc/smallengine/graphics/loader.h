@@ -0,0 +1,95 @@
+#ifndef __loader_h__
+#define __loader_h__
+
+/*
+ * loader
+ *
+ * Loads images on background threads so reading and decoding files never
+ * holds up a frame. Requests are queued by priority, the loader threads read
+ * and decode them, build textures and palettes and insert sprites into
+ * atlases, then hand each result back through a lock free completion queue
+ * which the program polls once a frame on its own thread. Requests can be
+ * cancelled until their result has been handed back.
+ *
+ * Requests, polling and cancelling must all happen on the same thread.
+ * Requests made before loader_init wait for it to start loading. An atlas
+ * being loaded into belongs to the loader: it mustn't be used by the program
+ * until every request for it has been polled or cancelled.
+ */
+
+#include <smallengine/graphics/atlas.h>
+#include <smallengine/graphics/canvas.h>
+#include <smallengine/graphics/color.h>
+#include <smallengine/graphics/texture.h>
+
+enum loader_type {
+        LOADER_CANVAS,
+        LOADER_TEXTURE,
+        LOADER_ATLAS,
+        NUM_LOADER_TYPES
+};
+
+/*
+ * a finished request, only the part for its type is set
+ */
+struct loader_result {
+        int id;                         // as returned by the request
+        enum loader_type type;
+        int ok;                         // 0 if the file couldn't be loaded
+        void *user;                     // as passed to the request
+        struct canvas canvas;           // LOADER_CANVAS
+        struct texture texture;         // LOADER_TEXTURE
+        int handle;                     // LOADER_ATLAS, -1 if it didn't fit
+};
+
+/*
+ * start the loader threads, passing 0 starts one. Returns the number started
+ */
+int loader_init(int threads);
+
+/*
+ * cancel everything outstanding, stop the loader threads and free any results
+ * that were never polled
+ */
+void loader_quit(void);
+
+/*
+ * queue an image to be loaded as a canvas. Higher priorities are loaded
+ * first, equal priorities in the order requested. Returns the id of the
+ * request, user is handed back with the result
+ */
+int loader_request_canvas(const char *filename, int priority, void *user);
+
+/*
+ * queue an image to be loaded as a texture, pixels matching trans are
+ * transparent (none are if trans is NULL)
+ */
+int loader_request_texture(const char *filename, struct color *trans,
+                           int priority, void *user);
+
+/*
+ * queue an image to be loaded and added to an atlas, as
+ * loader_request_texture. The handle of the sprite is in the result
+ */
+int loader_request_atlas(const char *filename, struct atlas *a,
+                         struct color *trans, int priority, void *user);
+
+/*
+ * cancel a request, returns 1 if it was cancelled, in which case no result
+ * will be handed back for it, 0 if it has already been polled or doesn't
+ * exist
+ */
+int loader_cancel(int id);
+
+/*
+ * take the next finished request, returns 1 if there was one, 0 if there
+ * wasn't. The result's canvas or texture belongs to the caller
+ */
+int loader_poll(struct loader_result *result);
+
+/*
+ * return the number of requests not yet polled or cancelled
+ */
+int loader_pending(void);
+
+#endif // __loader_h__
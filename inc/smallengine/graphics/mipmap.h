@@ -0,0 +1,81 @@
+#ifndef __mipmap_h__
+#define __mipmap_h__
+
+/*
+ * mipmap
+ *
+ * A chain of successively halved copies of an image, used when drawing an
+ * image smaller than its real size so that only around as many source pixels
+ * are read as there are pixels drawn. Level 0 is the image itself, level n is
+ * the image reduced by 2^n in each direction down to 1x1. Chains belong to
+ * canvases and textures and are rebuilt lazily when their source changes.
+ */
+
+#include <stdint.h>
+
+#include <smallengine/graphics/canvas.h>
+
+struct mipmap {
+        int levels;             // number of reduced levels held
+        enum mip_filter filter;
+        uint32_t version;       // version of the source the levels match
+        int built;              // 0 until the levels have been made once
+        struct canvas *level;   // level[0] is the source reduced by 2
+        uint32_t mask_version;  // edits to the mask of the texture the chain
+                                // belongs to, kept here as every copy of
+                                // the texture shares the chain
+};
+
+/*
+ * Creation and Destruction
+ */
+
+/*
+ * create an empty chain, nothing is allocated for the levels until the chain
+ * is first updated
+ */
+struct mipmap *mipmap_new(void);
+
+/*
+ * free a chain and all of its levels
+ */
+void mipmap_destroy(struct mipmap *mip);
+
+/*
+ * Operations
+ */
+
+/*
+ * return the number of levels below the full size image for an image of the
+ * given size (ie 3 for an 8x8 image: 4x4, 2x2 and 1x1)
+ */
+int mipmap_count_levels(const int w, const int h);
+
+/*
+ * pick the level to sample when drawing a w x h area at dst_w x dst_h, the
+ * chosen level is never smaller than the area drawn
+ */
+int mipmap_select_level(const int w, const int h, 
+                        const int dst_w, const int dst_h);
+
+/*
+ * reduce src into dst, dst must be half the size of src (rounded down, at
+ * least 1). Rows are split across the worker threads
+ */
+void mipmap_downsample(struct canvas src, struct canvas dst, 
+                       enum mip_filter filter);
+
+/*
+ * rebuild the levels from src if they were made from an older version of it
+ * or with a different filter
+ */
+void mipmap_update(struct mipmap *mip, struct canvas src, 
+                   const uint32_t version, enum mip_filter filter);
+
+/*
+ * return the canvas for a level of an up to date chain, level 0 is src
+ * itself and levels past the end of the chain return the smallest level
+ */
+struct canvas mipmap_level(struct mipmap *mip, struct canvas src, int level);
+
+#endif // __mipmap_h__
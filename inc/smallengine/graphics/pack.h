@@ -0,0 +1,178 @@
+#ifndef __pack_h__
+#define __pack_h__
+
+/*
+ * pack
+ *
+ * A single file of canvases, textures, palettes and atlases stored exactly
+ * as they are laid out in memory, so loading one is a matter of pointing at
+ * the file rather than decoding images and rebuilding palettes and masks.
+ * Packs are written offline (see src/programs/assetpack.c) and opened by
+ * mapping the file: what is returned points straight into the mapping, so
+ * pages are only read from disk when they are first drawn. Changes to what
+ * is returned are private to the program and never reach the file.
+ *
+ * Everything returned belongs to the pack and is valid until it is closed.
+ * Canvases, textures and atlases are released with canvas_destroy,
+ * texture_destroy and atlas_destroy as normal, which leave what belongs to
+ * the pack alone. Palettes mustn't be destroyed and are full (no colors can
+ * be added), atlases are read only. The file is in the
+ * byte order of the machine that wrote it, packs from the other order are
+ * refused.
+ *
+ * The file is a header, then the data of each asset, then an index of the
+ * assets. Everything is aligned to PACK_ALIGN bytes.
+ *
+ * A pack can also be compressed once written (see lz.h), a compressed pack
+ * is decompressed whole into memory when opened rather than mapped, which
+ * trades the mapping's lazy loading for a smaller file read at full speed.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include <smallengine/graphics/atlas.h>
+#include <smallengine/graphics/canvas.h>
+#include <smallengine/graphics/palette.h>
+#include <smallengine/graphics/texture.h>
+
+#include <smallengine/sys/file.h>
+
+#define PACK_MAGIC "SEPK"
+#define PACK_VERSION 1
+#define PACK_BYTE_ORDER 0x01020304      // as written by the packing machine
+#define PACK_ALIGN 64
+#define PACK_NAME_SIZE 56               // including the terminating 0
+
+enum pack_type {
+        PACK_CANVAS,
+        PACK_TEXTURE,
+        PACK_PALETTE,
+        PACK_ATLAS,
+        NUM_PACK_TYPES
+};
+
+/*
+ * the start of a pack file
+ */
+struct pack_header {
+        char magic[4];
+        uint32_t byte_order;
+        uint32_t version;
+        uint32_t count;                 // assets in the index
+        uint64_t index;                 // offset of the index in the file
+};
+
+/*
+ * an asset in the index. w, h, colors, count and padding are only used by
+ * the types that need them
+ */
+struct pack_entry {
+        char name[PACK_NAME_SIZE];
+        uint32_t type;                  // enum pack_type
+        uint32_t w;
+        uint32_t h;
+        uint32_t colors;                // palette entries
+        uint32_t count;                 // atlas handles
+        uint32_t padding;               // atlas padding
+        uint64_t offset;                // of the data in the file
+        uint64_t size;                  // bytes of data
+};
+
+/*
+ * an open pack
+ */
+struct pack {
+        struct file_map map;
+        const struct pack_entry *entries;
+        int count;
+};
+
+/*
+ * a pack being written
+ */
+struct pack_writer {
+        FILE *file;
+        struct pack_entry *entries;
+        int count;
+        int capacity;
+        uint64_t offset;                // where the next data goes
+        int ok;                         // 0 once anything has failed
+};
+
+/*
+ * Reading
+ */
+
+/*
+ * open a pack file, compressed or not, count is 0 and nothing can be found if
+ * the file can't be read or isn't a pack
+ */
+struct pack pack_open(const char *filename);
+
+/*
+ * close a pack, everything returned from it becomes invalid
+ */
+void pack_close(struct pack *p);
+
+/*
+ * return the index of a named asset of the given type, -1 if there isn't one
+ */
+int pack_find(const struct pack p, const char *name, enum pack_type type);
+
+/*
+ * return a named canvas, an empty canvas (0x0) if it isn't in the pack
+ */
+struct canvas pack_get_canvas(const struct pack p, const char *name);
+
+/*
+ * return a named texture, it is 0x0 with no mask if it isn't in the pack
+ */
+struct texture pack_get_texture(const struct pack p, const char *name);
+
+/*
+ * return a named palette, it has no colors if it isn't in the pack
+ */
+struct palette pack_get_palette(const struct pack p, const char *name);
+
+/*
+ * return a named atlas (read only), it has no sprites if it isn't in the
+ * pack
+ */
+struct atlas pack_get_atlas(const struct pack p, const char *name);
+
+/*
+ * Writing
+ */
+
+/*
+ * start writing a pack file, ok is 0 if it can't be created
+ */
+struct pack_writer pack_writer(const char *filename);
+
+/*
+ * add an asset to a pack being written under a name of less than
+ * PACK_NAME_SIZE characters, returns 1 on success, 0 on failure
+ */
+int pack_add_canvas(struct pack_writer *w, const char *name,
+                    const struct canvas c);
+int pack_add_texture(struct pack_writer *w, const char *name,
+                     const struct texture tex);
+int pack_add_palette(struct pack_writer *w, const char *name,
+                     const struct palette pal);
+int pack_add_atlas(struct pack_writer *w, const char *name,
+                   const struct atlas a);
+
+/*
+ * write the index and close the file, returns 1 if the whole pack was
+ * written, 0 otherwise
+ */
+int pack_writer_finish(struct pack_writer *w);
+
+/*
+ * rewrite a finished pack file compressed, returns 1 on success, 0 on
+ * failure
+ */
+int pack_compress(const char *filename);
+
+#endif // __pack_h__
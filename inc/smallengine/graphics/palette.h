@@ -5,11 +5,15 @@
  * a data struct to contain colors used for sprites and other objects
  */
 
+#include <stdint.h>
+
 #include <smallengine/graphics/color.h>
 #include <smallengine/graphics/canvas.h>
 
 struct palette {
-        struct color **colors;
+        struct color *colors;   // one after another, indexed by the mask
+        uint32_t *packed;       // the same colors as color_to_RGBA, ready to
+                                // store in the display format
         int size;               // total number of colors that can be stored
         int assigned;           // number of colors in the palette
 };
@@ -29,6 +33,14 @@ struct palette palette(int size);
  */
 struct palette palette_from_canvas(const struct canvas can);
 
+/*
+ * as palette_from_canvas, also storing the palette index of each pixel in
+ * indices (if it isn't NULL), row by row. Both take time in proportion to the
+ * number of pixels however many colors there are
+ */
+struct palette palette_from_canvas_indexed(const struct canvas can,
+                                           int *indices);
+
 /*
  * Palette Destruction
  */
@@ -53,6 +65,21 @@ int palette_check_color(struct palette pal, const struct color col);
  */
 struct color palette_get_by_index(struct palette pal, int index);
 
+/*
+ * get the color of the specified index packed as color_to_RGBA, returns
+ * black if the index is invalid
+ */
+uint32_t palette_get_packed(struct palette pal, int index);
+
+/*
+ * copy the palette's colors converted from one color space to another, for
+ * drawing onto a canvas in a different space. Returns NULL if the spaces are
+ * the same, otherwise the copy is the caller's to mem_free
+ */
+struct color *palette_convert_colors(struct palette pal,
+                                    enum color_space from,
+                                    enum color_space to);
+
 // check if palette contains a range of colors? replace a range of colors?
 
 /*
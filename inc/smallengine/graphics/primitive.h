@@ -0,0 +1,84 @@
+#ifndef __primitive_h__
+#define __primitive_h__
+
+/*
+ * primitive
+ *
+ * Lines and shapes drawn onto a canvas. Every shape is broken into horizontal
+ * spans which are written with canvas_fill_span, each pixel of a shape is
+ * written once so additive and multiplied shapes blend evenly. Shapes are
+ * clipped to the canvas, coordinates are inclusive
+ */
+
+#include <smallengine/graphics/canvas.h>
+#include <smallengine/graphics/color.h>
+#include <smallengine/maths/tuple.h>
+
+/*
+ * Lines
+ */
+
+/*
+ * draw a line between two points, runs of pixels on the same row are
+ * written as one span
+ */
+void primitive_line(struct canvas c, int x1, int y1, int x2, int y2,
+                    struct color col, enum blit_mode mode);
+
+/*
+ * Rectangles
+ */
+
+/*
+ * draw the outline of the rectangle from (x1, y1) to (x2, y2)
+ */
+void primitive_rect(struct canvas c, int x1, int y1, int x2, int y2,
+                    struct color col, enum blit_mode mode);
+
+/*
+ * fill the rectangle from (x1, y1) to (x2, y2)
+ */
+void primitive_rect_fill(struct canvas c, int x1, int y1, int x2, int y2,
+                         struct color col, enum blit_mode mode);
+
+/*
+ * Circles and Ellipses
+ */
+
+/*
+ * draw the outline of a circle of radius r centred on (cx, cy)
+ */
+void primitive_circle(struct canvas c, int cx, int cy, int r,
+                      struct color col, enum blit_mode mode);
+
+/*
+ * fill a circle of radius r centred on (cx, cy)
+ */
+void primitive_circle_fill(struct canvas c, int cx, int cy, int r,
+                           struct color col, enum blit_mode mode);
+
+/*
+ * draw the outline of an ellipse with radii rx and ry centred on (cx, cy)
+ */
+void primitive_ellipse(struct canvas c, int cx, int cy, int rx, int ry,
+                       struct color col, enum blit_mode mode);
+
+/*
+ * fill an ellipse with radii rx and ry centred on (cx, cy)
+ */
+void primitive_ellipse_fill(struct canvas c, int cx, int cy, int rx, int ry,
+                            struct color col, enum blit_mode mode);
+
+/*
+ * Polygons
+ */
+
+/*
+ * fill the polygon made by joining n points (the x and y of each are used),
+ * the last point joins back to the first. Pixels whose centres fall inside
+ * the polygon are filled, self intersecting polygons use the even-odd rule
+ */
+void primitive_polygon_fill(struct canvas c, const point *points, int n,
+                            struct color col, enum blit_mode mode);
+
+#endif // __primitive_h__
@@ -0,0 +1,76 @@
+#ifndef __quantise_h__
+#define __quantise_h__
+
+/*
+ * quantise
+ *
+ * Reducing full colour images to the colors of a palette, for retro palette
+ * modes and indexed textures. A quantiser is built once per palette: it holds
+ * a 32x32x32 cube giving the nearest palette color to every cell of the RGB
+ * cube, so finding the color for a pixel is a single lookup. Canvases can be
+ * quantised directly or with ordered (Bayer) or error diffusion
+ * (Floyd-Steinberg) dithering, the rows are split across the worker threads
+ * (see job.h).
+ */
+
+#include <stdint.h>
+
+#include <smallengine/graphics/canvas.h>
+#include <smallengine/graphics/color.h>
+#include <smallengine/graphics/palette.h>
+
+#define QUANTISE_CUBE_BITS 5
+#define QUANTISE_CUBE_SIZE (1 << QUANTISE_CUBE_BITS)   // cells along an axis
+#define QUANTISE_MAX_COLORS 0xffff
+
+enum dither_mode {
+        DITHER_NONE,
+        DITHER_BAYER,           // 8x8 ordered threshold pattern
+        DITHER_FLOYD_STEINBERG, // error diffusion, each band of rows on its own
+        NUM_DITHER_MODES
+};
+
+struct quantiser {
+        struct color *colors;   // the palette colors when it was built
+        int count;
+        uint16_t *cube;         // nearest color index for each cell
+        double spread;          // strength of ordered dithering, about the
+                                // distance between neighbouring colors
+};
+
+/*
+ * Creation and Destruction
+ */
+
+/*
+ * build a quantiser for the colors of a palette, the palette can be changed or
+ * destroyed afterwards without affecting the quantiser. Only the first
+ * QUANTISE_MAX_COLORS colors are used
+ */
+struct quantiser quantiser(const struct palette pal);
+
+/*
+ * free all memory used by a quantiser
+ */
+void quantiser_destroy(struct quantiser *q);
+
+/*
+ * Operations
+ */
+
+/*
+ * return the index of the palette color nearest to col, -1 if the palette
+ * was empty
+ */
+int quantiser_nearest(const struct quantiser q, const struct color col);
+
+/*
+ * replace every pixel of src with a palette color and write it to dst, which
+ * must be the same size and may be the same canvas. If indices isn't NULL the
+ * palette index of each pixel is stored there too, row by row
+ */
+void quantiser_canvas(const struct quantiser q, const struct canvas src,
+                      struct canvas dst, uint16_t *indices,
+                      enum dither_mode dither);
+
+#endif // __quantise_h__
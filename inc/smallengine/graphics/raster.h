@@ -0,0 +1,124 @@
+#ifndef __raster_h__
+#define __raster_h__
+
+/*
+ * raster
+ *
+ * Software triangle drawing. Triangles are recorded into a raster, then drawn
+ * together: each is sorted into the screen tiles it touches and the tiles are
+ * drawn in parallel on the worker threads (see job.h). Inside a tile pixels
+ * are tested against the three edges of a triangle a few at a time, colours
+ * and texture coordinates are interpolated with perspective correction and an
+ * optional depth buffer hides what is behind. Triangles in a tile are always
+ * drawn in the order they were added, so the result doesn't depend on how the
+ * work was split up.
+ */
+
+#include <smallengine/graphics/canvas.h>
+#include <smallengine/graphics/color.h>
+#include <smallengine/graphics/texture.h>
+#include <smallengine/maths/tuple.h>
+
+struct raster_vertex {
+        point pos;              // x, y in pixels, z is depth from 0.0 (near)
+                                // to 1.0 (far), w is the clip space w, 1.0
+                                // for flat triangles
+        struct color color;
+        double u, v;            // texture coordinates, 0.0-1.0 across
+};
+
+struct raster_tri {
+        struct raster_vertex v[3];
+        struct texture texture;
+        int textured;
+        enum blit_mode mode;
+};
+
+struct raster {
+        struct raster_tri *tris;
+        int size;               // maximum number of triangles
+        int count;
+};
+
+/*
+ * one float depth per pixel, kept alongside the canvas being drawn to
+ */
+struct depth_buffer {
+        int w;
+        int h;
+        float *depth;
+};
+
+/*
+ * Creation and Destruction
+ */
+
+/*
+ * create a raster able to hold size triangles
+ */
+struct raster raster(int size);
+
+/*
+ * free all memory used by a raster
+ */
+void raster_destroy(struct raster *r);
+
+/*
+ * create a depth buffer, every depth starts at 1.0 (furthest)
+ */
+struct depth_buffer depth_buffer(const int w, const int h);
+
+/*
+ * free all memory used by a depth buffer
+ */
+void depth_buffer_destroy(struct depth_buffer *db);
+
+/*
+ * set every depth in the buffer to the given value
+ */
+void depth_buffer_clear(struct depth_buffer db, const float depth);
+
+/*
+ * Recording
+ */
+
+/*
+ * create a vertex
+ */
+struct raster_vertex raster_vertex(point pos, struct color col, 
+                                   double u, double v);
+
+/*
+ * add a triangle coloured by its vertex colours, returns 1 on success, 0 if
+ * the raster is full
+ */
+int raster_triangle(struct raster *r, struct raster_vertex v0, 
+                    struct raster_vertex v1, struct raster_vertex v2,
+                    enum blit_mode mode);
+
+/*
+ * add a textured triangle, the texture colour is multiplied by the vertex
+ * colours and transparent texels are not drawn. returns 1 on success, 0 if
+ * the raster is full or the texture is empty
+ */
+int raster_triangle_textured(struct raster *r, struct raster_vertex v0, 
+                             struct raster_vertex v1, struct raster_vertex v2,
+                             struct texture tex, enum blit_mode mode);
+
+/*
+ * Drawing
+ */
+
+/*
+ * draw every triangle onto dst, testing against and updating the depth buffer
+ * if one is given (it must be the same size as dst), NULL draws without
+ * depth testing. The triangles are kept so they can be drawn again
+ */
+void raster_draw(struct raster *r, struct canvas dst, struct depth_buffer *db);
+
+/*
+ * remove all triangles, ready for the next frame
+ */
+void raster_clear(struct raster *r);
+
+#endif // __raster_h__
@@ -0,0 +1,65 @@
+#ifndef __recorder_h__
+#define __recorder_h__
+
+/*
+ * recorder
+ *
+ * Records every frame shown into one uncompressed video file, either Y4M
+ * (YUV4MPEG2, 4:2:0, readable by ffmpeg and most players) or raw r, g, b, a
+ * bytes. Recording a frame only copies it into one of two buffers, a writer
+ * thread converts it and writes it with one large write while the next frame
+ * is drawn. If the writer falls behind, frames are dropped rather than making
+ * the game wait, and the last frame queued is written again in their place so
+ * the video keeps time.
+ *
+ * While recording, renderer_update_display records each frame it shows.
+ * Recording is started, fed and stopped from one thread.
+ */
+
+#include <stdint.h>
+
+#include <smallengine/graphics/color.h>
+
+enum recorder_format {
+        RECORDER_Y4M,
+        RECORDER_RGBA,
+        NUM_RECORDER_FORMATS
+};
+
+/*
+ * start recording frames of w x h at fps frames per second to a new file,
+ * returns 1 on success, 0 on failure or if already recording
+ */
+int recorder_start(const char *filename, int w, int h, int fps,
+                   enum recorder_format format);
+
+/*
+ * write the frames still queued, close the file and stop recording. Returns
+ * 1 if every frame was written, 0 if any write failed
+ */
+int recorder_stop(void);
+
+/*
+ * return 1 while recording
+ */
+int recorder_active(void);
+
+/*
+ * record a frame of packed pixels in the given layout, pitch is the number of
+ * pixels from one row to the next. Returns 1 if the frame was queued, 0 if it
+ * was dropped or isn't the size being recorded
+ */
+int recorder_frame(const uint32_t *pixels, int w, int h, int pitch,
+                   enum color_layout layout);
+
+/*
+ * return the number of frames in the file so far, including repeats
+ */
+int recorder_frames(void);
+
+/*
+ * return the number of frames dropped because the writer was behind
+ */
+int recorder_dropped(void);
+
+#endif // __recorder_h__
@@ -0,0 +1,75 @@
+#ifndef __reload_h__
+#define __reload_h__
+
+/*
+ * reload
+ *
+ * Hot reloading of images while working on them. Textures and atlas sprites
+ * loaded from image files can be watched: when a file is written a
+ * background thread decodes it again and converts only that asset (building
+ * its palette and mask is the slow part of loading), then reload_apply,
+ * called between frames, swaps the new version in. A texture is never seen
+ * half replaced and nothing else is reloaded.
+ *
+ * The directories of watched files are watched with inotify, which catches
+ * both files written in place and files replaced by renaming over them, as
+ * many editors save. Without inotify reload_init fails and nothing is
+ * watched.
+ *
+ * Watching, unwatching and applying happen on one thread. A watched texture
+ * or atlas must stay where it is until it is unwatched or the reloader quits.
+ */
+
+#include <smallengine/graphics/atlas.h>
+#include <smallengine/graphics/color.h>
+#include <smallengine/graphics/texture.h>
+
+#define RELOAD_MAX_WATCHES 256
+#define RELOAD_PATH_SIZE 256
+
+/*
+ * start watching for changes, returns 1 on success, 0 if files can't be
+ * watched here
+ */
+int reload_init(void);
+
+/*
+ * stop watching everything and free any changes never applied
+ */
+void reload_quit(void);
+
+/*
+ * replace *tex with the image in filename whenever the file changes, freeing
+ * the texture it replaces. Pixels matching trans are transparent (none are if
+ * trans is NULL). Returns an id for reload_unwatch, 0 if the file can't be
+ * watched
+ */
+int reload_watch_texture(const char *filename, struct texture *tex,
+                         struct color *trans);
+
+/*
+ * replace the sprite handle of an atlas with the image in filename whenever
+ * the file changes, as reload_watch_texture
+ */
+int reload_watch_atlas(const char *filename, struct atlas *a, int handle,
+                       struct color *trans);
+
+/*
+ * stop reloading a texture or sprite, anything converted for it and not yet
+ * applied is dropped
+ */
+void reload_unwatch(int id);
+
+/*
+ * swap in everything converted since the last call, returns the number of
+ * textures and sprites replaced. Call once a frame, between drawing
+ */
+int reload_apply(void);
+
+/*
+ * return the number of changed files that couldn't be read, or whose sprite
+ * didn't fit back in its atlas
+ */
+int reload_failed(void);
+
+#endif // __reload_h__
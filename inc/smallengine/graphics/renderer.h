@@ -7,6 +7,14 @@
 
 #include <smallengine/graphics/canvas.h>
 #include <smallengine/graphics/color.h>
+#include <smallengine/graphics/indexed.h>
+#include <smallengine/graphics/palette.h>
+
+enum renderer_mode {
+        RENDERER_COLOR,         // the screen is a canvas of colors
+        RENDERER_INDEXED,       // the screen is 8 bit indices into a palette
+        NUM_RENDERER_MODES
+};
 
 /*
  * takes the dimensions of the window on the screen and the resolution
@@ -18,7 +26,7 @@ int renderer_init(char *title, int win_res_w, int win_res_h,
 
 /*
  * returns the canvas that is written to the main window so it can be
- * manipulated directly
+ * manipulated directly, the canvas is empty in RENDERER_INDEXED mode
  */
 struct canvas renderer_get_window_canvas();
 
@@ -27,12 +35,45 @@ struct canvas renderer_get_window_canvas();
  */
 struct canvas renderer_new_canvas();
 
+/*
+ * switch what the screen is drawn to, in RENDERER_INDEXED mode the window
+ * canvas is replaced by an indexed screen (see renderer_get_indexed_screen)
+ * and the reverse. The old screen's contents are lost, returns 0 on failure
+ */
+int renderer_set_mode(enum renderer_mode mode);
+
+/*
+ * returns the mode the screen is currently drawn in
+ */
+enum renderer_mode renderer_get_mode();
+
+/*
+ * set the palette the indexed screen is shown with. The colors are only
+ * looked up when the display is updated, so fades and flashes cost nothing
+ * per pixel: change the palette's colors or set another between frames. The
+ * palette still belongs to the caller, only the first 255 colors are used
+ */
+void renderer_set_palette(const struct palette pal);
+
+/*
+ * returns the indexed screen so it can be drawn to directly, index
+ * INDEXED_CLEAR_8 shows as black. Only valid in RENDERER_INDEXED mode
+ */
+struct indexed_texture renderer_get_indexed_screen();
+
 /*
  * write the contents of the screen_canvas to the window_surface and update
- * the screen to show the result
+ * the screen to show the result, which is also recorded while a recording is
+ * running (see recorder.h)
  */
 void renderer_update_display();
 
+/*
+ * queue the last frame shown to be written to a bitmap file without waiting
+ * for the write (see capture.h). Returns 0 if the frame was dropped
+ */
+int renderer_capture(const char *filename);
+
 /*
  * destroy SDL allocated memory and shutdown the video subsystem
  */
@@ -0,0 +1,80 @@
+#ifndef __rle_h__
+#define __rle_h__
+
+/*
+ * rle
+ *
+ * Run length encoded sprites, compiled once from a texture or canvas for
+ * sprites that are mostly transparent. Each row is a list of spans, each a
+ * count of transparent pixels to skip followed by a run of opaque pixels,
+ * with the colors of every run stored one after another. Drawing skips the
+ * transparent pixels without looking at them and copies or blends each run
+ * as a whole, so the time taken depends on the pixels that are seen. The
+ * colors are looked up when the sprite is compiled, so later changes to a
+ * texture's palette don't show.
+ */
+
+#include <smallengine/graphics/canvas.h>
+#include <smallengine/graphics/color.h>
+#include <smallengine/graphics/texture.h>
+
+struct rle_span {
+        int skip;               // transparent pixels before the run
+        int len;                // opaque pixels in the run
+};
+
+/*
+ * where each row starts in the spans and pixels
+ */
+struct rle_row {
+        int span;
+        int pixel;
+};
+
+struct rle_sprite {
+        int w;
+        int h;
+        struct rle_row *rows;   // h + 1 entries, the last marks the end
+        struct rle_span *spans;
+        struct color *pixels;   // the opaque pixels, run after run
+        enum color_space space; // of the pixels, as their source
+};
+
+/*
+ * Creation and Destruction
+ */
+
+/*
+ * compile a sprite from a texture, drawing the pixels its mask marks opaque
+ */
+struct rle_sprite rle_sprite_from_texture(const struct texture tex);
+
+/*
+ * compile a sprite from a canvas, pixels matching trans are transparent
+ * (none are if trans is NULL)
+ */
+struct rle_sprite rle_sprite_from_canvas(const struct canvas c,
+                                         struct color *trans);
+
+/*
+ * free all memory used by a sprite
+ */
+void rle_sprite_destroy(struct rle_sprite *s);
+
+/*
+ * Operations
+ */
+
+/*
+ * return the number of opaque pixels in the sprite
+ */
+int rle_sprite_opaque(const struct rle_sprite s);
+
+/*
+ * draw the whole sprite with its top left at dsx, dsy using the specified
+ * blending mode, clipped to the canvas
+ */
+void rle_sprite_blit(const struct rle_sprite s, struct canvas dst, int dsx,
+                     int dsy, enum blit_mode mode);
+
+#endif // __rle_h__
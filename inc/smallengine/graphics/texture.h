@@ -15,7 +15,9 @@
 
 #include <smallengine/graphics/canvas.h>
 #include <smallengine/graphics/color.h>
+#include <smallengine/graphics/coverage.h>
 #include <smallengine/graphics/palette.h>
+#include <smallengine/graphics/mipmap.h>
 
 struct texture {
         int w;
@@ -23,6 +25,11 @@ struct texture {
         struct canvas canvas;   // direct color data
         int *mask;              // indices of associated palette
         struct palette palette; // colors to match indices of the mask
+        struct mipmap *mips;    // reduced copies for scaled drawing
+        struct coverage coverage; // the opaque pixels of the mask, keep up
+                                  // to date with texture_update_coverage
+        int borrowed;           // the pixels, mask, palette and coverage
+                                // belong to something else, such as a pack
 };
 
 /* create a new blank texture */
@@ -34,6 +41,12 @@ struct texture texture(const int width, const int height);
  */
 struct texture texture_from_canvas(const struct canvas c, struct color *trans);
 
+/*
+ * free all memory used by a texture: its canvas, mask, palette, coverage and
+ * reduced copies. A borrowed texture only frees what it made itself
+ */
+void texture_destroy(struct texture *tex);
+
 /*
  * return the value of the mask (palette color index) at the given coordinate
  * a negative value indicates the pixel is transparent
@@ -46,7 +59,21 @@ int texture_read_mask(struct texture tex, int x, int y);
 struct color texture_read_pixel(struct texture tex, int x, int y);
 
 /*
- * blit an area of a texture to a canvas using the specified blending mode
+ * return 1 if the pixel at the given coordinate is drawn, 0 if it is
+ * transparent or outside the texture
+ */
+int texture_hit(const struct texture tex, int x, int y);
+
+/*
+ * update the coverage of an inclusive area after changing the mask directly,
+ * the reduced copies are rebuilt when next drawn
+ */
+void texture_update_coverage(struct texture tex, int x1, int y1, int x2,
+                             int y2);
+
+/*
+ * blit an area of a texture to a canvas using the specified blending mode,
+ * only the opaque runs found in the coverage are visited
  * int srx1: start of blit area x-coord on source
  * int srx2: end of blit area x-coord on source
  * int sry1, sry2: as srx1 and srx2 but for the y coords
@@ -56,5 +83,23 @@ void texture_blit_to_canvas(struct texture tex, int srx1, int sry1, int srx2,
                             int sry2, struct canvas dst, int dsx, int dsy, 
                             enum blit_mode mode);
 
+/*
+ * return a copy of the texture reduced by 2^level in each direction, built
+ * with the given filter from the palette colours. Transparency is kept in the
+ * alpha of each pixel (colors are premultiplied, see color_rgba) and the
+ * copies are only rebuilt when the canvas or palette has changed
+ */
+struct canvas texture_mip(struct texture tex, int level, 
+                          enum mip_filter filter);
+
+/*
+ * blit an area of a texture to a differently sized area of a canvas, the
+ * coordinates are inclusive as with texture_blit_to_canvas. Areas drawn
+ * smaller than their source are read from the reduced copies of the texture,
+ * pixels less than half covered are treated as transparent
+ */
+void texture_blit_scaled(struct texture tex, int srx1, int sry1, int srx2, 
+                         int sry2, struct canvas dst, int dsx1, int dsy1, 
+                         int dsx2, int dsy2, enum blit_mode mode);
 
 #endif // __texture_h__
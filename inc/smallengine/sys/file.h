@@ -0,0 +1,39 @@
+#ifndef __file_h__
+#define __file_h__
+
+/*
+ * file
+ *
+ * Read only access to the whole of a file. Where the system allows it the
+ * file is mapped into memory rather than read, so nothing is copied, pages
+ * are only loaded when they are touched and they are shared with the
+ * system's file cache. Otherwise the file is read into memory in one go.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct file_map {
+        const uint8_t *data;    // the contents, NULL if the file wasn't read
+        size_t size;
+        int mapped;             // 1 if data is a mapping, 0 if it was read
+};
+
+/*
+ * map a file for reading, data is NULL if it can't be opened or is empty
+ */
+struct file_map file_map(const char *filename);
+
+/*
+ * map a file as file_map, the contents can also be written to but the
+ * changes are private to the program and never reach the file. Pages are
+ * only copied when they are first written
+ */
+struct file_map file_map_writable(const char *filename);
+
+/*
+ * release a file mapped with file_map
+ */
+void file_unmap(struct file_map *map);
+
+#endif // __file_h__
@@ -0,0 +1,38 @@
+#ifndef __job_h__
+#define __job_h__
+
+/*
+ * job
+ * a small pool of worker threads used to split loops (rows of a canvas,
+ * screen tiles etc) across the cpu. The calling thread always takes part in
+ * the work so everything still runs, only serially, if the pool was never
+ * started. Jobs shouldn't use mem_alloc/mem_free, every worker would wait on
+ * the heap lock
+ */
+
+typedef void (*job_func)(void *data, int index);
+
+/*
+ * start the worker threads, passing 0 uses one thread per cpu core besides
+ * the calling thread, returns the number of workers started
+ */
+int job_init(int workers);
+
+/*
+ * stop and clean up all worker threads
+ */
+void job_quit(void);
+
+/*
+ * return the number of worker threads running
+ */
+int job_workers(void);
+
+/*
+ * call fn(data, i) for every i from 0 to count - 1, spread across the worker
+ * threads, returns once every call has finished. Indices are handed out in
+ * order but may finish in any order. Calls from inside a job run serially
+ */
+void job_parallel_for(int count, job_func fn, void *data);
+
+#endif // __job_h__
@@ -0,0 +1,83 @@
+#ifndef __lz_h__
+#define __lz_h__
+
+/*
+ * lz
+ *
+ * A fast LZ77 compressor in the style of LZ4: data is a sequence of
+ * literal bytes and copies of up to 64k back, with no entropy coding, so
+ * decompressing is little more than memcpy. Blocks use the LZ4 block layout.
+ *
+ * Files and larger buffers are split into frames of LZ_BLOCK_SIZE blocks
+ * compressed independently, so a frame is compressed and decompressed a
+ * block per job across the worker threads (see job.h). A frame is a header,
+ * the stored size of each block, then the blocks; blocks that don't shrink
+ * are stored as they are. Everything in the header is little endian.
+ *
+ * Packs and bitmaps are read through lz_map_file, so either can be stored
+ * compressed.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <smallengine/sys/file.h>
+
+#define LZ_MAGIC "SELZ"
+#define LZ_VERSION 1
+#define LZ_BLOCK_SIZE (256 * 1024)
+#define LZ_HEADER_SIZE 24
+
+/*
+ * return the most a block of size bytes can compress to
+ */
+size_t lz_bound(size_t size);
+
+/*
+ * compress size bytes into dst, which must have room for lz_bound(size)
+ * bytes. Returns the compressed size, which may be larger than size for data
+ * that doesn't compress
+ */
+size_t lz_compress(const uint8_t *src, size_t size, uint8_t *dst);
+
+/*
+ * decompress a block into dst, never writing more than capacity bytes.
+ * Returns the decompressed size, 0 if the block is corrupt or doesn't fit
+ */
+size_t lz_decompress(const uint8_t *src, size_t size, uint8_t *dst,
+                     size_t capacity);
+
+/*
+ * compress size bytes as a frame, returns the frame (free with mem_free) and
+ * its size in frame_size
+ */
+uint8_t *lz_compress_frame(const uint8_t *src, size_t size,
+                           size_t *frame_size);
+
+/*
+ * return the decompressed size of a frame, 0 if it isn't a frame (or is an
+ * empty one)
+ */
+size_t lz_frame_size(const uint8_t *frame, size_t size);
+
+/*
+ * decompress a frame into dst, which has room for capacity bytes. Returns 1
+ * on success, 0 if the frame is corrupt or doesn't fit
+ */
+int lz_decompress_frame(const uint8_t *frame, size_t size, uint8_t *dst,
+                        size_t capacity);
+
+/*
+ * compress data to a new file as one frame, returns 1 on success, 0 on
+ * failure
+ */
+int lz_write_file(const char *filename, const void *data, size_t size);
+
+/*
+ * map a file as file_map/file_map_writable, if it holds a frame it is
+ * decompressed into memory instead and what's returned is the original
+ * contents. Either way it is released with file_unmap
+ */
+struct file_map lz_map_file(const char *filename, int writable);
+
+#endif // __lz_h__
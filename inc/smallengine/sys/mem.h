@@ -38,7 +38,8 @@ void mem_free_all();
 void mem_destroy(void);
 
 /*
- * Request a portion of memory (replacement for malloc)
+ * Request a portion of memory (replacement for malloc). mem_alloc and
+ * mem_free can be called from any thread, they take a lock around the heap
  */
 void *mem_alloc(size_t size);
 
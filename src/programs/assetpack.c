@@ -0,0 +1,176 @@
+/*
+ * Builds an asset pack (see smallengine/graphics/pack.h) from images, so a
+ * program can map its assets ready to use instead of loading each image.
+ *
+ *      assetpack <out.pack> [-z] [-t rrggbb] type:name=image[,image...] ...
+ *
+ * type is canvas, texture, palette or atlas. Images are .bmp, .ppm or .qoi
+ * files, an atlas takes a list of them and the handle of each sprite is its
+ * place in the list. Pixels of the transparent color (magenta unless -t is
+ * given) are clear in textures and atlases. -z compresses the pack.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <smallengine/sys/arg.h>
+#include <smallengine/sys/job.h>
+#include <smallengine/sys/mem.h>
+#include <smallengine/graphics/atlas.h>
+#include <smallengine/graphics/canvas.h>
+#include <smallengine/graphics/color.h>
+#include <smallengine/graphics/pack.h>
+#include <smallengine/graphics/palette.h>
+#include <smallengine/graphics/texture.h>
+
+#define MAX_ATLAS_SIZE 2048
+#define MAX_IMAGES 1024
+
+static struct color trans;
+
+/*
+ * pack the images into the smallest square atlas they fit, trying each power
+ * of two in turn
+ */
+static int _add_atlas(struct pack_writer *w, const char *name, char *images)
+{
+        struct canvas sprites[MAX_IMAGES];
+        int n = 0, ok = 1;
+
+        for (char *file = strtok(images, ","); file != NULL;
+             file = strtok(NULL, ",")) {
+                if (n == MAX_IMAGES) {
+                        fprintf(stderr, "%s: too many images\n", name);
+                        ok = 0;
+                        break;
+                }
+                sprites[n] = canvas_from_file(file);
+                ok = ok && (sprites[n].w > 0);
+                n++;
+        }
+
+        int added = 0;
+        for (int side = 64; ok && side <= MAX_ATLAS_SIZE; side *= 2) {
+                struct atlas a = atlas(side, side, 65535, 1);
+                for (added = 0; added < n; added++) {
+                        if (atlas_add_canvas(&a, sprites[added], &trans) < 0) {
+                                break;
+                        }
+                }
+
+                if (added == n) {
+                        ok = pack_add_atlas(w, name, a);
+                        printf("%s: %d sprites in %dx%d\n", name, n, side,
+                               side);
+                }
+                atlas_destroy(&a);
+
+                if (added == n) {
+                        break;
+                }
+        }
+
+        if (ok && added < n) {
+                fprintf(stderr, "%s: doesn't fit in %dx%d\n", name,
+                        MAX_ATLAS_SIZE, MAX_ATLAS_SIZE);
+                ok = 0;
+        }
+
+        for (int i = 0; i < n; i++) {
+                canvas_destroy(&sprites[i]);
+        }
+
+        return ok;
+}
+
+/*
+ * add one type:name=image argument to the pack
+ */
+static int _add(struct pack_writer *w, char *spec)
+{
+        char *name = strchr(spec, ':');
+        char *images = (name != NULL) ? strchr(name, '=') : NULL;
+        if (images == NULL) {
+                fprintf(stderr, "%s: expected type:name=image\n", spec);
+                return 0;
+        }
+        *name++ = '\0';
+        *images++ = '\0';
+
+        if (strcmp(spec, "atlas") == 0) {
+                return _add_atlas(w, name, images);
+        }
+
+        struct canvas c = canvas_from_file(images);
+        if (c.w == 0) {
+                return 0;
+        }
+
+        int ok = 1;
+        if (strcmp(spec, "canvas") == 0) {
+                ok = pack_add_canvas(w, name, c);
+        } else if (strcmp(spec, "texture") == 0) {
+                struct texture tex = texture_from_canvas(c, &trans);
+                ok = pack_add_texture(w, name, tex);
+                texture_destroy(&tex);
+        } else if (strcmp(spec, "palette") == 0) {
+                struct palette pal = palette_from_canvas(c);
+                ok = pack_add_palette(w, name, pal);
+                palette_destroy(&pal);
+        } else {
+                fprintf(stderr, "%s: unknown type %s\n", name, spec);
+                ok = 0;
+        }
+
+        canvas_destroy(&c);
+        return ok;
+}
+
+int main(int argc, char *argv[])
+{
+        arg_init(argc, argv);
+        if (arg_number() < 3) {
+                fprintf(stderr, "usage: %s <out.pack> [-z] [-t rrggbb] "
+                        "type:name=image[,image...] ...\n", argv[0]);
+                return 1;
+        }
+
+        mem_init(512 * MEM_MEGABYTE);
+
+        trans = color_rgb(1.0, 0.0, 1.0);
+        int t = arg_check("-t");
+        if (t > 0 && arg_get(t + 1) != NULL) {
+                long rgb = strtol(arg_get(t + 1), NULL, 16);
+                trans = color_rgb(((rgb >> 16) & 0xff) / 255.0,
+                                  ((rgb >> 8) & 0xff) / 255.0,
+                                  (rgb & 0xff) / 255.0);
+        }
+
+        int z = arg_check("-z");
+
+        struct pack_writer w = pack_writer(arg_get(1));
+        int ok = w.ok;
+
+        for (int i = 2; ok && i < arg_number(); i++) {
+                if ((t > 0 && (i == t || i == t + 1)) || i == z) {
+                        continue;
+                }
+                ok = _add(&w, arg_get(i));
+        }
+
+        ok = pack_writer_finish(&w) && ok;
+        if (ok && z > 0) {
+                job_init(0);
+                ok = pack_compress(arg_get(1));
+                job_quit();
+        }
+        if (!ok) {
+                fprintf(stderr, "%s: failed to write pack\n", arg_get(1));
+                remove(arg_get(1));
+        }
+
+        mem_destroy();
+
+        return ok ? 0 : 1;
+}
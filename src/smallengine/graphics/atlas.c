@@ -0,0 +1,526 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <smallengine/graphics/atlas.h>
+#include <smallengine/graphics/canvas.h>
+#include <smallengine/graphics/color.h>
+#include <smallengine/graphics/palette.h>
+#include <smallengine/graphics/texture.h>
+
+#include <smallengine/sys/mem.h>
+
+#define ATLAS_MIN_HANDLES 16
+
+/*
+ * a sprite waiting to be placed when repacking
+ */
+struct atlas_order {
+        int handle;
+        int w;
+        int h;
+};
+
+/*
+ * Skyline
+ */
+
+static void _skyline_reset(struct atlas *a, int w)
+{
+        struct atlas_span all = {0, 0, w};
+        a->skyline[0] = all;
+        a->spans = 1;
+}
+
+/*
+ * find the lowest place a w x h area fits under the given height, the
+ * leftmost of equally low places. Returns 0 if there is nowhere
+ */
+static int _skyline_find(const struct atlas_span *sky, int spans, int width,
+                         int height, int w, int h, int *fx, int *fy)
+{
+        int found = 0;
+
+        for (int i = 0; i < spans; i++) {
+                int x = sky[i].x;
+                if (x + w > width) {
+                        break;
+                }
+
+                // the area rests on the highest span it crosses
+                int y = 0;
+                for (int j = i, covered = 0; covered < w; j++) {
+                        if (sky[j].y > y) {
+                                y = sky[j].y;
+                        }
+                        covered += sky[j].w;
+                }
+
+                if (y + h <= height && (!found || y < *fy)) {
+                        *fx = x;
+                        *fy = y;
+                        found = 1;
+                }
+        }
+
+        return found;
+}
+
+/*
+ * raise the skyline over an area placed at the start of a span
+ */
+static void _skyline_place(struct atlas_span *sky, int *spans, int x, int y,
+                           int w, int h)
+{
+        int i = 0;
+        while (sky[i].x != x) {
+                i++;
+        }
+
+        // spans wholly under the area go, one partly under it is cut short
+        int j = i;
+        while (j < *spans && sky[j].x + sky[j].w <= x + w) {
+                j++;
+        }
+        if (j < *spans && sky[j].x < x + w) {
+                sky[j].w -= x + w - sky[j].x;
+                sky[j].x = x + w;
+        }
+
+        memmove(&sky[i + 1], &sky[j], (*spans - j) * sizeof(struct atlas_span));
+        *spans += 1 - (j - i);
+
+        struct atlas_span top = {x, y + h, w};
+        sky[i] = top;
+
+        // join neighbours of the same height
+        int n = 0;
+        for (int k = 1; k < *spans; k++) {
+                if (sky[k].y == sky[n].y) {
+                        sky[n].w += sky[k].w;
+                } else {
+                        sky[++n] = sky[k];
+                }
+        }
+        *spans = n + 1;
+}
+
+/*
+ * Creation and Destruction
+ */
+
+static struct texture _blank_texture(int w, int h, struct palette pal)
+{
+        struct texture tex = texture(w, h);
+        tex.palette = pal;
+        for (int i = 0; i < w * h; i++) {
+                tex.mask[i] = -1;
+        }
+
+        return tex;
+}
+
+/*
+ * create an empty atlas of the given size, with room for colors palette
+ * entries. padding clear pixels are kept around each sprite so scaled drawing
+ * doesn't pick up its neighbours
+ */
+struct atlas atlas(int w, int h, int colors, int padding)
+{
+        struct atlas a;
+        a.tex = _blank_texture(w, h, palette(colors));
+        a.padding = (padding < 0) ? 0 : padding;
+        a.rects = (struct atlas_rect *)mem_alloc(ATLAS_MIN_HANDLES *
+                                                 sizeof(struct atlas_rect));
+        a.count = 0;
+        a.capacity = ATLAS_MIN_HANDLES;
+
+        // every span is at least a column wide, so there can't be more spans
+        // than columns
+        a.skyline = (struct atlas_span *)mem_alloc((w + 1) *
+                                                   sizeof(struct atlas_span));
+        _skyline_reset(&a, w);
+
+        return a;
+}
+
+/*
+ * free all memory used by an atlas, including its texture
+ */
+void atlas_destroy(struct atlas *a)
+{
+        if (a->rects == NULL) {
+                return;
+        }
+
+        // the texture of a read only atlas is borrowed from the pack it came
+        // from, as are its rects
+        texture_destroy(&a->tex);
+        if (a->skyline != NULL) {
+                mem_free(a->rects);
+                mem_free(a->skyline);
+        }
+
+        a->rects = NULL;
+        a->skyline = NULL;
+        a->count = 0;
+        a->capacity = 0;
+        a->spans = 0;
+}
+
+/*
+ * Operations
+ */
+
+/*
+ * a free handle, reusing those of removed sprites first
+ */
+static int _new_handle(struct atlas *a)
+{
+        for (int i = 0; i < a->count; i++) {
+                if (a->rects[i].w == 0) {
+                        return i;
+                }
+        }
+
+        if (a->count == a->capacity) {
+                struct atlas_rect *rects = (struct atlas_rect *)mem_alloc(
+                                a->capacity * 2 * sizeof(struct atlas_rect));
+                memcpy(rects, a->rects, a->count * sizeof(struct atlas_rect));
+                mem_free(a->rects);
+                a->rects = rects;
+                a->capacity *= 2;
+        }
+
+        return a->count++;
+}
+
+/*
+ * draw a sprite given as a mask into a palette of its own, negative values
+ * being transparent. Its colors are matched to or added to the atlas palette.
+ * It goes at *at if given, otherwise space is found for it and returned in
+ * *at. Returns 1 on success, 0 if there is no room for it or its colors
+ */
+static int _place(struct atlas *a, int w, int h, const int *mask,
+                  const struct palette local, struct atlas_rect *at,
+                  int fixed)
+{
+        if (w <= 0 || h <= 0 || a->skyline == NULL) {
+                return 0;
+        }
+
+        // mark the local colors in use, then find those the atlas already has.
+        // -1 is unused, -2 used but not yet in the atlas palette
+        int *remap = (int *)mem_alloc((local.assigned + 1) * sizeof(int));
+        for (int i = 0; i < local.assigned; i++) {
+                remap[i] = -1;
+        }
+        for (int i = 0; i < w * h; i++) {
+                if (mask[i] >= 0 && mask[i] < local.assigned) {
+                        remap[mask[i]] = -2;
+                }
+        }
+
+        struct palette *pal = &a->tex.palette;
+        int fresh = 0;
+        for (int i = 0; i < local.assigned; i++) {
+                if (remap[i] == -2) {
+                        int index = palette_check_color(*pal, local.colors[i]);
+                        if (index < 0) {
+                                fresh++;
+                        } else {
+                                remap[i] = index;
+                        }
+                }
+        }
+
+        int x = at->x, y = at->y;
+        if (fresh > pal->size - pal->assigned ||
+            (!fixed && !_skyline_find(a->skyline, a->spans, a->tex.w,
+                                      a->tex.h, w + a->padding,
+                                      h + a->padding, &x, &y))) {
+                mem_free(remap);
+                return 0;
+        }
+
+        if (!fixed) {
+                _skyline_place(a->skyline, &a->spans, x, y, w + a->padding,
+                               h + a->padding);
+        }
+
+        for (int i = 0; i < local.assigned; i++) {
+                if (remap[i] == -2) {
+                        // the same color may appear twice in the local palette
+                        remap[i] = palette_check_color(*pal, local.colors[i]);
+                        if (remap[i] < 0) {
+                                // there is room, so this is the new index
+                                remap[i] = palette_add_color(pal,
+                                                             local.colors[i]);
+                        }
+                }
+        }
+
+        struct color *pixels = canvas_pixels_writable(a->tex.canvas);
+        for (int sy = 0; sy < h; sy++) {
+                for (int sx = 0; sx < w; sx++) {
+                        int index = mask[sy * w + sx];
+                        int to = (y + sy) * a->tex.w + x + sx;
+                        if (index < 0 || index >= local.assigned) {
+                                a->tex.mask[to] = -1;
+                                continue;
+                        }
+                        a->tex.mask[to] = remap[index];
+                        pixels[to] = pal->colors[remap[index]];
+                }
+        }
+        texture_update_coverage(a->tex, x, y, x + w - 1, y + h - 1);
+
+        mem_free(remap);
+
+        struct atlas_rect rect = {x, y, w, h};
+        *at = rect;
+
+        return 1;
+}
+
+/*
+ * place a sprite anywhere there is room and give it a new handle, returns -1
+ * if there isn't room
+ */
+static int _insert(struct atlas *a, int w, int h, const int *mask,
+                   const struct palette local)
+{
+        struct atlas_rect rect;
+        if (!_place(a, w, h, mask, local, &rect, 0)) {
+                return -1;
+        }
+
+        int handle = _new_handle(a);
+        a->rects[handle] = rect;
+
+        return handle;
+}
+
+/*
+ * copy a canvas into the atlas, pixels matching trans are transparent (none
+ * are if trans is NULL). Returns the handle of the sprite, -1 if there is no
+ * room for it or its colors, in which case the atlas is unchanged
+ */
+int atlas_add_canvas(struct atlas *a, const struct canvas c,
+                     struct color *trans)
+{
+        if (c.w <= 0 || c.h <= 0) {
+                return -1;
+        }
+
+        int *mask = (int *)mem_alloc(c.w * c.h * sizeof(int));
+        struct palette local = palette_from_canvas_indexed(c, mask);
+
+        if (trans != NULL) {
+                for (int i = 0; i < c.w * c.h; i++) {
+                        if (color_equal(local.colors[mask[i]], *trans)) {
+                                mask[i] = -1;
+                        }
+                }
+        }
+
+        int handle = _insert(a, c.w, c.h, mask, local);
+
+        palette_destroy(&local);
+        mem_free(mask);
+
+        return handle;
+}
+
+/*
+ * copy a texture into the atlas as atlas_add_canvas, its transparent pixels
+ * stay transparent
+ */
+int atlas_add_texture(struct atlas *a, const struct texture tex)
+{
+        return _insert(a, tex.w, tex.h, tex.mask, tex.palette);
+}
+
+/*
+ * make an area of the atlas clear
+ */
+static void _clear(struct atlas *a, struct atlas_rect r)
+{
+        for (int y = r.y; y < r.y + r.h; y++) {
+                for (int x = r.x; x < r.x + r.w; x++) {
+                        a->tex.mask[y * a->tex.w + x] = -1;
+                }
+        }
+        texture_update_coverage(a->tex, r.x, r.y, r.x + r.w - 1,
+                                r.y + r.h - 1);
+}
+
+/*
+ * replace a sprite with a texture, keeping its handle. A sprite of the same
+ * size is drawn over the old one, otherwise it is placed in new space and the
+ * old space is a gap until the atlas is repacked. Returns 1 on success, 0 if
+ * there is no room for it or its colors, leaving the sprite unchanged
+ */
+int atlas_replace_texture(struct atlas *a, int handle,
+                          const struct texture tex)
+{
+        struct atlas_rect old = atlas_get_rect(*a, handle);
+        if (old.w == 0) {
+                return 0;
+        }
+
+        struct atlas_rect rect = old;
+        int same = (tex.w == old.w && tex.h == old.h);
+        if (!_place(a, tex.w, tex.h, tex.mask, tex.palette, &rect, same)) {
+                return 0;
+        }
+
+        if (!same) {
+                _clear(a, old);
+                a->rects[handle] = rect;
+        }
+
+        return 1;
+}
+
+/*
+ * clear a sprite from the atlas and free its handle. Its space is only
+ * reused once the atlas is repacked
+ */
+void atlas_remove(struct atlas *a, int handle)
+{
+        struct atlas_rect r = atlas_get_rect(*a, handle);
+        if (r.w == 0 || a->skyline == NULL) {
+                return;
+        }
+
+        _clear(a, r);
+
+        struct atlas_rect none = {0, 0, 0, 0};
+        a->rects[handle] = none;
+}
+
+/*
+ * tallest first, then widest, then in handle order so repacking is repeatable
+ */
+static int _taller(const void *p, const void *q)
+{
+        const struct atlas_order *a = (const struct atlas_order *)p;
+        const struct atlas_order *b = (const struct atlas_order *)q;
+
+        if (a->h != b->h) {
+                return b->h - a->h;
+        }
+        if (a->w != b->w) {
+                return b->w - a->w;
+        }
+        return a->handle - b->handle;
+}
+
+/*
+ * place every sprite again, tallest first, in an atlas of the given size
+ * (which may be the current one). Handles keep referring to the same sprites.
+ * Returns 1 on success, 0 if they don't all fit, leaving the atlas unchanged
+ */
+int atlas_repack(struct atlas *a, int w, int h)
+{
+        if (w <= 0 || h <= 0 || a->skyline == NULL) {
+                return 0;
+        }
+
+        struct atlas_order *order = (struct atlas_order *)mem_alloc(
+                        (a->count + 1) * sizeof(struct atlas_order));
+        int live = 0;
+        for (int i = 0; i < a->count; i++) {
+                if (a->rects[i].w > 0) {
+                        struct atlas_order o = {i, a->rects[i].w,
+                                                a->rects[i].h};
+                        order[live++] = o;
+                }
+        }
+        qsort(order, live, sizeof(struct atlas_order), _taller);
+
+        struct atlas packed = *a;
+        packed.skyline = (struct atlas_span *)mem_alloc((w + 1) *
+                                                sizeof(struct atlas_span));
+        packed.rects = (struct atlas_rect *)mem_alloc(a->capacity *
+                                                sizeof(struct atlas_rect));
+        memcpy(packed.rects, a->rects, a->count * sizeof(struct atlas_rect));
+        _skyline_reset(&packed, w);
+
+        for (int i = 0; i < live; i++) {
+                int pw = order[i].w + a->padding;
+                int ph = order[i].h + a->padding;
+                int x, y;
+                if (!_skyline_find(packed.skyline, packed.spans, w, h, pw, ph,
+                                   &x, &y)) {
+                        mem_free(packed.skyline);
+                        mem_free(packed.rects);
+                        mem_free(order);
+                        return 0;
+                }
+
+                _skyline_place(packed.skyline, &packed.spans, x, y, pw, ph);
+                packed.rects[order[i].handle].x = x;
+                packed.rects[order[i].handle].y = y;
+        }
+
+        // move every sprite's mask and colors to its new place
+        packed.tex = _blank_texture(w, h, a->tex.palette);
+        const struct color *from = canvas_pixels(a->tex.canvas);
+        struct color *to = canvas_pixels_writable(packed.tex.canvas);
+
+        for (int i = 0; i < live; i++) {
+                struct atlas_rect src = a->rects[order[i].handle];
+                struct atlas_rect dst = packed.rects[order[i].handle];
+                for (int y = 0; y < src.h; y++) {
+                        int s = (src.y + y) * a->tex.w + src.x;
+                        int d = (dst.y + y) * w + dst.x;
+                        memcpy(&packed.tex.mask[d], &a->tex.mask[s],
+                               src.w * sizeof(int));
+                        memcpy(&to[d], &from[s], src.w * sizeof(struct color));
+                }
+        }
+        texture_update_coverage(packed.tex, 0, 0, w - 1, h - 1);
+
+        // the palette carries over to the repacked texture
+        struct palette none = {NULL, NULL, 0, 0};
+        a->tex.palette = none;
+        texture_destroy(&a->tex);
+        mem_free(a->skyline);
+        mem_free(a->rects);
+        mem_free(order);
+        *a = packed;
+
+        return 1;
+}
+
+/*
+ * return the area of a sprite in the atlas texture, all 0 for an invalid
+ * handle
+ */
+struct atlas_rect atlas_get_rect(const struct atlas a, int handle)
+{
+        struct atlas_rect none = {0, 0, 0, 0};
+        if (handle < 0 || handle >= a.count) {
+                return none;
+        }
+
+        return a.rects[handle];
+}
+
+/*
+ * blit a whole sprite to a canvas using the specified blending mode, as
+ * texture_blit_to_canvas with the sprite's area of the atlas texture
+ */
+void atlas_blit(const struct atlas a, int handle, struct canvas dst, int dsx,
+                int dsy, enum blit_mode mode)
+{
+        struct atlas_rect r = atlas_get_rect(a, handle);
+        if (r.w == 0) {
+                return;
+        }
+
+        texture_blit_to_canvas(a.tex, r.x, r.y, r.x + r.w - 1, r.y + r.h - 1,
+                               dst, dsx, dsy, mode);
+}
@@ -0,0 +1,456 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <smallengine/graphics/batch.h>
+#include <smallengine/graphics/canvas.h>
+#include <smallengine/graphics/color.h>
+#include <smallengine/graphics/coverage.h>
+#include <smallengine/graphics/texture.h>
+#include <smallengine/graphics/palette.h>
+
+#include <smallengine/sys/mem.h>
+#include <smallengine/sys/job.h>
+
+#define BATCH_TILE_SIZE 64      // destination is drawn in tiles this wide
+#define BATCH_KEY_BITS 24       // 8 bits of layer, 16 bits of depth
+#define BATCH_RADIX_BITS 8
+
+/*
+ * everything the tile workers share
+ */
+struct batch_job {
+        struct batch *b;
+        struct color *pixels;   // destination
+        int w, h;               // destination size
+        int tiles_x;
+        enum color_space space; // destination color space
+};
+
+/*
+ * Creation and Destruction
+ */
+
+/*
+ * create a batch able to hold size commands
+ */
+struct batch batch(int size)
+{
+        struct batch b = {NULL, NULL, NULL, NULL, size, 0, 0};
+
+        b.cmds = (struct batch_cmd *)mem_alloc(size * sizeof(struct batch_cmd));
+        b.order = (uint32_t *)mem_alloc(size * sizeof(uint32_t));
+        b.scratch = (uint32_t *)mem_alloc(size * sizeof(uint32_t));
+        b.items = (struct batch_item *)mem_alloc(size * 
+                                                 sizeof(struct batch_item));
+
+        return b;
+}
+
+/*
+ * free all memory used by a batch
+ */
+void batch_destroy(struct batch *b)
+{
+        mem_free(b->cmds);
+        mem_free(b->order);
+        mem_free(b->scratch);
+        mem_free(b->items);
+        b->size = 0;
+        b->count = 0;
+        b->drawn = 0;
+}
+
+/*
+ * Recording
+ */
+
+static int _clamp(int val, int min, int max)
+{
+        if (val < min) { return min; }
+        if (val > max) { return max; }
+        return val;
+}
+
+static uint32_t _key(int layer, int depth)
+{
+        return (uint32_t)_clamp(layer, 0, BATCH_MAX_LAYER) << 16 |
+               (uint32_t)_clamp(depth, 0, BATCH_MAX_DEPTH);
+}
+
+/*
+ * take the next free command, NULL if the batch is full
+ */
+static struct batch_cmd *_next(struct batch *b, enum batch_type type,
+                               int layer, int depth, enum blit_mode mode)
+{
+        if (b->count >= b->size) {
+                return NULL;
+        }
+
+        struct batch_cmd *cmd = &b->cmds[b->count++];
+        cmd->type = type;
+        cmd->mode = mode;
+        cmd->key = _key(layer, depth);
+        
+        return cmd;
+}
+
+/*
+ * clip a source area to the source size, moving the destination to match,
+ * returns 0 if nothing is left
+ */
+static int _clip_source(struct batch_cmd *cmd, int w, int h, int srx1, 
+                        int sry1, int srx2, int sry2, int dsx, int dsy)
+{
+        int x1 = _clamp(srx1, 0, w - 1), x2 = _clamp(srx2, 0, w - 1);
+        int y1 = _clamp(sry1, 0, h - 1), y2 = _clamp(sry2, 0, h - 1);
+        if (w <= 0 || h <= 0 || x1 > x2 || y1 > y2) {
+                return 0;
+        }
+
+        cmd->sx = x1;
+        cmd->sy = y1;
+        cmd->x1 = dsx + (x1 - srx1);
+        cmd->y1 = dsy + (y1 - sry1);
+        cmd->x2 = cmd->x1 + (x2 - x1);
+        cmd->y2 = cmd->y1 + (y2 - y1);
+
+        return 1;
+}
+
+/*
+ * fill the area from (x1, y1) to (x2, y2) with a color
+ */
+int batch_fill(struct batch *b, int layer, int depth, int x1, int y1, 
+               int x2, int y2, struct color col, enum blit_mode mode)
+{
+        struct batch_cmd *cmd = _next(b, BATCH_FILL, layer, depth, mode);
+        if (cmd == NULL) {
+                return 0;
+        }
+
+        cmd->x1 = x1;
+        cmd->y1 = y1;
+        cmd->x2 = x2;
+        cmd->y2 = y2;
+        cmd->color = col;
+
+        return 1;
+}
+
+/*
+ * blit an area of a canvas, the canvas must not change until the batch is
+ * drawn
+ */
+int batch_blit(struct batch *b, int layer, int depth, struct canvas src,
+               int srx1, int sry1, int srx2, int sry2, int dsx, int dsy,
+               enum blit_mode mode)
+{
+        struct batch_cmd *cmd = _next(b, BATCH_BLIT, layer, depth, mode);
+        if (cmd == NULL) {
+                return 0;
+        }
+
+        cmd->canvas = src;
+        if (!_clip_source(cmd, src.w, src.h, srx1, sry1, srx2, sry2, 
+                          dsx, dsy)) {
+                b->count--;
+        }
+
+        return 1;
+}
+
+/*
+ * draw an area of a texture, transparent pixels are skipped
+ */
+int batch_sprite(struct batch *b, int layer, int depth, struct texture tex,
+                 int srx1, int sry1, int srx2, int sry2, int dsx, int dsy,
+                 enum blit_mode mode)
+{
+        struct batch_cmd *cmd = _next(b, BATCH_SPRITE, layer, depth, mode);
+        if (cmd == NULL) {
+                return 0;
+        }
+
+        cmd->texture = tex;
+        if (!_clip_source(cmd, tex.w, tex.h, srx1, sry1, srx2, sry2, 
+                          dsx, dsy)) {
+                b->count--;
+        }
+
+        return 1;
+}
+
+/*
+ * Sorting and Merging
+ */
+
+/*
+ * least significant digit radix sort of the command indices by key, stable
+ * so commands with equal keys keep the order they were added in
+ */
+static void _sort(struct batch *b)
+{
+        uint32_t *in = b->order, *out = b->scratch;
+        int i;
+
+        for (i = 0; i < b->count; i++) {
+                in[i] = i;
+        }
+
+        for (int shift = 0; shift < BATCH_KEY_BITS; shift += BATCH_RADIX_BITS) {
+                int count[1 << BATCH_RADIX_BITS] = {0};
+                uint32_t mask = (1 << BATCH_RADIX_BITS) - 1;
+
+                for (i = 0; i < b->count; i++) {
+                        count[(b->cmds[in[i]].key >> shift) & mask]++;
+                }
+
+                int total = 0;
+                for (i = 0; i < (1 << BATCH_RADIX_BITS); i++) {
+                        int c = count[i];
+                        count[i] = total;
+                        total += c;
+                }
+
+                for (i = 0; i < b->count; i++) {
+                        uint32_t digit = (b->cmds[in[i]].key >> shift) & mask;
+                        out[count[digit]++] = in[i];
+                }
+
+                uint32_t *tmp = in;
+                in = out;
+                out = tmp;
+        }
+
+        // an odd number of passes leaves the result in the scratch buffer
+        if (in != b->order) {
+                memcpy(b->order, in, b->count * sizeof(uint32_t));
+        }
+}
+
+/*
+ * two fills can become one if they are the same and their areas line up
+ * exactly side by side or one on top of the other
+ */
+static int _merge_fill(struct batch_item *prev, const struct batch_cmd *pc,
+                       const struct batch_cmd *cmd)
+{
+        if (pc->type != BATCH_FILL || cmd->type != BATCH_FILL ||
+            pc->mode != cmd->mode || 
+            memcmp(&pc->color, &cmd->color, sizeof(struct color)) != 0) {
+                return 0;
+        }
+
+        if (prev->y1 == cmd->y1 && prev->y2 == cmd->y2) {
+                if (prev->x2 + 1 == cmd->x1) {
+                        prev->x2 = cmd->x2;
+                        return 1;
+                }
+                if (cmd->x2 + 1 == prev->x1) {
+                        prev->x1 = cmd->x1;
+                        return 1;
+                }
+        }
+
+        if (prev->x1 == cmd->x1 && prev->x2 == cmd->x2) {
+                if (prev->y2 + 1 == cmd->y1) {
+                        prev->y2 = cmd->y2;
+                        return 1;
+                }
+                if (cmd->y2 + 1 == prev->y1) {
+                        prev->y1 = cmd->y1;
+                        return 1;
+                }
+        }
+
+        return 0;
+}
+
+/*
+ * build the draw list from the sorted commands
+ */
+static void _merge(struct batch *b)
+{
+        b->drawn = 0;
+
+        for (int i = 0; i < b->count; i++) {
+                struct batch_cmd *cmd = &b->cmds[b->order[i]];
+
+                if (b->drawn > 0) {
+                        struct batch_item *prev = &b->items[b->drawn - 1];
+                        struct batch_cmd *pc = &b->cmds[prev->cmd];
+                        if (_merge_fill(prev, pc, cmd)) {
+                                continue;
+                        }
+                }
+
+                struct batch_item *item = &b->items[b->drawn];
+                item->cmd = b->order[i];
+                item->x1 = cmd->x1;
+                item->y1 = cmd->y1;
+                item->x2 = cmd->x2;
+                item->y2 = cmd->y2;
+
+                b->drawn++;
+        }
+}
+
+/*
+ * Drawing
+ */
+
+static void _draw_sprite(const struct batch_job *job, 
+                         const struct batch_item *item, 
+                         const struct batch_cmd *cmd,
+                         int x1, int y1, int x2, int y2)
+{
+        // the palette colors are contiguous, so the mask indexes them directly
+        struct texture tex = cmd->texture;
+        const struct color *lut = (cmd->colors != NULL) ? cmd->colors :
+                                                          tex.palette.colors;
+        struct color black = color_rgb(0.0, 0.0, 0.0);
+        int sx1 = cmd->sx + (x1 - item->x1);
+        int sx2 = sx1 + x2 - x1;
+
+        for (int y = y1; y <= y2; y++) {
+                int sy = cmd->sy + y - item->y1;
+                const int *mask = tex.mask + sy * tex.w;
+                struct color *out = job->pixels + y * job->w + x1 - sx1;
+
+                // only the opaque runs of the row are visited
+                int x = sx1, start, len;
+                while ((len = coverage_span(tex.coverage, sy, x, sx2,
+                                            &start)) > 0) {
+                        for (int i = start; i < start + len; i++) {
+                                int index = mask[i];
+                                struct color col =
+                                        (index < tex.palette.assigned) ?
+                                        lut[index] : black;
+                                if (cmd->mode == BLIT_ABS) {
+                                        out[i] = col;
+                                } else {
+                                        canvas_fill_span(&out[i], col, 1,
+                                                         cmd->mode);
+                                }
+                        }
+                        x = start + len;
+                }
+        }
+}
+
+/*
+ * draw every item overlapping the tile, clipped to it
+ */
+static void _draw_tile(void *data, int tile)
+{
+        struct batch_job *job = (struct batch_job *)data;
+        struct batch *b = job->b;
+
+        int tx1 = (tile % job->tiles_x) * BATCH_TILE_SIZE;
+        int ty1 = (tile / job->tiles_x) * BATCH_TILE_SIZE;
+        int tx2 = _clamp(tx1 + BATCH_TILE_SIZE - 1, 0, job->w - 1);
+        int ty2 = _clamp(ty1 + BATCH_TILE_SIZE - 1, 0, job->h - 1);
+
+        for (int i = 0; i < b->drawn; i++) {
+                const struct batch_item *item = &b->items[i];
+                const struct batch_cmd *cmd = &b->cmds[item->cmd];
+
+                int x1 = (item->x1 > tx1) ? item->x1 : tx1;
+                int y1 = (item->y1 > ty1) ? item->y1 : ty1;
+                int x2 = (item->x2 < tx2) ? item->x2 : tx2;
+                int y2 = (item->y2 < ty2) ? item->y2 : ty2;
+                if (x1 > x2 || y1 > y2) {
+                        continue;
+                }
+
+                int n = x2 - x1 + 1;
+                int y;
+
+                switch (cmd->type) {
+                        case BATCH_FILL:
+                                for (y = y1; y <= y2; y++) {
+                                        canvas_fill_span(job->pixels + 
+                                                y * job->w + x1,
+                                                cmd->color, n, cmd->mode);
+                                }
+                                break;
+
+                        case BATCH_BLIT:
+                        {
+                                const struct color *src = 
+                                                canvas_pixels(cmd->canvas);
+                                enum color_space from =
+                                        canvas_color_space(cmd->canvas);
+                                for (y = y1; y <= y2; y++) {
+                                        int sy = cmd->sy + (y - item->y1);
+                                        int sx = cmd->sx + (x1 - item->x1);
+                                        canvas_blend_span_convert(
+                                                job->pixels + y * job->w + x1,
+                                                src + sy * cmd->canvas.w + sx,
+                                                n, cmd->mode, from,
+                                                job->space);
+                                }
+                                break;
+                        }
+
+                        case BATCH_SPRITE:
+                                _draw_sprite(job, item, cmd, x1, y1, x2, y2);
+                                break;
+
+                        default:
+                                break;
+                }
+        }
+}
+
+/*
+ * sort, merge and draw every recorded command onto dst, the commands are kept
+ * so the same batch can be drawn again
+ */
+void batch_draw(struct batch *b, struct canvas dst)
+{
+        if (b->count == 0 || dst.w <= 0 || dst.h <= 0) {
+                return;
+        }
+
+        _sort(b);
+        _merge(b);
+
+        int tiles_x = (dst.w + BATCH_TILE_SIZE - 1) / BATCH_TILE_SIZE;
+        int tiles_y = (dst.h + BATCH_TILE_SIZE - 1) / BATCH_TILE_SIZE;
+        struct batch_job job = {b, canvas_pixels_writable(dst), dst.w, dst.h,
+                                tiles_x, canvas_color_space(dst)};
+
+        // sprites from another color space have their palettes converted
+        // once here, the workers can't allocate
+        for (int i = 0; i < b->drawn; i++) {
+                struct batch_cmd *cmd = &b->cmds[b->items[i].cmd];
+                if (cmd->type == BATCH_SPRITE) {
+                        cmd->colors = palette_convert_colors(
+                                        cmd->texture.palette,
+                                        canvas_color_space(cmd->texture.canvas),
+                                        job.space);
+                }
+        }
+
+        job_parallel_for(tiles_x * tiles_y, _draw_tile, &job);
+
+        for (int i = 0; i < b->drawn; i++) {
+                struct batch_cmd *cmd = &b->cmds[b->items[i].cmd];
+                if (cmd->type == BATCH_SPRITE && cmd->colors != NULL) {
+                        mem_free(cmd->colors);
+                        cmd->colors = NULL;
+                }
+        }
+}
+
+/*
+ * remove all commands, ready for the next frame
+ */
+void batch_clear(struct batch *b)
+{
+        b->count = 0;
+        b->drawn = 0;
+}
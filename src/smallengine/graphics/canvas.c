@@ -2,13 +2,85 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 #include <errno.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include <smallengine/graphics/canvas.h>
 #include <smallengine/graphics/color.h>
+#include <smallengine/graphics/mipmap.h>
 
+#include <smallengine/sys/file.h>
+#include <smallengine/sys/lz.h>
 #include <smallengine/sys/mem.h>
 
+/*
+ * These structs are given here as they shouldn't be used outside of this
+ * module.
+ */
+
+/*
+ * pixel storage, the pixels follow the header in the same allocation
+ */
+struct canvas_buffer {
+        int refs;               // number of images using these pixels
+        struct color *pixels;
+};
+
+/*
+ * an image is what a struct canvas refers to, several images can point at the
+ * same buffer, an image about to be written takes its own buffer first
+ */
+struct canvas_image {
+        struct canvas_buffer *buffer;
+        uint32_t version;       // bumped on every write
+        struct mipmap *mips;    // reduced copies, made when first needed
+        enum color_space space; // what the pixel values mean
+};
+
+static struct canvas_buffer *_buffer_new(const int w, const int h)
+{
+        struct canvas_buffer *buf = (struct canvas_buffer *)mem_alloc(
+                sizeof(struct canvas_buffer) +
+                (size_t)w * h * sizeof(struct color));
+
+        buf->refs = 1;
+        buf->pixels = (struct color *)(buf + 1);
+
+        return buf;
+}
+
+static void _buffer_release(struct canvas_buffer *buf)
+{
+        if (--buf->refs == 0) {
+                mem_free(buf);
+        }
+}
+
+/*
+ * give the image its own buffer if it is sharing one, the pixel values are
+ * only copied across if they are going to be kept
+ */
+static void _unshare(struct canvas c, int keep_pixels)
+{
+        struct canvas_buffer *old = c.image->buffer;
+        if (old->refs == 1) {
+                return;
+        }
+
+        struct canvas_buffer *new = _buffer_new(c.w, c.h);
+        if (keep_pixels) {
+                memcpy(new->pixels, old->pixels, 
+                       (size_t)c.w * c.h * sizeof(struct color));
+        }
+
+        _buffer_release(old);
+        c.image->buffer = new;
+}
+
 /*
  * Creation and Initialization
  */
@@ -20,16 +92,212 @@ struct canvas canvas(const int w, const int h)
 {
         struct canvas c = {w, h, NULL};
 
-        c.pixels = (struct color *)mem_alloc(w * h * sizeof(struct color));
+        c.image = (struct canvas_image *)mem_alloc(sizeof(struct canvas_image));
+        c.image->buffer = _buffer_new(w, h);
+        c.image->version = 0;
+        c.image->mips = NULL;
+        c.image->space = COLOR_SRGB;
 
+        struct color *pixels = c.image->buffer->pixels;
         int i;
         for (i = 0; i < w * h; i++) {
-                c.pixels[i] = color_rgb(0.0, 0.0, 0.0);
+                pixels[i] = color_rgb(0.0, 0.0, 0.0);
         }
 
         return c;
 }
 
+/*
+ * Create a canvas that draws on the pixels given rather than its own, such as
+ * those of a mapped file. They aren't freed with the canvas, so they must
+ * outlive it and every copy of it
+ */
+struct canvas canvas_from_pixels(struct color *pixels, const int w,
+                                 const int h)
+{
+        struct canvas c = {w, h, NULL};
+
+        // only the header is allocated, so releasing it leaves the pixels
+        struct canvas_buffer *buf = (struct canvas_buffer *)mem_alloc(
+                                                sizeof(struct canvas_buffer));
+        buf->refs = 1;
+        buf->pixels = pixels;
+
+        c.image = (struct canvas_image *)mem_alloc(sizeof(struct canvas_image));
+        c.image->buffer = buf;
+        c.image->version = 0;
+        c.image->mips = NULL;
+        c.image->space = COLOR_SRGB;
+
+        return c;
+}
+
+/*
+ * Create a duplicate of a canvas, this is O(1) as the pixels are shared and
+ * only cloned when either canvas is first written to
+ */
+struct canvas canvas_copy(const struct canvas c)
+{
+        struct canvas dup = {c.w, c.h, NULL};
+        if (c.image == NULL) {
+                return dup;
+        }
+
+        dup.image = (struct canvas_image *)mem_alloc(
+                                                sizeof(struct canvas_image));
+        dup.image->buffer = c.image->buffer;
+        dup.image->buffer->refs++;
+        dup.image->version = 0;
+        dup.image->mips = NULL;
+        dup.image->space = c.image->space;
+
+        return dup;
+}
+
+/*
+ * Destruction
+ */
+
+/*
+ * release a canvas, the pixels are freed once no other canvas shares them
+ */
+void canvas_destroy(struct canvas *c)
+{
+        if (c->image == NULL) {
+                return;
+        }
+
+        if (c->image->mips != NULL) {
+                mipmap_destroy(c->image->mips);
+        }
+
+        _buffer_release(c->image->buffer);
+        mem_free(c->image);
+
+        c->image = NULL;
+        c->w = 0;
+        c->h = 0;
+}
+
+/*
+ * Pixel Access
+ */
+
+/*
+ * returns 1 if the canvas pixels are currently shared with another canvas
+ */
+int canvas_is_shared(const struct canvas c)
+{
+        return (c.image != NULL && c.image->buffer->refs > 1);
+}
+
+/*
+ * return the pixels of the canvas for reading, row by row from the top left,
+ * the pointer is valid until the canvas is next written to
+ */
+const struct color *canvas_pixels(const struct canvas c)
+{
+        return (c.image != NULL) ? c.image->buffer->pixels : NULL;
+}
+
+/*
+ * return the pixels of the canvas for writing, the pixels are cloned first if
+ * they are shared with another canvas
+ */
+struct color *canvas_pixels_writable(struct canvas c)
+{
+        if (c.image == NULL) {
+                return NULL;
+        }
+
+        _unshare(c, 1);
+        c.image->version++;
+        return c.image->buffer->pixels;
+}
+
+/*
+ * return a count of the writes made to the canvas, anything built from the
+ * canvas is out of date once this changes
+ */
+uint32_t canvas_version(const struct canvas c)
+{
+        return (c.image != NULL) ? c.image->version : 0;
+}
+
+/*
+ * return the color space the canvas pixels are in, COLOR_SRGB unless changed
+ */
+enum color_space canvas_color_space(const struct canvas c)
+{
+        return (c.image != NULL) ? c.image->space : COLOR_SRGB;
+}
+
+/*
+ * mark the canvas pixels as being in the given color space without changing
+ * them
+ */
+void canvas_set_color_space(struct canvas c, enum color_space space)
+{
+        if (c.image != NULL) {
+                c.image->space = space;
+        }
+}
+
+/*
+ * convert the canvas pixels to the given color space
+ */
+void canvas_convert_color_space(struct canvas c, enum color_space space)
+{
+        if (c.image == NULL || c.image->space == space) {
+                return;
+        }
+
+        struct color *pixels = canvas_pixels_writable(c);
+        color_span_convert(pixels, pixels, c.w * c.h, c.image->space, space);
+        c.image->space = space;
+}
+
+/*
+ * convert n pixels to packed ARGB, encoding linear canvases to sRGB as files
+ * and displays expect
+ */
+static void _to_argb(const struct canvas c, const struct color *pixels,
+                     uint32_t *dst, int n)
+{
+        if (c.image->space == COLOR_LINEAR) {
+                color_span_to_srgb32(pixels, dst, n, COLOR_ARGB);
+        } else {
+                color_span_to_rgba32(pixels, dst, n, COLOR_ARGB);
+        }
+}
+
+/*
+ * bring the reduced copies of the canvas up to date and return the chain
+ */
+static struct mipmap *_update_mips(struct canvas c, enum mip_filter filter)
+{
+        if (c.image->mips == NULL) {
+                c.image->mips = mipmap_new();
+        }
+
+        mipmap_update(c.image->mips, c, c.image->version, filter);
+        return c.image->mips;
+}
+
+/*
+ * return a copy of the canvas reduced by 2^level in each direction, built
+ * with the given filter. The copies are kept with the canvas and only rebuilt
+ * once the canvas has changed, the returned canvas must not be destroyed
+ */
+struct canvas canvas_mip(struct canvas c, int level, enum mip_filter filter)
+{
+        if (level <= 0 || c.image == NULL) {
+                return c;
+        }
+
+        return mipmap_level(_update_mips(c, filter), c, level);
+}
+
 /*
  * Operations
  */
@@ -43,6 +311,30 @@ static int _within_bounds(struct canvas c, int x, int y)
         return 1;
 }
 
+/*
+ * combine col with the pixel at dst according to the blit mode
+ */
+static inline void _blend(struct color *dst, struct color col, 
+                          enum blit_mode mode)
+{
+        switch (mode) {
+                case BLIT_ABS: 
+                        *dst = col;
+                        break;
+
+                case BLIT_ADD:
+                        *dst = color_add(*dst, col);
+                        break;
+
+                case BLIT_MUL:
+                        *dst = color_multiply(*dst, col);
+                        break;
+
+                default:
+                        break;
+        }
+}
+
 /*
  * Read the value of a given pixel, the color (0, 0, 0) will be returned if a
  * pixel coordinate outside the canvas area was requested
@@ -53,7 +345,7 @@ struct color canvas_read_pixel(struct canvas canvas, const int x, const int y)
                 return color_rgb(0.0, 0.0, 0.0);
         }
 
-        return canvas.pixels[y * canvas.w + x];
+        return canvas.image->buffer->pixels[y * canvas.w + x];
 }
         
 
@@ -68,52 +360,135 @@ const int canvas_write_pixel(struct canvas can, int x, int y, struct color col,
                 return 0;
         }
 
-        // temporary storage for blending
-        struct color new;
+        if (mode < 0 || mode >= NUM_BLIT_MODES) {
+                return 0;
+        }
+
+        struct color *pixels = canvas_pixels_writable(can);
+        _blend(&pixels[y * can.w + x], col, mode);
+                        
+        return 1;
+}
+
+/*
+ * Fill the canvas with the color given
+ */
+void canvas_fill(struct canvas canvas, struct color color)
+{
+        if (canvas.image == NULL) {
+                return;
+        }
+
+        // every pixel is overwritten so a shared buffer needn't be cloned
+        _unshare(canvas, 0);
+        canvas.image->version++;
+
+        canvas_fill_span(canvas.image->buffer->pixels, color, 
+                         canvas.w * canvas.h, BLIT_ABS);
+}
+
+/*
+ * Set every pixel in the canvas to black (0, 0, 0)
+ */
+void canvas_clear(struct canvas canvas)
+{
+        canvas_fill(canvas, color_rgb(0.0, 0.0, 0.0));
+}
+
+/*
+ * Spans
+ */
+
+/*
+ * blend col into n pixels starting at dst according to the blit mode
+ */
+void canvas_fill_span(struct color *dst, struct color col, int n,
+                      enum blit_mode mode)
+{
+        int i;
 
         switch (mode) {
-                case BLIT_ABS: 
-                        can.pixels[y * can.w + x] = col;
+                case BLIT_ABS:
+                        for (i = 0; i < n; i++) {
+                                dst[i] = col;
+                        }
                         break;
 
                 case BLIT_ADD:
-                        new = color_add(can.pixels[y * can.w + x], col);
-                        can.pixels[y * can.w + x] = new;
-                        break;
-
                 case BLIT_MUL:
-                        new = color_multiply(can.pixels[y * can.w + x], col);
-                        can.pixels[y * can.w + x] = new;
+#ifdef __SSE2__
+                {
+                        // blended colours always come out opaque, as with
+                        // color_add and color_multiply
+                        __m128d c_rg = _mm_loadu_pd(&col.r);
+                        __m128d c_ba = _mm_loadu_pd(&col.b);
+                        __m128d opaque = _mm_set_pd(1.0, 0.0);
+
+                        for (i = 0; i < n; i++) {
+                                __m128d rg = _mm_loadu_pd(&dst[i].r);
+                                __m128d ba = _mm_loadu_pd(&dst[i].b);
+                                if (mode == BLIT_ADD) {
+                                        rg = _mm_add_pd(rg, c_rg);
+                                        ba = _mm_add_pd(ba, c_ba);
+                                } else {
+                                        rg = _mm_mul_pd(rg, c_rg);
+                                        ba = _mm_mul_pd(ba, c_ba);
+                                }
+                                _mm_storeu_pd(&dst[i].r, rg);
+                                _mm_storeu_pd(&dst[i].b, 
+                                              _mm_move_sd(opaque, ba));
+                        }
+                }
+#else
+                        for (i = 0; i < n; i++) {
+                                _blend(&dst[i], col, mode);
+                        }
+#endif
                         break;
 
                 default:
-                        return 0;
-                        break;  // yeah, I know...
+                        break;
         }
-                        
-        return 1;
 }
 
 /*
- * Fill the canvas with the color given
+ * blend n pixels from src into n pixels starting at dst
  */
-void canvas_fill(struct canvas canvas, struct color color)
+void canvas_blend_span(struct color *dst, const struct color *src, int n,
+                       enum blit_mode mode)
 {
-        int i;
-        for (i = 0; i < canvas.w * canvas.h; i++) {
-                canvas.pixels[i] = color;
+        if (mode == BLIT_ABS) {
+                memmove(dst, src, n * sizeof(struct color));
+                return;
+        }
+
+        for (int i = 0; i < n; i++) {
+                _blend(&dst[i], src[i], mode);
         }
 }
 
+#define CANVAS_CONVERT_SPAN 64  // pixels converted at a time
+
 /*
- * Set every pixel in the canvas to black (0, 0, 0)
+ * as canvas_blend_span, converting src from one color space to another on
+ * the way. Nothing is converted if the spaces are the same
  */
-void canvas_clear(struct canvas canvas)
+void canvas_blend_span_convert(struct color *dst, const struct color *src,
+                               int n, enum blit_mode mode,
+                               enum color_space from, enum color_space to)
 {
-        int i;
-        struct color black = color_rgb(0.0, 0.0, 0.0);
-        for (i = 0; i < canvas.w * canvas.h; i++) {
-                canvas.pixels[i] = black;
+        if (from == to) {
+                canvas_blend_span(dst, src, n, mode);
+                return;
+        }
+
+        // converted a piece at a time on the stack, so workers can use it
+        struct color buf[CANVAS_CONVERT_SPAN];
+        for (int i = 0; i < n; i += CANVAS_CONVERT_SPAN) {
+                int len = (n - i < CANVAS_CONVERT_SPAN) ? n - i :
+                                                          CANVAS_CONVERT_SPAN;
+                color_span_convert(buf, src + i, len, from, to);
+                canvas_blend_span(dst + i, buf, len, mode);
         }
 }
 
@@ -173,14 +548,100 @@ static int _clip_blit_y(struct canvas src, int sry1, int sry2,
 void canvas_blit(struct canvas src, int srx1, int sry1, int srx2, int sry2,
                  struct canvas dst, int dsx, int dsy, enum blit_mode mode)
 {
+        if (src.image == NULL || dst.image == NULL) {
+                return;
+        }
+
         int dx = _clip_blit_x(src, srx1, srx2, dst, dsx);
         int dy = _clip_blit_y(src, sry1, sry2, dst, dsy);
 
+        // source pixels are brought into the destination's color space
+        enum color_space from = src.image->space, to = dst.image->space;
+
         int x, y;
         for (x = 0; x <= dx; x++) {
                 for (y = 0; y <= dy; y++) {
-                        canvas_write_pixel(dst, dsx+x, dsy+y, 
-                                canvas_read_pixel(src, srx1+x, sry1+y), mode);
+                        struct color col = canvas_read_pixel(src, srx1+x,
+                                                             sry1+y);
+                        if (from != to) {
+                                col = color_convert(col, from, to);
+                        }
+                        canvas_write_pixel(dst, dsx+x, dsy+y, col, mode);
+                }
+        }
+}
+
+/*
+ * blit an area of one canvas to a differently sized area of another, the
+ * coordinates are inclusive as with canvas_blit. Areas drawn smaller than
+ * their source are read from the canvas's reduced copies so the cost is in
+ * proportion to the area drawn
+ */
+void canvas_blit_scaled(struct canvas src, int srx1, int sry1, int srx2, 
+                        int sry2, struct canvas dst, int dsx1, int dsy1, 
+                        int dsx2, int dsy2, enum blit_mode mode)
+{
+        int sw = srx2 - srx1 + 1, sh = sry2 - sry1 + 1;
+        int dw = dsx2 - dsx1 + 1, dh = dsy2 - dsy1 + 1;
+        if (sw <= 0 || sh <= 0 || dw <= 0 || dh <= 0 || src.image == NULL ||
+            dst.image == NULL) {
+                return;
+        }
+
+        int level = mipmap_select_level(sw, sh, dw, dh);
+        // keep whichever filter the reduced copies were last built with
+        struct canvas lvl = src;
+        if (level > 0) {
+                struct mipmap *mips = src.image->mips;
+                lvl = canvas_mip(src, level, 
+                                 (mips != NULL) ? mips->filter : MIP_BOX);
+        }
+
+        // clip the destination area, the source follows from the scaling
+        int x1 = (dsx1 < 0) ? 0 : dsx1;
+        int y1 = (dsy1 < 0) ? 0 : dsy1;
+        int x2 = (dsx2 >= dst.w) ? dst.w - 1 : dsx2;
+        int y2 = (dsy2 >= dst.h) ? dst.h - 1 : dsy2;
+        if (x1 > x2 || y1 > y2) {
+                return;
+        }
+
+        // step through the level in 16.16 fixed point, sampling pixel
+        // centres. Levels are rounded down in size, so positions are scaled
+        // to the level rather than shifted by it
+        double scale_x = (double)lvl.w / src.w, scale_y = (double)lvl.h / src.h;
+        double step_x = scale_x * sw / dw, step_y = scale_y * sh / dh;
+        int64_t step_u = (int64_t)(step_x * 65536.0);
+        int64_t step_v = (int64_t)(step_y * 65536.0);
+        step_u += (step_u == 0);
+        step_v += (step_v == 0);
+        int64_t u0 = (int64_t)floor((srx1 * scale_x +
+                                     (x1 - dsx1 + 0.5) * step_x) * 65536.0);
+        int64_t v = (int64_t)floor((sry1 * scale_y +
+                                    (y1 - dsy1 + 0.5) * step_y) * 65536.0);
+
+        const struct color *in = canvas_pixels(lvl);
+        struct color *out = canvas_pixels_writable(dst);
+        enum color_space from = src.image->space, to = dst.image->space;
+
+        for (int y = y1; y <= y2; y++, v += step_v) {
+                int ly = (int)(v >> 16);
+                if (ly < 0 || ly >= lvl.h) {
+                        continue;
+                }
+
+                const struct color *row = in + ly * lvl.w;
+                int64_t u = u0;
+                for (int x = x1; x <= x2; x++, u += step_u) {
+                        int lx = (int)(u >> 16);
+                        if (lx < 0 || lx >= lvl.w) {
+                                continue;
+                        }
+                        struct color col = row[lx];
+                        if (from != to) {
+                                col = color_convert(col, from, to);
+                        }
+                        _blend(&out[y * dst.w + x], col, mode);
                 }
         }
 }
@@ -220,92 +681,253 @@ void canvas_test(struct canvas src)
  * Exporting
  */
 
+#define PPM_LINE_PIXELS 5       // ppm lines must stay under 70 characters
+
 /*
- * Create a header for a ppm file, it will follow this format:
- * "P3
- *  WW HH
- *  255"
- * Where WW and HH are strings of the decimal representations of the width and
- * height respectively (not restricted to 2 chars) (P3 is the file format
- * signature and 255 is the max colour component value (R, G and B = 0-255)
+ * write a value of 0-255 as decimal digits, returning the end of the digits
  */
-static char *_create_ppm_header(const struct canvas c)
+static char *_format_component(char *ptr, uint32_t v)
 {
-        // get header length:
-        int wc = 1, hc = 1, w = c.w, h = c.h;
-        while ((w /= 10) > 0) {
-                wc++;
+        if (v >= 100) {
+                *ptr++ = '0' + v / 100;
+                v %= 100;
+                *ptr++ = '0' + v / 10;
+        } else if (v >= 10) {
+                *ptr++ = '0' + v / 10;
         }
+        *ptr++ = '0' + v % 10;
 
-        while ((h /= 10) > 0) {
-                hc++;
+        return ptr;
+}
+
+/*
+ * format one row of ARGB pixels as ppm pixel data into text, returning the
+ * number of bytes to write. P3 rows are numbers separated by spaces with a
+ * line break every few pixels, ie: 255 0 0 252 152 0 212 124 0, P6 rows are
+ * the r, g and b bytes
+ */
+static int _format_ppm_row(const uint32_t *row, int w, char *text,
+                           enum ppm_format format)
+{
+        char *ptr = text;
+
+        if (format == PPM_BINARY) {
+                for (int x = 0; x < w; x++) {
+                        *ptr++ = (row[x] >> 16) & 0xff;
+                        *ptr++ = (row[x] >> 8) & 0xff;
+                        *ptr++ = row[x] & 0xff;
+                }
+                return ptr - text;
+        }
+
+        for (int x = 0; x < w; x++) {
+                ptr = _format_component(ptr, (row[x] >> 16) & 0xff);
+                *ptr++ = ' ';
+                ptr = _format_component(ptr, (row[x] >> 8) & 0xff);
+                *ptr++ = ' ';
+                ptr = _format_component(ptr, row[x] & 0xff);
+                int end = (x % PPM_LINE_PIXELS == PPM_LINE_PIXELS - 1 ||
+                           x == w - 1);
+                *ptr++ = end ? '\n' : ' ';
+        }
+
+        return ptr - text;
+}
+
+/*
+ * Export the current canvas to a ppm file with the given name, the file is
+ * written a row at a time. Returns 1 on success, 0 otherwise
+ */
+const int canvas_export_to_ppm(const struct canvas c, const char *filename,
+                               enum ppm_format format)
+{
+        if (c.image == NULL) {
+                return 0;
         }
 
-        #define SIG "P3\n"
-        #define END "255\n"
+        FILE *file = fopen(filename, "wb");
+        if (file == NULL) {
+                fprintf(stderr, "%s\n", strerror(errno));
+                return 0;
+        }
 
-        // "P3\n" + (wc + ' ' + hc copy string safe+ '\n') + "255\n" + '\0'
-        int len = 3 + wc + 1 + hc + 1 + 4 + 1;
-        char *header = (char *)mem_alloc(len);
-        char *ptr = header;
+        // "P3\n" or "P6\n", then "WW HH\n255\n"
+        fprintf(file, "%s\n%d %d\n255\n", 
+                (format == PPM_BINARY) ? "P6" : "P3", c.w, c.h);
+
+        // one row of packed pixels followed by its text, 12 characters per
+        // pixel is the most P3 can need
+        uint32_t *row = (uint32_t *)mem_alloc(c.w * (sizeof(uint32_t) + 12));
+        char *text = (char *)(row + c.w);
+        const struct color *pixels = canvas_pixels(c);
+
+        int ok = 1;
+        for (int y = 0; y < c.h && ok; y++) {
+                _to_argb(c, pixels + y * c.w, row, c.w);
+                int len = _format_ppm_row(row, c.w, text, format);
+                ok = (fwrite(text, 1, len, file) == len);
+        }
 
-        ptr += sprintf(ptr, SIG);
-        ptr += sprintf(ptr, "%d %d\n", c.w, c.h);
-        ptr += sprintf(ptr, END);
+        mem_free(row);
+        if (fclose(file) != 0 || !ok) {
+                fprintf(stderr, "Unable to write ppm %s\n", filename);
+                return 0;
+        }
 
-        return header; 
+        return 1;
 }
 
 /*
- * Return a string formatted to the ppm pixel data format.
- * ie: 255 0 0 252 152 0 212 124 0 22 76
- * where each number is an r, g or b component
- * restricts each line to 12 components before a newline (ppm has a 70 char
- * legacy limit)
+ * read the next number in a ppm file, skipping whitespace and comments in the
+ * header. Returns -1 if there isn't one
  */
-static char *_create_ppm_data(struct canvas c)
+static int _read_ppm_number(FILE *file, int header)
 {
-        int num_pix = c.w * c.h;
+        int ch = fgetc(file);
+        while (ch != EOF) {
+                if (header && ch == '#') {
+                        while (ch != '\n' && ch != EOF) {
+                                ch = fgetc(file);
+                        }
+                } else if (ch != ' ' && ch != '\t' && ch != '\n' && 
+                           ch != '\r') {
+                        break;
+                }
+                ch = fgetc(file);
+        }
 
-        // reserve space assuming each R, G and B will be 3 chars long
-        // and for a space between them
-        char *data = (char *)mem_alloc(num_pix * 3 * 4);
-        char *ptr = data;
+        if (ch < '0' || ch > '9') {
+                return -1;
+        }
 
-        // ppm files like a line break every 70 chars (legacy stuff), I'll
-        // put one every 5 pixels (60 chars worst case scenario, 20 best)
-        #define LINE_BREAK 5
-        for (int i = 0; i < c.w * c.h; i++) {
-                char end = (i % LINE_BREAK == (LINE_BREAK-1)) ? '\n' : ' ';
-                ptr += sprintf(ptr, "%s%c", color_to_ppm_string(c.pixels[i]), end);
+        int val = 0;
+        while (ch >= '0' && ch <= '9') {
+                if (val > 0xffffff) {
+                        return -1;
+                }
+                val = val * 10 + (ch - '0');
+                ch = fgetc(file);
+        }
+        // the single whitespace character after the header is eaten here,
+        // anything else belongs to the pixels
+        if (ch != EOF && !header) {
+                ungetc(ch, file);
         }
 
-        return data;   
+        return val;
 }
 
+/*
+ * read P6 pixel data a row at a time, components are one byte each when the
+ * maximum value is below 256 and two (most significant first) otherwise
+ */
+static int _read_ppm_binary(FILE *file, struct canvas c, int max)
+{
+        int bytes = (max < 256) ? 1 : 2;
+        int row_len = c.w * 3 * bytes;
+        uint8_t *row = (uint8_t *)mem_alloc(row_len);
+        struct color *pixels = canvas_pixels_writable(c);
+
+        int ok = 1;
+        for (int y = 0; y < c.h && ok; y++) {
+                ok = (fread(row, 1, row_len, file) == row_len);
+                for (int x = 0; x < c.w && ok; x++) {
+                        int comp[3];
+                        for (int i = 0; i < 3; i++) {
+                                const uint8_t *in = row + (x * 3 + i) * bytes;
+                                comp[i] = (bytes == 1) ? in[0] : 
+                                                         in[0] << 8 | in[1];
+                        }
+                        pixels[y * c.w + x] = color_rgb(
+                                                (double)comp[0] / max,
+                                                (double)comp[1] / max,
+                                                (double)comp[2] / max);
+                }
+        }
+
+        mem_free(row);
+        return ok;
+}
 
 /*
- * Export the current canvas to a ppm file with the given name
- * Returns 1 on success, 0 otherwise
+ * read P3 pixel data, the numbers can be spread over lines in any way
  */
-const int export_to_ppm(const struct canvas c, const char *filename)
+static int _read_ppm_ascii(FILE *file, struct canvas c, int max)
 {
-        char *header = _create_ppm_header(c);
-        char *data = _create_ppm_data(c);
+        struct color *pixels = canvas_pixels_writable(c);
+
+        for (int i = 0; i < c.w * c.h; i++) {
+                int r = _read_ppm_number(file, 0);
+                int g = _read_ppm_number(file, 0);
+                int b = _read_ppm_number(file, 0);
+                if (r < 0 || g < 0 || b < 0) {
+                        return 0;
+                }
+                pixels[i] = color_rgb((double)r / max, (double)g / max, 
+                                      (double)b / max);
+        }
 
-        FILE *file = fopen(filename, "w");
+        return 1;
+}
+
+/*
+ * Create a canvas from a P3 or P6 ppm file, an empty canvas (0x0, which can
+ * still be passed to canvas_destroy) is returned if the file can't be read
+ */
+struct canvas canvas_from_ppm(const char *filename)
+{
+        struct canvas image = {0, 0, NULL};
+
+        FILE *file = fopen(filename, "rb");
         if (file == NULL) {
                 fprintf(stderr, "%s\n", strerror(errno));
-                return 0;
+                return image;
+        }
+
+        int sig[2] = {fgetc(file), fgetc(file)};
+        int binary = (sig[0] == 'P' && sig[1] == '6');
+        int w = _read_ppm_number(file, 1);
+        int h = _read_ppm_number(file, 1);
+        int max = _read_ppm_number(file, 1);
+
+        if (sig[0] != 'P' || (sig[1] != '3' && sig[1] != '6') || 
+            w <= 0 || h <= 0 || max <= 0 || max > 0xffff) {
+                fprintf(stderr, "%s is not a ppm file\n", filename);
+                fclose(file);
+                return image;
+        }
+
+        if ((size_t)w * h > CANVAS_MAX_PIXELS) {
+                fprintf(stderr, "%s is too large\n", filename);
+                fclose(file);
+                return image;
+        }
+
+        // binary pixel data has a known size, so a short file is caught
+        // before the canvas is made
+        if (binary) {
+                size_t need = (size_t)w * h * 3 * ((max < 256) ? 1 : 2);
+                long at = ftell(file);
+                long end = (fseek(file, 0, SEEK_END) == 0) ? ftell(file) : -1;
+                if (at < 0 || end < at || (size_t)(end - at) < need ||
+                    fseek(file, at, SEEK_SET) != 0) {
+                        fprintf(stderr, "%s is truncated\n", filename);
+                        fclose(file);
+                        return image;
+                }
         }
 
-        fprintf(file, "%s%s", header, data);
+        image = canvas(w, h);
+        int ok = binary ? _read_ppm_binary(file, image, max) :
+                          _read_ppm_ascii(file, image, max);
         fclose(file);
 
-        mem_free(header);
-        mem_free(data);
-        
-        return 1;
+        if (!ok) {
+                fprintf(stderr, "%s is truncated\n", filename);
+                canvas_destroy(&image);
+        }
+
+        return image;
 }
 
 #define BMP_FILE_INFO_SIZE 14
@@ -314,16 +936,14 @@ const int export_to_ppm(const struct canvas c, const char *filename)
 /*
  * BMP files start with a 14 header containing various info about the file
  */
-static void *_create_bmp_file_header(const struct canvas c)
-{        
-        char *buf = mem_alloc(BMP_HEADER_SIZE);
-        
+static void _create_bmp_file_header(uint8_t *buf, int w, int h)
+{
         // signature
         memcpy(buf, "BM", 2);
 
         // the total size of the header for bitmaps varies, but this will
         // always use 54, rest of the file is 4 bytes per pixel (ARGB)
-        uint32_t word32 = BMP_HEADER_SIZE + c.w * c.h * 4;
+        uint32_t word32 = BMP_HEADER_SIZE + w * h * 4;
         memcpy(buf+2, &word32, sizeof(word32));
         word32 = 0;       // next 4 bytes must be 0
         memcpy(buf+6, &word32, sizeof(word32));
@@ -332,9 +952,9 @@ static void *_create_bmp_file_header(const struct canvas c)
 
         word32 = BMP_HEADER_SIZE - BMP_FILE_INFO_SIZE;
         memcpy(buf+BMP_FILE_INFO_SIZE, &word32, sizeof(word32));
-        word32 = c.w;
+        word32 = w;
         memcpy(buf+BMP_FILE_INFO_SIZE+4, &word32, sizeof(word32));
-        word32 = c.h * -1;      // windows bmp writes stuff upside down...  
+        word32 = h * -1;        // windows bmp writes stuff upside down...
         memcpy(buf+BMP_FILE_INFO_SIZE+8, &word32, sizeof(word32));
         uint16_t wee_num = 1;   // biPlanes
         memcpy(buf+BMP_FILE_INFO_SIZE+12, &wee_num, sizeof(wee_num));
@@ -352,102 +972,707 @@ static void *_create_bmp_file_header(const struct canvas c)
         memcpy(buf+BMP_FILE_INFO_SIZE+32, &word32, sizeof(word32));
         // significant colours (?), usually 0 apparently
         memcpy(buf+BMP_FILE_INFO_SIZE+36, &word32, sizeof(word32));
-
-        return buf;
 }
 
-static void *_create_bmp_data(const struct canvas c)
+/*
+ * Write pixels already packed as COLOR_ARGB to a bitmap file, top row first.
+ * Files named .lz are compressed (see lz.h). Returns 1 on success, 0 on
+ * failure
+ */
+const int canvas_export_argb_to_bmp(const uint32_t *argb, int w, int h,
+                                    const char *filename)
 {
-        uint32_t *buf = mem_alloc(c.w * c.h * 4);
-        for (int i = 0; i < c.w * c.h; i++) {
-                uint32_t val = color_to_ARGB(c.pixels[i]);
-                *(buf+i) = val;
+        uint8_t head[BMP_HEADER_SIZE];
+        _create_bmp_file_header(head, w, h);
+
+        // a compressed file is put together in memory and written as a frame
+        const char *ext = strrchr(filename, '.');
+        if (ext != NULL && strcmp(ext, ".lz") == 0) {
+                size_t size = BMP_HEADER_SIZE + (size_t)w * h * 4;
+                uint8_t *bmp = (uint8_t *)mem_alloc(size);
+                memcpy(bmp, head, BMP_HEADER_SIZE);
+                memcpy(bmp + BMP_HEADER_SIZE, argb, size - BMP_HEADER_SIZE);
+
+                int ok = lz_write_file(filename, bmp, size);
+                mem_free(bmp);
+                return ok;
         }
 
-        return buf;
+        FILE *file = fopen(filename, "wb");
+        if (file == NULL) {
+                fprintf(stderr, "Unable to create bmp\n");
+                fprintf(stderr, "%s\n", strerror(errno));
+                return 0;
+        }
+
+        int ok = (fwrite(head, BMP_HEADER_SIZE, 1, file) == 1);
+        ok = ok && (fwrite(argb, 4, (size_t)w * h, file) == (size_t)w * h);
+        ok = (fclose(file) == 0) && ok;
+
+        return ok;
 }
 
-/* 
- * Write the contents of a canvas to a bitmap file - this is mostly
- * for testing and more robust, portable file i/o code should be
- * written for screenshots etc. Returns 1 on success, 0 on failure
+/*
+ * Write the contents of a canvas to a bitmap file. Returns 1 on success, 0
+ * on failure
  */
 const int canvas_export_to_bmp(const struct canvas c, const char *filename)
 {
-        FILE *file = fopen(filename, "w");
-        if (file == NULL) {
-                fprintf(stderr, "Unable to create bmp\n");
-                fprintf(stderr, "%s\n", strerror(errno));
+        if (c.image == NULL) {
                 return 0;
         }
 
-        void *bmp_head = _create_bmp_file_header(c);
-        void *bmp_data = _create_bmp_data(c);
+        uint32_t *argb = mem_alloc(c.w * c.h * 4);
+        _to_argb(c, canvas_pixels(c), argb, c.w * c.h);
 
-        fwrite(bmp_head, BMP_HEADER_SIZE, 1, file);
-        fwrite(bmp_data, (c.w * c.h * 4), 1, file);
+        int ok = canvas_export_argb_to_bmp(argb, c.w, c.h, filename);
+        mem_free(argb);
 
-        fclose(file);
+        return ok;
+}
 
-        return 1;
+/*
+ * little endian values from the file, which may not be aligned
+ */
+static uint32_t _le16(const uint8_t *p)
+{
+        return p[0] | p[1] << 8;
+}
+
+static uint32_t _le32(const uint8_t *p)
+{
+        return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 |
+               (uint32_t)p[3] << 24;
+}
+
+/*
+ * position and width of the bits of a mask, for BI_BITFIELDS images
+ */
+static void _bmp_mask_shift(uint32_t mask, int *shift, uint32_t *max)
+{
+        *shift = 0;
+        *max = 0;
+        if (mask == 0) {
+                return;
+        }
+        while (!(mask & 1)) {
+                mask >>= 1;
+                (*shift)++;
+        }
+        *max = mask;
+}
+
+/*
+ * store a pixel held as bytes b, g, r from the lowest, alpha is always 1.0
+ * as in color_rgb
+ */
+static inline void _store_bgr(struct color *out, uint32_t bgr)
+{
+#ifdef __SSE2__
+        // spread the bytes into 32 bit lanes, swap red and blue and convert
+        // two lanes at a time, then replace the unused top lane with alpha
+        const __m128i zero = _mm_setzero_si128();
+        const __m128d scale = _mm_set1_pd(1.0 / 255.0);
+        __m128i v = _mm_cvtsi32_si128(bgr);
+        v = _mm_unpacklo_epi16(_mm_unpacklo_epi8(v, zero), zero);
+        v = _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 0, 1, 2));
+
+        __m128d rg = _mm_mul_pd(_mm_cvtepi32_pd(v), scale);
+        __m128d bx = _mm_mul_pd(_mm_cvtepi32_pd(
+                        _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2))), scale);
+        _mm_storeu_pd(&out->r, rg);
+        _mm_storeu_pd(&out->b, _mm_move_sd(_mm_set1_pd(1.0), bx));
+#else
+        *out = color_rgb(((bgr >> 16) & 0xff) / 255.0,
+                         ((bgr >> 8) & 0xff) / 255.0, (bgr & 0xff) / 255.0);
+#endif
 }
 
 /*
- * create a canvas from a bitmap file
+ * everything needed to read the pixels once the headers have been checked
+ */
+struct bmp_info {
+        int w;
+        int h;
+        int top_down;
+        int bpp;
+        int stride;                     // bytes per row including padding
+        const uint8_t *pixels;          // the first row in the file
+        struct color table[256];        // the colors of an 8 bit image
+        int masked;                     // 32 bit with non standard masks
+        int shift[3];                   // red, green and blue
+        uint32_t max[3];
+};
+
+/*
+ * convert a row of the file into canvas pixels
+ */
+static void _bmp_row(const struct bmp_info *bmp, const uint8_t *in,
+                     struct color *out)
+{
+        if (bmp->bpp == 8) {
+                for (int x = 0; x < bmp->w; x++) {
+                        out[x] = bmp->table[in[x]];
+                }
+        } else if (bmp->bpp == 24) {
+                for (int x = 0; x < bmp->w; x++, in += 3) {
+                        _store_bgr(&out[x], in[0] | in[1] << 8 | in[2] << 16);
+                }
+        } else if (!bmp->masked) {
+                for (int x = 0; x < bmp->w; x++, in += 4) {
+                        _store_bgr(&out[x], _le32(in));
+                }
+        } else {
+                for (int x = 0; x < bmp->w; x++, in += 4) {
+                        uint32_t px = _le32(in);
+                        double comp[3] = {0.0, 0.0, 0.0};
+                        for (int i = 0; i < 3; i++) {
+                                if (bmp->max[i] != 0) {
+                                        comp[i] = (double)((px >> bmp->shift[i])
+                                                  & bmp->max[i]) / bmp->max[i];
+                                }
+                        }
+                        out[x] = color_rgb(comp[0], comp[1], comp[2]);
+                }
+        }
+}
+
+/*
+ * check the headers of a bitmap held in memory, returns an error message or
+ * NULL if the pixels can be read
+ */
+static const char *_bmp_parse(const uint8_t *data, size_t size,
+                              struct bmp_info *bmp)
+{
+        if (size < BMP_HEADER_SIZE || data[0] != 'B' || data[1] != 'M') {
+                return "not a bmp file";
+        }
+
+        uint32_t offset = _le32(data + 10);
+        uint32_t header = _le32(data + BMP_FILE_INFO_SIZE);
+        int32_t w = (int32_t)_le32(data + 18);
+        int32_t h = (int32_t)_le32(data + 22);
+        uint32_t planes = _le16(data + 26);
+        uint32_t bpp = _le16(data + 28);
+        uint32_t compression = _le32(data + 30);
+        uint32_t colors = _le32(data + 46);
+
+        if (header < 40 || BMP_FILE_INFO_SIZE + (size_t)header > size) {
+                return "unsupported bmp header";
+        }
+        if (planes != 1 || (bpp != 8 && bpp != 24 && bpp != 32)) {
+                return "unsupported bmp depth, only 8, 24 and 32 bit";
+        }
+        // BI_RGB, or BI_BITFIELDS for 32 bit
+        if (compression != 0 && !(compression == 3 && bpp == 32)) {
+                return "compressed bmps are unsupported";
+        }
+        if (w <= 0 || h == 0 || h == INT32_MIN || w > 0xffff ||
+            (h < 0 ? -h : h) > 0xffff ||
+            (uint64_t)w * (h < 0 ? -h : h) > CANVAS_MAX_PIXELS) {
+                return "bad bmp dimensions";
+        }
+
+        bmp->w = w;
+        bmp->h = (h < 0) ? -h : h;
+        bmp->top_down = (h < 0);
+        bmp->bpp = bpp;
+        bmp->stride = ((w * bpp + 31) / 32) * 4;
+        bmp->masked = 0;
+
+        if ((uint64_t)offset + (uint64_t)bmp->stride * bmp->h > size) {
+                return "bmp is truncated";
+        }
+        bmp->pixels = data + offset;
+
+        if (compression == 3) {
+                // the masks follow a 40 byte header, or are part of a larger
+                size_t at = BMP_FILE_INFO_SIZE + 40;
+                if (at + 12 > size) {
+                        return "bmp is truncated";
+                }
+                uint32_t masks[3] = {_le32(data + at), _le32(data + at + 4),
+                                     _le32(data + at + 8)};
+                bmp->masked = !(masks[0] == 0xff0000 && masks[1] == 0xff00 &&
+                                masks[2] == 0xff);
+                for (int i = 0; i < 3; i++) {
+                        _bmp_mask_shift(masks[i], &bmp->shift[i],
+                                        &bmp->max[i]);
+                }
+        }
+
+        if (bpp == 8) {
+                // missing entries are black
+                size_t at = BMP_FILE_INFO_SIZE + header;
+                if (colors == 0 || colors > 256) {
+                        colors = 256;
+                }
+                if (at + (size_t)colors * 4 > offset) {
+                        return "bmp color table is truncated";
+                }
+                for (int i = 0; i < 256; i++) {
+                        bmp->table[i] = color_rgb(0.0, 0.0, 0.0);
+                        if (i < colors) {
+                                _store_bgr(&bmp->table[i],
+                                           _le32(data + at + i * 4));
+                        }
+                }
+        }
+
+        return NULL;
+}
+
+/*
+ * Create a canvas from an uncompressed 8, 24 or 32 bit bitmap file, stored
+ * either way up. The file is mapped rather than read and converted a row at
+ * a time, compressed files (see lz.h) are decompressed first. An empty canvas
+ * (0x0, which can still be passed to canvas_destroy) is returned if the file
+ * can't be read
  */
 struct canvas canvas_from_bmp(const char *filename)
 {
-        FILE *file = fopen(filename, "r");
+        struct canvas image = {0, 0, NULL};
+
+        struct file_map map = lz_map_file(filename, 0);
+        if (map.data == NULL) {
+                return image;
+        }
+
+        struct bmp_info *bmp = (struct bmp_info *)mem_alloc(
+                                                sizeof(struct bmp_info));
+        const char *error = _bmp_parse(map.data, map.size, bmp);
+        if (error != NULL) {
+                fprintf(stderr, "%s: %s\n", filename, error);
+                mem_free(bmp);
+                file_unmap(&map);
+                return image;
+        }
+
+        image = canvas(bmp->w, bmp->h);
+        struct color *pixels = canvas_pixels_writable(image);
+
+        // bottom up files store the last row first
+        for (int y = 0; y < bmp->h; y++) {
+                int row = bmp->top_down ? y : bmp->h - 1 - y;
+                _bmp_row(bmp, bmp->pixels + (size_t)row * bmp->stride,
+                         pixels + y * bmp->w);
+        }
+
+        mem_free(bmp);
+        file_unmap(&map);
+
+        return image;
+}
+
+/*
+ * QOI files (qoiformat.org) hold a stream of 8 bit r, g, b, a pixels, each
+ * one written as a change from the one before it: a run of repeats, an index
+ * into the last 64 pixels seen, a small difference or the whole value. The
+ * stream carries across rows and ends with 7 zero bytes and a one
+ */
+#define QOI_HEADER_SIZE 14
+#define QOI_END_SIZE 8
+#define QOI_MAX_PIXELS 400000000
+#define QOI_MAX_RUN 62          // the most pixels a single op can give
+#define QOI_CHUNK 65536
+
+#define QOI_OP_INDEX 0x00       // 00xxxxxx
+#define QOI_OP_DIFF 0x40        // 01xxxxxx
+#define QOI_OP_LUMA 0x80        // 10xxxxxx
+#define QOI_OP_RUN 0xc0         // 11xxxxxx
+#define QOI_OP_RGB 0xfe
+#define QOI_OP_RGBA 0xff
+#define QOI_MASK 0xc0
+
+static const uint8_t qoi_end[QOI_END_SIZE] = {0, 0, 0, 0, 0, 0, 0, 1};
+
+/*
+ * pixels are compared and indexed packed as COLOR_RGBA
+ */
+#define QOI_R(px) (((px) >> RSHIFT) & 0xff)
+#define QOI_G(px) (((px) >> GSHIFT) & 0xff)
+#define QOI_B(px) (((px) >> BSHIFT) & 0xff)
+#define QOI_A(px) (((px) >> ASHIFT) & 0xff)
+
+static inline uint32_t _qoi_pixel(uint32_t r, uint32_t g, uint32_t b,
+                                  uint32_t a)
+{
+        return r << RSHIFT | g << GSHIFT | b << BSHIFT | a << ASHIFT;
+}
+
+static inline int _qoi_hash(uint32_t px)
+{
+        return (QOI_R(px) * 3 + QOI_G(px) * 5 + QOI_B(px) * 7 +
+                QOI_A(px) * 11) % 64;
+}
+
+static void _be32_write(uint8_t *p, uint32_t v)
+{
+        p[0] = v >> 24;
+        p[1] = v >> 16;
+        p[2] = v >> 8;
+        p[3] = v;
+}
+
+static uint32_t _be32(const uint8_t *p)
+{
+        return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 |
+               (uint32_t)p[2] << 8 | (uint32_t)p[3];
+}
+
+/*
+ * the encoder's output, written out whenever it fills. The state carries on
+ * from one row to the next as the stream does
+ */
+struct qoi_writer {
+        FILE *file;
+        int ok;
+        size_t used;
+        uint8_t buf[QOI_CHUNK];
+        uint32_t index[64];
+        uint32_t prev;
+        int run;
+};
+
+static void _qoi_flush(struct qoi_writer *q)
+{
+        q->ok = q->ok && (fwrite(q->buf, 1, q->used, q->file) == q->used);
+        q->used = 0;
+}
+
+/*
+ * encode a row of packed pixels, the longest op is 5 bytes
+ */
+static void _qoi_encode_row(struct qoi_writer *q, const uint32_t *row, int n)
+{
+        for (int i = 0; i < n; i++) {
+                uint32_t px = row[i];
+
+                if (q->used + 5 > QOI_CHUNK) {
+                        _qoi_flush(q);
+                }
+
+                if (px == q->prev) {
+                        if (++q->run == QOI_MAX_RUN) {
+                                q->buf[q->used++] = QOI_OP_RUN | (q->run - 1);
+                                q->run = 0;
+                        }
+                        continue;
+                }
+
+                if (q->run > 0) {
+                        q->buf[q->used++] = QOI_OP_RUN | (q->run - 1);
+                        q->run = 0;
+                }
+
+                int hash = _qoi_hash(px);
+                if (q->index[hash] == px) {
+                        q->buf[q->used++] = QOI_OP_INDEX | hash;
+                } else if (QOI_A(px) == QOI_A(q->prev)) {
+                        // differences wrap around, as the decoder's sums do
+                        int dr = (int8_t)(QOI_R(px) - QOI_R(q->prev));
+                        int dg = (int8_t)(QOI_G(px) - QOI_G(q->prev));
+                        int db = (int8_t)(QOI_B(px) - QOI_B(q->prev));
+                        int dr_dg = dr - dg;
+                        int db_dg = db - dg;
+
+                        if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 &&
+                            db >= -2 && db <= 1) {
+                                q->buf[q->used++] = QOI_OP_DIFF |
+                                        (dr + 2) << 4 | (dg + 2) << 2 |
+                                        (db + 2);
+                        } else if (dg >= -32 && dg <= 31 && dr_dg >= -8 &&
+                                   dr_dg <= 7 && db_dg >= -8 && db_dg <= 7) {
+                                q->buf[q->used++] = QOI_OP_LUMA | (dg + 32);
+                                q->buf[q->used++] = (dr_dg + 8) << 4 |
+                                                    (db_dg + 8);
+                        } else {
+                                q->buf[q->used++] = QOI_OP_RGB;
+                                q->buf[q->used++] = QOI_R(px);
+                                q->buf[q->used++] = QOI_G(px);
+                                q->buf[q->used++] = QOI_B(px);
+                        }
+                } else {
+                        q->buf[q->used++] = QOI_OP_RGBA;
+                        q->buf[q->used++] = QOI_R(px);
+                        q->buf[q->used++] = QOI_G(px);
+                        q->buf[q->used++] = QOI_B(px);
+                        q->buf[q->used++] = QOI_A(px);
+                }
+
+                q->index[hash] = px;
+                q->prev = px;
+        }
+}
+
+/*
+ * pack a row as COLOR_RGBA for the file. The span conversions make every
+ * pixel opaque, so translucent pixels are redone without the alpha
+ * premultiplied, which QOI doesn't use
+ */
+static void _qoi_pack_row(const struct canvas c, const struct color *pixels,
+                          uint32_t *dst, int n)
+{
+        int linear = (c.image->space == COLOR_LINEAR);
+
+        if (linear) {
+                color_span_to_srgb32(pixels, dst, n, COLOR_RGBA);
+        } else {
+                color_span_to_rgba32(pixels, dst, n, COLOR_RGBA);
+        }
+
+        for (int i = 0; i < n; i++) {
+                double a = pixels[i].a;
+                if (a >= 1.0) {
+                        continue;
+                }
+                // negative or NaN alpha is fully transparent
+                if (!(a > 0.0)) {
+                        a = 0.0;
+                }
+
+                uint32_t px = 0;
+                if (a > 0.0) {
+                        struct color straight = color_rgb(pixels[i].r / a,
+                                        pixels[i].g / a, pixels[i].b / a);
+                        if (linear) {
+                                color_span_to_srgb32(&straight, &px, 1,
+                                                     COLOR_RGBA);
+                        } else {
+                                color_span_to_rgba32(&straight, &px, 1,
+                                                     COLOR_RGBA);
+                        }
+                }
+                px &= ~(0xffu << ASHIFT);
+                dst[i] = px | (uint32_t)(a * 255.0 + 0.5) << ASHIFT;
+        }
+}
+
+/*
+ * Write the contents of a canvas to a QOI file. Rows are packed and encoded
+ * one at a time into a small buffer, so the memory used only depends on the
+ * width of the canvas. Opaque canvases are written with 3 channels, alpha is
+ * kept otherwise. Returns 1 on success, 0 on failure
+ */
+const int canvas_export_to_qoi(const struct canvas c, const char *filename)
+{
+        if (c.image == NULL || c.w <= 0 || c.h <= 0) {
+                return 0;
+        }
+
+        FILE *file = fopen(filename, "wb");
         if (file == NULL) {
-                fprintf(stderr, "%s\n", strerror(errno));
-                exit(0);
-        }
-
-        // get image properties
-        fseek(file, 18, SEEK_SET);
-        uint32_t width, height;
-        fread(&width, 4, 1, file);
-        fread(&height, 4, 1, file);
-        height *= -1;   // windows stores bmps upside down
-
-        // get color depth
-        fseek(file, 28, SEEK_SET); 
-        uint32_t color_depth;
-        fread(&color_depth, 4, 1, file);
-        color_depth /= 8;
-        if (color_depth != 3 && color_depth != 4) {
-                exit(0);
-        }
-
-        // get the pixels
-        uint32_t file_pixel_offset;
-        fseek(file, 10, SEEK_SET);
-        fread(&file_pixel_offset, 4, 1, file);
-
-        double r, g, b, a;
-        uint32_t *data = (uint32_t *)mem_alloc(width * height * color_depth);
-        fseek(file, file_pixel_offset, SEEK_SET);
-        fread(data, sizeof(uint32_t), width * height, file);
-
-        struct canvas image = canvas(width, height);
-
-        for (int i = 0; i < width * height; i++) {
-
-                uint32_t pixel;
-                
-                pixel = data[i];
-                
-                a = (double)((pixel >> 24) & 0xff) / 255.0;
-                r = (double)((pixel >> 16) & 0xff) / 255.0;
-                g = (double)((pixel >> 8) & 0xff) / 255.0;
-                b = (double)((pixel) & 0xff) / 255.0;
-        
-                struct color color = color_rgb(r, g, b);
-                image.pixels[i] = color;
+                fprintf(stderr, "%s: %s\n", filename, strerror(errno));
+                return 0;
         }
 
-        mem_free(data);
-        fclose(file);
+        const struct color *pixels = canvas_pixels(c);
+        int channels = 3;
+        for (int i = 0; i < c.w * c.h; i++) {
+                if (pixels[i].a < 1.0 - 0.5 / 255.0) {
+                        channels = 4;
+                        break;
+                }
+        }
+
+        // linear canvases are written as sRGB, as for the other formats
+        uint8_t head[QOI_HEADER_SIZE];
+        memcpy(head, "qoif", 4);
+        _be32_write(head + 4, c.w);
+        _be32_write(head + 8, c.h);
+        head[12] = channels;
+        head[13] = 0;
+
+        struct qoi_writer *q = (struct qoi_writer *)mem_alloc(
+                                                sizeof(struct qoi_writer));
+        uint32_t *row = (uint32_t *)mem_alloc(c.w * sizeof(uint32_t));
+        memset(q->index, 0, sizeof(q->index));
+        q->file = file;
+        q->ok = 1;
+        q->prev = _qoi_pixel(0, 0, 0, 255);
+        q->run = 0;
+        memcpy(q->buf, head, QOI_HEADER_SIZE);
+        q->used = QOI_HEADER_SIZE;
+
+        for (int y = 0; y < c.h && q->ok; y++) {
+                _qoi_pack_row(c, pixels + y * c.w, row, c.w);
+                _qoi_encode_row(q, row, c.w);
+        }
 
+        if (q->run > 0) {
+                q->buf[q->used++] = QOI_OP_RUN | (q->run - 1);
+        }
+        if (q->used + QOI_END_SIZE > QOI_CHUNK) {
+                _qoi_flush(q);
+        }
+        memcpy(q->buf + q->used, qoi_end, QOI_END_SIZE);
+        q->used += QOI_END_SIZE;
+        _qoi_flush(q);
+
+        int ok = q->ok;
+        mem_free(row);
+        mem_free(q);
+        if (fclose(file) != 0 || !ok) {
+                fprintf(stderr, "Unable to write qoi %s\n", filename);
+                return 0;
+        }
+
+        return 1;
+}
+
+/*
+ * decode the pixels of a QOI file held in memory, whose header has been
+ * checked. Returns an error message or NULL
+ */
+static const char *_qoi_decode(const uint8_t *data, size_t size,
+                               struct color *out, size_t n)
+{
+        uint32_t index[64];
+        uint32_t px = _qoi_pixel(0, 0, 0, 255);
+        size_t p = QOI_HEADER_SIZE;
+        size_t end = size - QOI_END_SIZE;
+        int run = 0;
+
+        memset(index, 0, sizeof(index));
+
+        for (size_t i = 0; i < n; i++) {
+                if (run > 0) {
+                        run--;
+                } else {
+                        if (p >= end) {
+                                return "qoi is truncated";
+                        }
+
+                        int op = data[p++];
+                        if (op == QOI_OP_RGB || op == QOI_OP_RGBA) {
+                                size_t len = (op == QOI_OP_RGB) ? 3 : 4;
+                                if (p + len > end) {
+                                        return "qoi is truncated";
+                                }
+                                uint32_t a = (op == QOI_OP_RGB) ? QOI_A(px) :
+                                             data[p + 3];
+                                px = _qoi_pixel(data[p], data[p + 1],
+                                                data[p + 2], a);
+                                p += len;
+                        } else if ((op & QOI_MASK) == QOI_OP_INDEX) {
+                                px = index[op];
+                        } else if ((op & QOI_MASK) == QOI_OP_DIFF) {
+                                int dr = ((op >> 4) & 3) - 2;
+                                int dg = ((op >> 2) & 3) - 2;
+                                int db = (op & 3) - 2;
+                                px = _qoi_pixel((QOI_R(px) + dr) & 0xff,
+                                                (QOI_G(px) + dg) & 0xff,
+                                                (QOI_B(px) + db) & 0xff,
+                                                QOI_A(px));
+                        } else if ((op & QOI_MASK) == QOI_OP_LUMA) {
+                                if (p >= end) {
+                                        return "qoi is truncated";
+                                }
+                                int dg = (op & 0x3f) - 32;
+                                int dr = dg + (data[p] >> 4) - 8;
+                                int db = dg + (data[p] & 0x0f) - 8;
+                                p++;
+                                px = _qoi_pixel((QOI_R(px) + dr) & 0xff,
+                                                (QOI_G(px) + dg) & 0xff,
+                                                (QOI_B(px) + db) & 0xff,
+                                                QOI_A(px));
+                        } else {
+                                run = op & 0x3f;
+                        }
+
+                        index[_qoi_hash(px)] = px;
+                }
+
+                uint32_t a = QOI_A(px);
+                if (a == 255) {
+                        _store_bgr(&out[i], QOI_B(px) | QOI_G(px) << 8 |
+                                            QOI_R(px) << 16);
+                } else {
+                        out[i] = color_rgba_int(QOI_R(px), QOI_G(px),
+                                                QOI_B(px), a);
+                }
+        }
+
+        return NULL;
+}
+
+/*
+ * Create a canvas from a QOI file. The file is mapped rather than read and
+ * decoded straight into the canvas, files marked as all linear give a linear
+ * canvas. An empty canvas (0x0) is returned if the file can't be read
+ */
+struct canvas canvas_from_qoi(const char *filename)
+{
+        struct canvas image = {0, 0, NULL};
+
+        struct file_map map = file_map(filename);
+        if (map.data == NULL) {
+                return image;
+        }
+
+        const uint8_t *data = map.data;
+        const char *error = NULL;
+        uint32_t w = 0, h = 0;
+
+        if (map.size < QOI_HEADER_SIZE + QOI_END_SIZE ||
+            memcmp(data, "qoif", 4) != 0) {
+                error = "not a qoi file";
+        } else {
+                w = _be32(data + 4);
+                h = _be32(data + 8);
+                if ((data[12] != 3 && data[12] != 4) || data[13] > 1) {
+                        error = "unsupported qoi channels or color space";
+                } else if (w == 0 || h == 0 || w > 0xffff || h > 0xffff ||
+                           (uint64_t)w * h > QOI_MAX_PIXELS ||
+                           (uint64_t)w * h > CANVAS_MAX_PIXELS) {
+                        error = "bad qoi dimensions";
+                } else if (map.size - QOI_HEADER_SIZE - QOI_END_SIZE <
+                           ((size_t)w * h + QOI_MAX_RUN - 1) / QOI_MAX_RUN) {
+                        // checked before the canvas is made, so a short file
+                        // can't ask for a huge one
+                        error = "qoi is truncated";
+                }
+        }
+
+        if (error == NULL) {
+                image = canvas(w, h);
+                error = _qoi_decode(data, map.size,
+                                    canvas_pixels_writable(image),
+                                    (size_t)w * h);
+                if (error != NULL) {
+                        canvas_destroy(&image);
+                } else if (data[13] == 1) {
+                        canvas_set_color_space(image, COLOR_LINEAR);
+                }
+        }
+
+        if (error != NULL) {
+                fprintf(stderr, "%s: %s\n", filename, error);
+        }
+
+        file_unmap(&map);
         return image;
 }
+
+/*
+ * Create a canvas from a .bmp, .ppm or .qoi file, chosen by the extension, an
+ * empty canvas (0x0) is returned if the file can't be read
+ */
+struct canvas canvas_from_file(const char *filename)
+{
+        struct canvas c = {0, 0, NULL};
+        const char *ext = strrchr(filename, '.');
+
+        if (ext != NULL && strcmp(ext, ".bmp") == 0) {
+                c = canvas_from_bmp(filename);
+        } else if (ext != NULL && strcmp(ext, ".ppm") == 0) {
+                c = canvas_from_ppm(filename);
+        } else if (ext != NULL && strcmp(ext, ".qoi") == 0) {
+                c = canvas_from_qoi(filename);
+        } else {
+                fprintf(stderr, "%s: not a .bmp, .ppm or .qoi image\n",
+                        filename);
+        }
+
+        return c;
+}
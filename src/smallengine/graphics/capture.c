@@ -0,0 +1,318 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <SDL2/SDL.h>
+
+#include <smallengine/graphics/capture.h>
+#include <smallengine/graphics/canvas.h>
+#include <smallengine/graphics/color.h>
+
+#include <smallengine/sys/log.h>
+#include <smallengine/sys/mem.h>
+
+/*
+ * a captured frame, the buffer is kept for the next capture using the slot
+ */
+struct capture_frame {
+        uint32_t *pixels;
+        int size;                       // pixels the buffer has room for
+        int w;
+        int h;
+        enum color_layout layout;
+        char filename[CAPTURE_PATH_SIZE];
+};
+
+/*
+ * the queue is a ring of frames: count frames before head are waiting to be
+ * written, oldest first. The capturing thread only fills the frame at head
+ * and the writer only reads the oldest, so neither holds the lock while
+ * copying or writing
+ */
+static struct {
+        SDL_Thread *thread;
+        SDL_mutex *lock;
+        SDL_cond *queued;               // the writer waits here for frames
+        SDL_cond *written;              // captures wait here for room
+        struct capture_frame frames[CAPTURE_MAX_FRAMES];
+        int capacity;
+        int head;
+        int count;
+        int quit;
+        enum capture_policy policy;
+        int dropped;
+        int failed;
+        struct capture_frame serial;    // used when there is no writer
+} cap;
+
+/*
+ * make sure a frame's buffer has room for w x h pixels
+ */
+static void _fit(struct capture_frame *f, int w, int h)
+{
+        if (f->size < w * h) {
+                if (f->pixels != NULL) {
+                        mem_free(f->pixels);
+                }
+                f->pixels = (uint32_t *)mem_alloc((size_t)w * h *
+                                                  sizeof(uint32_t));
+                f->size = w * h;
+        }
+
+        f->w = w;
+        f->h = h;
+}
+
+/*
+ * convert a frame to the bitmap layout if it isn't already and write it
+ */
+static int _write(struct capture_frame *f)
+{
+        if (f->layout == COLOR_RGBA) {
+                for (int i = 0; i < f->w * f->h; i++) {
+                        uint32_t p = f->pixels[i];
+                        f->pixels[i] = 0xff000000 |
+                                       ((p >> RSHIFT) & 0xff) << 16 |
+                                       ((p >> GSHIFT) & 0xff) << 8 |
+                                       ((p >> BSHIFT) & 0xff);
+                }
+                f->layout = COLOR_ARGB;
+        }
+
+        return canvas_export_argb_to_bmp(f->pixels, f->w, f->h, f->filename);
+}
+
+static int _writer(void *unused)
+{
+        SDL_LockMutex(cap.lock);
+
+        while (1) {
+                while (cap.count == 0 && !cap.quit) {
+                        SDL_CondWait(cap.queued, cap.lock);
+                }
+
+                // everything queued is written before quitting
+                if (cap.count == 0) {
+                        break;
+                }
+
+                int oldest = (cap.head - cap.count + cap.capacity) %
+                             cap.capacity;
+                SDL_UnlockMutex(cap.lock);
+
+                int ok = _write(&cap.frames[oldest]);
+
+                SDL_LockMutex(cap.lock);
+                cap.failed += !ok;
+                cap.count--;
+                SDL_CondBroadcast(cap.written);
+        }
+
+        SDL_UnlockMutex(cap.lock);
+        return 0;
+}
+
+/*
+ * start the writer thread with room for frames captures waiting to be
+ * written (up to CAPTURE_MAX_FRAMES). Returns 1 on success, 0 on failure
+ */
+int capture_init(int frames, enum capture_policy policy)
+{
+        if (cap.thread != NULL) {
+                return 1;
+        }
+
+        if (frames < 1) {
+                frames = 1;
+        }
+
+        if (frames > CAPTURE_MAX_FRAMES) {
+                frames = CAPTURE_MAX_FRAMES;
+        }
+
+        cap.capacity = frames;
+        cap.policy = policy;
+        cap.head = 0;
+        cap.count = 0;
+        cap.quit = 0;
+        cap.lock = SDL_CreateMutex();
+        cap.queued = SDL_CreateCond();
+        cap.written = SDL_CreateCond();
+
+        cap.thread = SDL_CreateThread(_writer, "capture", NULL);
+        if (cap.thread == NULL) {
+                log_wrn("Unable to create capture writer: %s", SDL_GetError());
+                SDL_DestroyCond(cap.written);
+                SDL_DestroyCond(cap.queued);
+                SDL_DestroyMutex(cap.lock);
+                cap.lock = NULL;
+                return 0;
+        }
+
+        return 1;
+}
+
+/*
+ * write everything still queued, stop the writer thread and free the buffers
+ */
+void capture_quit(void)
+{
+        if (cap.thread != NULL) {
+                SDL_LockMutex(cap.lock);
+                cap.quit = 1;
+                SDL_CondSignal(cap.queued);
+                SDL_UnlockMutex(cap.lock);
+
+                SDL_WaitThread(cap.thread, NULL);
+
+                SDL_DestroyCond(cap.written);
+                SDL_DestroyCond(cap.queued);
+                SDL_DestroyMutex(cap.lock);
+        }
+
+        for (int i = 0; i < CAPTURE_MAX_FRAMES; i++) {
+                if (cap.frames[i].pixels != NULL) {
+                        mem_free(cap.frames[i].pixels);
+                }
+        }
+        if (cap.serial.pixels != NULL) {
+                mem_free(cap.serial.pixels);
+        }
+
+        memset(&cap, 0, sizeof(cap));
+}
+
+/*
+ * the frame to capture into, NULL if the queue is full and frames are being
+ * dropped
+ */
+static struct capture_frame *_reserve(const char *filename)
+{
+        struct capture_frame *f = &cap.serial;
+
+        if (cap.thread != NULL) {
+                SDL_LockMutex(cap.lock);
+                while (cap.count == cap.capacity) {
+                        if (cap.policy == CAPTURE_DROP) {
+                                cap.dropped++;
+                                SDL_UnlockMutex(cap.lock);
+                                return NULL;
+                        }
+                        SDL_CondWait(cap.written, cap.lock);
+                }
+                f = &cap.frames[cap.head];
+                SDL_UnlockMutex(cap.lock);
+        }
+
+        snprintf(f->filename, CAPTURE_PATH_SIZE, "%s", filename);
+        return f;
+}
+
+/*
+ * pass a filled frame to the writer, or write it now if there isn't one
+ */
+static void _submit(struct capture_frame *f)
+{
+        if (cap.thread == NULL) {
+                cap.failed += !_write(f);
+                return;
+        }
+
+        SDL_LockMutex(cap.lock);
+        cap.head = (cap.head + 1) % cap.capacity;
+        cap.count++;
+        SDL_CondSignal(cap.queued);
+        SDL_UnlockMutex(cap.lock);
+}
+
+/*
+ * queue packed pixels of the given layout to be written, pitch is the number
+ * of pixels from the start of one row to the next. Returns 1 if the frame was
+ * queued (or written), 0 if it was dropped
+ */
+int capture_pixels(const uint32_t *pixels, int w, int h, int pitch,
+                   enum color_layout layout, const char *filename)
+{
+        struct capture_frame *f = _reserve(filename);
+        if (f == NULL) {
+                return 0;
+        }
+
+        _fit(f, w, h);
+        f->layout = layout;
+        if (pitch == w) {
+                memcpy(f->pixels, pixels, (size_t)w * h * sizeof(uint32_t));
+        } else {
+                for (int y = 0; y < h; y++) {
+                        memcpy(f->pixels + y * w, pixels + y * pitch,
+                               w * sizeof(uint32_t));
+                }
+        }
+
+        _submit(f);
+        return 1;
+}
+
+/*
+ * queue the contents of a canvas to be written, as capture_pixels
+ */
+int capture_canvas(const struct canvas c, const char *filename)
+{
+        struct capture_frame *f = _reserve(filename);
+        if (f == NULL) {
+                return 0;
+        }
+
+        _fit(f, c.w, c.h);
+        f->layout = COLOR_ARGB;
+        if (canvas_color_space(c) == COLOR_LINEAR) {
+                color_span_to_srgb32(canvas_pixels(c), f->pixels, c.w * c.h,
+                                     COLOR_ARGB);
+        } else {
+                color_span_to_rgba32(canvas_pixels(c), f->pixels, c.w * c.h,
+                                     COLOR_ARGB);
+        }
+
+        _submit(f);
+        return 1;
+}
+
+/*
+ * wait until every queued frame has been written
+ */
+void capture_flush(void)
+{
+        if (cap.thread == NULL) {
+                return;
+        }
+
+        SDL_LockMutex(cap.lock);
+        while (cap.count > 0) {
+                SDL_CondWait(cap.written, cap.lock);
+        }
+        SDL_UnlockMutex(cap.lock);
+}
+
+/*
+ * return the number of frames dropped because the queue was full
+ */
+int capture_dropped(void)
+{
+        return cap.dropped;
+}
+
+/*
+ * return the number of frames that couldn't be written
+ */
+int capture_failed(void)
+{
+        if (cap.thread == NULL) {
+                return cap.failed;
+        }
+
+        SDL_LockMutex(cap.lock);
+        int failed = cap.failed;
+        SDL_UnlockMutex(cap.lock);
+
+        return failed;
+}
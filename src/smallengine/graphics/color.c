@@ -1,5 +1,11 @@
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include <smallengine/graphics/color.h>
 #include <smallengine/maths/maths.h>
@@ -92,7 +98,8 @@ const struct color color_cap(const struct color c)
         return c1;
 }
 
-/* return a ppm style string of the color (ie "255 0 128")*/
+/* return a ppm style string of the color (ie "255 0 128"), the string must be
+ * released with mem_free */
 char *color_to_ppm_string(const struct color c)
 {
         int r = _clamp_component_int(c.r);
@@ -133,6 +140,239 @@ const uint32_t color_to_RGBA(struct color c)
         return val;
 }
 
+/*
+ * scale a component to 0-255 without branches, (int)(c * 255 + 0.5) for
+ * components inside the range as _clamp_component_int
+ */
+static inline uint32_t _quantise(double comp)
+{
+        comp = (comp < 0.0) ? 0.0 : comp;
+        comp = (comp > 1.0) ? 1.0 : comp;
+        return (uint32_t)(comp * 255.0 + 0.5);
+}
+
+static void _span_to_rgba32_scalar(const struct color *src, uint32_t *dst,
+                                   int n, enum color_layout layout)
+{
+        if (layout == COLOR_ARGB) {
+                for (int i = 0; i < n; i++) {
+                        dst[i] = 0xffu << 24 | _quantise(src[i].r) << 16 |
+                                 _quantise(src[i].g) << 8 | _quantise(src[i].b);
+                }
+                return;
+        }
+
+        for (int i = 0; i < n; i++) {
+                dst[i] = _quantise(src[i].r) << RSHIFT |
+                         _quantise(src[i].g) << GSHIFT |
+                         _quantise(src[i].b) << BSHIFT | 0xffu << ASHIFT;
+        }
+}
+
+#ifdef __SSE2__
+/*
+ * clamp, scale and truncate one color to four int32 lanes r, g, b, a
+ */
+static inline __m128i _quantise_sse2(const struct color *c)
+{
+        const __m128d zero = _mm_setzero_pd();
+        const __m128d one = _mm_set1_pd(1.0);
+        const __m128d scale = _mm_set1_pd(255.0);
+        const __m128d half = _mm_set1_pd(0.5);
+
+        __m128d rg = _mm_loadu_pd(&c->r);
+        __m128d ba = _mm_loadu_pd(&c->b);
+        rg = _mm_min_pd(_mm_max_pd(rg, zero), one);
+        ba = _mm_min_pd(_mm_max_pd(ba, zero), one);
+        rg = _mm_add_pd(_mm_mul_pd(rg, scale), half);
+        ba = _mm_add_pd(_mm_mul_pd(ba, scale), half);
+
+        return _mm_unpacklo_epi64(_mm_cvttpd_epi32(rg), _mm_cvttpd_epi32(ba));
+}
+#endif
+
+/*
+ * convert n colors to packed 32 bit pixels in the given layout, giving the
+ * same values as color_to_RGBA/color_to_ARGB (components clamped to 0.0-1.0,
+ * alpha always 0xff). Used for whole rows or frames at a time
+ */
+void color_span_to_rgba32(const struct color *src, uint32_t *dst, int n,
+                          enum color_layout layout)
+{
+#if defined(__SSE2__) && SDL_BYTEORDER == SDL_LIL_ENDIAN
+        // two pixels at a time, byte order in memory r, g, b, a for RGBA
+        // and b, g, r, a for ARGB
+        const __m128i opaque = _mm_set1_epi32(0xff000000);
+        int i = 0;
+
+        for (; i + 1 < n; i += 2) {
+                __m128i p0 = _quantise_sse2(&src[i]);
+                __m128i p1 = _quantise_sse2(&src[i + 1]);
+                if (layout == COLOR_ARGB) {
+                        p0 = _mm_shuffle_epi32(p0, _MM_SHUFFLE(3, 0, 1, 2));
+                        p1 = _mm_shuffle_epi32(p1, _MM_SHUFFLE(3, 0, 1, 2));
+                }
+
+                __m128i words = _mm_packs_epi32(p0, p1);
+                __m128i bytes = _mm_or_si128(_mm_packus_epi16(words, words),
+                                             opaque);
+                _mm_storel_epi64((__m128i *)&dst[i], bytes);
+        }
+
+        _span_to_rgba32_scalar(src + i, dst + i, n - i, layout);
+#else
+        _span_to_rgba32_scalar(src, dst, n, layout);
+#endif
+}
+
+/*
+ * Color Spaces
+ */
+
+/*
+ * each table samples its curve at SRGB_TABLE_SIZE steps from 0.0 to 1.0,
+ * interpolating between samples keeps the error below 1e-5 everywhere. The
+ * sRGB curve is far too steep near black for even steps, so that table is
+ * stepped evenly in sqrt(v) instead
+ */
+#define SRGB_TABLE_SIZE 4096
+
+static double _to_linear_table[SRGB_TABLE_SIZE + 1];
+static double _to_srgb_table[SRGB_TABLE_SIZE + 1];
+
+enum {TABLES_EMPTY, TABLES_BUILDING, TABLES_BUILT};
+static SDL_atomic_t _tables_state;
+
+static double _srgb_to_linear_exact(double v)
+{
+        return (v <= 0.04045) ? v / 12.92 : pow((v + 0.055) / 1.055, 2.4);
+}
+
+static double _linear_to_srgb_exact(double v)
+{
+        return (v <= 0.0031308) ? v * 12.92 : 1.055 * pow(v, 1.0 / 2.4) - 0.055;
+}
+
+/*
+ * the tables are filled on first use by whichever thread gets here first, any
+ * others wait for it. The release barrier makes sure the table stores are
+ * seen before TABLES_BUILT is
+ */
+static void _build_tables()
+{
+        if (!SDL_AtomicCAS(&_tables_state, TABLES_EMPTY, TABLES_BUILDING)) {
+                while (SDL_AtomicGet(&_tables_state) != TABLES_BUILT) {
+                        SDL_Delay(0);
+                }
+                return;
+        }
+
+        for (int i = 0; i <= SRGB_TABLE_SIZE; i++) {
+                double v = (double)i / SRGB_TABLE_SIZE;
+                _to_linear_table[i] = _srgb_to_linear_exact(v);
+                _to_srgb_table[i] = _linear_to_srgb_exact(v * v);
+        }
+
+        SDL_MemoryBarrierRelease();
+        SDL_AtomicSet(&_tables_state, TABLES_BUILT);
+}
+
+/*
+ * build the tables if they haven't been, the acquire barrier pairs with the
+ * release in _build_tables so their contents are seen after the flag
+ */
+static inline void _need_tables()
+{
+        if (SDL_AtomicGet(&_tables_state) != TABLES_BUILT) {
+                _build_tables();
+        }
+        SDL_MemoryBarrierAcquire();
+}
+
+static inline double _lookup(const double *table, double v,
+                             double (*exact)(double))
+{
+        if (v <= 0.0 || v >= 1.0) {
+                return (v < 0.0) ? -exact(-v) : exact(v);
+        }
+
+        if (table == _to_srgb_table) {
+                v = sqrt(v);
+        }
+
+        double pos = v * SRGB_TABLE_SIZE;
+        int i = (int)pos;
+        return table[i] + (table[i + 1] - table[i]) * (pos - i);
+}
+
+/* convert a single sRGB component to linear */
+double color_srgb_to_linear(const double v)
+{
+        _need_tables();
+        return _lookup(_to_linear_table, v, _srgb_to_linear_exact);
+}
+
+/* convert a single linear component to sRGB */
+double color_linear_to_srgb(const double v)
+{
+        _need_tables();
+        return _lookup(_to_srgb_table, v, _linear_to_srgb_exact);
+}
+
+/* convert a color between color spaces */
+struct color color_convert(const struct color c, enum color_space from,
+                           enum color_space to)
+{
+        struct color new;
+        color_span_convert(&new, &c, 1, from, to);
+        return new;
+}
+
+/* convert n colors between color spaces, dst and src may be the same */
+void color_span_convert(struct color *dst, const struct color *src, int n,
+                        enum color_space from, enum color_space to)
+{
+        if (from == to) {
+                if (dst != src) {
+                        memmove(dst, src, n * sizeof(struct color));
+                }
+                return;
+        }
+
+        _need_tables();
+
+        const double *table = (to == COLOR_LINEAR) ? _to_linear_table :
+                                                     _to_srgb_table;
+        double (*exact)(double) = (to == COLOR_LINEAR) ?
+                                  _srgb_to_linear_exact :
+                                  _linear_to_srgb_exact;
+
+        for (int i = 0; i < n; i++) {
+                dst[i].r = _lookup(table, src[i].r, exact);
+                dst[i].g = _lookup(table, src[i].g, exact);
+                dst[i].b = _lookup(table, src[i].b, exact);
+                dst[i].a = src[i].a;
+        }
+}
+
+/*
+ * convert n colors to packed 32 bit pixels as color_span_to_rgba32, the
+ * colors are linear and are encoded to sRGB on the way
+ */
+void color_span_to_srgb32(const struct color *src, uint32_t *dst, int n,
+                          enum color_layout layout)
+{
+        // a few pixels at a time through a small buffer on the stack
+        struct color buf[64];
+
+        for (int i = 0; i < n; i += 64) {
+                int len = (n - i < 64) ? n - i : 64;
+                color_span_convert(buf, src + i, len, COLOR_LINEAR,
+                                   COLOR_SRGB);
+                color_span_to_rgba32(buf, dst + i, len, layout);
+        }
+}
+
 /*
  * Operations
  */
@@ -166,3 +406,259 @@ const struct color color_multiply(const struct color c1, const struct color c2)
         struct color new = {c1.r * c2.r, c1.g * c2.g, c1.b * c2.b, 1.0};
         return new;
 }
+
+/*
+ * Fixed Point Colors
+ */
+
+static inline uint16_t _to_fixed(double comp)
+{
+        comp = (comp < 0.0) ? 0.0 : comp;
+        comp = comp * COLOR16_ONE + 0.5;
+        return (comp >= COLOR16_MAX) ? COLOR16_MAX : (uint16_t)comp;
+}
+
+static inline uint16_t _add_fixed(uint32_t c1, uint32_t c2)
+{
+        uint32_t sum = c1 + c2;
+        return (sum > COLOR16_MAX) ? COLOR16_MAX : sum;
+}
+
+static inline uint16_t _mul_fixed(uint32_t c1, uint32_t c2)
+{
+        uint32_t prod = (c1 * c2) >> 12;
+        return (prod > COLOR16_MAX) ? COLOR16_MAX : prod;
+}
+
+/* convert a color to fixed point, components are clamped to 0.0-16.0 */
+struct color16 color16_from_color(const struct color c)
+{
+        struct color16 new = {_to_fixed(c.r), _to_fixed(c.g), _to_fixed(c.b),
+                              _to_fixed(c.a)};
+        return new;
+}
+
+/* convert a fixed point color back to doubles */
+struct color color16_to_color(const struct color16 c)
+{
+        struct color new = {(double)c.r / COLOR16_ONE, 
+                            (double)c.g / COLOR16_ONE,
+                            (double)c.b / COLOR16_ONE, 
+                            (double)c.a / COLOR16_ONE};
+        return new;
+}
+
+/* add 2 fixed point colors, saturating, the result is opaque as color_add */
+struct color16 color16_add(const struct color16 c1, const struct color16 c2)
+{
+        struct color16 new = {_add_fixed(c1.r, c2.r), _add_fixed(c1.g, c2.g),
+                              _add_fixed(c1.b, c2.b), COLOR16_ONE};
+        return new;
+}
+
+/* multiply 2 fixed point colors, saturating, the result is opaque as
+ * color_multiply */
+struct color16 color16_multiply(const struct color16 c1, 
+                                const struct color16 c2)
+{
+        struct color16 new = {_mul_fixed(c1.r, c2.r), _mul_fixed(c1.g, c2.g),
+                              _mul_fixed(c1.b, c2.b), COLOR16_ONE};
+        return new;
+}
+
+/*
+ * Video
+ */
+
+/*
+ * BT.601 studio range in 8.8 fixed point. The offsets (16 or 128 plus 0.5
+ * for rounding) are applied as two halves so they fit the 16 bit multipliers
+ * of the SSE2 path, which gives the same results as the scalar one
+ */
+#define YUV_Y_BIAS 2112                 // (16 * 256 + 128) / 2
+#define YUV_C_BIAS 16448                // (128 * 256 + 128) / 2
+
+static void _layout_shifts(enum color_layout layout, int *rs, int *gs, int *bs)
+{
+        if (layout == COLOR_ARGB) {
+                *rs = 16;
+                *gs = 8;
+                *bs = 0;
+        } else {
+                *rs = RSHIFT;
+                *gs = GSHIFT;
+                *bs = BSHIFT;
+        }
+}
+
+static inline int _avg8(int a, int b)
+{
+        return (a + b + 1) >> 1;
+}
+
+static inline int _yuv_y(int r, int g, int b)
+{
+        return (66 * r + 129 * g + 25 * b + 2 * YUV_Y_BIAS) >> 8;
+}
+
+static inline int _yuv_u(int r, int g, int b)
+{
+        return (-38 * r - 74 * g + 112 * b + 2 * YUV_C_BIAS) >> 8;
+}
+
+static inline int _yuv_v(int r, int g, int b)
+{
+        return (112 * r - 94 * g - 18 * b + 2 * YUV_C_BIAS) >> 8;
+}
+
+#ifdef __SSE2__
+/*
+ * two 16 bit multipliers for _mm_madd_epi16, lo for the low half of each 32
+ * bit lane and hi for the high half
+ */
+#define YUV_PAIR(lo, hi) _mm_set1_epi32((int)((uint32_t)(uint16_t)(hi) << 16 | \
+                                              (uint16_t)(lo)))
+
+/*
+ * one of y, u or v for 4 packed pixels as 32 bit lanes: r and g share a lane
+ * to be multiplied and added in one step, b shares one with a constant 2 to
+ * add the offset
+ */
+static inline __m128i _yuv_sse2(__m128i px, __m128i rs, __m128i gs,
+                                __m128i bs, __m128i mrg, __m128i mb)
+{
+        const __m128i byte = _mm_set1_epi32(0xff);
+        const __m128i two = _mm_set1_epi32(2 << 16);
+
+        __m128i r = _mm_and_si128(_mm_srl_epi32(px, rs), byte);
+        __m128i g = _mm_and_si128(_mm_srl_epi32(px, gs), byte);
+        __m128i b = _mm_and_si128(_mm_srl_epi32(px, bs), byte);
+
+        __m128i rg = _mm_or_si128(r, _mm_slli_epi32(g, 16));
+        __m128i b2 = _mm_or_si128(b, two);
+
+        return _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(rg, mrg),
+                                            _mm_madd_epi16(b2, mb)), 8);
+}
+#endif
+
+static void _luma_row(const uint32_t *src, int w, int rs, int gs, int bs,
+                      uint8_t *y)
+{
+        int x = 0;
+
+#ifdef __SSE2__
+        const __m128i vr = _mm_cvtsi32_si128(rs);
+        const __m128i vg = _mm_cvtsi32_si128(gs);
+        const __m128i vb = _mm_cvtsi32_si128(bs);
+        const __m128i mrg = YUV_PAIR(66, 129);
+        const __m128i mb = YUV_PAIR(25, YUV_Y_BIAS);
+
+        for (; x + 8 <= w; x += 8) {
+                __m128i p0 = _mm_loadu_si128((const __m128i *)(src + x));
+                __m128i p1 = _mm_loadu_si128((const __m128i *)(src + x + 4));
+                __m128i y0 = _yuv_sse2(p0, vr, vg, vb, mrg, mb);
+                __m128i y1 = _yuv_sse2(p1, vr, vg, vb, mrg, mb);
+                __m128i words = _mm_packs_epi32(y0, y1);
+                _mm_storel_epi64((__m128i *)(y + x),
+                                 _mm_packus_epi16(words, words));
+        }
+#endif
+
+        for (; x < w; x++) {
+                uint32_t p = src[x];
+                y[x] = _yuv_y((p >> rs) & 0xff, (p >> gs) & 0xff,
+                              (p >> bs) & 0xff);
+        }
+}
+
+/*
+ * u and v for a pair of rows, each 2x2 block averaged down each column then
+ * across, a missing column or row repeats the last one
+ */
+static void _chroma_row(const uint32_t *row0, const uint32_t *row1, int w,
+                        int rs, int gs, int bs, uint8_t *u, uint8_t *v)
+{
+        int x = 0;
+
+#ifdef __SSE2__
+        const __m128i vr = _mm_cvtsi32_si128(rs);
+        const __m128i vg = _mm_cvtsi32_si128(gs);
+        const __m128i vb = _mm_cvtsi32_si128(bs);
+        const __m128i mrg_u = YUV_PAIR(-38, -74);
+        const __m128i mb_u = YUV_PAIR(112, YUV_C_BIAS);
+        const __m128i mrg_v = YUV_PAIR(112, -94);
+        const __m128i mb_v = YUV_PAIR(-18, YUV_C_BIAS);
+
+        for (; x + 8 <= w; x += 8) {
+                __m128i a = _mm_avg_epu8(
+                        _mm_loadu_si128((const __m128i *)(row0 + x)),
+                        _mm_loadu_si128((const __m128i *)(row1 + x)));
+                __m128i b = _mm_avg_epu8(
+                        _mm_loadu_si128((const __m128i *)(row0 + x + 4)),
+                        _mm_loadu_si128((const __m128i *)(row1 + x + 4)));
+
+                // average each pixel with its right neighbour, the blocks
+                // end up in lanes 0 and 2 of each, then gather them
+                a = _mm_avg_epu8(a, _mm_srli_epi64(a, 32));
+                b = _mm_avg_epu8(b, _mm_srli_epi64(b, 32));
+                __m128i px = _mm_unpacklo_epi64(
+                        _mm_shuffle_epi32(a, _MM_SHUFFLE(3, 1, 2, 0)),
+                        _mm_shuffle_epi32(b, _MM_SHUFFLE(3, 1, 2, 0)));
+
+                __m128i cu = _yuv_sse2(px, vr, vg, vb, mrg_u, mb_u);
+                __m128i cv = _yuv_sse2(px, vr, vg, vb, mrg_v, mb_v);
+                __m128i words = _mm_packs_epi32(cu, cv);
+                __m128i bytes = _mm_packus_epi16(words, words);
+
+                uint32_t packed = _mm_cvtsi128_si32(bytes);
+                memcpy(u + x / 2, &packed, 4);
+                packed = _mm_cvtsi128_si32(_mm_srli_si128(bytes, 4));
+                memcpy(v + x / 2, &packed, 4);
+        }
+#endif
+
+        for (; x < w; x += 2) {
+                int x1 = (x + 1 < w) ? x + 1 : x;
+                uint32_t p[4] = {row0[x], row1[x], row0[x1], row1[x1]};
+                int c[3];
+                int shifts[3] = {rs, gs, bs};
+
+                for (int i = 0; i < 3; i++) {
+                        int s = shifts[i];
+                        c[i] = _avg8(_avg8((p[0] >> s) & 0xff,
+                                           (p[1] >> s) & 0xff),
+                                     _avg8((p[2] >> s) & 0xff,
+                                           (p[3] >> s) & 0xff));
+                }
+
+                u[x / 2] = _yuv_u(c[0], c[1], c[2]);
+                v[x / 2] = _yuv_v(c[0], c[1], c[2]);
+        }
+}
+
+/*
+ * convert w x h packed pixels of the given layout (pitch pixels from one row
+ * to the next) to 8 bit BT.601 studio range Y'CbCr 4:2:0: a full size y
+ * plane and u and v planes of (w + 1) / 2 x (h + 1) / 2, each chroma sample
+ * the average of a 2x2 block
+ */
+void color_rgb32_to_yuv420(const uint32_t *src, int w, int h, int pitch,
+                           enum color_layout layout, uint8_t *y, uint8_t *u,
+                           uint8_t *v)
+{
+        int rs, gs, bs;
+        _layout_shifts(layout, &rs, &gs, &bs);
+
+        for (int row = 0; row < h; row++) {
+                _luma_row(src + row * pitch, w, rs, gs, bs, y + row * w);
+        }
+
+        int cw = (w + 1) / 2;
+        for (int row = 0; row < (h + 1) / 2; row++) {
+                const uint32_t *row0 = src + 2 * row * pitch;
+                const uint32_t *row1 = (2 * row + 1 < h) ? row0 + pitch : row0;
+                _chroma_row(row0, row1, w, rs, gs, bs, u + row * cw,
+                            v + row * cw);
+        }
+}
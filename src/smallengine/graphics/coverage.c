@@ -0,0 +1,230 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <smallengine/graphics/coverage.h>
+#include <smallengine/graphics/canvas.h>
+#include <smallengine/graphics/color.h>
+
+#include <smallengine/sys/mem.h>
+
+/*
+ * index of the lowest set bit, bits must not be 0
+ */
+static inline int _ctz(uint64_t bits)
+{
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_ctzll(bits);
+#else
+        int n = 0;
+        while (!(bits & 1)) {
+                bits >>= 1;
+                n++;
+        }
+        return n;
+#endif
+}
+
+static inline int _popcount(uint64_t bits)
+{
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_popcountll(bits);
+#else
+        int n = 0;
+        for (; bits != 0; bits &= bits - 1) {
+                n++;
+        }
+        return n;
+#endif
+}
+
+/*
+ * Creation and Destruction
+ */
+
+/*
+ * create a coverage mask with every pixel transparent
+ */
+struct coverage coverage(int w, int h)
+{
+        struct coverage cov = {w, h, 0, NULL};
+        cov.words = (w + COVERAGE_WORD_BITS - 1) / COVERAGE_WORD_BITS;
+        cov.bits = (uint64_t *)mem_alloc((cov.words * h + 1) *
+                                         sizeof(uint64_t));
+        memset(cov.bits, 0, cov.words * h * sizeof(uint64_t));
+
+        return cov;
+}
+
+/*
+ * create a coverage mask from a mask of ints, negative values are transparent
+ * as in a texture's mask
+ */
+struct coverage coverage_from_mask(const int *mask, int w, int h)
+{
+        struct coverage cov = coverage(w, h);
+        coverage_update(cov, mask, 0, 0, w - 1, h - 1);
+
+        return cov;
+}
+
+/*
+ * create a coverage mask from a canvas, pixels matching trans are
+ * transparent (none are if trans is NULL)
+ */
+struct coverage coverage_from_canvas(const struct canvas c,
+                                     struct color *trans)
+{
+        struct coverage cov = coverage(c.w, c.h);
+        const struct color *pixels = canvas_pixels(c);
+
+        for (int y = 0; y < c.h; y++) {
+                uint64_t *row = cov.bits + y * cov.words;
+                for (int x = 0; x < c.w; x++) {
+                        if (trans == NULL ||
+                            !color_equal(pixels[y * c.w + x], *trans)) {
+                                row[x / COVERAGE_WORD_BITS] |=
+                                        1ull << (x % COVERAGE_WORD_BITS);
+                        }
+                }
+        }
+
+        return cov;
+}
+
+/*
+ * free all memory used by a coverage mask
+ */
+void coverage_destroy(struct coverage *cov)
+{
+        if (cov->bits != NULL) {
+                mem_free(cov->bits);
+        }
+
+        cov->bits = NULL;
+        cov->w = 0;
+        cov->h = 0;
+        cov->words = 0;
+}
+
+/*
+ * Operations
+ */
+
+/*
+ * set an inclusive area of the coverage from a mask of ints of the same
+ * width, negative values being transparent. For keeping the coverage of a
+ * texture up to date after changing its mask
+ */
+void coverage_update(struct coverage cov, const int *mask, int x1, int y1,
+                     int x2, int y2)
+{
+        if (x1 < 0) { x1 = 0; }
+        if (y1 < 0) { y1 = 0; }
+        if (x2 >= cov.w) { x2 = cov.w - 1; }
+        if (y2 >= cov.h) { y2 = cov.h - 1; }
+
+        for (int y = y1; y <= y2; y++) {
+                uint64_t *row = cov.bits + y * cov.words;
+                const int *in = mask + y * cov.w;
+                for (int x = x1; x <= x2; x++) {
+                        uint64_t bit = 1ull << (x % COVERAGE_WORD_BITS);
+                        if (in[x] >= 0) {
+                                row[x / COVERAGE_WORD_BITS] |= bit;
+                        } else {
+                                row[x / COVERAGE_WORD_BITS] &= ~bit;
+                        }
+                }
+        }
+}
+
+/*
+ * mark one pixel as opaque or transparent
+ */
+void coverage_set(struct coverage cov, int x, int y, int opaque)
+{
+        if (x < 0 || x >= cov.w || y < 0 || y >= cov.h) {
+                return;
+        }
+
+        uint64_t *word = cov.bits + y * cov.words + x / COVERAGE_WORD_BITS;
+        uint64_t bit = 1ull << (x % COVERAGE_WORD_BITS);
+        *word = opaque ? (*word | bit) : (*word & ~bit);
+}
+
+/*
+ * return 1 if the pixel is opaque, 0 if it is transparent or outside the mask
+ */
+int coverage_test(const struct coverage cov, int x, int y)
+{
+        if (x < 0 || x >= cov.w || y < 0 || y >= cov.h) {
+                return 0;
+        }
+
+        uint64_t word = cov.bits[y * cov.words + x / COVERAGE_WORD_BITS];
+        return (word >> (x % COVERAGE_WORD_BITS)) & 1;
+}
+
+/*
+ * find the first run of opaque pixels in row y starting between x1 and x2
+ * inclusive. Returns its length cut short at x2 and stores where it starts
+ * in start, returns 0 if there are none
+ */
+int coverage_span(const struct coverage cov, int y, int x1, int x2,
+                  int *start)
+{
+        if (y < 0 || y >= cov.h) {
+                return 0;
+        }
+        if (x1 < 0) { x1 = 0; }
+        if (x2 >= cov.w) { x2 = cov.w - 1; }
+        if (x1 > x2) {
+                return 0;
+        }
+
+        const uint64_t *row = cov.bits + y * cov.words;
+        int last = x2 / COVERAGE_WORD_BITS;
+
+        // the first opaque pixel, ignoring those before x1
+        int w = x1 / COVERAGE_WORD_BITS;
+        uint64_t bits = row[w] & (~0ull << (x1 % COVERAGE_WORD_BITS));
+        while (bits == 0) {
+                if (++w > last) {
+                        return 0;
+                }
+                bits = row[w];
+        }
+
+        int s = w * COVERAGE_WORD_BITS + _ctz(bits);
+        if (s > x2) {
+                return 0;
+        }
+
+        // then the first transparent pixel after it, the unused bits at the
+        // end of a row are 0 so a run always ends within the row
+        bits = ~row[w] & (~0ull << (s % COVERAGE_WORD_BITS));
+        while (bits == 0 && w < last) {
+                bits = ~row[++w];
+        }
+
+        int e = (bits == 0) ? x2 + 1 : w * COVERAGE_WORD_BITS + _ctz(bits);
+        if (e > x2 + 1) {
+                e = x2 + 1;
+        }
+
+        *start = s;
+        return e - s;
+}
+
+/*
+ * return the number of opaque pixels
+ */
+int coverage_count(const struct coverage cov)
+{
+        int n = 0;
+        for (int i = 0; i < cov.words * cov.h; i++) {
+                n += _popcount(cov.bits[i]);
+        }
+
+        return n;
+}
@@ -0,0 +1,321 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <smallengine/graphics/hdr.h>
+#include <smallengine/graphics/canvas.h>
+#include <smallengine/graphics/color.h>
+
+#include <smallengine/sys/mem.h>
+
+/*
+ * Creation and Destruction
+ */
+
+/*
+ * create a new hdr canvas, every colour will be initialised to (0, 0, 0, 0)
+ */
+struct hdr_canvas hdr_canvas(const int w, const int h)
+{
+        struct hdr_canvas hdr = {w, h, NULL};
+        hdr.pixels = (struct color16 *)mem_alloc(w * h *
+                                                 sizeof(struct color16));
+        memset(hdr.pixels, 0, w * h * sizeof(struct color16));
+
+        return hdr;
+}
+
+/*
+ * create a hdr canvas holding the same image as a canvas, components are
+ * clamped to 0.0-16.0
+ */
+struct hdr_canvas hdr_canvas_from_canvas(const struct canvas c)
+{
+        struct hdr_canvas hdr = hdr_canvas(c.w, c.h);
+        const struct color *pixels = canvas_pixels(c);
+
+        for (int i = 0; i < c.w * c.h; i++) {
+                hdr.pixels[i] = color16_from_color(pixels[i]);
+        }
+
+        return hdr;
+}
+
+/*
+ * free all memory used by a hdr canvas
+ */
+void hdr_canvas_destroy(struct hdr_canvas *hdr)
+{
+        mem_free(hdr->pixels);
+        hdr->pixels = NULL;
+        hdr->w = 0;
+        hdr->h = 0;
+}
+
+/*
+ * Spans
+ */
+
+#ifdef __SSE2__
+/*
+ * each register holds two pixels, the alpha lanes are 3 and 7
+ */
+static inline __m128i _alpha_mask_sse2()
+{
+        return _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+}
+
+/*
+ * saturating add, alpha comes out as 1.0 as with color16_add
+ */
+static inline __m128i _add_sse2(__m128i dst, __m128i src)
+{
+        const __m128i amask = _alpha_mask_sse2();
+        const __m128i one = _mm_set1_epi16(COLOR16_ONE);
+
+        __m128i sum = _mm_adds_epu16(dst, src);
+        return _mm_or_si128(_mm_andnot_si128(amask, sum),
+                            _mm_and_si128(amask, one));
+}
+
+/*
+ * saturating 4.12 multiply, (dst * src) >> 12 assembled from the high and low
+ * halves of the 32 bit products. It overflows once the high half reaches
+ * 0x1000, alpha comes out as 1.0 as with color16_multiply
+ */
+static inline __m128i _mul_sse2(__m128i dst, __m128i src)
+{
+        const __m128i amask = _alpha_mask_sse2();
+        const __m128i one = _mm_set1_epi16(COLOR16_ONE);
+        const __m128i limit = _mm_set1_epi16(0x0fff);
+
+        __m128i hi = _mm_mulhi_epu16(dst, src);
+        __m128i lo = _mm_mullo_epi16(dst, src);
+        __m128i prod = _mm_or_si128(_mm_slli_epi16(hi, 4),
+                                    _mm_srli_epi16(lo, 12));
+        __m128i fits = _mm_cmpeq_epi16(_mm_subs_epu16(hi, limit),
+                                       _mm_setzero_si128());
+        prod = _mm_or_si128(prod, _mm_andnot_si128(fits, _mm_set1_epi16(-1)));
+
+        return _mm_or_si128(_mm_andnot_si128(amask, prod),
+                            _mm_and_si128(amask, one));
+}
+#endif
+
+static inline void _blend(struct color16 *dst, const struct color16 col,
+                          enum blit_mode mode)
+{
+        switch (mode) {
+                case BLIT_ABS:
+                        *dst = col;
+                        break;
+
+                case BLIT_ADD:
+                        *dst = color16_add(*dst, col);
+                        break;
+
+                case BLIT_MUL:
+                        *dst = color16_multiply(*dst, col);
+                        break;
+
+                default:
+                        break;
+        }
+}
+
+/*
+ * blend col into n pixels starting at dst according to the blit mode
+ */
+void hdr_fill_span(struct color16 *dst, const struct color16 col, int n,
+                   enum blit_mode mode)
+{
+        int i = 0;
+
+        if (mode == BLIT_ABS) {
+                for (; i < n; i++) {
+                        dst[i] = col;
+                }
+                return;
+        }
+
+#ifdef __SSE2__
+        __m128i c = _mm_set_epi16(col.a, col.b, col.g, col.r,
+                                  col.a, col.b, col.g, col.r);
+        for (; i + 1 < n; i += 2) {
+                __m128i d = _mm_loadu_si128((__m128i *)&dst[i]);
+                d = (mode == BLIT_ADD) ? _add_sse2(d, c) : _mul_sse2(d, c);
+                _mm_storeu_si128((__m128i *)&dst[i], d);
+        }
+#endif
+
+        for (; i < n; i++) {
+                _blend(&dst[i], col, mode);
+        }
+}
+
+/*
+ * blend n pixels from src into n pixels starting at dst
+ */
+void hdr_blend_span(struct color16 *dst, const struct color16 *src, int n,
+                    enum blit_mode mode)
+{
+        int i = 0;
+
+        if (mode == BLIT_ABS) {
+                memmove(dst, src, n * sizeof(struct color16));
+                return;
+        }
+
+#ifdef __SSE2__
+        for (; i + 1 < n; i += 2) {
+                __m128i d = _mm_loadu_si128((__m128i *)&dst[i]);
+                __m128i s = _mm_loadu_si128((__m128i *)&src[i]);
+                d = (mode == BLIT_ADD) ? _add_sse2(d, s) : _mul_sse2(d, s);
+                _mm_storeu_si128((__m128i *)&dst[i], d);
+        }
+#endif
+
+        for (; i < n; i++) {
+                _blend(&dst[i], src[i], mode);
+        }
+}
+
+/*
+ * scale a component to 0-255, rounding as color_to_RGBA would on the
+ * equivalent double
+ */
+static inline uint32_t _quantise(uint32_t comp)
+{
+        comp = (comp > COLOR16_ONE) ? COLOR16_ONE : comp;
+        return (comp * 255 + COLOR16_ONE / 2) >> 12;
+}
+
+/*
+ * convert n pixels to packed 32 bit pixels as color_span_to_rgba32, values
+ * above 1.0 are clamped to white
+ */
+void hdr_span_to_rgba32(const struct color16 *src, uint32_t *dst, int n,
+                        enum color_layout layout)
+{
+        int i = 0;
+
+#if defined(__SSE2__) && SDL_BYTEORDER == SDL_LIL_ENDIAN
+        // comp * 255 + 2048 for each component with madd against pairs of
+        // (comp, 1), components are clamped to 1.0 first so this fits
+        const __m128i one = _mm_set1_epi16(COLOR16_ONE);
+        const __m128i ones = _mm_set1_epi16(1);
+        const __m128i factors = _mm_set_epi16(COLOR16_ONE / 2, 255,
+                                              COLOR16_ONE / 2, 255,
+                                              COLOR16_ONE / 2, 255,
+                                              COLOR16_ONE / 2, 255);
+        const __m128i opaque = _mm_set1_epi32(0xff000000);
+
+        for (; i + 1 < n; i += 2) {
+                __m128i v = _mm_loadu_si128((__m128i *)&src[i]);
+                v = _mm_sub_epi16(v, _mm_subs_epu16(v, one));
+                if (layout == COLOR_ARGB) {
+                        v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(3, 0, 1, 2));
+                        v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(3, 0, 1, 2));
+                }
+
+                __m128i p0 = _mm_madd_epi16(_mm_unpacklo_epi16(v, ones),
+                                            factors);
+                __m128i p1 = _mm_madd_epi16(_mm_unpackhi_epi16(v, ones),
+                                            factors);
+                p0 = _mm_srli_epi32(p0, 12);
+                p1 = _mm_srli_epi32(p1, 12);
+
+                __m128i words = _mm_packs_epi32(p0, p1);
+                __m128i bytes = _mm_or_si128(_mm_packus_epi16(words, words),
+                                             opaque);
+                _mm_storel_epi64((__m128i *)&dst[i], bytes);
+        }
+#endif
+
+        for (; i < n; i++) {
+                uint32_t r = _quantise(src[i].r);
+                uint32_t g = _quantise(src[i].g);
+                uint32_t b = _quantise(src[i].b);
+                if (layout == COLOR_ARGB) {
+                        dst[i] = 0xffu << 24 | r << 16 | g << 8 | b;
+                } else {
+                        dst[i] = r << RSHIFT | g << GSHIFT | b << BSHIFT |
+                                 0xffu << ASHIFT;
+                }
+        }
+}
+
+/*
+ * Operations
+ */
+
+/*
+ * fill the hdr canvas with the color given
+ */
+void hdr_canvas_fill(struct hdr_canvas hdr, const struct color16 col)
+{
+        hdr_fill_span(hdr.pixels, col, hdr.w * hdr.h, BLIT_ABS);
+}
+
+/*
+ * set every pixel in the hdr canvas to black (0, 0, 0)
+ */
+void hdr_canvas_clear(struct hdr_canvas hdr)
+{
+        struct color16 black = {0, 0, 0, COLOR16_ONE};
+        hdr_canvas_fill(hdr, black);
+}
+
+/*
+ * blit an area of one hdr canvas to another using the specified blending
+ * mode, the coordinates are inclusive as with canvas_blit
+ */
+void hdr_canvas_blit(const struct hdr_canvas src, int srx1, int sry1,
+                     int srx2, int sry2, struct hdr_canvas dst, int dsx,
+                     int dsy, enum blit_mode mode)
+{
+        // clip the source area to the source, then to the destination
+        if (srx1 < 0) { dsx -= srx1; srx1 = 0; }
+        if (sry1 < 0) { dsy -= sry1; sry1 = 0; }
+        if (srx2 >= src.w) { srx2 = src.w - 1; }
+        if (sry2 >= src.h) { sry2 = src.h - 1; }
+        if (dsx < 0) { srx1 -= dsx; dsx = 0; }
+        if (dsy < 0) { sry1 -= dsy; dsy = 0; }
+        if (dsx + srx2 - srx1 >= dst.w) { srx2 = srx1 + dst.w - 1 - dsx; }
+        if (dsy + sry2 - sry1 >= dst.h) { sry2 = sry1 + dst.h - 1 - dsy; }
+
+        int w = srx2 - srx1 + 1;
+        if (w <= 0 || sry2 < sry1) {
+                return;
+        }
+
+        for (int y = sry1; y <= sry2; y++) {
+                hdr_blend_span(&dst.pixels[(dsy + y - sry1) * dst.w + dsx],
+                               &src.pixels[y * src.w + srx1], w, mode);
+        }
+}
+
+/*
+ * write the hdr canvas into the top left of a canvas, values above 1.0 are
+ * kept
+ */
+void hdr_canvas_resolve(const struct hdr_canvas src, struct canvas dst)
+{
+        int w = (src.w < dst.w) ? src.w : dst.w;
+        int h = (src.h < dst.h) ? src.h : dst.h;
+        if (w <= 0 || h <= 0) {
+                return;
+        }
+
+        struct color *out = canvas_pixels_writable(dst);
+        for (int y = 0; y < h; y++) {
+                for (int x = 0; x < w; x++) {
+                        out[y * dst.w + x] = color16_to_color(
+                                        src.pixels[y * src.w + x]);
+                }
+        }
+}
@@ -0,0 +1,460 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+// the shuffle path is built for SSSE3 whatever the compiler flags and only
+// used once the cpu is known to have it
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <tmmintrin.h>
+#define INDEXED_SSSE3
+#endif
+
+#include <smallengine/graphics/indexed.h>
+#include <smallengine/graphics/canvas.h>
+#include <smallengine/graphics/color.h>
+#include <smallengine/graphics/palette.h>
+#include <smallengine/graphics/quantise.h>
+#include <smallengine/graphics/texture.h>
+
+#include <smallengine/sys/mem.h>
+
+/*
+ * an area to copy after clipping against both the source and destination
+ */
+struct indexed_area {
+        int sx, sy;             // top left in the source
+        int dx, dy;             // top left in the destination
+        int w, h;
+};
+
+/*
+ * clip an inclusive source area drawn at dsx, dsy, returns 0 if nothing is
+ * left to draw
+ */
+static int _clip(const struct indexed_texture it, int srx1, int sry1,
+                 int srx2, int sry2, int dst_w, int dst_h, int dsx, int dsy,
+                 struct indexed_area *area)
+{
+        if (srx1 < 0) { dsx -= srx1; srx1 = 0; }
+        if (sry1 < 0) { dsy -= sry1; sry1 = 0; }
+        if (srx2 >= it.w) { srx2 = it.w - 1; }
+        if (sry2 >= it.h) { sry2 = it.h - 1; }
+        if (dsx < 0) { srx1 -= dsx; dsx = 0; }
+        if (dsy < 0) { sry1 -= dsy; dsy = 0; }
+        if (dsx + srx2 - srx1 >= dst_w) { srx2 = srx1 + dst_w - 1 - dsx; }
+        if (dsy + sry2 - sry1 >= dst_h) { sry2 = sry1 + dst_h - 1 - dsy; }
+
+        area->sx = srx1;
+        area->sy = sry1;
+        area->dx = dsx;
+        area->dy = dsy;
+        area->w = srx2 - srx1 + 1;
+        area->h = sry2 - sry1 + 1;
+
+        return (area->w > 0 && area->h > 0);
+}
+
+static struct indexed_texture _alloc(int w, int h, struct palette pal,
+                                     int owns_palette, enum color_space space)
+{
+        struct indexed_texture it = {w, h, 0, NULL, pal, owns_palette, space};
+        it.wide = (pal.assigned > INDEXED_CLEAR_8);
+        it.indices = mem_alloc(w * h * (it.wide ? 2 : 1));
+
+        return it;
+}
+
+/*
+ * store the indices of a mask, negative values are transparent
+ */
+static void _fill_indices(struct indexed_texture it, const int *mask)
+{
+        for (int i = 0; i < it.w * it.h; i++) {
+                if (it.wide) {
+                        uint16_t *indices = (uint16_t *)it.indices;
+                        indices[i] = (mask[i] < 0 ||
+                                      mask[i] >= INDEXED_CLEAR_16) ?
+                                     INDEXED_CLEAR_16 : mask[i];
+                } else {
+                        uint8_t *indices = (uint8_t *)it.indices;
+                        indices[i] = (mask[i] < 0) ? INDEXED_CLEAR_8 : mask[i];
+                }
+        }
+}
+
+/*
+ * Creation and Destruction
+ */
+
+/*
+ * create an indexed texture from a canvas, pixels matching trans are
+ * transparent (none are if trans is NULL). The canvas isn't kept
+ */
+struct indexed_texture indexed_texture_from_canvas(const struct canvas c,
+                                                   struct color *trans)
+{
+        int *mask = (int *)mem_alloc(c.w * c.h * sizeof(int));
+        struct palette pal = palette_from_canvas_indexed(c, mask);
+
+        if (trans != NULL) {
+                for (int i = 0; i < c.w * c.h; i++) {
+                        if (color_equal(pal.colors[mask[i]], *trans)) {
+                                mask[i] = -1;
+                        }
+                }
+        }
+
+        struct indexed_texture it = _alloc(c.w, c.h, pal, 1,
+                                            canvas_color_space(c));
+        _fill_indices(it, mask);
+        mem_free(mask);
+
+        return it;
+}
+
+/*
+ * create an indexed texture drawing the same as a texture, the palette is
+ * shared so changes to the texture's palette show in both
+ */
+struct indexed_texture indexed_texture_from_texture(const struct texture tex)
+{
+        struct indexed_texture it = _alloc(tex.w, tex.h, tex.palette, 0,
+                                canvas_color_space(tex.canvas));
+        _fill_indices(it, tex.mask);
+
+        return it;
+}
+
+/*
+ * create an indexed texture from a canvas using the nearest colors of an
+ * existing palette, such as the one the screen is drawn with. The palette is
+ * shared rather than copied, pixels matching trans are transparent
+ */
+struct indexed_texture indexed_texture_from_palette(const struct canvas c,
+                                                    const struct palette pal,
+                                                    struct color *trans)
+{
+        struct quantiser q = quantiser(pal);
+        int *mask = (int *)mem_alloc(c.w * c.h * sizeof(int));
+        const struct color *pixels = canvas_pixels(c);
+
+        for (int i = 0; i < c.w * c.h; i++) {
+                if (trans != NULL && color_equal(pixels[i], *trans)) {
+                        mask[i] = -1;
+                } else {
+                        mask[i] = quantiser_nearest(q, pixels[i]);
+                }
+        }
+
+        struct indexed_texture it = _alloc(c.w, c.h, pal, 0,
+                                            canvas_color_space(c));
+        _fill_indices(it, mask);
+        mem_free(mask);
+        quantiser_destroy(&q);
+
+        return it;
+}
+
+/*
+ * free all memory used by an indexed texture, a shared palette is left alone
+ */
+void indexed_texture_destroy(struct indexed_texture *it)
+{
+        if (it->owns_palette) {
+                palette_destroy(&it->palette);
+        }
+
+        if (it->indices != NULL) {
+                mem_free(it->indices);
+        }
+
+        it->indices = NULL;
+        it->w = 0;
+        it->h = 0;
+}
+
+/*
+ * Operations
+ */
+
+/*
+ * return the palette index at the given coordinate, -1 if the pixel is
+ * transparent or outside the texture
+ */
+int indexed_texture_read_index(const struct indexed_texture it, int x, int y)
+{
+        if (x < 0 || x >= it.w || y < 0 || y >= it.h) {
+                return -1;
+        }
+
+        if (it.wide) {
+                uint16_t index = ((uint16_t *)it.indices)[y * it.w + x];
+                return (index == INDEXED_CLEAR_16) ? -1 : index;
+        }
+
+        uint8_t index = ((uint8_t *)it.indices)[y * it.w + x];
+        return (index == INDEXED_CLEAR_8) ? -1 : index;
+}
+
+/*
+ * set every pixel of an indexed texture to the same index, INDEXED_CLEAR_8 or
+ * INDEXED_CLEAR_16 clears it
+ */
+void indexed_texture_fill(struct indexed_texture it, int index)
+{
+        if (it.wide) {
+                uint16_t *indices = (uint16_t *)it.indices;
+                for (int i = 0; i < it.w * it.h; i++) {
+                        indices[i] = index;
+                }
+        } else {
+                memset(it.indices, index, it.w * it.h);
+        }
+}
+
+/*
+ * map one row of indices through the palette colors onto a canvas row
+ */
+#define BLIT_ROW(type, clear) \
+        for (int i = 0; i < n; i++) { \
+                type index = ((const type *)row)[i]; \
+                if (index == clear) { \
+                        continue; \
+                } \
+                struct color col = (index < count) ? colors[index] : black; \
+                if (mode == BLIT_ABS) { \
+                        out[i] = col; \
+                } else { \
+                        canvas_fill_span(&out[i], col, 1, mode); \
+                } \
+        }
+
+static void _blit_row(const struct indexed_texture *it,
+                      const struct color *colors, const void *row,
+                      struct color *out, int n, enum blit_mode mode)
+{
+        const int count = it->palette.assigned;
+        const struct color black = color_rgb(0.0, 0.0, 0.0);
+
+        if (it->wide) {
+                BLIT_ROW(uint16_t, INDEXED_CLEAR_16);
+        } else {
+                BLIT_ROW(uint8_t, INDEXED_CLEAR_8);
+        }
+}
+
+/*
+ * blit an area of an indexed texture to a canvas using the specified blending
+ * mode, the coordinates are inclusive as with texture_blit_to_canvas
+ */
+void indexed_texture_blit(const struct indexed_texture it, int srx1, int sry1,
+                          int srx2, int sry2, struct canvas dst, int dsx,
+                          int dsy, enum blit_mode mode)
+{
+        struct indexed_area area;
+        if (!_clip(it, srx1, sry1, srx2, sry2, dst.w, dst.h, dsx, dsy,
+                   &area)) {
+                return;
+        }
+
+        struct color *pixels = canvas_pixels_writable(dst);
+        int size = it.wide ? 2 : 1;
+
+        // a palette from another color space is converted once per blit
+        struct color *converted = palette_convert_colors(it.palette, it.space,
+                                        canvas_color_space(dst));
+        const struct color *colors = (converted != NULL) ? converted :
+                                                           it.palette.colors;
+
+        for (int y = 0; y < area.h; y++) {
+                const uint8_t *row = (const uint8_t *)it.indices +
+                                     ((area.sy + y) * it.w + area.sx) * size;
+                _blit_row(&it, colors, row,
+                          pixels + (area.dy + y) * dst.w + area.dx, area.w,
+                          mode);
+        }
+
+        if (converted != NULL) {
+                mem_free(converted);
+        }
+}
+
+/*
+ * copy the indices of an area of one indexed texture into another, skipping
+ * transparent pixels. No colors are looked up so both should index the same
+ * palette (see indexed_texture_from_palette), and both must have indices of
+ * the same size
+ */
+void indexed_texture_blit_indices(const struct indexed_texture it, int srx1,
+                                  int sry1, int srx2, int sry2,
+                                  struct indexed_texture dst, int dsx, int dsy)
+{
+        struct indexed_area area;
+        if (it.wide != dst.wide ||
+            !_clip(it, srx1, sry1, srx2, sry2, dst.w, dst.h, dsx, dsy,
+                   &area)) {
+                return;
+        }
+
+        for (int y = 0; y < area.h; y++) {
+                int from = (area.sy + y) * it.w + area.sx;
+                int to = (area.dy + y) * dst.w + area.dx;
+
+                if (it.wide) {
+                        const uint16_t *row = (const uint16_t *)it.indices +
+                                              from;
+                        uint16_t *out = (uint16_t *)dst.indices + to;
+                        for (int i = 0; i < area.w; i++) {
+                                if (row[i] != INDEXED_CLEAR_16) {
+                                        out[i] = row[i];
+                                }
+                        }
+                } else {
+                        const uint8_t *row = (const uint8_t *)it.indices +
+                                             from;
+                        uint8_t *out = (uint8_t *)dst.indices + to;
+                        for (int i = 0; i < area.w; i++) {
+                                if (row[i] != INDEXED_CLEAR_8) {
+                                        out[i] = row[i];
+                                }
+                        }
+                }
+        }
+}
+
+#ifdef INDEXED_SSSE3
+#define INDEXED_SMALL 15        // colors drawn with the shuffle, the 16th
+                                // entry stands for every index beyond them
+
+/*
+ * 16 pixels of 8 bit indices from a palette of at most INDEXED_SMALL colors:
+ * each byte of the packed colors is looked up with a byte shuffle, then the
+ * four bytes are interleaved back into pixels. Indices are clamped to the
+ * last entry first, as the shuffle only looks at their low bits. Transparent
+ * pixels keep what was there
+ */
+__attribute__((target("ssse3")))
+static int _blit_rgba32_small(const uint8_t *row, uint32_t *out, int n,
+                              const uint8_t bytes[4][16])
+{
+        const __m128i clear = _mm_set1_epi8((char)INDEXED_CLEAR_8);
+        const __m128i last = _mm_set1_epi8(INDEXED_SMALL);
+        __m128i planes[4];
+        for (int p = 0; p < 4; p++) {
+                planes[p] = _mm_loadu_si128((const __m128i *)bytes[p]);
+        }
+
+        int i = 0;
+        for (; i + 16 <= n; i += 16) {
+                __m128i idx = _mm_loadu_si128((const __m128i *)&row[i]);
+                __m128i keep = _mm_cmpeq_epi8(idx, clear);
+                idx = _mm_min_epu8(idx, last);
+
+                __m128i b0 = _mm_shuffle_epi8(planes[0], idx);
+                __m128i b1 = _mm_shuffle_epi8(planes[1], idx);
+                __m128i b2 = _mm_shuffle_epi8(planes[2], idx);
+                __m128i b3 = _mm_shuffle_epi8(planes[3], idx);
+
+                __m128i lo01 = _mm_unpacklo_epi8(b0, b1);
+                __m128i hi01 = _mm_unpackhi_epi8(b0, b1);
+                __m128i lo23 = _mm_unpacklo_epi8(b2, b3);
+                __m128i hi23 = _mm_unpackhi_epi8(b2, b3);
+                __m128i lok = _mm_unpacklo_epi8(keep, keep);
+                __m128i hik = _mm_unpackhi_epi8(keep, keep);
+
+                __m128i px[4] = {
+                        _mm_unpacklo_epi16(lo01, lo23),
+                        _mm_unpackhi_epi16(lo01, lo23),
+                        _mm_unpacklo_epi16(hi01, hi23),
+                        _mm_unpackhi_epi16(hi01, hi23)
+                };
+                __m128i mask[4] = {
+                        _mm_unpacklo_epi16(lok, lok),
+                        _mm_unpackhi_epi16(lok, lok),
+                        _mm_unpacklo_epi16(hik, hik),
+                        _mm_unpackhi_epi16(hik, hik)
+                };
+
+                for (int k = 0; k < 4; k++) {
+                        __m128i *dst = (__m128i *)&out[i + k * 4];
+                        __m128i old = _mm_loadu_si128(dst);
+                        _mm_storeu_si128(dst, _mm_or_si128(
+                                        _mm_and_si128(mask[k], old),
+                                        _mm_andnot_si128(mask[k], px[k])));
+                }
+        }
+
+        return i;
+}
+#endif
+
+/*
+ * copy an area of an indexed texture to packed pixels (as color_to_RGBA),
+ * dst is dst_w x dst_h pixels with pitch pixels from one row to the next.
+ * Palettes of 15 colors or fewer are drawn 16 pixels at a time with SSSE3
+ * when the cpu has it
+ */
+void indexed_texture_blit_rgba32(const struct indexed_texture it, int srx1,
+                                 int sry1, int srx2, int sry2, uint32_t *dst,
+                                 int dst_w, int dst_h, int pitch, int dsx,
+                                 int dsy)
+{
+        struct indexed_area area;
+        if (!_clip(it, srx1, sry1, srx2, sry2, dst_w, dst_h, dsx, dsy,
+                   &area)) {
+                return;
+        }
+
+        // indices beyond the palette come out black, as palette_get_by_index
+        int entries = it.wide ? INDEXED_CLEAR_16 : INDEXED_CLEAR_8;
+        int count = (it.palette.assigned < entries) ? it.palette.assigned :
+                                                      entries;
+        const uint32_t *packed = it.palette.packed;
+        uint32_t black = color_to_RGBA(color_rgb(0.0, 0.0, 0.0));
+
+#ifdef INDEXED_SSSE3
+        uint8_t bytes[4][16];
+        int small = (!it.wide && count <= INDEXED_SMALL &&
+                     __builtin_cpu_supports("ssse3"));
+        if (small) {
+                for (int k = 0; k < 16; k++) {
+                        uint32_t c = (k < count) ? packed[k] : black;
+                        bytes[0][k] = c & 0xff;
+                        bytes[1][k] = (c >> 8) & 0xff;
+                        bytes[2][k] = (c >> 16) & 0xff;
+                        bytes[3][k] = (c >> 24) & 0xff;
+                }
+        }
+#endif
+
+        for (int y = 0; y < area.h; y++) {
+                uint32_t *out = dst + (area.dy + y) * pitch + area.dx;
+                int first = (area.sy + y) * it.w + area.sx;
+                int i = 0;
+
+                if (it.wide) {
+                        const uint16_t *row = (const uint16_t *)it.indices +
+                                              first;
+                        for (; i < area.w; i++) {
+                                if (row[i] != INDEXED_CLEAR_16) {
+                                        out[i] = (row[i] < count) ?
+                                                 packed[row[i]] : black;
+                                }
+                        }
+                        continue;
+                }
+
+                const uint8_t *row = (const uint8_t *)it.indices + first;
+#ifdef INDEXED_SSSE3
+                if (small) {
+                        i = _blit_rgba32_small(row, out, area.w, bytes);
+                }
+#endif
+                for (; i < area.w; i++) {
+                        if (row[i] != INDEXED_CLEAR_8) {
+                                out[i] = (row[i] < count) ? packed[row[i]] :
+                                                            black;
+                        }
+                }
+        }
+}
@@ -0,0 +1,448 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <SDL2/SDL.h>
+
+#include <smallengine/graphics/loader.h>
+#include <smallengine/graphics/atlas.h>
+#include <smallengine/graphics/canvas.h>
+#include <smallengine/graphics/color.h>
+#include <smallengine/graphics/texture.h>
+
+#include <smallengine/sys/log.h>
+#include <smallengine/sys/mem.h>
+
+#define LOADER_MAX_THREADS 8
+
+struct loader_request {
+        struct loader_result result;
+        char *filename;
+        struct color trans;
+        int has_trans;
+        struct atlas *atlas;
+        int priority;
+        SDL_atomic_t cancelled;
+        struct loader_request *next;    // in whichever list it is on
+};
+
+static struct {
+        SDL_Thread *threads[LOADER_MAX_THREADS];
+        int threads_started;
+
+        SDL_mutex *lock;                // guards the queue and running list
+        SDL_cond *wake;                 // loader threads wait here for work
+        int quit;
+        struct loader_request *queue;   // highest priority first
+        struct loader_request *running;
+
+        // finished requests are pushed here by the loader threads without
+        // taking the lock, newest first. Polling takes the whole list at once
+        // and keeps it oldest first in ready, which only it touches
+        struct loader_request *done;
+        struct loader_request *ready;
+
+        SDL_mutex *atlas_lock;          // one insert into any atlas at a time
+        int next_id;
+        int pending;
+} loader;
+
+/*
+ * free a request and anything it loaded which will never be handed back
+ */
+static void _discard(struct loader_request *req)
+{
+        struct loader_result *r = &req->result;
+
+        if (r->ok) {
+                switch (r->type) {
+                case LOADER_CANVAS:
+                        canvas_destroy(&r->canvas);
+                        break;
+                case LOADER_TEXTURE:
+                        texture_destroy(&r->texture);
+                        break;
+                case LOADER_ATLAS:
+                        SDL_LockMutex(loader.atlas_lock);
+                        atlas_remove(req->atlas, r->handle);
+                        SDL_UnlockMutex(loader.atlas_lock);
+                        break;
+                default:
+                        break;
+                }
+        }
+
+        mem_free(req->filename);
+        mem_free(req);
+}
+
+/*
+ * do the work of a request, stopping early once it has been cancelled
+ */
+static void _load(struct loader_request *req)
+{
+        struct loader_result *r = &req->result;
+        struct color *trans = req->has_trans ? &req->trans : NULL;
+
+        struct canvas c = canvas_from_file(req->filename);
+        if (c.w == 0 || SDL_AtomicGet(&req->cancelled)) {
+                canvas_destroy(&c);
+                return;
+        }
+
+        switch (r->type) {
+        case LOADER_CANVAS:
+                r->canvas = c;
+                r->ok = 1;
+                return;
+        case LOADER_TEXTURE:
+                r->texture = texture_from_canvas(c, trans);
+                r->ok = 1;
+                break;
+        case LOADER_ATLAS:
+                SDL_LockMutex(loader.atlas_lock);
+                if (!SDL_AtomicGet(&req->cancelled)) {
+                        r->handle = atlas_add_canvas(req->atlas, c, trans);
+                        r->ok = (r->handle >= 0);
+                }
+                SDL_UnlockMutex(loader.atlas_lock);
+                break;
+        default:
+                break;
+        }
+
+        canvas_destroy(&c);
+}
+
+/*
+ * hand a finished request back to the polling thread
+ */
+static void _push_done(struct loader_request *req)
+{
+        void *head;
+        do {
+                head = SDL_AtomicGetPtr((void **)&loader.done);
+                req->next = head;
+        } while (!SDL_AtomicCASPtr((void **)&loader.done, head, req));
+}
+
+/*
+ * remove a request from a list, returns 1 if it was there
+ */
+static int _unlink(struct loader_request **list, struct loader_request *req)
+{
+        for (; *list != NULL; list = &(*list)->next) {
+                if (*list == req) {
+                        *list = req->next;
+                        return 1;
+                }
+        }
+
+        return 0;
+}
+
+static int _worker(void *unused)
+{
+        SDL_LockMutex(loader.lock);
+
+        while (1) {
+                while (loader.queue == NULL && !loader.quit) {
+                        SDL_CondWait(loader.wake, loader.lock);
+                }
+
+                if (loader.quit) {
+                        break;
+                }
+
+                struct loader_request *req = loader.queue;
+                loader.queue = req->next;
+                req->next = loader.running;
+                loader.running = req;
+                SDL_UnlockMutex(loader.lock);
+
+                _load(req);
+
+                // pushed under the lock so a cancel finds it either running
+                // or finished, never in between
+                SDL_LockMutex(loader.lock);
+                _unlink(&loader.running, req);
+                int cancelled = SDL_AtomicGet(&req->cancelled);
+                if (!cancelled) {
+                        _push_done(req);
+                }
+                SDL_UnlockMutex(loader.lock);
+
+                if (cancelled) {
+                        _discard(req);
+                }
+
+                SDL_LockMutex(loader.lock);
+        }
+
+        SDL_UnlockMutex(loader.lock);
+        return 0;
+}
+
+/*
+ * create the locks on the first request or loader_init, whichever is first
+ */
+static void _setup(void)
+{
+        if (loader.lock == NULL) {
+                loader.lock = SDL_CreateMutex();
+                loader.wake = SDL_CreateCond();
+                loader.atlas_lock = SDL_CreateMutex();
+                loader.quit = 0;
+        }
+}
+
+/*
+ * start the loader threads, passing 0 starts one. Returns the number started
+ */
+int loader_init(int threads)
+{
+        if (loader.threads_started > 0) {
+                return loader.threads_started;
+        }
+
+        if (threads <= 0) {
+                threads = 1;
+        }
+
+        if (threads > LOADER_MAX_THREADS) {
+                threads = LOADER_MAX_THREADS;
+        }
+
+        _setup();
+
+        int i;
+        for (i = 0; i < threads; i++) {
+                loader.threads[i] = SDL_CreateThread(_worker, "loader", NULL);
+                if (loader.threads[i] == NULL) {
+                        log_wrn("Unable to create loader: %s", SDL_GetError());
+                        break;
+                }
+        }
+
+        loader.threads_started = i;
+        return loader.threads_started;
+}
+
+/*
+ * cancel everything outstanding, stop the loader threads and free any results
+ * that were never polled
+ */
+void loader_quit(void)
+{
+        if (loader.lock == NULL) {
+                return;
+        }
+
+        SDL_LockMutex(loader.lock);
+        loader.quit = 1;
+        SDL_CondBroadcast(loader.wake);
+        SDL_UnlockMutex(loader.lock);
+
+        for (int i = 0; i < loader.threads_started; i++) {
+                SDL_WaitThread(loader.threads[i], NULL);
+        }
+
+        // nothing is running now, only queued and finished requests are left
+        struct loader_request *lists[3] = {loader.queue, loader.ready,
+                                           loader.done};
+        for (int i = 0; i < 3; i++) {
+                while (lists[i] != NULL) {
+                        struct loader_request *next = lists[i]->next;
+                        _discard(lists[i]);
+                        lists[i] = next;
+                }
+        }
+
+        SDL_DestroyMutex(loader.atlas_lock);
+        SDL_DestroyCond(loader.wake);
+        SDL_DestroyMutex(loader.lock);
+
+        memset(&loader, 0, sizeof(loader));
+}
+
+/*
+ * queue a request behind any of the same or higher priority
+ */
+static int _request(const char *filename, enum loader_type type,
+                    struct color *trans, struct atlas *a, int priority,
+                    void *user)
+{
+        struct loader_request *req = (struct loader_request *)mem_alloc(
+                                        sizeof(struct loader_request));
+        memset(req, 0, sizeof(struct loader_request));
+
+        req->filename = (char *)mem_alloc(strlen(filename) + 1);
+        strcpy(req->filename, filename);
+        req->has_trans = (trans != NULL);
+        if (trans != NULL) {
+                req->trans = *trans;
+        }
+        req->atlas = a;
+        req->priority = priority;
+        SDL_AtomicSet(&req->cancelled, 0);
+
+        req->result.id = ++loader.next_id;
+        req->result.type = type;
+        req->result.user = user;
+        req->result.handle = -1;
+
+        _setup();
+        SDL_LockMutex(loader.lock);
+        struct loader_request **at = &loader.queue;
+        while (*at != NULL && (*at)->priority >= priority) {
+                at = &(*at)->next;
+        }
+        req->next = *at;
+        *at = req;
+        SDL_CondSignal(loader.wake);
+        SDL_UnlockMutex(loader.lock);
+
+        loader.pending++;
+        return req->result.id;
+}
+
+/*
+ * queue an image to be loaded as a canvas. Higher priorities are loaded
+ * first, equal priorities in the order requested. Returns the id of the
+ * request, user is handed back with the result
+ */
+int loader_request_canvas(const char *filename, int priority, void *user)
+{
+        return _request(filename, LOADER_CANVAS, NULL, NULL, priority, user);
+}
+
+/*
+ * queue an image to be loaded as a texture, pixels matching trans are
+ * transparent (none are if trans is NULL)
+ */
+int loader_request_texture(const char *filename, struct color *trans,
+                           int priority, void *user)
+{
+        return _request(filename, LOADER_TEXTURE, trans, NULL, priority,
+                        user);
+}
+
+/*
+ * queue an image to be loaded and added to an atlas, as
+ * loader_request_texture. The handle of the sprite is in the result
+ */
+int loader_request_atlas(const char *filename, struct atlas *a,
+                         struct color *trans, int priority, void *user)
+{
+        return _request(filename, LOADER_ATLAS, trans, a, priority, user);
+}
+
+/*
+ * move everything finished so far onto the end of ready, oldest first
+ */
+static void _collect(void)
+{
+        if (SDL_AtomicGetPtr((void **)&loader.done) == NULL) {
+                return;
+        }
+
+        struct loader_request *req = SDL_AtomicSetPtr((void **)&loader.done,
+                                                      NULL);
+        // newest first, so reverse into finishing order
+        struct loader_request *taken = NULL;
+        while (req != NULL) {
+                struct loader_request *next = req->next;
+                req->next = taken;
+                taken = req;
+                req = next;
+        }
+
+        struct loader_request **end = &loader.ready;
+        while (*end != NULL) {
+                end = &(*end)->next;
+        }
+        *end = taken;
+}
+
+static struct loader_request *_find(struct loader_request *list, int id)
+{
+        for (; list != NULL; list = list->next) {
+                if (list->result.id == id) {
+                        return list;
+                }
+        }
+
+        return NULL;
+}
+
+/*
+ * cancel a request, returns 1 if it was cancelled, in which case no result
+ * will be handed back for it, 0 if it has already been polled or doesn't
+ * exist
+ */
+int loader_cancel(int id)
+{
+        if (loader.lock == NULL) {
+                return 0;
+        }
+
+        SDL_LockMutex(loader.lock);
+
+        struct loader_request *req = _find(loader.queue, id);
+        if (req != NULL) {
+                _unlink(&loader.queue, req);
+        } else if ((req = _find(loader.running, id)) != NULL) {
+                // its loader thread frees it once it notices
+                SDL_AtomicSet(&req->cancelled, 1);
+                SDL_UnlockMutex(loader.lock);
+                loader.pending--;
+                return 1;
+        }
+
+        SDL_UnlockMutex(loader.lock);
+
+        // finished but not yet polled, only this thread takes it from here
+        if (req == NULL) {
+                _collect();
+                req = _find(loader.ready, id);
+                if (req == NULL) {
+                        return 0;
+                }
+                _unlink(&loader.ready, req);
+        }
+
+        _discard(req);
+        loader.pending--;
+        return 1;
+}
+
+/*
+ * take the next finished request, returns 1 if there was one, 0 if there
+ * wasn't. The result's canvas or texture belongs to the caller
+ */
+int loader_poll(struct loader_result *result)
+{
+        if (loader.ready == NULL) {
+                _collect();
+        }
+
+        struct loader_request *req = loader.ready;
+        if (req == NULL) {
+                return 0;
+        }
+
+        loader.ready = req->next;
+        *result = req->result;
+        mem_free(req->filename);
+        mem_free(req);
+
+        loader.pending--;
+        return 1;
+}
+
+/*
+ * return the number of requests not yet polled or cancelled
+ */
+int loader_pending(void)
+{
+        return loader.pending;
+}
@@ -0,0 +1,355 @@
+#include <stdio.h>
+#include <stdint.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <smallengine/graphics/mipmap.h>
+#include <smallengine/graphics/canvas.h>
+#include <smallengine/graphics/color.h>
+
+#include <smallengine/sys/mem.h>
+#include <smallengine/sys/job.h>
+
+#define MIP_BAND_ROWS 16        // rows handed to a worker at a time
+
+// kaiser filter taps, centred between the two source pixels of each output
+#define KAISER_TAPS 6
+
+/*
+ * a windowed sinc with a cut off at half the source frequency, sampled at the
+ * distances of the taps from the output pixel centre (+-0.5, 1.5, 2.5) under
+ * a kaiser window with beta 4.0 and radius 3, then normalised. Fixed so the
+ * threads downsampling at once have nothing to set up
+ */
+static const double kaiser_weights[KAISER_TAPS] = {
+        -0.02099248194957392, 0.094502332937343267, 0.42649014901223059,
+        0.42649014901223059, 0.094502332937343267, -0.02099248194957392
+};
+
+/*
+ * everything a worker needs to reduce its band of rows
+ */
+struct mip_job {
+        const struct color *src;
+        struct color *dst;
+        int sw, sh;             // source dimensions
+        int dw, dh;             // destination dimensions
+        int rows;               // rows in the pass being run
+};
+
+/*
+ * Creation and Destruction
+ */
+
+/*
+ * create an empty chain, nothing is allocated for the levels until the chain
+ * is first updated
+ */
+struct mipmap *mipmap_new(void)
+{
+        struct mipmap *mip = (struct mipmap *)mem_alloc(sizeof(struct mipmap));
+        mip->levels = 0;
+        mip->filter = MIP_BOX;
+        mip->version = 0;
+        mip->built = 0;
+        mip->level = NULL;
+        mip->mask_version = 0;
+
+        return mip;
+}
+
+static void _free_levels(struct mipmap *mip)
+{
+        for (int i = 0; i < mip->levels; i++) {
+                canvas_destroy(&mip->level[i]);
+        }
+
+        if (mip->level != NULL) {
+                mem_free(mip->level);
+        }
+
+        mip->level = NULL;
+        mip->levels = 0;
+        mip->built = 0;
+}
+
+/*
+ * free a chain and all of its levels
+ */
+void mipmap_destroy(struct mipmap *mip)
+{
+        _free_levels(mip);
+        mem_free(mip);
+}
+
+/*
+ * Filters
+ */
+
+static inline int _min(int a, int b) { return (a < b) ? a : b; }
+static inline int _max(int a, int b) { return (a > b) ? a : b; }
+
+/*
+ * average each 2x2 block of source pixels, odd edges reuse the last pixel
+ */
+static void _box_band(void *data, int band)
+{
+        struct mip_job *job = (struct mip_job *)data;
+        int y0 = band * MIP_BAND_ROWS;
+        int y1 = _min(y0 + MIP_BAND_ROWS, job->dh);
+
+#ifdef __SSE2__
+        const __m128d quarter = _mm_set1_pd(0.25);
+#endif
+
+        for (int y = y0; y < y1; y++) {
+                const struct color *r0 = job->src + (2 * y) * job->sw;
+                const struct color *r1 = job->src + 
+                                         _min(2 * y + 1, job->sh - 1) * job->sw;
+                struct color *out = job->dst + y * job->dw;
+
+                for (int x = 0; x < job->dw; x++) {
+                        int a = 2 * x;
+                        int b = _min(2 * x + 1, job->sw - 1);
+#ifdef __SSE2__
+                        // r and g in one register, b and a in the other
+                        __m128d rg = _mm_add_pd(
+                                _mm_add_pd(_mm_loadu_pd(&r0[a].r), 
+                                           _mm_loadu_pd(&r0[b].r)),
+                                _mm_add_pd(_mm_loadu_pd(&r1[a].r), 
+                                           _mm_loadu_pd(&r1[b].r)));
+                        __m128d ba = _mm_add_pd(
+                                _mm_add_pd(_mm_loadu_pd(&r0[a].b), 
+                                           _mm_loadu_pd(&r0[b].b)),
+                                _mm_add_pd(_mm_loadu_pd(&r1[a].b), 
+                                           _mm_loadu_pd(&r1[b].b)));
+                        _mm_storeu_pd(&out[x].r, _mm_mul_pd(rg, quarter));
+                        _mm_storeu_pd(&out[x].b, _mm_mul_pd(ba, quarter));
+#else
+                        out[x].r = (r0[a].r + r0[b].r + r1[a].r + r1[b].r) * 0.25;
+                        out[x].g = (r0[a].g + r0[b].g + r1[a].g + r1[b].g) * 0.25;
+                        out[x].b = (r0[a].b + r0[b].b + r1[a].b + r1[b].b) * 0.25;
+                        out[x].a = (r0[a].a + r0[b].a + r1[a].a + r1[b].a) * 0.25;
+#endif
+                }
+        }
+}
+
+/*
+ * out = sum of weights[k] * in[index[k]] over the kaiser taps
+ */
+static inline void _kaiser_sum(struct color *out, const struct color *in,
+                               const int *index)
+{
+#ifdef __SSE2__
+        __m128d rg = _mm_setzero_pd();
+        __m128d ba = _mm_setzero_pd();
+        for (int k = 0; k < KAISER_TAPS; k++) {
+                __m128d w = _mm_set1_pd(kaiser_weights[k]);
+                rg = _mm_add_pd(rg, _mm_mul_pd(w, _mm_loadu_pd(&in[index[k]].r)));
+                ba = _mm_add_pd(ba, _mm_mul_pd(w, _mm_loadu_pd(&in[index[k]].b)));
+        }
+        _mm_storeu_pd(&out->r, rg);
+        _mm_storeu_pd(&out->b, ba);
+#else
+        struct color sum = {0.0, 0.0, 0.0, 0.0};
+        for (int k = 0; k < KAISER_TAPS; k++) {
+                double w = kaiser_weights[k];
+                sum.r += w * in[index[k]].r;
+                sum.g += w * in[index[k]].g;
+                sum.b += w * in[index[k]].b;
+                sum.a += w * in[index[k]].a;
+        }
+        *out = sum;
+#endif
+}
+
+/*
+ * horizontal kaiser pass, every source row reduced to the destination width
+ */
+static void _kaiser_band_x(void *data, int band)
+{
+        struct mip_job *job = (struct mip_job *)data;
+        int y0 = band * MIP_BAND_ROWS;
+        int y1 = _min(y0 + MIP_BAND_ROWS, job->rows);
+        int index[KAISER_TAPS];
+
+        for (int y = y0; y < y1; y++) {
+                const struct color *in = job->src + y * job->sw;
+                struct color *out = job->dst + y * job->dw;
+
+                for (int x = 0; x < job->dw; x++) {
+                        for (int k = 0; k < KAISER_TAPS; k++) {
+                                int sx = 2 * x + k - (KAISER_TAPS / 2 - 1);
+                                index[k] = _max(0, _min(sx, job->sw - 1));
+                        }
+                        _kaiser_sum(&out[x], in, index);
+                }
+        }
+}
+
+/*
+ * vertical kaiser pass, reads the output of the horizontal pass which is
+ * already at the destination width
+ */
+static void _kaiser_band_y(void *data, int band)
+{
+        struct mip_job *job = (struct mip_job *)data;
+        int y0 = band * MIP_BAND_ROWS;
+        int y1 = _min(y0 + MIP_BAND_ROWS, job->rows);
+        int index[KAISER_TAPS];
+
+        for (int y = y0; y < y1; y++) {
+                for (int k = 0; k < KAISER_TAPS; k++) {
+                        int sy = 2 * y + k - (KAISER_TAPS / 2 - 1);
+                        index[k] = _max(0, _min(sy, job->sh - 1)) * job->dw;
+                }
+
+                struct color *out = job->dst + y * job->dw;
+                for (int x = 0; x < job->dw; x++) {
+                        _kaiser_sum(&out[x], job->src + x, index);
+                }
+        }
+}
+
+static int _bands(int rows)
+{
+        return (rows + MIP_BAND_ROWS - 1) / MIP_BAND_ROWS;
+}
+
+/*
+ * Operations
+ */
+
+/*
+ * return the number of levels below the full size image for an image of the
+ * given size (ie 3 for an 8x8 image: 4x4, 2x2 and 1x1)
+ */
+int mipmap_count_levels(const int w, const int h)
+{
+        int levels = 0;
+        int cw = w, ch = h;
+
+        while (cw > 1 || ch > 1) {
+                cw = _max(1, cw / 2);
+                ch = _max(1, ch / 2);
+                levels++;
+        }
+
+        return levels;
+}
+
+/*
+ * pick the level to sample when drawing a w x h area at dst_w x dst_h, the
+ * chosen level is never smaller than the area drawn
+ */
+int mipmap_select_level(const int w, const int h, 
+                        const int dst_w, const int dst_h)
+{
+        int level = 0;
+        int cw = w, ch = h;
+
+        if (dst_w <= 0 || dst_h <= 0) {
+                return 0;
+        }
+
+        while ((cw > 1 || ch > 1) && 
+               (cw / 2) >= dst_w && (ch / 2) >= dst_h) {
+                cw = _max(1, cw / 2);
+                ch = _max(1, ch / 2);
+                level++;
+        }
+
+        return level;
+}
+
+/*
+ * reduce src into dst, dst must be half the size of src (rounded down, at
+ * least 1). Rows are split across the worker threads
+ */
+void mipmap_downsample(struct canvas src, struct canvas dst, 
+                       enum mip_filter filter)
+{
+        struct mip_job job = {canvas_pixels(src), canvas_pixels_writable(dst),
+                              src.w, src.h, dst.w, dst.h, dst.h};
+
+        if (filter == MIP_KAISER) {
+                // horizontal pass into a buffer dst.w wide and src.h high
+                struct color *tmp = (struct color *)mem_alloc(
+                                        dst.w * src.h * sizeof(struct color));
+                struct color *out = job.dst;
+
+                job.dst = tmp;
+                job.rows = src.h;
+                job_parallel_for(_bands(job.rows), _kaiser_band_x, &job);
+
+                job.src = tmp;
+                job.dst = out;
+                job.rows = dst.h;
+                job_parallel_for(_bands(job.rows), _kaiser_band_y, &job);
+
+                mem_free(tmp);
+                return;
+        }
+
+        job_parallel_for(_bands(job.rows), _box_band, &job);
+}
+
+/*
+ * rebuild the levels from src if they were made from an older version of it
+ * or with a different filter
+ */
+void mipmap_update(struct mipmap *mip, struct canvas src, 
+                   const uint32_t version, enum mip_filter filter)
+{
+        if (mip->built && mip->version == version && mip->filter == filter) {
+                return;
+        }
+
+        int levels = mipmap_count_levels(src.w, src.h);
+        if (mip->level != NULL && levels != mip->levels) {
+                _free_levels(mip);
+        }
+
+        if (mip->level == NULL && levels > 0) {
+                mip->level = (struct canvas *)mem_alloc(
+                                        levels * sizeof(struct canvas));
+
+                int w = src.w, h = src.h;
+                for (int i = 0; i < levels; i++) {
+                        w = _max(1, w / 2);
+                        h = _max(1, h / 2);
+                        mip->level[i] = canvas(w, h);
+                }
+                mip->levels = levels;
+        }
+
+        struct canvas prev = src;
+        for (int i = 0; i < mip->levels; i++) {
+                mipmap_downsample(prev, mip->level[i], filter);
+                prev = mip->level[i];
+        }
+
+        mip->version = version;
+        mip->filter = filter;
+        mip->built = 1;
+}
+
+/*
+ * return the canvas for a level of an up to date chain, level 0 is src
+ * itself and levels past the end of the chain return the smallest level
+ */
+struct canvas mipmap_level(struct mipmap *mip, struct canvas src, int level)
+{
+        if (level <= 0 || mip->levels == 0) {
+                return src;
+        }
+
+        if (level > mip->levels) {
+                level = mip->levels;
+        }
+
+        return mip->level[level - 1];
+}
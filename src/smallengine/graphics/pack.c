@@ -0,0 +1,519 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include <smallengine/graphics/pack.h>
+#include <smallengine/graphics/atlas.h>
+#include <smallengine/graphics/canvas.h>
+#include <smallengine/graphics/color.h>
+#include <smallengine/graphics/coverage.h>
+#include <smallengine/graphics/mipmap.h>
+#include <smallengine/graphics/palette.h>
+#include <smallengine/graphics/texture.h>
+
+#include <smallengine/sys/file.h>
+#include <smallengine/sys/lz.h>
+#include <smallengine/sys/mem.h>
+
+#define PACK_MIN_ENTRIES 16
+
+/*
+ * where each part of an asset's data goes, from the start of its data. Parts
+ * an asset doesn't have take no space
+ */
+struct pack_layout {
+        uint64_t pixels;
+        uint64_t mask;
+        uint64_t coverage;
+        uint64_t palette;
+        uint64_t rects;
+        uint64_t size;
+};
+
+static uint64_t _align(uint64_t n)
+{
+        return (n + PACK_ALIGN - 1) & ~(uint64_t)(PACK_ALIGN - 1);
+}
+
+static int _words(int w)
+{
+        return (w + COVERAGE_WORD_BITS - 1) / COVERAGE_WORD_BITS;
+}
+
+static struct pack_layout _layout(const struct pack_entry *e)
+{
+        struct pack_layout l = {0, 0, 0, 0, 0, 0};
+        uint64_t n = (uint64_t)e->w * e->h;
+        uint64_t colors = (uint64_t)e->colors * (sizeof(struct color) +
+                                                 sizeof(uint32_t));
+
+        switch (e->type) {
+        case PACK_CANVAS:
+                l.size = n * sizeof(struct color);
+                break;
+        case PACK_PALETTE:
+                l.size = colors;
+                break;
+        case PACK_TEXTURE:
+        case PACK_ATLAS:
+                l.mask = _align(n * sizeof(struct color));
+                l.coverage = l.mask + _align(n * sizeof(int));
+                l.palette = l.coverage + _align((uint64_t)_words(e->w) *
+                                                e->h * sizeof(uint64_t));
+                l.rects = l.palette + _align(colors);
+                l.size = l.rects;
+                if (e->type == PACK_ATLAS) {
+                        l.size += (uint64_t)e->count *
+                                  sizeof(struct atlas_rect);
+                }
+                break;
+        }
+
+        return l;
+}
+
+/*
+ * Reading
+ */
+
+/*
+ * check everything in the index lies within the file, so nothing returned
+ * can point outside the mapping
+ */
+static int _valid(const struct pack *p)
+{
+        for (int i = 0; i < p->count; i++) {
+                const struct pack_entry *e = &p->entries[i];
+                if (e->type >= NUM_PACK_TYPES ||
+                    memchr(e->name, 0, PACK_NAME_SIZE) == NULL ||
+                    e->w > 0xffff || e->h > 0xffff ||
+                    e->offset % PACK_ALIGN != 0 ||
+                    e->size < _layout(e).size ||
+                    e->offset > p->map.size ||
+                    e->size > p->map.size - e->offset) {
+                        return 0;
+                }
+        }
+
+        return 1;
+}
+
+/*
+ * open a pack file, compressed or not, count is 0 and nothing can be found if
+ * the file can't be read or isn't a pack
+ */
+struct pack pack_open(const char *filename)
+{
+        struct pack p = {{NULL, 0, 0}, NULL, 0};
+
+        p.map = lz_map_file(filename, 1);
+        if (p.map.data == NULL) {
+                return p;
+        }
+
+        const struct pack_header *head = (const struct pack_header *)p.map.data;
+        const char *error = NULL;
+
+        if (p.map.size < sizeof(struct pack_header) ||
+            memcmp(head->magic, PACK_MAGIC, 4) != 0) {
+                error = "not a pack file";
+        } else if (head->byte_order != PACK_BYTE_ORDER) {
+                error = "pack was written with the other byte order";
+        } else if (head->version != PACK_VERSION) {
+                error = "unsupported pack version";
+        } else if (head->index % PACK_ALIGN != 0 || head->index > p.map.size ||
+                   head->count > (p.map.size - head->index) /
+                                 sizeof(struct pack_entry)) {
+                error = "pack index is truncated";
+        } else {
+                p.entries = (const struct pack_entry *)(p.map.data +
+                                                        head->index);
+                p.count = head->count;
+                if (!_valid(&p)) {
+                        error = "pack index is corrupt";
+                }
+        }
+
+        if (error != NULL) {
+                fprintf(stderr, "%s: %s\n", filename, error);
+                pack_close(&p);
+        }
+
+        return p;
+}
+
+/*
+ * close a pack, everything returned from it becomes invalid
+ */
+void pack_close(struct pack *p)
+{
+        file_unmap(&p->map);
+        p->entries = NULL;
+        p->count = 0;
+}
+
+/*
+ * return the index of a named asset of the given type, -1 if there isn't one
+ */
+int pack_find(const struct pack p, const char *name, enum pack_type type)
+{
+        for (int i = 0; i < p.count; i++) {
+                if (p.entries[i].type == type &&
+                    strcmp(p.entries[i].name, name) == 0) {
+                        return i;
+                }
+        }
+
+        return -1;
+}
+
+/*
+ * the data of an asset, the mapping can be written to privately
+ */
+static uint8_t *_data(const struct pack p, const struct pack_entry *e)
+{
+        return (uint8_t *)p.map.data + e->offset;
+}
+
+/*
+ * return a named canvas, an empty canvas (0x0) if it isn't in the pack
+ */
+struct canvas pack_get_canvas(const struct pack p, const char *name)
+{
+        struct canvas c = {0, 0, NULL};
+
+        int i = pack_find(p, name, PACK_CANVAS);
+        if (i < 0) {
+                return c;
+        }
+
+        const struct pack_entry *e = &p.entries[i];
+        return canvas_from_pixels((struct color *)_data(p, e), e->w, e->h);
+}
+
+static struct palette _palette(uint8_t *data, int colors)
+{
+        struct color *ptr = (struct color *)data;
+        struct palette pal = {ptr, (uint32_t *)(ptr + colors), colors,
+                              colors};
+        return pal;
+}
+
+static struct texture _texture(const struct pack p, const struct pack_entry *e)
+{
+        uint8_t *data = _data(p, e);
+        struct pack_layout l = _layout(e);
+
+        struct texture tex = {e->w, e->h, canvas_from_pixels(
+                                (struct color *)(data + l.pixels), e->w, e->h),
+                              (int *)(data + l.mask)};
+        tex.palette = _palette(data + l.palette, e->colors);
+        tex.mips = mipmap_new();
+        tex.borrowed = 1;
+
+        struct coverage cov = {e->w, e->h, _words(e->w),
+                               (uint64_t *)(data + l.coverage)};
+        tex.coverage = cov;
+
+        return tex;
+}
+
+/*
+ * return a named texture, it is 0x0 with no mask if it isn't in the pack
+ */
+struct texture pack_get_texture(const struct pack p, const char *name)
+{
+        struct texture none = {0, 0, {0, 0, NULL}, NULL};
+
+        int i = pack_find(p, name, PACK_TEXTURE);
+        if (i < 0) {
+                return none;
+        }
+
+        return _texture(p, &p.entries[i]);
+}
+
+/*
+ * return a named palette, it has no colors if it isn't in the pack
+ */
+struct palette pack_get_palette(const struct pack p, const char *name)
+{
+        struct palette none = {NULL, NULL, 0, 0};
+
+        int i = pack_find(p, name, PACK_PALETTE);
+        if (i < 0) {
+                return none;
+        }
+
+        const struct pack_entry *e = &p.entries[i];
+        return _palette(_data(p, e), e->colors);
+}
+
+/*
+ * return a named atlas (read only), it has no sprites if it isn't in the
+ * pack
+ */
+struct atlas pack_get_atlas(const struct pack p, const char *name)
+{
+        struct atlas a;
+        memset(&a, 0, sizeof(a));
+
+        int i = pack_find(p, name, PACK_ATLAS);
+        if (i < 0) {
+                return a;
+        }
+
+        const struct pack_entry *e = &p.entries[i];
+        a.tex = _texture(p, e);
+        a.padding = e->padding;
+        a.rects = (struct atlas_rect *)(_data(p, e) + _layout(e).rects);
+        a.count = e->count;
+        a.capacity = e->count;
+
+        return a;
+}
+
+/*
+ * Writing
+ */
+
+/*
+ * write data at a position at or after the end of the file so far, the gap
+ * is filled with zeros
+ */
+static void _write_at(struct pack_writer *w, uint64_t at, const void *data,
+                      uint64_t len)
+{
+        static const uint8_t zeros[PACK_ALIGN];
+
+        while (w->ok && w->offset < at) {
+                uint64_t n = at - w->offset;
+                n = (n > PACK_ALIGN) ? PACK_ALIGN : n;
+                w->ok = (fwrite(zeros, 1, n, w->file) == n);
+                w->offset += n;
+        }
+
+        if (w->ok && len > 0) {
+                w->ok = (fwrite(data, 1, len, w->file) == len);
+                w->offset += len;
+        }
+}
+
+/*
+ * start writing a pack file, ok is 0 if it can't be created
+ */
+struct pack_writer pack_writer(const char *filename)
+{
+        struct pack_writer w = {NULL, NULL, 0, 0, 0, 0};
+
+        w.file = fopen(filename, "wb");
+        if (w.file == NULL) {
+                fprintf(stderr, "%s: %s\n", filename, strerror(errno));
+                return w;
+        }
+
+        w.entries = (struct pack_entry *)mem_alloc(PACK_MIN_ENTRIES *
+                                                   sizeof(struct pack_entry));
+        w.capacity = PACK_MIN_ENTRIES;
+        w.ok = 1;
+
+        // the header is written last, once the index is known
+        struct pack_header head;
+        memset(&head, 0, sizeof(head));
+        _write_at(&w, 0, &head, sizeof(head));
+
+        return w;
+}
+
+/*
+ * a new index entry with its data starting at the next aligned position
+ */
+static struct pack_entry *_entry(struct pack_writer *w, const char *name,
+                                 enum pack_type type, int width, int height)
+{
+        if (!w->ok || strlen(name) >= PACK_NAME_SIZE || width < 0 ||
+            height < 0 || width > 0xffff || height > 0xffff) {
+                return NULL;
+        }
+
+        if (w->count == w->capacity) {
+                struct pack_entry *entries = (struct pack_entry *)mem_alloc(
+                                w->capacity * 2 * sizeof(struct pack_entry));
+                memcpy(entries, w->entries,
+                       w->count * sizeof(struct pack_entry));
+                mem_free(w->entries);
+                w->entries = entries;
+                w->capacity *= 2;
+        }
+
+        struct pack_entry *e = &w->entries[w->count++];
+        memset(e, 0, sizeof(struct pack_entry));
+        strcpy(e->name, name);
+        e->type = type;
+        e->w = width;
+        e->h = height;
+        e->offset = _align(w->offset);
+
+        return e;
+}
+
+/*
+ * write the colors and packed copies of a palette one after the other, as
+ * palette() lays them out
+ */
+static void _write_palette(struct pack_writer *w, uint64_t at,
+                           const struct palette pal)
+{
+        _write_at(w, at, pal.colors, pal.assigned * sizeof(struct color));
+        _write_at(w, w->offset, pal.packed, pal.assigned * sizeof(uint32_t));
+}
+
+static void _write_texture(struct pack_writer *w, const struct pack_entry *e,
+                           const struct texture tex)
+{
+        struct pack_layout l = _layout(e);
+        uint64_t n = (uint64_t)tex.w * tex.h;
+
+        _write_at(w, e->offset + l.pixels, canvas_pixels(tex.canvas),
+                  n * sizeof(struct color));
+        _write_at(w, e->offset + l.mask, tex.mask, n * sizeof(int));
+        _write_at(w, e->offset + l.coverage, tex.coverage.bits,
+                  (uint64_t)tex.coverage.words * tex.h * sizeof(uint64_t));
+        _write_palette(w, e->offset + l.palette, tex.palette);
+}
+
+/*
+ * add an asset to a pack being written under a name of less than
+ * PACK_NAME_SIZE characters, returns 1 on success, 0 on failure
+ */
+int pack_add_canvas(struct pack_writer *w, const char *name,
+                    const struct canvas c)
+{
+        struct pack_entry *e = _entry(w, name, PACK_CANVAS, c.w, c.h);
+        if (e == NULL) {
+                return 0;
+        }
+
+        _write_at(w, e->offset, canvas_pixels(c),
+                  (uint64_t)c.w * c.h * sizeof(struct color));
+        e->size = w->offset - e->offset;
+
+        return w->ok;
+}
+
+int pack_add_texture(struct pack_writer *w, const char *name,
+                     const struct texture tex)
+{
+        struct pack_entry *e = _entry(w, name, PACK_TEXTURE, tex.w, tex.h);
+        if (e == NULL) {
+                return 0;
+        }
+
+        e->colors = tex.palette.assigned;
+        _write_texture(w, e, tex);
+        e->size = _layout(e).size;
+
+        return w->ok;
+}
+
+int pack_add_palette(struct pack_writer *w, const char *name,
+                     const struct palette pal)
+{
+        struct pack_entry *e = _entry(w, name, PACK_PALETTE, 0, 0);
+        if (e == NULL) {
+                return 0;
+        }
+
+        e->colors = pal.assigned;
+        _write_palette(w, e->offset, pal);
+        e->size = w->offset - e->offset;
+
+        return w->ok;
+}
+
+int pack_add_atlas(struct pack_writer *w, const char *name,
+                   const struct atlas a)
+{
+        struct pack_entry *e = _entry(w, name, PACK_ATLAS, a.tex.w, a.tex.h);
+        if (e == NULL) {
+                return 0;
+        }
+
+        e->colors = a.tex.palette.assigned;
+        e->count = a.count;
+        e->padding = a.padding;
+        _write_texture(w, e, a.tex);
+        _write_at(w, e->offset + _layout(e).rects, a.rects,
+                  a.count * sizeof(struct atlas_rect));
+        e->size = _layout(e).size;
+
+        return w->ok;
+}
+
+/*
+ * write the index and close the file, returns 1 if the whole pack was
+ * written, 0 otherwise
+ */
+int pack_writer_finish(struct pack_writer *w)
+{
+        if (w->file == NULL) {
+                return 0;
+        }
+
+        struct pack_header head;
+        memset(&head, 0, sizeof(head));
+        memcpy(head.magic, PACK_MAGIC, 4);
+        head.byte_order = PACK_BYTE_ORDER;
+        head.version = PACK_VERSION;
+        head.count = w->count;
+        head.index = _align(w->offset);
+
+        _write_at(w, head.index, w->entries,
+                  w->count * sizeof(struct pack_entry));
+
+        if (w->ok) {
+                w->ok = (fseek(w->file, 0, SEEK_SET) == 0 &&
+                         fwrite(&head, sizeof(head), 1, w->file) == 1);
+        }
+
+        w->ok = (fclose(w->file) == 0) && w->ok;
+        mem_free(w->entries);
+
+        w->file = NULL;
+        w->entries = NULL;
+        w->count = 0;
+        w->capacity = 0;
+
+        return w->ok;
+}
+
+/*
+ * rewrite a finished pack file compressed, returns 1 on success, 0 on
+ * failure
+ */
+int pack_compress(const char *filename)
+{
+        struct file_map map = file_map(filename);
+        if (map.data == NULL) {
+                return 0;
+        }
+
+        // the whole pack is compressed before the file is replaced
+        size_t size;
+        uint8_t *frame = lz_compress_frame(map.data, map.size, &size);
+        file_unmap(&map);
+
+        FILE *file = fopen(filename, "wb");
+        if (file == NULL) {
+                fprintf(stderr, "%s: %s\n", filename, strerror(errno));
+                mem_free(frame);
+                return 0;
+        }
+
+        int ok = (fwrite(frame, 1, size, file) == size);
+        ok = (fclose(file) == 0) && ok;
+        mem_free(frame);
+
+        return ok;
+}
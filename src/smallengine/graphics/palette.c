@@ -1,8 +1,12 @@
 #include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
 
 #include <smallengine/graphics/palette.h>
 #include <smallengine/graphics/color.h>
 #include <smallengine/graphics/canvas.h>
+#include <smallengine/maths/maths.h>
 
 #include <smallengine/sys/mem.h>
 
@@ -15,54 +19,218 @@
  */
 struct palette palette(int size)
 {
-        struct color **ptr = mem_alloc(sizeof(struct color *) * size);
-        struct palette p = {ptr, size, 0};
+        // the colors and their packed copies share one allocation
+        struct color *ptr = mem_alloc(size * (sizeof(struct color) +
+                                              sizeof(uint32_t)));
+        struct palette p = {ptr, (uint32_t *)(ptr + size), size, 0};
         return p;
 }
 
 /*
- * create a palette from a canvas. the canvas will be checked from left to
- * right, row by row, each unique color added in the order it is encountered
+ * set a color and its packed copy
  */
-struct palette palette_from_canvas(const struct canvas can)
+static void _set_color(struct palette p, int index, const struct color c)
+{
+        p.colors[index] = c;
+        p.packed[index] = color_to_RGBA(c);
+}
+
+/*
+ * an open addressing hash of the colors seen so far. Each color is keyed on
+ * the cell of a 1/4096th grid its components fall in, which is wider than
+ * EPSILON so anything color_equal to it is in the same or a neighbouring
+ * cell. Lookups check each of those cells and confirm with color_equal, so
+ * the palette treats colors exactly as palette_check_color
+ */
+struct color_hash {
+        uint64_t *keys;
+        int *indices;           // index into colors, -1 for an empty slot
+        int slots;              // always a power of 2
+        struct color *colors;   // unique colors in the order they were found
+        int count;
+        int capacity;
+};
+
+#define COLOR_HASH_MIN_SLOTS 1024
+#define COLOR_HASH_CELLS 4096.0
+
+static uint64_t _color_key(int64_t r, int64_t g, int64_t b)
+{
+        // splitmix style mixing of the cell
+        uint64_t h = (uint64_t)r;
+        h = h * 0x9e3779b97f4a7c15ull ^ (uint64_t)g;
+        h = h * 0x9e3779b97f4a7c15ull ^ (uint64_t)b;
+        h ^= h >> 31;
+        h *= 0xbf58476d1ce4e5b9ull;
+        h ^= h >> 29;
+
+        return h;
+}
+
+/*
+ * the cells a component equal to v could be in, at most two as the cells are
+ * wider than EPSILON. The margin is doubled to be safe from rounding
+ */
+static void _color_cells(double v, int64_t *lo, int64_t *hi)
+{
+        *lo = (int64_t)floor((v - 2 * EPSILON) * COLOR_HASH_CELLS);
+        *hi = (int64_t)floor((v + 2 * EPSILON) * COLOR_HASH_CELLS);
+}
+
+static void _hash_alloc(struct color_hash *hash, int slots)
+{
+        hash->slots = slots;
+        hash->keys = (uint64_t *)mem_alloc(slots * sizeof(uint64_t));
+        hash->indices = (int *)mem_alloc(slots * sizeof(int));
+        for (int i = 0; i < slots; i++) {
+                hash->indices[i] = -1;
+        }
+}
+
+static void _hash_insert_slot(struct color_hash *hash, uint64_t key, int index)
+{
+        int mask = hash->slots - 1;
+        int slot = key & mask;
+        while (hash->indices[slot] >= 0) {
+                slot = (slot + 1) & mask;
+        }
+
+        hash->keys[slot] = key;
+        hash->indices[slot] = index;
+}
+
+/*
+ * double the table once it is half full, and the color list once it is full
+ */
+static void _hash_grow(struct color_hash *hash)
+{
+        if (hash->count == hash->capacity) {
+                struct color *colors = (struct color *)mem_alloc(
+                                2 * hash->capacity * sizeof(struct color));
+                memcpy(colors, hash->colors,
+                       hash->count * sizeof(struct color));
+                mem_free(hash->colors);
+                hash->colors = colors;
+                hash->capacity *= 2;
+        }
+
+        if (hash->count * 2 < hash->slots) {
+                return;
+        }
+
+        uint64_t *keys = hash->keys;
+        int *indices = hash->indices;
+        int slots = hash->slots;
+
+        _hash_alloc(hash, slots * 2);
+        for (int i = 0; i < slots; i++) {
+                if (indices[i] >= 0) {
+                        _hash_insert_slot(hash, keys[i], indices[i]);
+                }
+        }
+
+        mem_free(keys);
+        mem_free(indices);
+}
+
+/*
+ * return the index of the first color equal to col, adding it first if there
+ * isn't one
+ */
+static int _hash_find_or_add(struct color_hash *hash, const struct color col)
 {
-        // create a list of colors large enough to count all colors
-        // even if each pixel on the canvas contains a unique value.
-        // For a 1080 * 1920 image this would be around 50MB
-        // This is destroyed once the palette is made
-        int size = can.w * can.h;
-        struct color *list = 
-                (struct color *)mem_alloc(size * sizeof(struct color));
-
-        // get all unique colors - slowly...
-        int i, j, count = 0, check = 0;
-        for (i = 0; i < size; i++) {
-                check = 0;
-                
-                // check if color at current pixel has already been added
-                // to the list
-                for (j = 0; j < count; j++) {
-                        if (color_equal(can.pixels[i], list[j])) {
-                                check = 1;
-                                break;
+        int64_t lo[3], hi[3];
+        _color_cells(col.r, &lo[0], &hi[0]);
+        _color_cells(col.g, &lo[1], &hi[1]);
+        _color_cells(col.b, &lo[2], &hi[2]);
+
+        // one or two cells per component, so up to eight to check
+        int mask = hash->slots - 1;
+        int found = -1;
+        for (int n = 0; n < 8; n++) {
+                if ((n & 1 && lo[0] == hi[0]) || (n & 2 && lo[1] == hi[1]) ||
+                    (n & 4 && lo[2] == hi[2])) {
+                        continue;
+                }
+
+                uint64_t key = _color_key(n & 1 ? hi[0] : lo[0],
+                                          n & 2 ? hi[1] : lo[1],
+                                          n & 4 ? hi[2] : lo[2]);
+                for (int slot = key & mask; hash->indices[slot] >= 0;
+                     slot = (slot + 1) & mask) {
+                        int index = hash->indices[slot];
+                        if (hash->keys[slot] == key &&
+                            (found < 0 || index < found) &&
+                            color_equal(hash->colors[index], col)) {
+                                found = index;
                         }
                 }
+        }
+
+        if (found >= 0) {
+                return found;
+        }
+
+        _hash_grow(hash);
+        _hash_insert_slot(hash, _color_key(
+                        (int64_t)floor(col.r * COLOR_HASH_CELLS),
+                        (int64_t)floor(col.g * COLOR_HASH_CELLS),
+                        (int64_t)floor(col.b * COLOR_HASH_CELLS)),
+                        hash->count);
+        hash->colors[hash->count] = col;
+
+        return hash->count++;
+}
 
-                if (check == 0) {
-                        list[count++] = can.pixels[i];
+/*
+ * create a palette from a canvas. the canvas will be checked from left to
+ * right, row by row, each unique color added in the order it is encountered.
+ * If indices isn't NULL the palette index of each pixel is stored there
+ */
+struct palette palette_from_canvas_indexed(const struct canvas can,
+                                           int *indices)
+{
+        struct color_hash hash = {NULL, NULL, 0, NULL, 0, 256};
+        _hash_alloc(&hash, COLOR_HASH_MIN_SLOTS);
+        hash.colors = (struct color *)mem_alloc(hash.capacity *
+                                                sizeof(struct color));
+
+        // runs of the same color are common, so the last match is kept
+        // while the pixel is identical to the one before
+        const struct color *pixels = canvas_pixels(can);
+        int last = -1;
+        for (int i = 0; i < can.w * can.h; i++) {
+                if (last < 0 || pixels[i].r != pixels[i - 1].r ||
+                    pixels[i].g != pixels[i - 1].g ||
+                    pixels[i].b != pixels[i - 1].b) {
+                        last = _hash_find_or_add(&hash, pixels[i]);
+                }
+                if (indices != NULL) {
+                        indices[i] = last;
                 }
         }
 
-        struct palette p = palette(count);
-        for (i = 0; i < count; i++) {
-                palette_add_color(&p, list[i]);
+        struct palette p = palette(hash.count);
+        for (int i = 0; i < hash.count; i++) {
+                palette_add_color(&p, hash.colors[i]);
         }
 
-        mem_free(list);
+        mem_free(hash.keys);
+        mem_free(hash.indices);
+        mem_free(hash.colors);
 
         return p;
 }
 
+/*
+ * create a palette from a canvas. the canvas will be checked from left to
+ * right, row by row, each unique color added in the order it is encountered
+ */
+struct palette palette_from_canvas(const struct canvas can)
+{
+        return palette_from_canvas_indexed(can, NULL);
+}
+
 /*
  * Palette Destruction
  */
@@ -72,7 +240,9 @@ struct palette palette_from_canvas(const struct canvas can)
  */
 void palette_destroy(struct palette *pal)
 {
-        free(pal->colors);
+        mem_free(pal->colors);
+        pal->colors = NULL;
+        pal->packed = NULL;
         pal->size = 0;
         pal->assigned = 0;
 }
@@ -87,7 +257,7 @@ void palette_destroy(struct palette *pal)
 int palette_check_color(struct palette pal, const struct color col)
 {
         for (int i = 0; i < pal.assigned; i++) {
-                if (color_equal(*pal.colors[i], col)) {
+                if (color_equal(pal.colors[i], col)) {
                         return i;
                 }
         }
@@ -105,12 +275,45 @@ struct color palette_get_by_index(struct palette pal, int index)
                 return color_rgb(0.0, 0.0, 0.0);
         }
         
-        return *pal.colors[index];
+        return pal.colors[index];
+}
+
+/*
+ * get the color of the specified index packed as color_to_RGBA, returns
+ * black if the index is invalid
+ */
+uint32_t palette_get_packed(struct palette pal, int index)
+{
+        if (index < 0 || index >= pal.assigned) {
+                return color_to_RGBA(color_rgb(0.0, 0.0, 0.0));
+        }
+
+        return pal.packed[index];
 }
 
 
 // check if palette contains a range of colors? replace a range of colors?
 
+/*
+ * copy the palette's colors converted from one color space to another, for
+ * drawing onto a canvas in a different space. Returns NULL if the spaces are
+ * the same, otherwise the copy is the caller's to mem_free
+ */
+struct color *palette_convert_colors(struct palette pal,
+                                    enum color_space from,
+                                    enum color_space to)
+{
+        if (from == to) {
+                return NULL;
+        }
+
+        struct color *colors = (struct color *)mem_alloc(
+                                (pal.assigned + 1) * sizeof(struct color));
+        color_span_convert(colors, pal.colors, pal.assigned, from, to);
+
+        return colors;
+}
+
 /*
  * add a color to a palette, returns the new size of the palette
  */
@@ -121,8 +324,7 @@ int palette_add_color(struct palette *p, const struct color col)
                 return 0;
         }
 
-        p->colors[p->assigned] = mem_alloc(sizeof(struct color));
-        *p->colors[p->assigned] = col;
+        _set_color(*p, p->assigned, col);
         return p->assigned++;
 }
 
@@ -138,7 +340,7 @@ int palette_replace_color(struct palette p, const struct color oldc,
                 return -1;
         }
 
-        *p.colors[index] = newc;
+        _set_color(p, index, newc);
         return 1;
 }
 
@@ -152,7 +354,7 @@ int palette_replace_index(struct palette p, int index, const struct color c)
                 return 0;
         }
 
-        *p.colors[index] = c;
+        _set_color(p, index, c);
         return 1;
 }
 
@@ -0,0 +1,459 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+
+#include <smallengine/graphics/primitive.h>
+#include <smallengine/graphics/canvas.h>
+#include <smallengine/graphics/color.h>
+#include <smallengine/maths/tuple.h>
+
+#include <smallengine/sys/mem.h>
+
+/*
+ * the pixels of the canvas being drawn on and how to write them
+ */
+struct span_target {
+        struct color *pixels;
+        int w, h;
+        struct color col;
+        enum blit_mode mode;
+};
+
+static struct span_target _target(struct canvas c, struct color col,
+                                  enum blit_mode mode)
+{
+        struct span_target t = {canvas_pixels_writable(c), c.w, c.h, 
+                                col, mode};
+        return t;
+}
+
+static inline int _min(int a, int b) { return (a < b) ? a : b; }
+static inline int _max(int a, int b) { return (a > b) ? a : b; }
+
+/*
+ * write the pixels from x1 to x2 on row y, clipped to the canvas
+ */
+static void _span(const struct span_target *t, int y, int x1, int x2)
+{
+        if (y < 0 || y >= t->h) {
+                return;
+        }
+
+        x1 = _max(x1, 0);
+        x2 = _min(x2, t->w - 1);
+        if (x1 > x2) {
+                return;
+        }
+
+        canvas_fill_span(t->pixels + y * t->w + x1, t->col, x2 - x1 + 1, 
+                         t->mode);
+}
+
+/*
+ * Lines
+ */
+
+/*
+ * draw a line between two points, runs of pixels on the same row are
+ * written as one span
+ */
+void primitive_line(struct canvas c, int x1, int y1, int x2, int y2,
+                    struct color col, enum blit_mode mode)
+{
+        struct span_target t = _target(c, col, mode);
+
+        // bresenham, tracking where the current run on this row began
+        int dx = abs(x2 - x1), sx = (x1 < x2) ? 1 : -1;
+        int dy = -abs(y2 - y1), sy = (y1 < y2) ? 1 : -1;
+        int err = dx + dy;
+        int x = x1, y = y1, run = x1;
+
+        while (1) {
+                if (x == x2 && y == y2) {
+                        break;
+                }
+
+                int e2 = 2 * err;
+                int nx = x, ny = y;
+                if (e2 >= dy) {
+                        err += dy;
+                        nx += sx;
+                }
+                if (e2 <= dx) {
+                        err += dx;
+                        ny += sy;
+                }
+
+                // moving to a new row finishes the run
+                if (ny != y) {
+                        _span(&t, y, _min(run, x), _max(run, x));
+                        run = nx;
+                }
+
+                x = nx;
+                y = ny;
+        }
+
+        _span(&t, y, _min(run, x), _max(run, x));
+}
+
+/*
+ * Rectangles
+ */
+
+/*
+ * put the corners of a rectangle in order
+ */
+static void _order(int *a, int *b)
+{
+        if (*a > *b) {
+                int tmp = *a;
+                *a = *b;
+                *b = tmp;
+        }
+}
+
+/*
+ * draw the outline of the rectangle from (x1, y1) to (x2, y2)
+ */
+void primitive_rect(struct canvas c, int x1, int y1, int x2, int y2,
+                    struct color col, enum blit_mode mode)
+{
+        struct span_target t = _target(c, col, mode);
+        _order(&x1, &x2);
+        _order(&y1, &y2);
+
+        _span(&t, y1, x1, x2);
+        if (y2 == y1) {
+                return;
+        }
+
+        for (int y = _max(y1 + 1, 0); y < y2 && y < t.h; y++) {
+                _span(&t, y, x1, x1);
+                if (x2 != x1) {
+                        _span(&t, y, x2, x2);
+                }
+        }
+
+        _span(&t, y2, x1, x2);
+}
+
+/*
+ * fill the rectangle from (x1, y1) to (x2, y2)
+ */
+void primitive_rect_fill(struct canvas c, int x1, int y1, int x2, int y2,
+                         struct color col, enum blit_mode mode)
+{
+        struct span_target t = _target(c, col, mode);
+        _order(&x1, &x2);
+        _order(&y1, &y2);
+
+        for (int y = _max(y1, 0); y <= y2 && y < t.h; y++) {
+                _span(&t, y, x1, x2);
+        }
+}
+
+/*
+ * Circles and Ellipses
+ *
+ * Both are found as the half width of each row in one quadrant, ext[dy] for
+ * dy from 0 to the vertical radius, and drawn as spans from those widths
+ */
+
+/*
+ * midpoint circle, each step gives a point in two octants
+ */
+static void _circle_extents(int *ext, int r)
+{
+        int x = r, y = 0, d = 1 - r;
+
+        for (int i = 0; i <= r; i++) {
+                ext[i] = -1;
+        }
+
+        while (x >= y) {
+                ext[y] = _max(ext[y], x);
+                ext[x] = _max(ext[x], y);
+
+                y++;
+                if (d < 0) {
+                        d += 2 * y + 1;
+                } else {
+                        x--;
+                        d += 2 * (y - x) + 1;
+                }
+        }
+}
+
+/*
+ * midpoint ellipse, stepping along y where the curve is steep and along x
+ * where it is shallow
+ */
+static void _ellipse_extents(int *ext, int rx, int ry)
+{
+        int64_t a2 = (int64_t)rx * rx, b2 = (int64_t)ry * ry;
+        int64_t x = 0, y = ry;
+        int64_t px = 0, py = 2 * a2 * y;
+
+        for (int i = 0; i <= ry; i++) {
+                ext[i] = (rx == 0) ? 0 : -1;
+        }
+
+        // flat ellipses are just lines
+        if (rx == 0 || ry == 0) {
+                ext[0] = rx;
+                return;
+        }
+
+        // region 1, slope shallower than -1
+        int64_t d = b2 - a2 * ry + a2 / 4;
+        while (px < py) {
+                ext[y] = _max(ext[y], x);
+                x++;
+                px += 2 * b2;
+                if (d < 0) {
+                        d += b2 + px;
+                } else {
+                        y--;
+                        py -= 2 * a2;
+                        d += b2 + px - py;
+                }
+        }
+
+        // region 2, slope steeper than -1
+        d = b2 * (2 * x + 1) * (2 * x + 1) / 4 + a2 * (y - 1) * (y - 1) - 
+            a2 * b2;
+        while (y >= 0) {
+                ext[y] = _max(ext[y], x);
+                y--;
+                py -= 2 * a2;
+                if (d > 0) {
+                        d += a2 - py;
+                } else {
+                        x++;
+                        px += 2 * b2;
+                        d += a2 - py + px;
+                }
+        }
+}
+
+/*
+ * fill every row of the shape
+ */
+static void _fill_extents(const struct span_target *t, int cx, int cy,
+                          const int *ext, int ry)
+{
+        for (int dy = -ry; dy <= ry; dy++) {
+                int w = ext[abs(dy)];
+                _span(t, cy + dy, cx - w, cx + w);
+        }
+}
+
+/*
+ * draw the edge of the shape, a pixel is on the edge unless the rows above
+ * and below it are at least as wide, so each row is either one span or a
+ * left and a right span and the outline has no gaps
+ */
+static void _outline_extents(const struct span_target *t, int cx, int cy,
+                             const int *ext, int ry)
+{
+        for (int dy = -ry; dy <= ry; dy++) {
+                int w = ext[abs(dy)];
+                int above = (abs(dy - 1) <= ry) ? ext[abs(dy - 1)] : -1;
+                int below = (abs(dy + 1) <= ry) ? ext[abs(dy + 1)] : -1;
+                int inner = _min(_min(above, below), w - 1);
+
+                if (inner < 0) {
+                        _span(t, cy + dy, cx - w, cx + w);
+                        continue;
+                }
+
+                _span(t, cy + dy, cx - w, cx - inner - 1);
+                _span(t, cy + dy, cx + inner + 1, cx + w);
+        }
+}
+
+/*
+ * draw the outline of a circle of radius r centred on (cx, cy)
+ */
+void primitive_circle(struct canvas c, int cx, int cy, int r,
+                      struct color col, enum blit_mode mode)
+{
+        if (r < 0) {
+                return;
+        }
+
+        struct span_target t = _target(c, col, mode);
+        int *ext = (int *)mem_alloc((r + 1) * sizeof(int));
+        _circle_extents(ext, r);
+        _outline_extents(&t, cx, cy, ext, r);
+        mem_free(ext);
+}
+
+/*
+ * fill a circle of radius r centred on (cx, cy)
+ */
+void primitive_circle_fill(struct canvas c, int cx, int cy, int r,
+                           struct color col, enum blit_mode mode)
+{
+        if (r < 0) {
+                return;
+        }
+
+        struct span_target t = _target(c, col, mode);
+        int *ext = (int *)mem_alloc((r + 1) * sizeof(int));
+        _circle_extents(ext, r);
+        _fill_extents(&t, cx, cy, ext, r);
+        mem_free(ext);
+}
+
+/*
+ * draw the outline of an ellipse with radii rx and ry centred on (cx, cy)
+ */
+void primitive_ellipse(struct canvas c, int cx, int cy, int rx, int ry,
+                       struct color col, enum blit_mode mode)
+{
+        if (rx < 0 || ry < 0) {
+                return;
+        }
+
+        struct span_target t = _target(c, col, mode);
+        int *ext = (int *)mem_alloc((ry + 1) * sizeof(int));
+        _ellipse_extents(ext, rx, ry);
+        _outline_extents(&t, cx, cy, ext, ry);
+        mem_free(ext);
+}
+
+/*
+ * fill an ellipse with radii rx and ry centred on (cx, cy)
+ */
+void primitive_ellipse_fill(struct canvas c, int cx, int cy, int rx, int ry,
+                            struct color col, enum blit_mode mode)
+{
+        if (rx < 0 || ry < 0) {
+                return;
+        }
+
+        struct span_target t = _target(c, col, mode);
+        int *ext = (int *)mem_alloc((ry + 1) * sizeof(int));
+        _ellipse_extents(ext, rx, ry);
+        _fill_extents(&t, cx, cy, ext, ry);
+        mem_free(ext);
+}
+
+/*
+ * Polygons
+ */
+
+/*
+ * a polygon edge, running downwards from y_top to y_bottom
+ */
+struct poly_edge {
+        double y_top;
+        double y_bottom;
+        double x_top;           // x at y_top
+        double dxdy;            // change in x for each row
+        double x;               // x where the edge crosses the current row
+};
+
+static int _compare_edges(const void *a, const void *b)
+{
+        const struct poly_edge *e1 = a, *e2 = b;
+        return (e1->y_top > e2->y_top) - (e1->y_top < e2->y_top);
+}
+
+/*
+ * fill the polygon made by joining n points (the x and y of each are used),
+ * the last point joins back to the first. Pixels whose centres fall inside
+ * the polygon are filled, self intersecting polygons use the even-odd rule
+ */
+void primitive_polygon_fill(struct canvas c, const point *points, int n,
+                            struct color col, enum blit_mode mode)
+{
+        if (n < 3) {
+                return;
+        }
+
+        struct span_target t = _target(c, col, mode);
+
+        // edge table of every non horizontal edge, sorted by top
+        struct poly_edge *edges = (struct poly_edge *)mem_alloc(
+                                        n * sizeof(struct poly_edge));
+        struct poly_edge **active = (struct poly_edge **)mem_alloc(
+                                        n * sizeof(struct poly_edge *));
+        int num_edges = 0;
+
+        double y_min = points[0].y, y_max = points[0].y;
+        for (int i = 0; i < n; i++) {
+                point p1 = points[i], p2 = points[(i + 1) % n];
+                y_min = (p1.y < y_min) ? p1.y : y_min;
+                y_max = (p1.y > y_max) ? p1.y : y_max;
+
+                if (p1.y == p2.y) {
+                        continue;
+                }
+
+                if (p1.y > p2.y) {
+                        point tmp = p1;
+                        p1 = p2;
+                        p2 = tmp;
+                }
+
+                struct poly_edge *e = &edges[num_edges++];
+                e->y_top = p1.y;
+                e->y_bottom = p2.y;
+                e->x_top = p1.x;
+                e->dxdy = (p2.x - p1.x) / (p2.y - p1.y);
+        }
+
+        qsort(edges, num_edges, sizeof(struct poly_edge), _compare_edges);
+
+        // rows whose centres lie inside the polygon and on the canvas
+        int row_first = _max((int)ceil(y_min - 0.5), 0);
+        int row_last = _min((int)ceil(y_max - 0.5) - 1, t.h - 1);
+        int next_edge = 0, num_active = 0;
+
+        for (int y = row_first; y <= row_last; y++) {
+                double yc = y + 0.5;
+
+                // edges reaching this row join the active list
+                while (next_edge < num_edges && edges[next_edge].y_top <= yc) {
+                        active[num_active++] = &edges[next_edge++];
+                }
+
+                // drop edges that have ended and find where the rest cross
+                int kept = 0;
+                for (int i = 0; i < num_active; i++) {
+                        struct poly_edge *e = active[i];
+                        if (e->y_bottom <= yc) {
+                                continue;
+                        }
+
+                        e->x = e->x_top + (yc - e->y_top) * e->dxdy;
+                        active[kept++] = e;
+                }
+                num_active = kept;
+
+                // insertion sort by x, the order barely changes between rows
+                for (int i = 1; i < num_active; i++) {
+                        struct poly_edge *e = active[i];
+                        int j = i - 1;
+                        while (j >= 0 && active[j]->x > e->x) {
+                                active[j + 1] = active[j];
+                                j--;
+                        }
+                        active[j + 1] = e;
+                }
+
+                // fill between pairs of crossings, pixel centres inside
+                for (int i = 0; i + 1 < num_active; i += 2) {
+                        int x1 = (int)ceil(active[i]->x - 0.5);
+                        int x2 = (int)ceil(active[i + 1]->x - 0.5) - 1;
+                        _span(&t, y, x1, x2);
+                }
+        }
+
+        mem_free(active);
+        mem_free(edges);
+}
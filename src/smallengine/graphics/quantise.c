@@ -0,0 +1,303 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+
+#include <smallengine/graphics/quantise.h>
+#include <smallengine/graphics/canvas.h>
+#include <smallengine/graphics/color.h>
+#include <smallengine/graphics/palette.h>
+
+#include <smallengine/sys/mem.h>
+#include <smallengine/sys/job.h>
+
+#define QUANTISE_BAND_ROWS 32   // rows handed to a worker at a time
+
+/*
+ * 8x8 Bayer threshold matrix, each value 0-63 appears once
+ */
+static const uint8_t bayer[8][8] = {
+        { 0, 32,  8, 40,  2, 34, 10, 42},
+        {48, 16, 56, 24, 50, 18, 58, 26},
+        {12, 44,  4, 36, 14, 46,  6, 38},
+        {60, 28, 52, 20, 62, 30, 54, 22},
+        { 3, 35, 11, 43,  1, 33,  9, 41},
+        {51, 19, 59, 27, 49, 17, 57, 25},
+        {15, 47,  7, 39, 13, 45,  5, 37},
+        {63, 31, 55, 23, 61, 29, 53, 21}
+};
+
+/*
+ * everything a worker needs to quantise its band of rows
+ */
+struct quantise_job {
+        const struct quantiser *q;
+        const struct color *src;
+        struct color *dst;
+        uint16_t *indices;
+        int w, h;
+        enum dither_mode dither;
+        struct color *error;    // two rows of w + 2 per band, for diffusion
+};
+
+static int _bands(int rows)
+{
+        return (rows + QUANTISE_BAND_ROWS - 1) / QUANTISE_BAND_ROWS;
+}
+
+static inline int _cell(double v)
+{
+        int i = (int)(v * QUANTISE_CUBE_SIZE);
+        if (i < 0) { return 0; }
+        if (i >= QUANTISE_CUBE_SIZE) { return QUANTISE_CUBE_SIZE - 1; }
+        return i;
+}
+
+static inline int _lookup(const struct quantiser *q, double r, double g,
+                          double b)
+{
+        return q->cube[_cell(r) << (2 * QUANTISE_CUBE_BITS) |
+                       _cell(g) << QUANTISE_CUBE_BITS | _cell(b)];
+}
+
+static int _nearest_exact(const struct quantiser *q, double r, double g,
+                          double b)
+{
+        int best = 0;
+        double best_dist = INFINITY;
+        for (int i = 0; i < q->count; i++) {
+                double dr = q->colors[i].r - r;
+                double dg = q->colors[i].g - g;
+                double db = q->colors[i].b - b;
+                double dist = dr * dr + dg * dg + db * db;
+                if (dist < best_dist) {
+                        best_dist = dist;
+                        best = i;
+                }
+        }
+
+        return best;
+}
+
+/*
+ * fill one red slice of the cube, each cell gets the color nearest its centre
+ */
+static void _cube_slice(void *data, int r)
+{
+        struct quantiser *q = (struct quantiser *)data;
+        double cr = (r + 0.5) / QUANTISE_CUBE_SIZE;
+
+        for (int g = 0; g < QUANTISE_CUBE_SIZE; g++) {
+                double cg = (g + 0.5) / QUANTISE_CUBE_SIZE;
+                for (int b = 0; b < QUANTISE_CUBE_SIZE; b++) {
+                        double cb = (b + 0.5) / QUANTISE_CUBE_SIZE;
+                        q->cube[r << (2 * QUANTISE_CUBE_BITS) |
+                                g << QUANTISE_CUBE_BITS | b] =
+                                        _nearest_exact(q, cr, cg, cb);
+                }
+        }
+}
+
+/*
+ * Creation and Destruction
+ */
+
+/*
+ * build a quantiser for the colors of a palette, the palette can be changed or
+ * destroyed afterwards without affecting the quantiser. Only the first
+ * QUANTISE_MAX_COLORS colors are used
+ */
+struct quantiser quantiser(const struct palette pal)
+{
+        struct quantiser q = {NULL, 0, NULL, 1.0};
+        q.count = (pal.assigned > QUANTISE_MAX_COLORS) ? QUANTISE_MAX_COLORS :
+                                                         pal.assigned;
+        if (q.count <= 0) {
+                q.count = 0;
+                return q;
+        }
+
+        q.colors = (struct color *)mem_alloc(q.count * sizeof(struct color));
+        for (int i = 0; i < q.count; i++) {
+                q.colors[i] = palette_get_by_index(pal, i);
+        }
+
+        // a palette spread evenly over the RGB cube has about cbrt(count)
+        // colors along each axis
+        double per_axis = cbrt((double)q.count);
+        if (per_axis > 2.0) {
+                q.spread = 1.0 / (per_axis - 1.0);
+        }
+
+        q.cube = (uint16_t *)mem_alloc(QUANTISE_CUBE_SIZE * QUANTISE_CUBE_SIZE *
+                                       QUANTISE_CUBE_SIZE * sizeof(uint16_t));
+        job_parallel_for(QUANTISE_CUBE_SIZE, _cube_slice, &q);
+
+        return q;
+}
+
+/*
+ * free all memory used by a quantiser
+ */
+void quantiser_destroy(struct quantiser *q)
+{
+        if (q->colors != NULL) {
+                mem_free(q->colors);
+                mem_free(q->cube);
+        }
+
+        q->colors = NULL;
+        q->cube = NULL;
+        q->count = 0;
+}
+
+/*
+ * Operations
+ */
+
+/*
+ * return the index of the palette color nearest to col, -1 if the palette
+ * was empty
+ */
+int quantiser_nearest(const struct quantiser q, const struct color col)
+{
+        if (q.count == 0) {
+                return -1;
+        }
+
+        return _lookup(&q, col.r, col.g, col.b);
+}
+
+static inline void _store(const struct quantise_job *job, int i, int index)
+{
+        job->dst[i] = job->q->colors[index];
+        if (job->indices != NULL) {
+                job->indices[i] = index;
+        }
+}
+
+static void _quantise_rows(const struct quantise_job *job, int y1, int y2)
+{
+        const struct quantiser *q = job->q;
+
+        for (int y = y1; y < y2; y++) {
+                const struct color *row = job->src + y * job->w;
+                for (int x = 0; x < job->w; x++) {
+                        struct color c = row[x];
+                        if (job->dither == DITHER_BAYER) {
+                                double t = (bayer[y & 7][x & 7] + 0.5) / 64.0;
+                                double offset = (t - 0.5) * q->spread;
+                                c.r += offset;
+                                c.g += offset;
+                                c.b += offset;
+                        }
+                        _store(job, y * job->w + x,
+                               _lookup(q, c.r, c.g, c.b));
+                }
+        }
+}
+
+static inline double _clamp(double v)
+{
+        return (v < 0.0) ? 0.0 : (v > 1.0) ? 1.0 : v;
+}
+
+static inline void _spread_error(struct color *e, double r, double g, double b,
+                                 double weight)
+{
+        e->r += r * weight;
+        e->g += g * weight;
+        e->b += b * weight;
+}
+
+/*
+ * Floyd-Steinberg over a band of rows, alternating direction each row. The
+ * error rows are padded by a pixel either side so the edges need no checks
+ */
+static void _diffuse_rows(const struct quantise_job *job, int band, int y1,
+                          int y2)
+{
+        const struct quantiser *q = job->q;
+        int stride = job->w + 2;
+        struct color *cur = job->error + band * 2 * stride + 1;
+        struct color *next = cur + stride;
+
+        for (int x = -1; x <= job->w; x++) {
+                cur[x] = color_rgb(0.0, 0.0, 0.0);
+        }
+
+        for (int y = y1; y < y2; y++) {
+                for (int x = -1; x <= job->w; x++) {
+                        next[x] = color_rgb(0.0, 0.0, 0.0);
+                }
+
+                int dir = ((y - y1) & 1) ? -1 : 1;
+                int x = (dir > 0) ? 0 : job->w - 1;
+                for (int n = 0; n < job->w; n++, x += dir) {
+                        const struct color *in = &job->src[y * job->w + x];
+                        double r = _clamp(in->r + cur[x].r);
+                        double g = _clamp(in->g + cur[x].g);
+                        double b = _clamp(in->b + cur[x].b);
+
+                        int index = _lookup(q, r, g, b);
+                        _store(job, y * job->w + x, index);
+
+                        r -= q->colors[index].r;
+                        g -= q->colors[index].g;
+                        b -= q->colors[index].b;
+                        _spread_error(&cur[x + dir], r, g, b, 7.0 / 16.0);
+                        _spread_error(&next[x - dir], r, g, b, 3.0 / 16.0);
+                        _spread_error(&next[x], r, g, b, 5.0 / 16.0);
+                        _spread_error(&next[x + dir], r, g, b, 1.0 / 16.0);
+                }
+
+                struct color *tmp = cur;
+                cur = next;
+                next = tmp;
+        }
+}
+
+static void _quantise_band(void *data, int band)
+{
+        const struct quantise_job *job = (const struct quantise_job *)data;
+        int y1 = band * QUANTISE_BAND_ROWS;
+        int y2 = y1 + QUANTISE_BAND_ROWS;
+        if (y2 > job->h) {
+                y2 = job->h;
+        }
+
+        if (job->dither == DITHER_FLOYD_STEINBERG) {
+                _diffuse_rows(job, band, y1, y2);
+        } else {
+                _quantise_rows(job, y1, y2);
+        }
+}
+
+/*
+ * replace every pixel of src with a palette color and write it to dst, which
+ * must be the same size and may be the same canvas. If indices isn't NULL the
+ * palette index of each pixel is stored there too, row by row
+ */
+void quantiser_canvas(const struct quantiser q, const struct canvas src,
+                      struct canvas dst, uint16_t *indices,
+                      enum dither_mode dither)
+{
+        if (q.count == 0 || src.w != dst.w || src.h != dst.h) {
+                return;
+        }
+
+        const struct color *in = canvas_pixels(src);
+        struct quantise_job job = {&q, in, canvas_pixels_writable(dst),
+                                   indices, src.w, src.h, dither, NULL};
+
+        // workers can't allocate, so every band's error rows are made here
+        if (dither == DITHER_FLOYD_STEINBERG) {
+                job.error = (struct color *)mem_alloc(_bands(src.h) * 2 *
+                                        (src.w + 2) * sizeof(struct color));
+        }
+
+        job_parallel_for(_bands(src.h), _quantise_band, &job);
+
+        if (job.error != NULL) {
+                mem_free(job.error);
+        }
+}
@@ -0,0 +1,504 @@
+#include <stdio.h>
+#include <math.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <smallengine/graphics/raster.h>
+#include <smallengine/graphics/canvas.h>
+#include <smallengine/graphics/color.h>
+#include <smallengine/graphics/texture.h>
+#include <smallengine/graphics/palette.h>
+#include <smallengine/maths/tuple.h>
+
+#include <smallengine/sys/mem.h>
+#include <smallengine/sys/job.h>
+
+#define RASTER_TILE_SIZE 32
+#define RASTER_SUBPIXELS 16.0   // vertices are snapped to 1/16th of a pixel
+
+/*
+ * With positions snapped to 1/16th of a pixel and pixels sampled at their
+ * centres every edge function value is an exact multiple of 1/256, so
+ * neighbouring triangles agree exactly on which of them owns a pixel. Edges
+ * on the top or left of a triangle own the pixels lying exactly on them.
+ */
+#define RASTER_TOP_LEFT_BIAS (0.5 / (RASTER_SUBPIXELS * RASTER_SUBPIXELS))
+
+#define NUM_ATTRS 6             // r, g, b, a, u, v
+
+/*
+ * a triangle prepared for drawing, edge i runs from vertex i to vertex i + 1
+ * and is positive on the inside
+ */
+struct tri_setup {
+        double x[3], y[3];      // snapped positions
+        double dx[3], dy[3];    // edge directions
+        double bias[3];         // top-left rule, see above
+        double inv_area;        // 1 / twice the area
+        double z[3];
+        double inv_w[3];
+        double attr[3][NUM_ATTRS];      // attributes divided by w
+        int x1, y1, x2, y2;     // bounds on the screen
+        const struct raster_tri *tri;
+};
+
+/*
+ * everything the tile workers share
+ */
+struct raster_job {
+        const struct tri_setup *setup;
+        const int *bin_start;   // bins[bin_start[t]] is the first of tile t
+        const int *bins;        // triangle indices for each tile in order
+        struct color *pixels;
+        float *depth;
+        int w, h;
+        int tiles_x;
+        enum color_space space; // of the destination
+};
+
+/*
+ * Creation and Destruction
+ */
+
+/*
+ * create a raster able to hold size triangles
+ */
+struct raster raster(int size)
+{
+        struct raster r = {NULL, size, 0};
+        r.tris = (struct raster_tri *)mem_alloc(size * sizeof(struct raster_tri));
+        return r;
+}
+
+/*
+ * free all memory used by a raster
+ */
+void raster_destroy(struct raster *r)
+{
+        mem_free(r->tris);
+        r->tris = NULL;
+        r->size = 0;
+        r->count = 0;
+}
+
+/*
+ * create a depth buffer, every depth starts at 1.0 (furthest)
+ */
+struct depth_buffer depth_buffer(const int w, const int h)
+{
+        struct depth_buffer db = {w, h, NULL};
+        db.depth = (float *)mem_alloc(w * h * sizeof(float));
+        depth_buffer_clear(db, 1.0f);
+
+        return db;
+}
+
+/*
+ * free all memory used by a depth buffer
+ */
+void depth_buffer_destroy(struct depth_buffer *db)
+{
+        mem_free(db->depth);
+        db->depth = NULL;
+        db->w = 0;
+        db->h = 0;
+}
+
+/*
+ * set every depth in the buffer to the given value
+ */
+void depth_buffer_clear(struct depth_buffer db, const float depth)
+{
+        for (int i = 0; i < db.w * db.h; i++) {
+                db.depth[i] = depth;
+        }
+}
+
+/*
+ * Recording
+ */
+
+/*
+ * create a vertex
+ */
+struct raster_vertex raster_vertex(point pos, struct color col, 
+                                   double u, double v)
+{
+        struct raster_vertex vert = {pos, col, u, v};
+        return vert;
+}
+
+static struct raster_tri *_add(struct raster *r, struct raster_vertex v0, 
+                               struct raster_vertex v1, 
+                               struct raster_vertex v2, enum blit_mode mode)
+{
+        if (r->count >= r->size) {
+                return NULL;
+        }
+
+        struct raster_tri *tri = &r->tris[r->count++];
+        tri->v[0] = v0;
+        tri->v[1] = v1;
+        tri->v[2] = v2;
+        tri->textured = 0;
+        tri->mode = mode;
+
+        return tri;
+}
+
+/*
+ * add a triangle coloured by its vertex colours, returns 1 on success, 0 if
+ * the raster is full
+ */
+int raster_triangle(struct raster *r, struct raster_vertex v0, 
+                    struct raster_vertex v1, struct raster_vertex v2,
+                    enum blit_mode mode)
+{
+        return (_add(r, v0, v1, v2, mode) != NULL);
+}
+
+/*
+ * add a textured triangle, the texture colour is multiplied by the vertex
+ * colours and transparent texels are not drawn. returns 1 on success, 0 if
+ * the raster is full or the texture is empty
+ */
+int raster_triangle_textured(struct raster *r, struct raster_vertex v0, 
+                             struct raster_vertex v1, struct raster_vertex v2,
+                             struct texture tex, enum blit_mode mode)
+{
+        if (tex.w <= 0 || tex.h <= 0 || tex.mask == NULL) {
+                return 0;
+        }
+
+        struct raster_tri *tri = _add(r, v0, v1, v2, mode);
+        if (tri == NULL) {
+                return 0;
+        }
+
+        tri->texture = tex;
+        tri->textured = 1;
+
+        return 1;
+}
+
+/*
+ * Setup
+ */
+
+static inline int _min(int a, int b) { return (a < b) ? a : b; }
+static inline int _max(int a, int b) { return (a > b) ? a : b; }
+
+static double _snap(double val)
+{
+        return floor(val * RASTER_SUBPIXELS + 0.5) / RASTER_SUBPIXELS;
+}
+
+/*
+ * edge function of edge i at (px, py)
+ */
+static inline double _edge(const struct tri_setup *s, int i, 
+                           double px, double py)
+{
+        return s->dx[i] * (py - s->y[i]) - s->dy[i] * (px - s->x[i]);
+}
+
+/*
+ * prepare a triangle for drawing, returns 0 if it covers nothing on screen
+ */
+static int _setup(struct tri_setup *s, const struct raster_tri *tri, 
+                  int w, int h)
+{
+        const struct raster_vertex *v[3] = {&tri->v[0], &tri->v[1], &tri->v[2]};
+
+        // wind every triangle the same way
+        double area = (v[1]->pos.x - v[0]->pos.x) * (v[2]->pos.y - v[0]->pos.y) -
+                      (v[1]->pos.y - v[0]->pos.y) * (v[2]->pos.x - v[0]->pos.x);
+        if (area < 0.0) {
+                const struct raster_vertex *tmp = v[1];
+                v[1] = v[2];
+                v[2] = tmp;
+        }
+
+        for (int i = 0; i < 3; i++) {
+                s->x[i] = _snap(v[i]->pos.x);
+                s->y[i] = _snap(v[i]->pos.y);
+        }
+
+        for (int i = 0; i < 3; i++) {
+                int j = (i + 1) % 3;
+                s->dx[i] = s->x[j] - s->x[i];
+                s->dy[i] = s->y[j] - s->y[i];
+
+                int top_left = (s->dy[i] < 0.0) || 
+                               (s->dy[i] == 0.0 && s->dx[i] > 0.0);
+                s->bias[i] = top_left ? RASTER_TOP_LEFT_BIAS : 0.0;
+        }
+
+        area = _edge(s, 0, s->x[2], s->y[2]);
+        if (area <= 0.0) {
+                return 0;
+        }
+        s->inv_area = 1.0 / area;
+
+        for (int i = 0; i < 3; i++) {
+                double inv_w = (v[i]->pos.w != 0.0) ? 1.0 / v[i]->pos.w : 1.0;
+                s->z[i] = v[i]->pos.z;
+                s->inv_w[i] = inv_w;
+                s->attr[i][0] = v[i]->color.r * inv_w;
+                s->attr[i][1] = v[i]->color.g * inv_w;
+                s->attr[i][2] = v[i]->color.b * inv_w;
+                s->attr[i][3] = v[i]->color.a * inv_w;
+                s->attr[i][4] = v[i]->u * inv_w;
+                s->attr[i][5] = v[i]->v * inv_w;
+        }
+
+        // pixels whose centres could be inside, clipped to the screen
+        double min_x = fmin(s->x[0], fmin(s->x[1], s->x[2]));
+        double max_x = fmax(s->x[0], fmax(s->x[1], s->x[2]));
+        double min_y = fmin(s->y[0], fmin(s->y[1], s->y[2]));
+        double max_y = fmax(s->y[0], fmax(s->y[1], s->y[2]));
+
+        s->x1 = _max((int)floor(min_x - 0.5), 0);
+        s->y1 = _max((int)floor(min_y - 0.5), 0);
+        s->x2 = _min((int)ceil(max_x - 0.5), w - 1);
+        s->y2 = _min((int)ceil(max_y - 0.5), h - 1);
+        s->tri = tri;
+
+        return (s->x1 <= s->x2 && s->y1 <= s->y2);
+}
+
+/*
+ * Shading
+ */
+
+/*
+ * the texel a texture coordinate falls on, repeating the texture. Wrapped
+ * before the cast so coordinates far outside 0.0-1.0 can't overflow an int
+ */
+static inline int _wrap(double t, int size)
+{
+        double i = fmod(floor(t * size), size);
+        if (i < 0.0) {
+                i += size;
+        }
+
+        // NaN from a degenerate triangle
+        return (i >= 0.0 && i < size) ? (int)i : 0;
+}
+
+/*
+ * colour one covered pixel from the edge function values there
+ */
+static void _shade(const struct raster_job *job, const struct tri_setup *s,
+                   int x, int y, double e0, double e1, double e2)
+{
+        // the weight of each vertex is the edge opposite it
+        double b[3] = {e1 * s->inv_area, e2 * s->inv_area, e0 * s->inv_area};
+        int index = y * job->w + x;
+
+        double z = b[0] * s->z[0] + b[1] * s->z[1] + b[2] * s->z[2];
+        if (job->depth != NULL && !(z < job->depth[index])) {
+                return;
+        }
+
+        // attributes were divided by w so they interpolate linearly on screen
+        double inv_w = b[0] * s->inv_w[0] + b[1] * s->inv_w[1] + 
+                       b[2] * s->inv_w[2];
+        double a[NUM_ATTRS];
+        for (int i = 0; i < NUM_ATTRS; i++) {
+                a[i] = (b[0] * s->attr[0][i] + b[1] * s->attr[1][i] + 
+                        b[2] * s->attr[2][i]) / inv_w;
+        }
+
+        struct color col = {a[0], a[1], a[2], a[3]};
+        const struct raster_tri *tri = s->tri;
+
+        if (tri->textured) {
+                struct texture tex = tri->texture;
+                int tx = _wrap(a[4], tex.w);
+                int ty = _wrap(a[5], tex.h);
+
+                int texel = tex.mask[ty * tex.w + tx];
+                if (texel < 0) {
+                        return;
+                }
+                // texels from another color space are converted as drawn
+                struct color tc = palette_get_by_index(tex.palette, texel);
+                enum color_space from = canvas_color_space(tex.canvas);
+                if (from != job->space) {
+                        tc = color_convert(tc, from, job->space);
+                }
+                col = color_multiply(tc, col);
+        }
+
+        if (job->depth != NULL) {
+                job->depth[index] = (float)z;
+        }
+
+        canvas_fill_span(&job->pixels[index], col, 1, tri->mode);
+}
+
+/*
+ * test the pixels from x1 to x2 on row y against the triangle, four at a
+ * time, and shade those covered
+ */
+static void _raster_row(const struct raster_job *job, const struct tri_setup *s,
+                        int y, int x1, int x2)
+{
+        double px = x1 + 0.5, py = y + 0.5;
+        double e[3], step[3];
+
+        for (int i = 0; i < 3; i++) {
+                e[i] = _edge(s, i, px, py);
+                step[i] = -s->dy[i];
+        }
+
+        for (int x = x1; x <= x2; x += 4) {
+                int mask = 0;
+#ifdef __SSE2__
+                __m128d inside_lo = _mm_castsi128_pd(_mm_set1_epi32(-1));
+                __m128d inside_hi = inside_lo;
+                for (int i = 0; i < 3; i++) {
+                        __m128d lo = _mm_set_pd(e[i] + step[i], e[i]);
+                        __m128d hi = _mm_add_pd(lo, _mm_set1_pd(2.0 * step[i]));
+                        __m128d limit = _mm_set1_pd(-s->bias[i]);
+                        inside_lo = _mm_and_pd(inside_lo, _mm_cmpgt_pd(lo, limit));
+                        inside_hi = _mm_and_pd(inside_hi, _mm_cmpgt_pd(hi, limit));
+                }
+                mask = _mm_movemask_pd(inside_lo) | 
+                       (_mm_movemask_pd(inside_hi) << 2);
+#else
+                for (int k = 0; k < 4; k++) {
+                        int in = 1;
+                        for (int i = 0; i < 3; i++) {
+                                in &= (e[i] + k * step[i] > -s->bias[i]);
+                        }
+                        mask |= in << k;
+                }
+#endif
+                for (int k = 0; k < 4 && x + k <= x2; k++) {
+                        if (mask & (1 << k)) {
+                                _shade(job, s, x + k, y, e[0] + k * step[0],
+                                       e[1] + k * step[1], e[2] + k * step[2]);
+                        }
+                }
+
+                for (int i = 0; i < 3; i++) {
+                        e[i] += 4.0 * step[i];
+                }
+        }
+}
+
+/*
+ * draw every triangle binned to the tile, in the order they were added
+ */
+static void _draw_tile(void *data, int tile)
+{
+        struct raster_job *job = (struct raster_job *)data;
+
+        int tx1 = (tile % job->tiles_x) * RASTER_TILE_SIZE;
+        int ty1 = (tile / job->tiles_x) * RASTER_TILE_SIZE;
+        int tx2 = _min(tx1 + RASTER_TILE_SIZE - 1, job->w - 1);
+        int ty2 = _min(ty1 + RASTER_TILE_SIZE - 1, job->h - 1);
+
+        for (int b = job->bin_start[tile]; b < job->bin_start[tile + 1]; b++) {
+                const struct tri_setup *s = &job->setup[job->bins[b]];
+                int x1 = _max(s->x1, tx1), x2 = _min(s->x2, tx2);
+                int y1 = _max(s->y1, ty1), y2 = _min(s->y2, ty2);
+
+                for (int y = y1; y <= y2; y++) {
+                        _raster_row(job, s, y, x1, x2);
+                }
+        }
+}
+
+/*
+ * Drawing
+ */
+
+/*
+ * draw every triangle onto dst, testing against and updating the depth buffer
+ * if one is given (it must be the same size as dst), NULL draws without
+ * depth testing. The triangles are kept so they can be drawn again
+ */
+void raster_draw(struct raster *r, struct canvas dst, struct depth_buffer *db)
+{
+        if (r->count == 0 || dst.w <= 0 || dst.h <= 0) {
+                return;
+        }
+
+        int tiles_x = (dst.w + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+        int tiles_y = (dst.h + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+        int tiles = tiles_x * tiles_y;
+
+        struct tri_setup *setup = (struct tri_setup *)mem_alloc(
+                                        r->count * sizeof(struct tri_setup));
+        int *bin_start = (int *)mem_alloc((tiles + 1) * sizeof(int));
+        int i, t, visible = 0;
+
+        for (t = 0; t <= tiles; t++) {
+                bin_start[t] = 0;
+        }
+
+        // count the triangles in each tile, keeping only those on screen
+        for (i = 0; i < r->count; i++) {
+                struct tri_setup *s = &setup[visible];
+                if (!_setup(s, &r->tris[i], dst.w, dst.h)) {
+                        continue;
+                }
+                visible++;
+
+                for (int ty = s->y1 / RASTER_TILE_SIZE; 
+                     ty <= s->y2 / RASTER_TILE_SIZE; ty++) {
+                        for (int tx = s->x1 / RASTER_TILE_SIZE; 
+                             tx <= s->x2 / RASTER_TILE_SIZE; tx++) {
+                                bin_start[ty * tiles_x + tx + 1]++;
+                        }
+                }
+        }
+
+        for (t = 0; t < tiles; t++) {
+                bin_start[t + 1] += bin_start[t];
+        }
+
+        // fill the bins in the order the triangles were added
+        int *bins = (int *)mem_alloc((bin_start[tiles] + 1) * sizeof(int));
+        int *fill = (int *)mem_alloc(tiles * sizeof(int));
+        for (t = 0; t < tiles; t++) {
+                fill[t] = bin_start[t];
+        }
+
+        for (i = 0; i < visible; i++) {
+                struct tri_setup *s = &setup[i];
+                for (int ty = s->y1 / RASTER_TILE_SIZE; 
+                     ty <= s->y2 / RASTER_TILE_SIZE; ty++) {
+                        for (int tx = s->x1 / RASTER_TILE_SIZE; 
+                             tx <= s->x2 / RASTER_TILE_SIZE; tx++) {
+                                bins[fill[ty * tiles_x + tx]++] = i;
+                        }
+                }
+        }
+
+        struct raster_job job = {setup, bin_start, bins, 
+                                 canvas_pixels_writable(dst),
+                                 (db != NULL) ? db->depth : NULL,
+                                 dst.w, dst.h, tiles_x,
+                                 canvas_color_space(dst)};
+
+        job_parallel_for(tiles, _draw_tile, &job);
+
+        mem_free(fill);
+        mem_free(bins);
+        mem_free(bin_start);
+        mem_free(setup);
+}
+
+/*
+ * remove all triangles, ready for the next frame
+ */
+void raster_clear(struct raster *r)
+{
+        r->count = 0;
+}
@@ -0,0 +1,304 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include <SDL2/SDL.h>
+
+#include <smallengine/graphics/recorder.h>
+#include <smallengine/graphics/color.h>
+
+#include <smallengine/sys/log.h>
+#include <smallengine/sys/mem.h>
+
+#define RECORDER_BUFFERS 2
+#define Y4M_FRAME "FRAME\n"
+
+/*
+ * a frame waiting to be written, repeats counts the dropped frames after it
+ * which it stands in for
+ */
+struct recorder_frame {
+        uint32_t *pixels;
+        enum color_layout layout;
+        int repeats;
+};
+
+/*
+ * the frames are a ring as in capture.c: count frames before head are
+ * waiting, the oldest being written. The recording thread only fills the
+ * frame at head and the writer only reads the oldest
+ */
+static struct {
+        SDL_Thread *thread;
+        SDL_mutex *lock;
+        SDL_cond *queued;               // the writer waits here for frames
+        struct recorder_frame frames[RECORDER_BUFFERS];
+        int head;
+        int count;
+        int quit;
+
+        FILE *file;
+        enum recorder_format format;
+        int w;
+        int h;
+        uint8_t *out;                   // a whole frame as written, only
+        size_t out_size;                // used by the writer
+
+        int written;
+        int dropped;
+        int failed;
+} rec;
+
+/*
+ * convert a frame to the file's format in the output buffer
+ */
+static void _convert(const struct recorder_frame *f)
+{
+        int n = rec.w * rec.h;
+
+        if (rec.format == RECORDER_Y4M) {
+                int chroma = ((rec.w + 1) / 2) * ((rec.h + 1) / 2);
+                uint8_t *y = rec.out + strlen(Y4M_FRAME);
+                color_rgb32_to_yuv420(f->pixels, rec.w, rec.h, rec.w,
+                                      f->layout, y, y + n, y + n + chroma);
+        } else if (f->layout == COLOR_RGBA) {
+                // RGBA pixels are already r, g, b, a in memory
+                memcpy(rec.out, f->pixels, n * sizeof(uint32_t));
+        } else {
+                for (int i = 0; i < n; i++) {
+                        uint32_t p = f->pixels[i];
+                        rec.out[i * 4] = (p >> 16) & 0xff;
+                        rec.out[i * 4 + 1] = (p >> 8) & 0xff;
+                        rec.out[i * 4 + 2] = p & 0xff;
+                        rec.out[i * 4 + 3] = 0xff;
+                }
+        }
+}
+
+static int _writer(void *unused)
+{
+        SDL_LockMutex(rec.lock);
+
+        while (1) {
+                while (rec.count == 0 && !rec.quit) {
+                        SDL_CondWait(rec.queued, rec.lock);
+                }
+
+                // everything queued is written before stopping
+                if (rec.count == 0) {
+                        break;
+                }
+
+                int oldest = (rec.head - rec.count + RECORDER_BUFFERS) %
+                             RECORDER_BUFFERS;
+                struct recorder_frame *f = &rec.frames[oldest];
+                SDL_UnlockMutex(rec.lock);
+
+                _convert(f);
+
+                // write it again for each frame dropped while it waited,
+                // more can be dropped until it is released
+                int more;
+                do {
+                        int ok = (fwrite(rec.out, rec.out_size, 1,
+                                         rec.file) == 1);
+
+                        SDL_LockMutex(rec.lock);
+                        rec.written++;
+                        rec.failed += !ok;
+                        more = (f->repeats > 0);
+                        if (more) {
+                                f->repeats--;
+                        } else {
+                                rec.count--;
+                        }
+                        SDL_UnlockMutex(rec.lock);
+                } while (more);
+
+                SDL_LockMutex(rec.lock);
+        }
+
+        SDL_UnlockMutex(rec.lock);
+        return 0;
+}
+
+/*
+ * start recording frames of w x h at fps frames per second to a new file,
+ * returns 1 on success, 0 on failure or if already recording
+ */
+int recorder_start(const char *filename, int w, int h, int fps,
+                   enum recorder_format format)
+{
+        if (rec.thread != NULL || w <= 0 || h <= 0 || fps <= 0) {
+                return 0;
+        }
+
+        rec.file = fopen(filename, "wb");
+        if (rec.file == NULL) {
+                fprintf(stderr, "%s: %s\n", filename, strerror(errno));
+                return 0;
+        }
+
+        // frames are written whole, so stdio's buffer would only add a copy
+        // and hold back the end of each frame until the next
+        setvbuf(rec.file, NULL, _IONBF, 0);
+
+        rec.format = format;
+        rec.w = w;
+        rec.h = h;
+        rec.written = 0;
+        rec.dropped = 0;
+        rec.failed = 0;
+
+        if (format == RECORDER_Y4M) {
+                // C420jpeg: chroma sited between each 2x2 block
+                fprintf(rec.file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n",
+                        w, h, fps);
+                rec.out_size = strlen(Y4M_FRAME) + (size_t)w * h +
+                               2 * (size_t)((w + 1) / 2) * ((h + 1) / 2);
+                rec.out = (uint8_t *)mem_alloc(rec.out_size);
+                memcpy(rec.out, Y4M_FRAME, strlen(Y4M_FRAME));
+        } else {
+                rec.out_size = (size_t)w * h * 4;
+                rec.out = (uint8_t *)mem_alloc(rec.out_size);
+        }
+
+        for (int i = 0; i < RECORDER_BUFFERS; i++) {
+                rec.frames[i].pixels = (uint32_t *)mem_alloc((size_t)w * h *
+                                                            sizeof(uint32_t));
+                rec.frames[i].repeats = 0;
+        }
+
+        rec.head = 0;
+        rec.count = 0;
+        rec.quit = 0;
+        rec.lock = SDL_CreateMutex();
+        rec.queued = SDL_CreateCond();
+
+        rec.thread = SDL_CreateThread(_writer, "recorder", NULL);
+        if (rec.thread == NULL) {
+                log_wrn("Unable to create recorder: %s", SDL_GetError());
+                rec.quit = 1;
+                recorder_stop();
+                return 0;
+        }
+
+        return 1;
+}
+
+/*
+ * write the frames still queued, close the file and stop recording. Returns
+ * 1 if every frame was written, 0 if any write failed
+ */
+int recorder_stop(void)
+{
+        if (rec.file == NULL) {
+                return 0;
+        }
+
+        if (rec.thread != NULL) {
+                SDL_LockMutex(rec.lock);
+                rec.quit = 1;
+                SDL_CondSignal(rec.queued);
+                SDL_UnlockMutex(rec.lock);
+
+                SDL_WaitThread(rec.thread, NULL);
+        }
+
+        SDL_DestroyCond(rec.queued);
+        SDL_DestroyMutex(rec.lock);
+
+        int ok = (fclose(rec.file) == 0) && rec.failed == 0;
+
+        for (int i = 0; i < RECORDER_BUFFERS; i++) {
+                mem_free(rec.frames[i].pixels);
+                rec.frames[i].pixels = NULL;
+        }
+        mem_free(rec.out);
+
+        rec.out = NULL;
+        rec.file = NULL;
+        rec.thread = NULL;
+        rec.lock = NULL;
+        rec.queued = NULL;
+
+        return ok;
+}
+
+/*
+ * return 1 while recording
+ */
+int recorder_active(void)
+{
+        return rec.thread != NULL;
+}
+
+/*
+ * record a frame of packed pixels in the given layout, pitch is the number of
+ * pixels from one row to the next. Returns 1 if the frame was queued, 0 if it
+ * was dropped or isn't the size being recorded
+ */
+int recorder_frame(const uint32_t *pixels, int w, int h, int pitch,
+                   enum color_layout layout)
+{
+        if (rec.thread == NULL || w != rec.w || h != rec.h) {
+                return 0;
+        }
+
+        SDL_LockMutex(rec.lock);
+        if (rec.count == RECORDER_BUFFERS) {
+                // the newest frame waiting stands in for this one
+                int newest = (rec.head + RECORDER_BUFFERS - 1) %
+                             RECORDER_BUFFERS;
+                rec.frames[newest].repeats++;
+                rec.dropped++;
+                SDL_UnlockMutex(rec.lock);
+                return 0;
+        }
+        struct recorder_frame *f = &rec.frames[rec.head];
+        SDL_UnlockMutex(rec.lock);
+
+        f->layout = layout;
+        f->repeats = 0;
+        if (pitch == w) {
+                memcpy(f->pixels, pixels, (size_t)w * h * sizeof(uint32_t));
+        } else {
+                for (int y = 0; y < h; y++) {
+                        memcpy(f->pixels + y * w, pixels + y * pitch,
+                               w * sizeof(uint32_t));
+                }
+        }
+
+        SDL_LockMutex(rec.lock);
+        rec.head = (rec.head + 1) % RECORDER_BUFFERS;
+        rec.count++;
+        SDL_CondSignal(rec.queued);
+        SDL_UnlockMutex(rec.lock);
+
+        return 1;
+}
+
+/*
+ * return the number of frames in the file so far, including repeats
+ */
+int recorder_frames(void)
+{
+        if (rec.lock == NULL) {
+                return rec.written;
+        }
+
+        SDL_LockMutex(rec.lock);
+        int written = rec.written;
+        SDL_UnlockMutex(rec.lock);
+
+        return written;
+}
+
+/*
+ * return the number of frames dropped because the writer was behind
+ */
+int recorder_dropped(void)
+{
+        return rec.dropped;
+}
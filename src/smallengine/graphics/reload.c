@@ -0,0 +1,405 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#ifdef __linux__
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#define RELOAD_INOTIFY
+#endif
+
+#include <SDL2/SDL.h>
+
+#include <smallengine/graphics/reload.h>
+#include <smallengine/graphics/atlas.h>
+#include <smallengine/graphics/canvas.h>
+#include <smallengine/graphics/color.h>
+#include <smallengine/graphics/texture.h>
+
+#include <smallengine/sys/log.h>
+#include <smallengine/sys/mem.h>
+
+/*
+ * a watched file and what it is loaded into, either a texture or a sprite
+ */
+struct reload_watch {
+        int id;                         // 0 if the slot is free
+        char filename[RELOAD_PATH_SIZE];
+        const char *name;               // filename without its directory
+        int wd;                         // the inotify watch of the directory
+        struct texture *tex;
+        struct atlas *atlas;
+        int handle;
+        struct color trans;
+        int has_trans;
+        int changed;                    // written since it was converted
+        int ready;                      // next is waiting to be applied
+        struct texture next;
+};
+
+/*
+ * the watcher thread waits for changes, then converts each changed file
+ * without holding the lock. Everything else here is used by the program's
+ * thread
+ */
+static struct {
+        SDL_Thread *thread;
+        SDL_mutex *lock;
+        int fd;                         // inotify
+        int wake[2];                    // written to stop the watcher
+        struct reload_watch watches[RELOAD_MAX_WATCHES];
+        int next_id;
+        int failed;
+} rl;
+
+#ifdef RELOAD_INOTIFY
+/*
+ * mark the watches of a file changed, called with the lock held
+ */
+static void _mark(int wd, const char *name)
+{
+        for (int i = 0; i < RELOAD_MAX_WATCHES; i++) {
+                struct reload_watch *w = &rl.watches[i];
+                if (w->id != 0 && w->wd == wd && strcmp(w->name, name) == 0) {
+                        w->changed = 1;
+                }
+        }
+}
+
+/*
+ * decode and convert every changed file, one at a time. A file changed again
+ * while it is converted is converted again after
+ */
+static void _convert_changed(void)
+{
+        while (1) {
+                SDL_LockMutex(rl.lock);
+                struct reload_watch *w = NULL;
+                for (int i = 0; i < RELOAD_MAX_WATCHES && w == NULL; i++) {
+                        if (rl.watches[i].id != 0 && rl.watches[i].changed) {
+                                w = &rl.watches[i];
+                        }
+                }
+                if (w == NULL) {
+                        SDL_UnlockMutex(rl.lock);
+                        return;
+                }
+
+                char filename[RELOAD_PATH_SIZE];
+                memcpy(filename, w->filename, RELOAD_PATH_SIZE);
+                struct color trans = w->trans;
+                int has_trans = w->has_trans;
+                int id = w->id;
+                w->changed = 0;
+                SDL_UnlockMutex(rl.lock);
+
+                struct canvas c = canvas_from_file(filename);
+                struct texture tex;
+                int ok = (c.w > 0);
+                if (ok) {
+                        tex = texture_from_canvas(c, has_trans ? &trans :
+                                                                 NULL);
+                }
+                canvas_destroy(&c);
+
+                // the watch may have been dropped meanwhile
+                SDL_LockMutex(rl.lock);
+                if (!ok) {
+                        rl.failed++;
+                } else if (w->id == id) {
+                        if (w->ready) {
+                                texture_destroy(&w->next);
+                        }
+                        w->next = tex;
+                        w->ready = 1;
+                } else {
+                        texture_destroy(&tex);
+                }
+                SDL_UnlockMutex(rl.lock);
+        }
+}
+
+static int _watcher(void *unused)
+{
+        struct pollfd fds[2] = {{rl.fd, POLLIN, 0}, {rl.wake[0], POLLIN, 0}};
+
+        // inotify events need the alignment of the struct
+        union {
+                struct inotify_event event;
+                char bytes[4096];
+        } buf;
+
+        while (1) {
+                if (poll(fds, 2, -1) < 0) {
+                        if (errno == EINTR) {
+                                continue;
+                        }
+                        log_wrn("Unable to watch files: %s", strerror(errno));
+                        break;
+                }
+
+                if (fds[1].revents != 0) {
+                        break;
+                }
+
+                ssize_t n = read(rl.fd, buf.bytes, sizeof(buf.bytes));
+                if (n <= 0) {
+                        continue;
+                }
+
+                SDL_LockMutex(rl.lock);
+                for (char *p = buf.bytes; p < buf.bytes + n;) {
+                        const struct inotify_event *e =
+                                (const struct inotify_event *)p;
+                        if (e->len > 0) {
+                                _mark(e->wd, e->name);
+                        }
+                        p += sizeof(struct inotify_event) + e->len;
+                }
+                SDL_UnlockMutex(rl.lock);
+
+                _convert_changed();
+        }
+
+        return 0;
+}
+#endif
+
+/*
+ * start watching for changes, returns 1 on success, 0 if files can't be
+ * watched here
+ */
+int reload_init(void)
+{
+        if (rl.thread != NULL) {
+                return 1;
+        }
+
+#ifdef RELOAD_INOTIFY
+        rl.fd = inotify_init1(IN_CLOEXEC);
+        if (rl.fd < 0) {
+                log_wrn("Unable to watch files: %s", strerror(errno));
+                return 0;
+        }
+
+        if (pipe(rl.wake) != 0) {
+                log_wrn("Unable to watch files: %s", strerror(errno));
+                close(rl.fd);
+                return 0;
+        }
+
+        rl.lock = SDL_CreateMutex();
+        rl.thread = SDL_CreateThread(_watcher, "reload", NULL);
+        if (rl.thread == NULL) {
+                log_wrn("Unable to create file watcher: %s", SDL_GetError());
+                reload_quit();
+                return 0;
+        }
+
+        return 1;
+#else
+        log_wrn("Hot reloading needs inotify, files won't be watched");
+        return 0;
+#endif
+}
+
+/*
+ * stop watching everything and free any changes never applied
+ */
+void reload_quit(void)
+{
+        if (rl.lock == NULL) {
+                return;
+        }
+
+#ifdef RELOAD_INOTIFY
+        if (rl.thread != NULL) {
+                char stop = 0;
+                if (write(rl.wake[1], &stop, 1) == 1) {
+                        SDL_WaitThread(rl.thread, NULL);
+                }
+        }
+
+        close(rl.wake[0]);
+        close(rl.wake[1]);
+        close(rl.fd);
+#endif
+
+        for (int i = 0; i < RELOAD_MAX_WATCHES; i++) {
+                if (rl.watches[i].id != 0 && rl.watches[i].ready) {
+                        texture_destroy(&rl.watches[i].next);
+                }
+        }
+
+        SDL_DestroyMutex(rl.lock);
+        memset(&rl, 0, sizeof(rl));
+}
+
+/*
+ * add a watch of either kind, returns its id or 0
+ */
+static int _watch(const char *filename, struct texture *tex, struct atlas *a,
+                  int handle, struct color *trans)
+{
+#ifdef RELOAD_INOTIFY
+        if (rl.thread == NULL || strlen(filename) >= RELOAD_PATH_SIZE) {
+                return 0;
+        }
+
+        // the directory is watched rather than the file, a file replaced by
+        // renaming another over it is a new file the old watch never sees
+        char dir[RELOAD_PATH_SIZE] = ".";
+        const char *name = filename;
+        const char *slash = strrchr(filename, '/');
+        if (slash != NULL) {
+                int len = (slash == filename) ? 1 : slash - filename;
+                memcpy(dir, filename, len);
+                dir[len] = '\0';
+                name = slash + 1;
+        }
+
+        int wd = inotify_add_watch(rl.fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (wd < 0) {
+                fprintf(stderr, "%s: %s\n", dir, strerror(errno));
+                return 0;
+        }
+
+        SDL_LockMutex(rl.lock);
+        struct reload_watch *w = NULL;
+        for (int i = 0; i < RELOAD_MAX_WATCHES && w == NULL; i++) {
+                if (rl.watches[i].id == 0) {
+                        w = &rl.watches[i];
+                }
+        }
+
+        int id = 0;
+        if (w != NULL) {
+                memset(w, 0, sizeof(*w));
+                memcpy(w->filename, filename, strlen(filename) + 1);
+                w->name = w->filename + (name - filename);
+                w->wd = wd;
+                w->tex = tex;
+                w->atlas = a;
+                w->handle = handle;
+                w->has_trans = (trans != NULL);
+                if (trans != NULL) {
+                        w->trans = *trans;
+                }
+                w->id = id = ++rl.next_id;
+        }
+        SDL_UnlockMutex(rl.lock);
+
+        if (id == 0) {
+                log_wrn("Unable to watch %s, too many watches", filename);
+        }
+
+        return id;
+#else
+        return 0;
+#endif
+}
+
+/*
+ * replace *tex with the image in filename whenever the file changes, freeing
+ * the texture it replaces. Pixels matching trans are transparent (none are if
+ * trans is NULL). Returns an id for reload_unwatch, 0 if the file can't be
+ * watched
+ */
+int reload_watch_texture(const char *filename, struct texture *tex,
+                         struct color *trans)
+{
+        return _watch(filename, tex, NULL, -1, trans);
+}
+
+/*
+ * replace the sprite handle of an atlas with the image in filename whenever
+ * the file changes, as reload_watch_texture
+ */
+int reload_watch_atlas(const char *filename, struct atlas *a, int handle,
+                       struct color *trans)
+{
+        return _watch(filename, NULL, a, handle, trans);
+}
+
+/*
+ * stop reloading a texture or sprite, anything converted for it and not yet
+ * applied is dropped
+ */
+void reload_unwatch(int id)
+{
+        if (rl.lock == NULL || id <= 0) {
+                return;
+        }
+
+        SDL_LockMutex(rl.lock);
+        for (int i = 0; i < RELOAD_MAX_WATCHES; i++) {
+                struct reload_watch *w = &rl.watches[i];
+                if (w->id == id) {
+                        if (w->ready) {
+                                texture_destroy(&w->next);
+                        }
+                        w->id = 0;
+                        w->ready = 0;
+                }
+        }
+        SDL_UnlockMutex(rl.lock);
+}
+
+/*
+ * swap in everything converted since the last call, returns the number of
+ * textures and sprites replaced. Call once a frame, between drawing
+ */
+int reload_apply(void)
+{
+        if (rl.lock == NULL) {
+                return 0;
+        }
+
+        int applied = 0;
+
+        SDL_LockMutex(rl.lock);
+        for (int i = 0; i < RELOAD_MAX_WATCHES; i++) {
+                struct reload_watch *w = &rl.watches[i];
+                if (w->id == 0 || !w->ready) {
+                        continue;
+                }
+
+                w->ready = 0;
+                if (w->tex != NULL) {
+                        struct texture old = *w->tex;
+                        *w->tex = w->next;
+                        texture_destroy(&old);
+                        applied++;
+                        continue;
+                }
+
+                if (atlas_replace_texture(w->atlas, w->handle, w->next)) {
+                        applied++;
+                } else {
+                        log_wrn("%s no longer fits its atlas", w->filename);
+                        rl.failed++;
+                }
+                texture_destroy(&w->next);
+        }
+        SDL_UnlockMutex(rl.lock);
+
+        return applied;
+}
+
+/*
+ * return the number of changed files that couldn't be read, or whose sprite
+ * didn't fit back in its atlas
+ */
+int reload_failed(void)
+{
+        if (rl.lock == NULL) {
+                return rl.failed;
+        }
+
+        SDL_LockMutex(rl.lock);
+        int failed = rl.failed;
+        SDL_UnlockMutex(rl.lock);
+
+        return failed;
+}
@@ -0,0 +1,203 @@
+#include <stdio.h>
+#include <stddef.h>
+
+#include <smallengine/graphics/rle.h>
+#include <smallengine/graphics/canvas.h>
+#include <smallengine/graphics/color.h>
+#include <smallengine/graphics/palette.h>
+#include <smallengine/graphics/texture.h>
+
+#include <smallengine/sys/mem.h>
+
+/*
+ * what a sprite is compiled from, either a texture's mask and palette or a
+ * canvas and its transparent color
+ */
+struct rle_source {
+        int w;
+        int h;
+        const int *mask;                // NULL for a canvas
+        struct palette palette;
+        const struct color *pixels;
+        const struct color *trans;
+        enum color_space space;
+};
+
+static int _opaque(const struct rle_source *src, int i)
+{
+        if (src->mask != NULL) {
+                return src->mask[i] >= 0;
+        }
+
+        return src->trans == NULL || !color_equal(src->pixels[i], *src->trans);
+}
+
+static struct color _color(const struct rle_source *src, int i)
+{
+        if (src->mask != NULL) {
+                return palette_get_by_index(src->palette, src->mask[i]);
+        }
+
+        return src->pixels[i];
+}
+
+/*
+ * the spans are counted first so everything is allocated once, then filled
+ */
+static struct rle_sprite _compile(const struct rle_source *src)
+{
+        struct rle_sprite s = {src->w, src->h, NULL, NULL, NULL, src->space};
+        int spans = 0, opaque = 0;
+
+        for (int i = 0; i < src->w * src->h; i++) {
+                if (_opaque(src, i)) {
+                        opaque++;
+                        if (i % src->w == 0 || !_opaque(src, i - 1)) {
+                                spans++;
+                        }
+                }
+        }
+
+        s.rows = (struct rle_row *)mem_alloc((src->h + 1) *
+                                             sizeof(struct rle_row));
+        s.spans = (struct rle_span *)mem_alloc((spans + 1) *
+                                               sizeof(struct rle_span));
+        s.pixels = (struct color *)mem_alloc((opaque + 1) *
+                                             sizeof(struct color));
+
+        int span = 0, pixel = 0;
+        for (int y = 0; y < src->h; y++) {
+                struct rle_row row = {span, pixel};
+                s.rows[y] = row;
+
+                int x = 0, end = 0;
+                while (x < src->w) {
+                        int i = y * src->w + x;
+                        if (!_opaque(src, i)) {
+                                x++;
+                                continue;
+                        }
+
+                        struct rle_span run = {x - end, 0};
+                        while (x < src->w && _opaque(src, i)) {
+                                s.pixels[pixel++] = _color(src, i);
+                                run.len++;
+                                x++;
+                                i++;
+                        }
+                        s.spans[span++] = run;
+                        end = x;
+                }
+        }
+
+        struct rle_row last = {span, pixel};
+        s.rows[src->h] = last;
+
+        return s;
+}
+
+/*
+ * Creation and Destruction
+ */
+
+/*
+ * compile a sprite from a texture, drawing the pixels its mask marks opaque
+ */
+struct rle_sprite rle_sprite_from_texture(const struct texture tex)
+{
+        struct rle_source src = {tex.w, tex.h, tex.mask, tex.palette, NULL,
+                                 NULL, canvas_color_space(tex.canvas)};
+        return _compile(&src);
+}
+
+/*
+ * compile a sprite from a canvas, pixels matching trans are transparent
+ * (none are if trans is NULL)
+ */
+struct rle_sprite rle_sprite_from_canvas(const struct canvas c,
+                                         struct color *trans)
+{
+        struct rle_source src = {c.w, c.h, NULL, {NULL, NULL, 0, 0},
+                                 canvas_pixels(c), trans,
+                                 canvas_color_space(c)};
+        return _compile(&src);
+}
+
+/*
+ * free all memory used by a sprite
+ */
+void rle_sprite_destroy(struct rle_sprite *s)
+{
+        if (s->rows != NULL) {
+                mem_free(s->rows);
+                mem_free(s->spans);
+                mem_free(s->pixels);
+        }
+
+        s->rows = NULL;
+        s->spans = NULL;
+        s->pixels = NULL;
+        s->w = 0;
+        s->h = 0;
+}
+
+/*
+ * Operations
+ */
+
+/*
+ * return the number of opaque pixels in the sprite
+ */
+int rle_sprite_opaque(const struct rle_sprite s)
+{
+        if (s.rows == NULL) {
+                return 0;
+        }
+
+        return s.rows[s.h].pixel;
+}
+
+/*
+ * draw the whole sprite with its top left at dsx, dsy using the specified
+ * blending mode, clipped to the canvas
+ */
+void rle_sprite_blit(const struct rle_sprite s, struct canvas dst, int dsx,
+                     int dsy, enum blit_mode mode)
+{
+        int y1 = (dsy < 0) ? -dsy : 0;
+        int y2 = (dsy + s.h > dst.h) ? dst.h - dsy : s.h;
+        if (y1 >= y2 || dsx >= dst.w || dsx + s.w <= 0 ||
+            mode < 0 || mode >= NUM_BLIT_MODES) {
+                return;
+        }
+
+        struct color *pixels = canvas_pixels_writable(dst);
+        enum color_space space = canvas_color_space(dst);
+
+        for (int y = y1; y < y2; y++) {
+                struct color *out = pixels + (dsy + y) * dst.w;
+                const struct color *px = s.pixels + s.rows[y].pixel;
+                int x = dsx;
+
+                for (int k = s.rows[y].span; k < s.rows[y + 1].span; k++) {
+                        x += s.spans[k].skip;
+                        if (x >= dst.w) {
+                                break;
+                        }
+
+                        // cut the run to the part on the canvas
+                        int len = s.spans[k].len;
+                        int from = (x < 0) ? -x : 0;
+                        int to = (x + len > dst.w) ? dst.w - x : len;
+                        if (from < to) {
+                                canvas_blend_span_convert(out + x + from,
+                                                          px + from, to - from,
+                                                          mode, s.space,
+                                                          space);
+                        }
+
+                        px += len;
+                        x += len;
+                }
+        }
+}
@@ -3,13 +3,22 @@
 
 #include <smallengine/sys/mem.h>
 #include <smallengine/graphics/canvas.h>
+#include <smallengine/graphics/capture.h>
 #include <smallengine/graphics/color.h>
+#include <smallengine/graphics/indexed.h>
+#include <smallengine/graphics/palette.h>
+#include <smallengine/graphics/recorder.h>
+#include <smallengine/graphics/renderer.h>
 
 static SDL_Window *screen_window = NULL;
 static SDL_Surface *window_surface = NULL;
 static SDL_Surface *render_surface = NULL;
 static struct canvas screen_canvas;
 
+static enum renderer_mode screen_mode = RENDERER_COLOR;
+static struct indexed_texture screen_indexed = {0, 0, 0, NULL};
+static struct palette screen_palette = {NULL, NULL, 0, 0};
+
 static int window_width = 0;
 static int window_height = 0;
 
@@ -64,7 +73,7 @@ int renderer_init(char *title, int win_res_w, int win_res_h,
 
 /*
  * returns the canvas that is written to the main window so it can be
- * manipulated directly
+ * manipulated directly, the canvas is empty in RENDERER_INDEXED mode
  */
 struct canvas renderer_get_window_canvas()
 {
@@ -79,9 +88,111 @@ struct canvas renderer_new_canvas()
         return canvas(res_width, res_height);
 }
 
+/*
+ * switch what the screen is drawn to, in RENDERER_INDEXED mode the window
+ * canvas is replaced by an indexed screen (see renderer_get_indexed_screen)
+ * and the reverse. The old screen's contents are lost, returns 0 on failure
+ */
+int renderer_set_mode(enum renderer_mode mode)
+{
+        if (mode < 0 || mode >= NUM_RENDERER_MODES) {
+                return 0;
+        }
+
+        if (mode == screen_mode) {
+                return 1;
+        }
+
+        if (mode == RENDERER_INDEXED) {
+                struct indexed_texture it = {res_width, res_height, 0, NULL,
+                                             screen_palette, 0};
+                it.indices = mem_alloc(res_width * res_height);
+                screen_indexed = it;
+                indexed_texture_fill(screen_indexed, 0);
+                canvas_destroy(&screen_canvas);
+        } else {
+                indexed_texture_destroy(&screen_indexed);
+                screen_canvas = canvas(res_width, res_height);
+        }
+
+        screen_mode = mode;
+
+        return 1;
+}
+
+/*
+ * returns the mode the screen is currently drawn in
+ */
+enum renderer_mode renderer_get_mode()
+{
+        return screen_mode;
+}
+
+/*
+ * set the palette the indexed screen is shown with. The colors are only
+ * looked up when the display is updated, so fades and flashes cost nothing
+ * per pixel: change the palette's colors or set another between frames. The
+ * palette still belongs to the caller, only the first 255 colors are used
+ */
+void renderer_set_palette(const struct palette pal)
+{
+        screen_palette = pal;
+        screen_indexed.palette = pal;
+}
+
+/*
+ * returns the indexed screen so it can be drawn to directly, index
+ * INDEXED_CLEAR_8 shows as black. Only valid in RENDERER_INDEXED mode
+ */
+struct indexed_texture renderer_get_indexed_screen()
+{
+        return screen_indexed;
+}
+
+/*
+ * turn the indexed screen into packed pixels, the palette is looked up once
+ * into a table of every possible index so each pixel is a single load
+ */
+static void _present_indexed(uint32_t *pixels, int offset)
+{
+        uint32_t lut[INDEXED_CLEAR_8 + 1];
+        uint32_t black = color_to_RGBA(color_rgb(0.0, 0.0, 0.0));
+
+        for (int i = 0; i <= INDEXED_CLEAR_8; i++) {
+                lut[i] = (i < screen_palette.assigned && i != INDEXED_CLEAR_8) ?
+                         screen_palette.packed[i] : black;
+        }
+
+        const uint8_t *src = (const uint8_t *)screen_indexed.indices;
+        for (int y = 0; y < screen_indexed.h; y++) {
+                const uint8_t *row = src + y * screen_indexed.w;
+                uint32_t *out = pixels + y * offset;
+                for (int x = 0; x < screen_indexed.w; x++) {
+                        out[x] = lut[row[x]];
+                }
+        }
+}
+
+/*
+ * scale the finished frame to the window, recording it first if a recording
+ * is running
+ */
+static void _show()
+{
+        if (recorder_active()) {
+                recorder_frame(render_surface->pixels, render_surface->w,
+                               render_surface->h, render_surface->pitch / 4,
+                               COLOR_RGBA);
+        }
+
+        SDL_BlitScaled(render_surface, NULL, window_surface, NULL);
+        SDL_UpdateWindowSurface(screen_window);
+}
+
 /*
  * write the contents of the screen_canvas to the window_surface and update
- * the screen to show the result
+ * the screen to show the result, which is also recorded while a recording is
+ * running (see recorder.h)
  */
 void renderer_update_display()
 {
@@ -89,17 +200,43 @@ void renderer_update_display()
         int offset = (render_surface->pitch / 4);
         uint32_t *pixels = render_surface->pixels;
 
-        int x, y;
-        for (x = 0; x < screen_canvas.w; x++) {
-                for (y = 0; y < screen_canvas.h; y++) {
-                        pixels[y*offset+x] = color_to_RGBA(
-                                             canvas_read_pixel(screen_canvas,
-                                                               x, y));
+        if (screen_mode == RENDERER_INDEXED) {
+                _present_indexed(pixels, offset);
+                _show();
+                return;
+        }
+
+        const struct color *src = canvas_pixels(screen_canvas);
+
+        int linear = (canvas_color_space(screen_canvas) == COLOR_LINEAR);
+
+        int y;
+        for (y = 0; y < screen_canvas.h; y++) {
+                if (linear) {
+                        color_span_to_srgb32(src + y * screen_canvas.w,
+                                             pixels + y * offset,
+                                             screen_canvas.w, COLOR_RGBA);
+                } else {
+                        color_span_to_rgba32(src + y * screen_canvas.w,
+                                             pixels + y * offset,
+                                             screen_canvas.w, COLOR_RGBA);
                 }
         }
 
-        SDL_BlitScaled(render_surface, NULL, window_surface, NULL);
-        SDL_UpdateWindowSurface(screen_window);
+        _show();
+}
+
+/*
+ * queue the last frame shown to be written to a bitmap file without waiting
+ * for the write (see capture.h). Returns 0 if the frame was dropped
+ */
+int renderer_capture(const char *filename)
+{
+        // the render surface still holds the frame as it was presented, so
+        // this is one copy of packed pixels whichever mode the screen is in
+        return capture_pixels(render_surface->pixels, render_surface->w,
+                              render_surface->h, render_surface->pitch / 4,
+                              COLOR_RGBA, filename);
 }
 
 /*
@@ -109,9 +246,9 @@ void renderer_quit()
 {
         SDL_DestroyWindow(screen_window);
         SDL_FreeSurface(render_surface);
-        mem_free(screen_canvas.pixels);
-        screen_canvas.w = 0;
-        screen_canvas.h = 0;
+        canvas_destroy(&screen_canvas);
+        indexed_texture_destroy(&screen_indexed);
+        screen_mode = RENDERER_COLOR;
 
         SDL_VideoQuit();
 }
@@ -1,7 +1,12 @@
+#include <stdint.h>
+#include <math.h>
+
 #include <smallengine/sys/mem.h>
 #include <smallengine/graphics/texture.h>
 #include <smallengine/graphics/canvas.h>
 #include <smallengine/graphics/color.h>
+#include <smallengine/graphics/coverage.h>
+#include <smallengine/graphics/mipmap.h>
 
 
 struct texture texture(const int width, const int height)
@@ -10,6 +15,8 @@ struct texture texture(const int width, const int height)
         struct texture t = {width, height, c, NULL};
 
         t.mask = (int *)mem_alloc(width * height * sizeof(int));
+        t.mips = mipmap_new();
+        t.coverage = coverage(width, height);
 
         return t;
 }
@@ -20,29 +27,69 @@ struct texture texture(const int width, const int height)
  */
 struct texture texture_from_canvas(const struct canvas c, struct color *trans)
 {
-        // create the palette
-        struct palette pal = palette_from_canvas(c);
-        
-        // create the texture and space for the mask
-        struct texture tex = {c.w, c.h, c, NULL, pal};
+        // create the texture and space for the mask, the texture keeps its
+        // own copy of the canvas which costs nothing until one is modified
+        struct texture tex = {c.w, c.h, canvas_copy(c), NULL};
         tex.mask = (int *)mem_alloc(c.w * c.h * sizeof(int));
-        
-        for (int i = 0; i < c.w * c.h; i++) {
-                struct color col = c.pixels[i];
-                // check transparancy
-                if (color_equal(col, *trans)) {
-                        tex.mask[i] = -1;
-                        continue;
+        tex.mips = mipmap_new();
+
+        // the palette and the mask are made together
+        tex.palette = palette_from_canvas_indexed(c, tex.mask);
+
+        if (trans != NULL) {
+                // mark the palette entries matching the transparent color,
+                // then clear the pixels using them
+                uint8_t *clear = (uint8_t *)mem_alloc(tex.palette.assigned +
+                                                      1);
+                for (int i = 0; i < tex.palette.assigned; i++) {
+                        clear[i] = color_equal(palette_get_by_index(
+                                                tex.palette, i), *trans);
+                }
+
+                for (int i = 0; i < c.w * c.h; i++) {
+                        if (clear[tex.mask[i]]) {
+                                tex.mask[i] = -1;
+                        }
                 }
-                
-                // this will automatically set any colors not found in the
-                // palette to transparent
-                tex.mask[i] = palette_check_color(tex.palette, col);
+
+                mem_free(clear);
         }
 
+        tex.coverage = coverage_from_mask(tex.mask, c.w, c.h);
+
         return tex;
 }
 
+/*
+ * free all memory used by a texture: its canvas, mask, palette, coverage and
+ * reduced copies. A borrowed texture only frees what it made itself
+ */
+void texture_destroy(struct texture *tex)
+{
+        // a borrowed canvas is made over pixels it doesn't own, so it can
+        // always be destroyed
+        canvas_destroy(&tex->canvas);
+
+        if (!tex->borrowed) {
+                coverage_destroy(&tex->coverage);
+                if (tex->palette.colors != NULL) {
+                        palette_destroy(&tex->palette);
+                }
+                if (tex->mask != NULL) {
+                        mem_free(tex->mask);
+                }
+        }
+
+        if (tex->mips != NULL) {
+                mipmap_destroy(tex->mips);
+        }
+
+        tex->mask = NULL;
+        tex->mips = NULL;
+        tex->w = 0;
+        tex->h = 0;
+}
+
 /*
  * return the value of the mask (palette color index) at the given coordinate
  * a negative value indicates the pixel is transparent
@@ -65,52 +112,62 @@ struct color texture_read_pixel(struct texture tex, int x, int y)
 }
 
 /*
- * clip the boundary for blits on x axis
+ * return 1 if the pixel at the given coordinate is drawn, 0 if it is
+ * transparent or outside the texture
  */
-static int _clip_blit_x(struct texture src, int srx1, int srx2,
-                        struct canvas dst, int dsx)
+int texture_hit(const struct texture tex, int x, int y)
 {
-        // check limits
-        if (srx1 >= src.w || dsx >= dst.w) { return 0; }
-
-        // check this doesn't over run the source canvas
-        if (srx2 >= src.w) {
-                srx2 = src.w - 1;
-        }
+        return coverage_test(tex.coverage, x, y);
+}
 
-        // get width of blit area
-        int dx = srx2 - srx1;
+/*
+ * update the coverage of an inclusive area after changing the mask directly,
+ * the reduced copies are rebuilt when next drawn
+ */
+void texture_update_coverage(struct texture tex, int x1, int y1, int x2,
+                             int y2)
+{
+        coverage_update(tex.coverage, tex.mask, x1, y1, x2, y2);
 
-        // or the destination canvas
-        if ((dsx + dx) >= dst.w) {
-                dx = dst.w - dsx;
+        // the reduced copies are made from the mask too
+        if (tex.mips != NULL) {
+                tex.mips->mask_version++;
         }
-
-        return dx;
 }
 
-static int _clip_blit_y(struct texture src, int sry1, int sry2,
-                        struct canvas dst, int dsy)
+/*
+ * clip an inclusive source area drawn at dsx, dsy against both the texture
+ * and the canvas, returns 0 if nothing is left to draw
+ */
+static int _clip_blit(struct texture src, int *srx1, int *sry1, int *srx2,
+                      int *sry2, struct canvas dst, int *dsx, int *dsy)
 {
-        // check stupid inputs
-        if (sry1 >= src.h || dsy >= dst.h) { return 0; }
-
-        if (sry2 >= src.h) {
-                sry2 = src.h - 1;
-        }
-                        
-        int dy = sry2 - sry1;
+        if (*srx1 < 0) { *dsx -= *srx1; *srx1 = 0; }
+        if (*sry1 < 0) { *dsy -= *sry1; *sry1 = 0; }
+        if (*srx2 >= src.w) { *srx2 = src.w - 1; }
+        if (*sry2 >= src.h) { *sry2 = src.h - 1; }
+        if (*dsx < 0) { *srx1 -= *dsx; *dsx = 0; }
+        if (*dsy < 0) { *sry1 -= *dsy; *dsy = 0; }
+        if (*dsx + *srx2 - *srx1 >= dst.w) { *srx2 = *srx1 + dst.w - 1 - *dsx; }
+        if (*dsy + *sry2 - *sry1 >= dst.h) { *sry2 = *sry1 + dst.h - 1 - *dsy; }
 
-        // check area is within destination bounds
-        if ((dsy + dy) >= dst.h) {
-                dy = dst.h - dsy;
-        }
+        return (*srx1 <= *srx2 && *sry1 <= *sry2);
+}
 
-        return dy;
+/*
+ * the palette colors converted to the color space of dst if the texture's
+ * canvas is in another, NULL if they can be drawn as they are
+ */
+static struct color *_draw_colors(struct texture tex, struct canvas dst)
+{
+        return palette_convert_colors(tex.palette,
+                                      canvas_color_space(tex.canvas),
+                                      canvas_color_space(dst));
 }
 
 /*
- * blit an area of a texture to a canvas using the specified blending mode
+ * blit an area of a texture to a canvas using the specified blending mode,
+ * only the opaque runs found in the coverage are visited
  * int srx1: start of blit area x-coord on source
  * int srx2: end of blit area x-coord on source
  * int sry1, sry2: as srx1 and srx2 but for the y coords
@@ -120,22 +177,232 @@ void texture_blit_to_canvas(struct texture tex, int srx1, int sry1, int srx2,
                             int sry2, struct canvas dst, int dsx, int dsy, 
                             enum blit_mode mode)
 {
-        int dx = _clip_blit_x(tex, srx1, srx2, dst, dsx);
-        int dy = _clip_blit_y(tex, sry1, sry2, dst, dsy);
+        if (mode < 0 || mode >= NUM_BLIT_MODES ||
+            !_clip_blit(tex, &srx1, &sry1, &srx2, &sry2, dst, &dsx, &dsy)) {
+                return;
+        }
 
-        int x, y;
-        for (x = 0; x <= dx; x++) {
-                for (y = 0; y <= dy; y++) {
-                        if (texture_read_mask(tex, srx1+x, sry1+y) < 0) {
-                                continue;
+        struct color *pixels = canvas_pixels_writable(dst);
+        struct color *converted = _draw_colors(tex, dst);
+        struct palette pal = tex.palette;
+        if (converted != NULL) {
+                pal.colors = converted;
+        }
+
+        for (int sy = sry1; sy <= sry2; sy++) {
+                const int *mask = tex.mask + sy * tex.w;
+                struct color *out = pixels + (dsy + sy - sry1) * dst.w +
+                                    dsx - srx1;
+                int x = srx1, start, len;
+
+                while ((len = coverage_span(tex.coverage, sy, x, srx2,
+                                            &start)) > 0) {
+                        for (int i = start; i < start + len; i++) {
+                                canvas_fill_span(&out[i],
+                                        palette_get_by_index(pal, mask[i]),
+                                        1, mode);
                         }
+                        x = start + len;
+                }
+        }
+
+        if (converted != NULL) {
+                mem_free(converted);
+        }
+}
+
+/*
+ * Scaled Drawing
+ */
+
+/*
+ * a cheap fingerprint of everything the reduced copies are made from, the
+ * palette is hashed as swapping colors doesn't touch the canvas, and mask
+ * edits are counted by texture_update_coverage
+ */
+static uint32_t _mip_version(struct texture tex)
+{
+        uint32_t hash = 2166136261u ^ canvas_version(tex.canvas);
+        hash = (hash ^ tex.mips->mask_version) * 16777619u;
+        const uint8_t *bytes = (const uint8_t *)tex.palette.colors;
+        for (int b = 0; b < tex.palette.assigned * sizeof(struct color); b++) {
+                hash = (hash ^ bytes[b]) * 16777619u;
+        }
 
-                        canvas_write_pixel(dst, dsx+x, dsy+y, 
-                                texture_read_pixel(tex, srx1+x, sry1+y), mode);
+        return hash;
+}
+
+/*
+ * return a copy of the texture reduced by 2^level in each direction, built
+ * with the given filter from the palette colours. Transparency is kept in the
+ * alpha of each pixel (colors are premultiplied, see color_rgba) and the
+ * copies are only rebuilt when the canvas or palette has changed
+ */
+struct canvas texture_mip(struct texture tex, int level, 
+                          enum mip_filter filter)
+{
+        uint32_t version = _mip_version(tex);
+        struct mipmap *mip = tex.mips;
+
+        if (!mip->built || mip->version != version || mip->filter != filter) {
+                // full size image of what the texture draws, transparent
+                // pixels have no colour and no alpha
+                struct canvas base = canvas(tex.w, tex.h);
+                struct color *pixels = canvas_pixels_writable(base);
+                struct color clear = {0.0, 0.0, 0.0, 0.0};
+
+                for (int i = 0; i < tex.w * tex.h; i++) {
+                        pixels[i] = (tex.mask[i] < 0) ? clear : 
+                                palette_get_by_index(tex.palette, tex.mask[i]);
+                }
+
+                mipmap_update(mip, base, version, filter);
+                canvas_destroy(&base);
+        }
+
+        if (level <= 0) {
+                level = 1;
+        }
+
+        return mipmap_level(mip, tex.canvas, level);
+}
+
+/*
+ * the first of n steps from u0 that reaches pos
+ */
+static int _first_step(int64_t pos, int64_t u0, int64_t step, int n)
+{
+        if (pos <= u0) {
+                return 0;
+        }
+
+        int64_t k = (pos - u0 + step - 1) / step;
+        return (k < n) ? (int)k : n;
+}
+
+/*
+ * draw the sampled pixels of row sy of a full size texture, only the opaque
+ * runs found in the coverage are visited
+ */
+static void _scaled_row(struct texture tex, struct palette pal, int sy,
+                        struct color *out, int64_t u0, int64_t step, int n,
+                        enum blit_mode mode)
+{
+        const int *mask = tex.mask + sy * tex.w;
+        int last = (int)((u0 + (n - 1) * step) >> 16);
+        int x = (int)(u0 >> 16), start, len;
+        if (x < 0) {
+                x = 0;
+        }
+        if (last >= tex.w) {
+                last = tex.w - 1;
+        }
+
+        while (x <= last &&
+               (len = coverage_span(tex.coverage, sy, x, last, &start)) > 0) {
+                int k1 = _first_step((int64_t)start << 16, u0, step, n);
+                int k2 = _first_step((int64_t)(start + len) << 16, u0, step,
+                                     n);
+                for (int k = k1; k < k2; k++) {
+                        canvas_fill_span(&out[k], palette_get_by_index(pal,
+                                         mask[(u0 + k * step) >> 16]), 1,
+                                         mode);
                 }
+                x = start + len;
         }
 }
 
-       
+/*
+ * blit an area of a texture to a differently sized area of a canvas, the
+ * coordinates are inclusive as with texture_blit_to_canvas. Areas drawn
+ * smaller than their source are read from the reduced copies of the texture,
+ * pixels less than half covered are treated as transparent
+ */
+void texture_blit_scaled(struct texture tex, int srx1, int sry1, int srx2, 
+                         int sry2, struct canvas dst, int dsx1, int dsy1, 
+                         int dsx2, int dsy2, enum blit_mode mode)
+{
+        int sw = srx2 - srx1 + 1, sh = sry2 - sry1 + 1;
+        int dw = dsx2 - dsx1 + 1, dh = dsy2 - dsy1 + 1;
+        if (sw <= 0 || sh <= 0 || dw <= 0 || dh <= 0 || tex.w <= 0 ||
+            tex.h <= 0 || mode < 0 || mode >= NUM_BLIT_MODES) {
+                return;
+        }
+
+        int level = mipmap_select_level(sw, sh, dw, dh);
+        struct canvas lvl = tex.canvas;
+        if (level > 0) {
+                lvl = texture_mip(tex, level, tex.mips->filter);
+        }
+
+        // clip the destination area, the source follows from the scaling
+        int x1 = (dsx1 < 0) ? 0 : dsx1;
+        int y1 = (dsy1 < 0) ? 0 : dsy1;
+        int x2 = (dsx2 >= dst.w) ? dst.w - 1 : dsx2;
+        int y2 = (dsy2 >= dst.h) ? dst.h - 1 : dsy2;
+        if (x1 > x2 || y1 > y2) {
+                return;
+        }
+
+        // step through the level in 16.16 fixed point, sampling pixel
+        // centres. Levels are rounded down in size, so positions are scaled
+        // to the level rather than shifted by it
+        double scale_x = (double)lvl.w / tex.w, scale_y = (double)lvl.h / tex.h;
+        double step_x = scale_x * sw / dw, step_y = scale_y * sh / dh;
+        int64_t step_u = (int64_t)(step_x * 65536.0);
+        int64_t step_v = (int64_t)(step_y * 65536.0);
+        step_u += (step_u == 0);
+        step_v += (step_v == 0);
+        int64_t u0 = (int64_t)floor((srx1 * scale_x +
+                                     (x1 - dsx1 + 0.5) * step_x) * 65536.0);
+        int64_t v = (int64_t)floor((sry1 * scale_y +
+                                    (y1 - dsy1 + 0.5) * step_y) * 65536.0);
 
+        const struct color *in = canvas_pixels(lvl);
+        struct color *pixels = canvas_pixels_writable(dst);
+        int n = x2 - x1 + 1;
 
+        // full size draws convert the palette once, reduced levels convert
+        // each pixel drawn
+        enum color_space from = canvas_color_space(tex.canvas);
+        enum color_space to = canvas_color_space(dst);
+        struct color *converted = NULL;
+        struct palette pal = tex.palette;
+        if (level == 0 && (converted = _draw_colors(tex, dst)) != NULL) {
+                pal.colors = converted;
+        }
+
+        for (int y = y1; y <= y2; y++, v += step_v) {
+                int ly = (int)(v >> 16);
+                if (ly < 0 || ly >= lvl.h) {
+                        continue;
+                }
+
+                struct color *out = pixels + y * dst.w + x1;
+                if (level == 0) {
+                        _scaled_row(tex, pal, ly, out, u0, step_u, n, mode);
+                        continue;
+                }
+
+                const struct color *row = in + ly * lvl.w;
+                int64_t u = u0;
+                for (int k = 0; k < n; k++, u += step_u) {
+                        int lx = (int)(u >> 16);
+                        if (lx < 0 || lx >= lvl.w || row[lx].a < 0.5) {
+                                continue;
+                        }
+
+                        // undo the premultiplied coverage
+                        struct color col = color_scale(row[lx],
+                                                       1.0 / row[lx].a);
+                        if (from != to) {
+                                col = color_convert(col, from, to);
+                        }
+                        canvas_fill_span(&out[k], col, 1, mode);
+                }
+        }
+
+        if (converted != NULL) {
+                mem_free(converted);
+        }
+}
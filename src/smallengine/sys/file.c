@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define FILE_MMAP
+#endif
+
+#include <smallengine/sys/file.h>
+#include <smallengine/sys/mem.h>
+
+/*
+ * read the whole file into memory, for systems or files that can't be mapped
+ */
+static struct file_map _read_file(const char *filename)
+{
+        struct file_map map = {NULL, 0, 0};
+
+        FILE *file = fopen(filename, "rb");
+        if (file == NULL) {
+                fprintf(stderr, "%s: %s\n", filename, strerror(errno));
+                return map;
+        }
+
+        long size = -1;
+        if (fseek(file, 0, SEEK_END) == 0) {
+                size = ftell(file);
+                rewind(file);
+        }
+
+        if (size > 0) {
+                uint8_t *data = (uint8_t *)mem_alloc(size);
+                if (fread(data, 1, size, file) == (size_t)size) {
+                        map.data = data;
+                        map.size = size;
+                } else {
+                        fprintf(stderr, "%s: unable to read\n", filename);
+                        mem_free(data);
+                }
+        }
+
+        fclose(file);
+        return map;
+}
+
+static struct file_map _map(const char *filename, int writable)
+{
+#ifdef FILE_MMAP
+        struct file_map map = {NULL, 0, 1};
+        int prot = writable ? (PROT_READ | PROT_WRITE) : PROT_READ;
+
+        int fd = open(filename, O_RDONLY);
+        if (fd < 0) {
+                fprintf(stderr, "%s: %s\n", filename, strerror(errno));
+                return map;
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+                void *data = mmap(NULL, st.st_size, prot, MAP_PRIVATE, fd,
+                                  0);
+                if (data != MAP_FAILED) {
+                        map.data = (const uint8_t *)data;
+                        map.size = st.st_size;
+                }
+        }
+
+        // the mapping stays valid once the file is closed
+        close(fd);
+
+        if (map.data != NULL) {
+                return map;
+        }
+#endif
+        return _read_file(filename);
+}
+
+/*
+ * map a file for reading, data is NULL if it can't be opened or is empty
+ */
+struct file_map file_map(const char *filename)
+{
+        return _map(filename, 0);
+}
+
+/*
+ * map a file as file_map, the contents can also be written to but the
+ * changes are private to the program and never reach the file. Pages are
+ * only copied when they are first written
+ */
+struct file_map file_map_writable(const char *filename)
+{
+        return _map(filename, 1);
+}
+
+/*
+ * release a file mapped with file_map
+ */
+void file_unmap(struct file_map *map)
+{
+        if (map->data != NULL) {
+#ifdef FILE_MMAP
+                if (map->mapped) {
+                        munmap((void *)map->data, map->size);
+                } else {
+                        mem_free((void *)map->data);
+                }
+#else
+                mem_free((void *)map->data);
+#endif
+        }
+
+        map->data = NULL;
+        map->size = 0;
+        map->mapped = 0;
+}
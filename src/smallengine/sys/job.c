@@ -0,0 +1,197 @@
+#include <stdio.h>
+
+#include <SDL2/SDL.h>
+
+#include <smallengine/sys/job.h>
+#include <smallengine/sys/log.h>
+
+#define JOB_MAX_WORKERS 64
+
+/*
+ * only one batch runs at a time, started by job_parallel_for() and shared
+ * by all of the workers
+ */
+static struct {
+        SDL_Thread *threads[JOB_MAX_WORKERS];
+        int workers;
+
+        SDL_mutex *lock;
+        SDL_cond *wake;         // workers wait here for a new batch
+        SDL_cond *idle;         // caller waits here for workers to finish
+        int generation;         // incremented for every new batch
+        int busy;               // workers still working on the batch
+        int active;             // a batch is running
+        int quit;
+
+        job_func fn;
+        void *data;
+        int count;
+        SDL_atomic_t next;      // next index to be handed out
+} pool;
+
+/*
+ * take indices from the current batch until there are none left
+ */
+static void _run_batch(job_func fn, void *data, int count)
+{
+        int i;
+        while ((i = SDL_AtomicAdd(&pool.next, 1)) < count) {
+                fn(data, i);
+        }
+}
+
+static int _worker(void *unused)
+{
+        SDL_LockMutex(pool.lock);
+        int seen = pool.generation;
+
+        while (1) {
+                while (pool.generation == seen && !pool.quit) {
+                        SDL_CondWait(pool.wake, pool.lock);
+                }
+
+                if (pool.quit) {
+                        break;
+                }
+
+                // a batch that finished before this worker woke is gone, its
+                // fn and data may no longer be valid
+                seen = pool.generation;
+                if (!pool.active) {
+                        continue;
+                }
+
+                job_func fn = pool.fn;
+                void *data = pool.data;
+                int count = pool.count;
+                pool.busy++;
+                SDL_UnlockMutex(pool.lock);
+
+                _run_batch(fn, data, count);
+
+                SDL_LockMutex(pool.lock);
+                if (--pool.busy == 0) {
+                        SDL_CondSignal(pool.idle);
+                }
+        }
+
+        SDL_UnlockMutex(pool.lock);
+        return 0;
+}
+
+/*
+ * start the worker threads, passing 0 uses one thread per cpu core besides
+ * the calling thread, returns the number of workers started
+ */
+int job_init(int workers)
+{
+        if (pool.workers > 0) {
+                return pool.workers;
+        }
+
+        if (workers <= 0) {
+                workers = SDL_GetCPUCount() - 1;
+        }
+
+        if (workers > JOB_MAX_WORKERS) {
+                workers = JOB_MAX_WORKERS;
+        }
+
+        pool.lock = SDL_CreateMutex();
+        pool.wake = SDL_CreateCond();
+        pool.idle = SDL_CreateCond();
+        pool.quit = 0;
+
+        int i;
+        for (i = 0; i < workers; i++) {
+                pool.threads[i] = SDL_CreateThread(_worker, "job", NULL);
+                if (pool.threads[i] == NULL) {
+                        log_wrn("Unable to create worker: %s", SDL_GetError());
+                        break;
+                }
+        }
+
+        pool.workers = i;
+        return pool.workers;
+}
+
+/*
+ * stop and clean up all worker threads
+ */
+void job_quit(void)
+{
+        if (pool.lock == NULL) {
+                return;
+        }
+
+        SDL_LockMutex(pool.lock);
+        pool.quit = 1;
+        SDL_CondBroadcast(pool.wake);
+        SDL_UnlockMutex(pool.lock);
+
+        for (int i = 0; i < pool.workers; i++) {
+                SDL_WaitThread(pool.threads[i], NULL);
+        }
+
+        SDL_DestroyCond(pool.idle);
+        SDL_DestroyCond(pool.wake);
+        SDL_DestroyMutex(pool.lock);
+
+        pool.lock = NULL;
+        pool.workers = 0;
+}
+
+/*
+ * return the number of worker threads running
+ */
+int job_workers(void)
+{
+        return pool.workers;
+}
+
+/*
+ * call fn(data, i) for every i from 0 to count - 1, spread across the worker
+ * threads, returns once every call has finished
+ */
+void job_parallel_for(int count, job_func fn, void *data)
+{
+        if (count <= 0) {
+                return;
+        }
+
+        // no workers, a single item or a job starting more jobs. The batch
+        // is set up in the same lock as it is marked active, so a worker
+        // that sees it active always sees its fn, data and count
+        int serial = (pool.workers == 0 || count == 1);
+        if (!serial) {
+                SDL_LockMutex(pool.lock);
+                serial = pool.active;
+                if (!serial) {
+                        pool.active = 1;
+                        pool.fn = fn;
+                        pool.data = data;
+                        pool.count = count;
+                        SDL_AtomicSet(&pool.next, 0);
+                        pool.generation++;
+                        SDL_CondBroadcast(pool.wake);
+                }
+                SDL_UnlockMutex(pool.lock);
+        }
+
+        if (serial) {
+                for (int i = 0; i < count; i++) {
+                        fn(data, i);
+                }
+                return;
+        }
+
+        _run_batch(fn, data, count);
+
+        // wait for workers to finish any indices they are still holding
+        SDL_LockMutex(pool.lock);
+        while (pool.busy > 0) {
+                SDL_CondWait(pool.idle, pool.lock);
+        }
+        pool.active = 0;
+        SDL_UnlockMutex(pool.lock);
+}
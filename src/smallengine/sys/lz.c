@@ -0,0 +1,566 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include <SDL2/SDL.h>
+
+#include <smallengine/sys/lz.h>
+#include <smallengine/sys/file.h>
+#include <smallengine/sys/job.h>
+#include <smallengine/sys/mem.h>
+
+/*
+ * A block is a list of sequences, each a token byte, the number of literals,
+ * the literals, a 2 byte offset back to copy from and the copy length. The
+ * token's top 4 bits are the literal count and the bottom 4 the copy length
+ * less LZ_MIN_MATCH, 15 in either means more bytes of length follow, added
+ * up until one isn't 255. The last sequence is only literals.
+ *
+ * As in LZ4 the last LZ_LAST_LITERALS bytes are always literals and no copy
+ * starts within LZ_MATCH_LIMIT bytes of the end, which other LZ4 decoders
+ * rely on to copy in whole words
+ */
+#define LZ_MIN_MATCH 4
+#define LZ_LAST_LITERALS 5
+#define LZ_MATCH_LIMIT 12
+#define LZ_MAX_OFFSET 65535
+#define LZ_HASH_LOG 12
+#define LZ_SKIP_TRIGGER 6               // misses before searching faster
+
+static inline uint32_t _read32(const uint8_t *p)
+{
+        uint32_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+}
+
+static inline uint64_t _read64(const uint8_t *p)
+{
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+}
+
+/*
+ * little endian values in the frame header
+ */
+static void _put32(uint8_t *p, uint32_t v)
+{
+        p[0] = v;
+        p[1] = v >> 8;
+        p[2] = v >> 16;
+        p[3] = v >> 24;
+}
+
+static uint32_t _get32(const uint8_t *p)
+{
+        return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 |
+               (uint32_t)p[3] << 24;
+}
+
+static inline uint32_t _hash(uint32_t seq)
+{
+        return (seq * 2654435761u) >> (32 - LZ_HASH_LOG);
+}
+
+/*
+ * the number of bytes from a and b that are the same, up to limit
+ */
+static inline size_t _common(const uint8_t *a, const uint8_t *b,
+                             const uint8_t *limit)
+{
+        const uint8_t *start = a;
+
+#if defined(__GNUC__) && SDL_BYTEORDER == SDL_LIL_ENDIAN
+        while (a + 8 <= limit) {
+                uint64_t diff = _read64(a) ^ _read64(b);
+                if (diff != 0) {
+                        return a - start + (__builtin_ctzll(diff) >> 3);
+                }
+                a += 8;
+                b += 8;
+        }
+#endif
+        while (a < limit && *a == *b) {
+                a++;
+                b++;
+        }
+
+        return a - start;
+}
+
+/*
+ * write the bytes following a length of 15 or more in a token
+ */
+static inline uint8_t *_write_length(uint8_t *op, size_t len)
+{
+        while (len >= 255) {
+                *op++ = 255;
+                len -= 255;
+        }
+        *op++ = (uint8_t)len;
+
+        return op;
+}
+
+/*
+ * write a sequence of literals followed by a copy, the copy is left out
+ * when match_len is 0
+ */
+static inline uint8_t *_write_sequence(uint8_t *op, const uint8_t *literals,
+                                       size_t lit_len, size_t offset,
+                                       size_t match_len)
+{
+        uint8_t *token = op++;
+
+        *token = (lit_len >= 15 ? 15 : lit_len) << 4;
+        if (lit_len >= 15) {
+                op = _write_length(op, lit_len - 15);
+        }
+        memcpy(op, literals, lit_len);
+        op += lit_len;
+
+        if (match_len > 0) {
+                size_t len = match_len - LZ_MIN_MATCH;
+                *op++ = offset & 0xff;
+                *op++ = offset >> 8;
+                *token |= (len >= 15 ? 15 : len);
+                if (len >= 15) {
+                        op = _write_length(op, len - 15);
+                }
+        }
+
+        return op;
+}
+
+/*
+ * return the most a block of size bytes can compress to
+ */
+size_t lz_bound(size_t size)
+{
+        return size + size / 255 + 16;
+}
+
+/*
+ * compress size bytes into dst, which must have room for lz_bound(size)
+ * bytes. Returns the compressed size, which may be larger than size for data
+ * that doesn't compress
+ */
+size_t lz_compress(const uint8_t *src, size_t size, uint8_t *dst)
+{
+        // positions from src of the last place each hash of 4 bytes was
+        // seen, kept small enough for a worker's stack
+        uint32_t table[1 << LZ_HASH_LOG];
+        const uint8_t *end = src + size;
+        const uint8_t *anchor = src;    // the first byte not yet written
+        uint8_t *op = dst;
+
+        memset(table, 0, sizeof(table));
+
+        if (size > LZ_MATCH_LIMIT) {
+                const uint8_t *match_limit = end - LZ_MATCH_LIMIT;
+                const uint8_t *ip = src + 1;
+
+                while (ip <= match_limit) {
+                        // look for an earlier copy of the next 4 bytes,
+                        // stepping further the longer nothing is found
+                        const uint8_t *ref;
+                        uint32_t misses = 1 << LZ_SKIP_TRIGGER;
+                        while (1) {
+                                uint32_t seq = _read32(ip);
+                                uint32_t h = _hash(seq);
+                                ref = src + table[h];
+                                table[h] = ip - src;
+                                if (ref < ip && ip - ref <= LZ_MAX_OFFSET &&
+                                    _read32(ref) == seq) {
+                                        break;
+                                }
+                                ip += misses++ >> LZ_SKIP_TRIGGER;
+                                if (ip > match_limit) {
+                                        goto last;
+                                }
+                        }
+
+                        while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+                                ip--;
+                                ref--;
+                        }
+
+                        size_t len = LZ_MIN_MATCH + _common(ip + LZ_MIN_MATCH,
+                                        ref + LZ_MIN_MATCH,
+                                        end - LZ_LAST_LITERALS);
+                        op = _write_sequence(op, anchor, ip - anchor,
+                                             ip - ref, len);
+
+                        ip += len;
+                        anchor = ip;
+                        if (ip <= match_limit) {
+                                table[_hash(_read32(ip - 2))] = ip - 2 - src;
+                        }
+                }
+        }
+
+last:
+        op = _write_sequence(op, anchor, end - anchor, 0, 0);
+        return op - dst;
+}
+
+/*
+ * read the bytes following a length of 15 in a token, returns 0 if the block
+ * ends first
+ */
+static inline int _read_length(const uint8_t **ip, const uint8_t *end,
+                               size_t *len)
+{
+        uint8_t b;
+        do {
+                if (*ip >= end) {
+                        return 0;
+                }
+                b = *(*ip)++;
+                *len += b;
+        } while (b == 255);
+
+        return 1;
+}
+
+/*
+ * decompress a block into dst, never writing more than capacity bytes.
+ * Returns the decompressed size, 0 if the block is corrupt or doesn't fit
+ */
+size_t lz_decompress(const uint8_t *src, size_t size, uint8_t *dst,
+                     size_t capacity)
+{
+        const uint8_t *ip = src;
+        const uint8_t *end = src + size;
+        uint8_t *op = dst;
+        uint8_t *out_end = dst + capacity;
+
+        while (ip < end) {
+                unsigned token = *ip++;
+                size_t lit_len = token >> 4;
+
+                // most sequences are a few literals and a short copy, with
+                // room on both sides they are copied in fixed sizes, the
+                // extra bytes written are overwritten later
+                if (lit_len < 15 && end - ip >= 18 && out_end - op >= 32) {
+                        memcpy(op, ip, 16);
+                        op += lit_len;
+                        ip += lit_len;
+
+                        size_t offset = ip[0] | ip[1] << 8;
+                        size_t len = token & 15;
+                        if (len < 15 && offset >= 8 &&
+                            offset <= (size_t)(op - dst)) {
+                                const uint8_t *ref = op - offset;
+                                memcpy(op, ref, 8);
+                                memcpy(op + 8, ref + 8, 8);
+                                memcpy(op + 16, ref + 16, 2);
+                                op += len + LZ_MIN_MATCH;
+                                ip += 2;
+                                continue;
+                        }
+
+                        goto copy;
+                }
+
+                if (lit_len == 15 && !_read_length(&ip, end, &lit_len)) {
+                        return 0;
+                }
+                if (lit_len > (size_t)(end - ip) ||
+                    lit_len > (size_t)(out_end - op)) {
+                        return 0;
+                }
+
+                memcpy(op, ip, lit_len);
+                op += lit_len;
+                ip += lit_len;
+
+                if (ip == end) {
+                        break;
+                }
+
+copy:
+                if (end - ip < 2) {
+                        return 0;
+                }
+                size_t offset = ip[0] | ip[1] << 8;
+                ip += 2;
+                if (offset == 0 || offset > (size_t)(op - dst)) {
+                        return 0;
+                }
+
+                size_t len = token & 15;
+                if (len == 15 && !_read_length(&ip, end, &len)) {
+                        return 0;
+                }
+                len += LZ_MIN_MATCH;
+                if (len > (size_t)(out_end - op)) {
+                        return 0;
+                }
+
+                const uint8_t *ref = op - offset;
+                if (offset >= 8 && (size_t)(out_end - op) >= len + 8) {
+                        // 8 bytes at a time, each read is already written
+                        // as the copy is at least 8 back
+                        uint8_t *stop = op + len;
+                        do {
+                                memcpy(op, ref, 8);
+                                op += 8;
+                                ref += 8;
+                        } while (op < stop);
+                        op = stop;
+                } else if (offset == 1) {
+                        memset(op, *ref, len);
+                        op += len;
+                } else if (offset >= len) {
+                        memcpy(op, ref, len);
+                        op += len;
+                } else {
+                        // a repeating pattern reads what it writes
+                        for (size_t i = 0; i < len; i++) {
+                                op[i] = ref[i];
+                        }
+                        op += len;
+                }
+        }
+
+        return op - dst;
+}
+
+/*
+ * one frame being compressed or decompressed a block per job. The blocks of
+ * a compressed frame are written stride apart and packed together after
+ */
+struct lz_job {
+        const uint8_t *src;
+        uint8_t *dst;
+        size_t size;                    // uncompressed
+        size_t stride;
+        uint32_t *stored;               // stored size of each block
+        const size_t *offsets;          // of each block in the frame
+        SDL_atomic_t failed;
+};
+
+static size_t _block_size(const struct lz_job *job, int i)
+{
+        size_t start = (size_t)i * LZ_BLOCK_SIZE;
+        size_t left = job->size - start;
+        return (left < LZ_BLOCK_SIZE) ? left : LZ_BLOCK_SIZE;
+}
+
+static void _compress_block(void *data, int i)
+{
+        struct lz_job *job = (struct lz_job *)data;
+        const uint8_t *src = job->src + (size_t)i * LZ_BLOCK_SIZE;
+        uint8_t *dst = job->dst + (size_t)i * job->stride;
+        size_t size = _block_size(job, i);
+
+        size_t stored = lz_compress(src, size, dst);
+        if (stored >= size) {
+                memcpy(dst, src, size);
+                stored = size;
+        }
+        job->stored[i] = stored;
+}
+
+static void _decompress_block(void *data, int i)
+{
+        struct lz_job *job = (struct lz_job *)data;
+        const uint8_t *src = job->src + job->offsets[i];
+        uint8_t *dst = job->dst + (size_t)i * LZ_BLOCK_SIZE;
+        size_t size = _block_size(job, i);
+
+        if (job->stored[i] == size) {
+                memcpy(dst, src, size);
+        } else if (lz_decompress(src, job->stored[i], dst, size) != size) {
+                SDL_AtomicSet(&job->failed, 1);
+        }
+}
+
+/*
+ * compress size bytes as a frame, returns the frame (free with mem_free) and
+ * its size in frame_size
+ */
+uint8_t *lz_compress_frame(const uint8_t *src, size_t size,
+                           size_t *frame_size)
+{
+        int blocks = (size + LZ_BLOCK_SIZE - 1) / LZ_BLOCK_SIZE;
+        size_t table = LZ_HEADER_SIZE + (size_t)blocks * 4;
+
+        // room for every block to be compressed where it can't overlap
+        // another, they are moved together once all are done
+        struct lz_job job;
+        job.src = src;
+        job.size = size;
+        job.stride = lz_bound(LZ_BLOCK_SIZE);
+        job.stored = (uint32_t *)mem_alloc((blocks + 1) * sizeof(uint32_t));
+
+        uint8_t *frame = (uint8_t *)mem_alloc(table + blocks * job.stride);
+        job.dst = frame + table;
+        job_parallel_for(blocks, _compress_block, &job);
+
+        memcpy(frame, LZ_MAGIC, 4);
+        _put32(frame + 4, LZ_VERSION);
+        _put32(frame + 8, LZ_BLOCK_SIZE);
+        _put32(frame + 12, blocks);
+        _put32(frame + 16, (uint64_t)size & 0xffffffff);
+        _put32(frame + 20, (uint64_t)size >> 32);
+
+        size_t at = table;
+        for (int i = 0; i < blocks; i++) {
+                _put32(frame + LZ_HEADER_SIZE + i * 4, job.stored[i]);
+                memmove(frame + at, job.dst + (size_t)i * job.stride,
+                        job.stored[i]);
+                at += job.stored[i];
+        }
+
+        mem_free(job.stored);
+        *frame_size = at;
+        return frame;
+}
+
+/*
+ * check a frame header and that the blocks it lists are all there, returns 1
+ * and the decompressed size and number of blocks if it is a frame
+ */
+static int _frame_check(const uint8_t *frame, size_t size, size_t *raw,
+                        int *blocks)
+{
+        if (size < LZ_HEADER_SIZE || memcmp(frame, LZ_MAGIC, 4) != 0 ||
+            _get32(frame + 4) != LZ_VERSION ||
+            _get32(frame + 8) != LZ_BLOCK_SIZE) {
+                return 0;
+        }
+
+        uint64_t count = _get32(frame + 12);
+        uint64_t total = _get32(frame + 16) |
+                         (uint64_t)_get32(frame + 20) << 32;
+
+        if (count != (total + LZ_BLOCK_SIZE - 1) / LZ_BLOCK_SIZE ||
+            count > (size - LZ_HEADER_SIZE) / 4 || (size_t)total != total) {
+                return 0;
+        }
+
+        uint64_t stored = LZ_HEADER_SIZE + count * 4;
+        for (uint64_t i = 0; i < count; i++) {
+                stored += _get32(frame + LZ_HEADER_SIZE + i * 4);
+        }
+        if (stored != size) {
+                return 0;
+        }
+
+        *raw = total;
+        *blocks = count;
+        return 1;
+}
+
+/*
+ * return the decompressed size of a frame, 0 if it isn't a frame (or is an
+ * empty one)
+ */
+size_t lz_frame_size(const uint8_t *frame, size_t size)
+{
+        size_t raw = 0;
+        int blocks;
+        _frame_check(frame, size, &raw, &blocks);
+        return raw;
+}
+
+/*
+ * decompress a frame into dst, which has room for capacity bytes. Returns 1
+ * on success, 0 if the frame is corrupt or doesn't fit
+ */
+int lz_decompress_frame(const uint8_t *frame, size_t size, uint8_t *dst,
+                        size_t capacity)
+{
+        size_t raw;
+        int blocks;
+        if (!_frame_check(frame, size, &raw, &blocks) || raw > capacity) {
+                return 0;
+        }
+
+        struct lz_job job;
+        job.src = frame;
+        job.dst = dst;
+        job.size = raw;
+        job.stored = (uint32_t *)mem_alloc((blocks + 1) * sizeof(uint32_t));
+        size_t *offsets = (size_t *)mem_alloc((blocks + 1) * sizeof(size_t));
+        job.offsets = offsets;
+        SDL_AtomicSet(&job.failed, 0);
+
+        size_t at = LZ_HEADER_SIZE + (size_t)blocks * 4;
+        for (int i = 0; i < blocks; i++) {
+                job.stored[i] = _get32(frame + LZ_HEADER_SIZE + i * 4);
+                offsets[i] = at;
+                at += job.stored[i];
+        }
+
+        job_parallel_for(blocks, _decompress_block, &job);
+
+        mem_free(offsets);
+        mem_free(job.stored);
+
+        return !SDL_AtomicGet(&job.failed);
+}
+
+/*
+ * compress data to a new file as one frame, returns 1 on success, 0 on
+ * failure
+ */
+int lz_write_file(const char *filename, const void *data, size_t size)
+{
+        FILE *file = fopen(filename, "wb");
+        if (file == NULL) {
+                fprintf(stderr, "%s: %s\n", filename, strerror(errno));
+                return 0;
+        }
+
+        size_t frame_size;
+        uint8_t *frame = lz_compress_frame(data, size, &frame_size);
+
+        int ok = (fwrite(frame, 1, frame_size, file) == frame_size);
+        ok = (fclose(file) == 0) && ok;
+        mem_free(frame);
+
+        if (!ok) {
+                fprintf(stderr, "Unable to write %s\n", filename);
+        }
+
+        return ok;
+}
+
+/*
+ * map a file as file_map/file_map_writable, if it holds a frame it is
+ * decompressed into memory instead and what's returned is the original
+ * contents. Either way it is released with file_unmap
+ */
+struct file_map lz_map_file(const char *filename, int writable)
+{
+        struct file_map map = writable ? file_map_writable(filename) :
+                                         file_map(filename);
+
+        if (map.data == NULL || map.size < LZ_HEADER_SIZE ||
+            memcmp(map.data, LZ_MAGIC, 4) != 0) {
+                return map;
+        }
+
+        struct file_map raw = {NULL, 0, 0};
+        size_t size = lz_frame_size(map.data, map.size);
+        if (size > 0) {
+                raw.data = (const uint8_t *)mem_alloc(size);
+                raw.size = size;
+                if (!lz_decompress_frame(map.data, map.size,
+                                         (uint8_t *)raw.data, size)) {
+                        file_unmap(&raw);
+                }
+        }
+
+        if (raw.data == NULL) {
+                fprintf(stderr, "%s: corrupt compressed file\n", filename);
+        }
+
+        file_unmap(&map);
+        return raw;
+}
@@ -4,6 +4,8 @@
 #include <string.h>     // strerror
 #include <errno.h>
 
+#include <SDL2/SDL.h>
+
 #include <smallengine/sys/mem.h>
 #include <smallengine/sys/log.h>
 
@@ -29,6 +31,10 @@ struct mem_heap {
 
 static struct mem_heap *memory = NULL;
 
+// allocation is rare enough next to everything else that one lock around the
+// whole heap lets background threads (see loader.h) allocate safely
+static SDL_SpinLock lock = 0;
+
 /*
  * Allocates memory, aborts program if unsuccessful
  */
@@ -125,10 +131,7 @@ int mem_valid()
 
         return valid;
 }
-/*
- * Request a portion of memory (replacement for malloc)
- */
-void *mem_alloc(size_t size)
+static void *_alloc(size_t size)
 {
         // consider checking if memory has been initialised and returning an error
         // or calling malloc (_checked_malloc) instead, would also need to check
@@ -172,9 +175,18 @@ void *mem_alloc(size_t size)
 }
 
 /*
- * Free a previously requested portion of memory to allow it to be reallocated
+ * Request a portion of memory (replacement for malloc)
  */
-void mem_free(void *ptr)
+void *mem_alloc(size_t size)
+{
+        SDL_AtomicLock(&lock);
+        void *ptr = _alloc(size);
+        SDL_AtomicUnlock(&lock);
+
+        return ptr;
+}
+
+static void _free(void *ptr)
 {
         // ptr points at memory immeditately after sector header, this
         // gets us to the start of the sector header itself
@@ -236,6 +248,16 @@ void mem_free(void *ptr)
         return;
 }
 
+/*
+ * Free a previously requested portion of memory to allow it to be reallocated
+ */
+void mem_free(void *ptr)
+{
+        SDL_AtomicLock(&lock);
+        _free(ptr);
+        SDL_AtomicUnlock(&lock);
+}
+
 
 /*
  * reports how much memory is being used in total by the program
@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include <smallengine/sys/mem.h>
+#include <smallengine/graphics/atlas.h>
+#include <smallengine/graphics/texture.h>
+#include <smallengine/graphics/palette.h>
+#include <smallengine/graphics/canvas.h>
+#include <smallengine/graphics/color.h>
+
+/*
+ * a sprite of a few colors with a transparent white corner
+ */
+static struct canvas _sprite(int w, int h, int seed)
+{
+        struct canvas c = canvas(w, h);
+        for (int y = 0; y < h; y++) {
+                for (int x = 0; x < w; x++) {
+                        int k = (x + y + seed) % 6;
+                        canvas_write_pixel(c, x, y, color_rgb_int(k * 40,
+                                           seed * 10, 100), BLIT_ABS);
+                }
+        }
+        canvas_write_pixel(c, 0, 0, color_rgb(1.0, 1.0, 1.0), BLIT_ABS);
+        return c;
+}
+
+static int _overlap(struct atlas_rect a, struct atlas_rect b)
+{
+        return a.x < b.x + b.w && b.x < a.x + a.w &&
+               a.y < b.y + b.h && b.y < a.y + a.h;
+}
+
+/*
+ * check every sprite lies within the atlas, apart from the others, and draws
+ * the same as its source
+ */
+static void _check(struct atlas a, int *handles, struct canvas *sprites,
+                   int n)
+{
+        struct color white = color_rgb(1.0, 1.0, 1.0);
+
+        for (int i = 0; i < n; i++) {
+                if (handles[i] < 0) {
+                        continue;
+                }
+
+                struct atlas_rect r = atlas_get_rect(a, handles[i]);
+                assert(r.w == sprites[i].w && r.h == sprites[i].h);
+                assert(r.x >= 0 && r.y >= 0);
+                assert(r.x + r.w <= a.tex.w && r.y + r.h <= a.tex.h);
+
+                for (int j = 0; j < i; j++) {
+                        if (handles[j] >= 0) {
+                                assert(!_overlap(r, atlas_get_rect(a,
+                                                         handles[j])));
+                        }
+                }
+
+                struct canvas out = canvas(r.w, r.h);
+                canvas_fill(out, color_rgb(0.0, 1.0, 0.0));
+                atlas_blit(a, handles[i], out, 0, 0, BLIT_ABS);
+
+                assert(color_equal(canvas_read_pixel(out, 0, 0),
+                                   color_rgb(0.0, 1.0, 0.0)));
+                assert(texture_read_mask(a.tex, r.x, r.y) < 0);
+                for (int y = 0; y < r.h; y++) {
+                        for (int x = (y == 0); x < r.w; x++) {
+                                struct color want = canvas_read_pixel(
+                                                sprites[i], x, y);
+                                assert(!color_equal(want, white));
+                                assert(color_equal(canvas_read_pixel(out, x,
+                                                                     y), want));
+                        }
+                }
+
+                canvas_destroy(&out);
+        }
+}
+
+void TST_AtlasAdd()
+{
+        struct color white = color_rgb(1.0, 1.0, 1.0);
+        struct atlas a = atlas(64, 64, 256, 1);
+        assert(a.tex.w == 64 && a.tex.h == 64);
+        assert(a.count == 0);
+
+        // sprites of mixed sizes, added one at a time until one doesn't fit
+        srand(5);
+        struct canvas sprites[40];
+        int handles[40];
+        int added = 0;
+        for (int i = 0; i < 40; i++) {
+                sprites[i] = _sprite(3 + rand() % 12, 3 + rand() % 12, i % 4);
+                handles[i] = atlas_add_canvas(&a, sprites[i], &white);
+                if (handles[i] >= 0) {
+                        added++;
+                }
+        }
+        assert(added > 10 && added < 40);
+        _check(a, handles, sprites, 40);
+
+        // the sprites share one palette, at most 6 shades each of 4 seeds
+        assert(a.tex.palette.assigned > 6 && a.tex.palette.assigned <= 24);
+
+        // a sprite bigger than the atlas never fits, nor does one too colorful
+        struct canvas big = canvas(65, 2);
+        assert(atlas_add_canvas(&a, big, NULL) == -1);
+
+        struct atlas small = atlas(16, 16, 4, 0);
+        struct canvas many = _sprite(4, 4, 1);
+        int before = small.tex.palette.assigned;
+        assert(atlas_add_canvas(&small, many, NULL) == -1);
+        assert(small.tex.palette.assigned == before);
+        assert(small.count == 0);
+
+        // a texture keeps its transparency
+        struct texture tex = texture_from_canvas(sprites[0], &white);
+        int h = atlas_add_texture(&small, tex);
+        assert(h == -1);
+        struct atlas roomy = atlas(16, 16, 16, 0);
+        h = atlas_add_texture(&roomy, tex);
+        assert(h >= 0);
+        _check(roomy, &h, &sprites[0], 1);
+
+        atlas_destroy(&roomy);
+        atlas_destroy(&small);
+        atlas_destroy(&a);
+        canvas_destroy(&many);
+        canvas_destroy(&big);
+        for (int i = 0; i < 40; i++) {
+                canvas_destroy(&sprites[i]);
+        }
+
+        printf("[Atlas Add] Complete, all tests pass!\n");
+}
+
+void TST_AtlasRepack()
+{
+        struct color white = color_rgb(1.0, 1.0, 1.0);
+        struct atlas a = atlas(48, 48, 64, 0);
+
+        // a row of tall thin sprites leaves no room for a wide one
+        struct canvas sprites[8];
+        int handles[8];
+        for (int i = 0; i < 6; i++) {
+                sprites[i] = _sprite(8, 40, i % 4);
+                handles[i] = atlas_add_canvas(&a, sprites[i], &white);
+                assert(handles[i] == i);
+        }
+        sprites[6] = _sprite(40, 20, 2);
+        handles[6] = atlas_add_canvas(&a, sprites[6], &white);
+        assert(handles[6] == -1);
+
+        // removing sprites leaves gaps until repacked
+        atlas_remove(&a, handles[1]);
+        atlas_remove(&a, handles[4]);
+        assert(atlas_get_rect(a, handles[1]).w == 0);
+        handles[1] = handles[4] = -1;
+        assert(atlas_add_canvas(&a, sprites[6], &white) == -1);
+
+        // repacking into something too small fails and changes nothing
+        struct atlas_rect r5 = atlas_get_rect(a, handles[5]);
+        assert(!atlas_repack(&a, 16, 16));
+        assert(atlas_get_rect(a, handles[5]).x == r5.x);
+        _check(a, handles, sprites, 6);
+
+        // handles survive repacking into a bigger atlas
+        assert(atlas_repack(&a, 64, 64));
+        assert(a.tex.w == 64);
+        _check(a, handles, sprites, 6);
+
+        handles[6] = atlas_add_canvas(&a, sprites[6], &white);
+        assert(handles[6] == 1);
+        sprites[7] = _sprite(20, 20, 3);
+        handles[7] = atlas_add_canvas(&a, sprites[7], &white);
+        assert(handles[7] == 4);
+        _check(a, handles, sprites, 8);
+
+        assert(atlas_repack(&a, 64, 64));
+        _check(a, handles, sprites, 8);
+
+        atlas_destroy(&a);
+        for (int i = 0; i < 8; i++) {
+                canvas_destroy(&sprites[i]);
+        }
+
+        printf("[Atlas Repack] Complete, all tests pass!\n");
+}
+
+int main()
+{
+        mem_init(16 * MEM_MEGABYTE);
+
+        TST_AtlasAdd();
+        TST_AtlasRepack();
+
+        mem_destroy();
+
+        return 0;
+}
@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <assert.h>
+
+#include <smallengine/sys/mem.h>
+#include <smallengine/sys/job.h>
+#include <smallengine/graphics/batch.h>
+#include <smallengine/graphics/texture.h>
+#include <smallengine/graphics/canvas.h>
+#include <smallengine/graphics/color.h>
+
+void TST_BatchNew()
+{
+        struct batch b = batch(2);
+        assert(b.size == 2);
+        assert(b.count == 0);
+
+        struct color red = color_rgb(1.0, 0.0, 0.0);
+        assert(batch_fill(&b, 0, 0, 0, 0, 1, 1, red, BLIT_ABS) == 1);
+        assert(batch_fill(&b, 0, 0, 0, 0, 1, 1, red, BLIT_ABS) == 1);
+        assert(batch_fill(&b, 0, 0, 0, 0, 1, 1, red, BLIT_ABS) == 0);
+        assert(b.count == 2);
+
+        batch_clear(&b);
+        assert(b.count == 0);
+
+        batch_destroy(&b);
+
+        printf("[Batch New] Complete, all tests pass!\n");
+}
+
+void TST_BatchOrder()
+{
+        struct color red = color_rgb(1.0, 0.0, 0.0);
+        struct color green = color_rgb(0.0, 1.0, 0.0);
+        struct color blue = color_rgb(0.0, 0.0, 1.0);
+        struct color white = color_rgb(1.0, 1.0, 1.0);
+
+        struct canvas dst = canvas(100, 100);
+        struct batch b = batch(16);
+
+        // recorded back to front, drawn by layer then depth then order
+        batch_fill(&b, 2, 0, 0, 0, 9, 9, blue, BLIT_ABS);
+        batch_fill(&b, 1, 500, 0, 0, 19, 19, green, BLIT_ABS);
+        batch_fill(&b, 1, 10, 0, 0, 29, 29, red, BLIT_ABS);
+        batch_fill(&b, 0, 0, 0, 0, 99, 99, white, BLIT_ABS);
+        batch_fill(&b, 2, 0, 5, 5, 9, 9, red, BLIT_ABS);
+
+        batch_draw(&b, dst);
+
+        assert(color_equal(canvas_read_pixel(dst, 0, 0), blue) == 1);
+        assert(color_equal(canvas_read_pixel(dst, 7, 7), red) == 1);
+        assert(color_equal(canvas_read_pixel(dst, 15, 15), green) == 1);
+        assert(color_equal(canvas_read_pixel(dst, 25, 25), red) == 1);
+        assert(color_equal(canvas_read_pixel(dst, 99, 99), white) == 1);
+
+        batch_destroy(&b);
+        canvas_destroy(&dst);
+
+        printf("[Batch Order] Complete, all tests pass!\n");
+}
+
+void TST_BatchMerge()
+{
+        struct color grey = color_rgb(0.25, 0.25, 0.25);
+        struct color half = color_rgb(0.5, 0.5, 0.5);
+
+        struct canvas dst = canvas(64, 64);
+        struct batch b = batch(16);
+
+        // a row of touching additive fills becomes a single fill
+        for (int i = 0; i < 8; i++) {
+                batch_fill(&b, 0, 0, i * 8, 0, i * 8 + 7, 7, grey, BLIT_ADD);
+        }
+        batch_fill(&b, 0, 0, 0, 8, 63, 15, grey, BLIT_ADD);
+
+        batch_draw(&b, dst);
+        assert(b.drawn == 1);
+        assert(color_equal(canvas_read_pixel(dst, 0, 0), grey) == 1);
+        assert(color_equal(canvas_read_pixel(dst, 63, 15), grey) == 1);
+
+        // drawing again adds once more, merged areas aren't drawn twice
+        batch_draw(&b, dst);
+        assert(b.drawn == 1);
+        assert(color_equal(canvas_read_pixel(dst, 20, 5), half) == 1);
+
+        batch_destroy(&b);
+        canvas_destroy(&dst);
+
+        printf("[Batch Merge] Complete, all tests pass!\n");
+}
+
+void TST_BatchSprites()
+{
+        struct color black = color_rgb(0.0, 0.0, 0.0);
+        struct color white = color_rgb(1.0, 1.0, 1.0);
+        struct color red = color_rgb(1.0, 0.0, 0.0);
+        struct color blue = color_rgb(0.0, 0.0, 1.0);
+
+        struct canvas c = canvas(8, 8);
+        canvas_pattern(c, white, red, 1);
+        struct texture tex = texture_from_canvas(c, &white);
+
+        struct canvas src = canvas(4, 4);
+        canvas_fill(src, blue);
+
+        // draw the same scene serially and on worker threads
+        struct canvas serial = canvas(300, 200);
+        struct canvas parallel = canvas(300, 200);
+        struct batch b = batch(2048);
+
+        for (int i = 0; i < 1000; i++) {
+                batch_sprite(&b, 1, i, tex, 0, 0, 7, 7, 
+                             (i * 37) % 310 - 5, (i * 13) % 210 - 5, BLIT_ABS);
+        }
+        batch_blit(&b, 0, 0, src, 0, 0, 3, 3, 296, 196, BLIT_ABS);
+        batch_draw(&b, serial);
+
+        job_init(4);
+        batch_draw(&b, parallel);
+        job_quit();
+
+        for (int y = 0; y < 200; y++) {
+                for (int x = 0; x < 300; x++) {
+                        assert(color_equal(canvas_read_pixel(serial, x, y),
+                                canvas_read_pixel(parallel, x, y)) == 1);
+                }
+        }
+
+        // white is transparent, sprites share one palette
+        struct canvas dst = canvas(16, 16);
+        batch_clear(&b);
+        batch_sprite(&b, 0, 0, tex, 0, 0, 7, 7, 2, 2, BLIT_ABS);
+        batch_sprite(&b, 0, 0, tex, 0, 0, 7, 7, 20, 20, BLIT_ABS);
+        batch_draw(&b, dst);
+        assert(color_equal(canvas_read_pixel(dst, 2, 2), black) == 1);
+        assert(color_equal(canvas_read_pixel(dst, 3, 2), red) == 1);
+        assert(color_equal(canvas_read_pixel(dst, 10, 10), black) == 1);
+
+        batch_destroy(&b);
+        canvas_destroy(&serial);
+        canvas_destroy(&parallel);
+        canvas_destroy(&dst);
+
+        printf("[Batch Sprites] Complete, all tests pass!\n");
+}
+
+void TST_BatchColorSpace()
+{
+        // sprites and blits are drawn onto a linear canvas as canvas_blit
+        // would, converting from sRGB
+        struct color lin = color_rgb(0.214041, 0.214041, 0.214041);
+        struct canvas c = canvas(4, 4);
+        canvas_fill(c, color_rgb(0.5, 0.5, 0.5));
+        struct texture tex = texture_from_canvas(c, NULL);
+        struct canvas dst = canvas(8, 4);
+        canvas_set_color_space(dst, COLOR_LINEAR);
+
+        struct batch b = batch(4);
+        batch_sprite(&b, 0, 0, tex, 0, 0, 3, 3, 0, 0, BLIT_ABS);
+        batch_blit(&b, 0, 0, c, 0, 0, 3, 3, 4, 0, BLIT_ABS);
+        batch_draw(&b, dst);
+        assert(color_equal(canvas_read_pixel(dst, 1, 1), lin));
+        assert(color_equal(canvas_read_pixel(dst, 6, 2), lin));
+
+        // nothing converted is left behind for the next draw
+        assert(b.cmds[0].colors == NULL);
+
+        batch_destroy(&b);
+        texture_destroy(&tex);
+        canvas_destroy(&dst);
+        canvas_destroy(&c);
+
+        printf("[Batch Color Space] Complete, all tests pass!\n");
+}
+
+int main()
+{
+        mem_init(32 * MEM_MEGABYTE);
+
+        TST_BatchNew();
+        TST_BatchOrder();
+        TST_BatchMerge();
+        TST_BatchSprites();
+        TST_BatchColorSpace();
+
+        mem_destroy();
+
+        return 0;
+}
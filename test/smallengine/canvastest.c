@@ -1,5 +1,8 @@
 #include <stdio.h>
+#include <stdint.h>
+#include <string.h>
 #include <assert.h>
+#include <math.h>
 
 #include <smallengine/graphics/canvas.h>
 #include <smallengine/graphics/color.h>
@@ -11,9 +14,9 @@ void TST_CanvasNew()
 
         assert(c.w == 3);
         assert(c.h == 4);
-        assert(c.pixels != NULL);
+        assert(canvas_pixels(c) != NULL);
 
-        assert(color_equal(c.pixels[1], color_rgb(0.0, 0.0, 0.0)) == 1);
+        assert(color_equal(canvas_pixels(c)[1], color_rgb(0.0, 0.0, 0.0)) == 1);
 
         printf("[Canvas New] Complete, all tests pass!\n");
 }
@@ -89,6 +92,506 @@ void TST_CanvasBlit()
         printf("[Canvas Blit] Complete, all tests pass!\n");
 }
 
+void TST_CanvasCopy()
+{
+        struct canvas c = canvas(4, 4);
+        struct color black = color_rgb(0.0, 0.0, 0.0);
+        struct color red = color_rgb(1.0, 0.0, 0.0);
+        struct color blue = color_rgb(0.0, 0.0, 1.0);
+
+        canvas_fill(c, red);
+        
+        // copies share pixels until written to
+        struct canvas dup = canvas_copy(c);
+        assert(dup.w == 4);
+        assert(dup.h == 4);
+        assert(canvas_is_shared(c) == 1);
+        assert(canvas_pixels(c) == canvas_pixels(dup));
+
+        // writing gives the copy its own pixels, the original is untouched
+        canvas_write_pixel(dup, 1, 1, blue, BLIT_ABS);
+        assert(canvas_is_shared(c) == 0);
+        assert(canvas_is_shared(dup) == 0);
+        assert(canvas_pixels(c) != canvas_pixels(dup));
+        assert(color_equal(canvas_read_pixel(dup, 1, 1), blue) == 1);
+        assert(color_equal(canvas_read_pixel(dup, 2, 2), red) == 1);
+        assert(color_equal(canvas_read_pixel(c, 1, 1), red) == 1);
+
+        // assignment still refers to the same canvas
+        struct canvas alias = c;
+        canvas_write_pixel(alias, 0, 0, blue, BLIT_ABS);
+        assert(color_equal(canvas_read_pixel(c, 0, 0), blue) == 1);
+
+        // the pixels outlive the canvas they were copied from
+        struct canvas snapshot = canvas_copy(c);
+        canvas_destroy(&c);
+        assert(c.image == NULL);
+        assert(canvas_is_shared(snapshot) == 0);
+        assert(color_equal(canvas_read_pixel(snapshot, 0, 0), blue) == 1);
+        assert(color_equal(canvas_read_pixel(snapshot, 3, 3), red) == 1);
+
+        canvas_clear(snapshot);
+        assert(color_equal(canvas_read_pixel(snapshot, 3, 3), black) == 1);
+
+        canvas_destroy(&snapshot);
+        canvas_destroy(&dup);
+
+        printf("[Canvas Copy] Complete, all tests pass!\n");
+}
+
+void TST_CanvasBlitScaled()
+{
+        struct canvas src = canvas(64, 64);
+        struct canvas dst = canvas(40, 40);
+
+        struct color black = color_rgb(0.0, 0.0, 0.0);
+        struct color red = color_rgb(1.0, 0.0, 0.0);
+        struct color blue = color_rgb(0.0, 0.0, 1.0);
+
+        // left half red, right half blue
+        canvas_fill(src, red);
+        for (int y = 0; y < 64; y++) {
+                for (int x = 32; x < 64; x++) {
+                        canvas_write_pixel(src, x, y, blue, BLIT_ABS);
+                }
+        }
+
+        // shrink to 16x16, read from the reduced copies
+        canvas_blit_scaled(src, 0, 0, 63, 63, dst, 4, 4, 19, 19, BLIT_ABS);
+        assert(color_equal(canvas_read_pixel(dst, 3, 3), black) == 1);
+        assert(color_equal(canvas_read_pixel(dst, 4, 4), red) == 1);
+        assert(color_equal(canvas_read_pixel(dst, 10, 10), red) == 1);
+        assert(color_equal(canvas_read_pixel(dst, 13, 10), blue) == 1);
+        assert(color_equal(canvas_read_pixel(dst, 19, 19), blue) == 1);
+        assert(color_equal(canvas_read_pixel(dst, 20, 20), black) == 1);
+
+        // enlarge a corner, clipped against the destination
+        canvas_clear(dst);
+        canvas_blit_scaled(src, 0, 0, 3, 3, dst, 30, 30, 45, 45, BLIT_ABS);
+        assert(color_equal(canvas_read_pixel(dst, 29, 29), black) == 1);
+        assert(color_equal(canvas_read_pixel(dst, 39, 39), red) == 1);
+
+        canvas_destroy(&src);
+        canvas_destroy(&dst);
+
+        printf("[Canvas Blit Scaled] Complete, all tests pass!\n");
+}
+
+void TST_CanvasPpm()
+{
+        struct canvas c = canvas(7, 3);
+        for (int y = 0; y < c.h; y++) {
+                for (int x = 0; x < c.w; x++) {
+                        canvas_write_pixel(c, x, y, color_rgb_int(x * 40,
+                                           y * 100, 255 - x * 7), BLIT_ABS);
+                }
+        }
+        canvas_write_pixel(c, 0, 0, color_rgb(2.0, -1.0, 0.5), BLIT_ABS);
+
+        for (int format = PPM_ASCII; format <= PPM_BINARY; format++) {
+                assert(canvas_export_to_ppm(c, "canvastest.ppm", format));
+                struct canvas in = canvas_from_ppm("canvastest.ppm");
+                assert(in.w == 7 && in.h == 3);
+                assert(color_equal(canvas_read_pixel(in, 0, 0),
+                                   color_rgb_int(255, 0, 128)));
+                for (int i = 1; i < c.w * c.h; i++) {
+                        assert(color_equal(canvas_read_pixel(in, i % 7, i / 7),
+                                        canvas_read_pixel(c, i % 7, i / 7)));
+                }
+                canvas_destroy(&in);
+        }
+
+        // text lines are kept under 70 characters
+        assert(canvas_export_to_ppm(c, "canvastest.ppm", PPM_ASCII));
+        FILE *file = fopen("canvastest.ppm", "r");
+        char line[128];
+        int lines = 0;
+        while (fgets(line, sizeof(line), file) != NULL) {
+                assert(strlen(line) < 70);
+                lines++;
+        }
+        fclose(file);
+        assert(lines == 3 + 3 * 2);
+
+        // comments, other maximum values and numbers spread over lines
+        file = fopen("canvastest.ppm", "w");
+        fprintf(file, "P3\n# a comment\n2 1 # another\n15\n15 0\n0 0 15\n5\n");
+        fclose(file);
+        struct canvas in = canvas_from_ppm("canvastest.ppm");
+        assert(in.w == 2 && in.h == 1);
+        assert(color_equal(canvas_read_pixel(in, 0, 0), color_rgb(1, 0, 0)));
+        assert(color_equal(canvas_read_pixel(in, 1, 0), 
+                           color_rgb(0, 1, 1.0 / 3.0)));
+        canvas_destroy(&in);
+
+        // 16 bit binary
+        file = fopen("canvastest.ppm", "wb");
+        fprintf(file, "P6 1 1 65535\n");
+        fwrite("\xff\xff\x80\x00\x00\x00", 1, 6, file);
+        fclose(file);
+        in = canvas_from_ppm("canvastest.ppm");
+        assert(color_equal(canvas_read_pixel(in, 0, 0), 
+                           color_rgb(1.0, 32768.0 / 65535.0, 0.0)));
+        canvas_destroy(&in);
+
+        // truncated and missing files give an empty canvas
+        file = fopen("canvastest.ppm", "w");
+        fprintf(file, "P3 2 2 255 1 2 3 4 5 6");
+        fclose(file);
+        in = canvas_from_ppm("canvastest.ppm");
+        assert(in.w == 0 && in.h == 0);
+        canvas_destroy(&in);
+
+        // sizes that overflow, or that the data is too short for
+        const char *headers[] = {"P6 65536 65537 255\n", "P6 4 4 255\n",
+                                 "P3 100000 100000 255\n"};
+        for (int i = 0; i < 3; i++) {
+                file = fopen("canvastest.ppm", "wb");
+                fputs(headers[i], file);
+                fwrite(canvas_pixels(c), 1, 3 * 3 * 4, file);
+                fclose(file);
+                in = canvas_from_ppm("canvastest.ppm");
+                assert(in.w == 0 && in.h == 0);
+                canvas_destroy(&in);
+        }
+        remove("canvastest.ppm");
+        in = canvas_from_ppm("canvastest.ppm");
+        assert(in.w == 0 && in.h == 0);
+
+        canvas_destroy(&c);
+
+        printf("[Canvas Ppm] Complete, all tests pass!\n");
+}
+
+/*
+ * write a bitmap with a 40 byte header, extra (color table or masks) and the
+ * given pixel rows
+ */
+static void _write_bmp(const char *filename, int w, int h, int bpp,
+                       int compression, const uint8_t *extra, int extra_len,
+                       const uint8_t *pixels, int pixels_len)
+{
+        uint8_t head[54] = {'B', 'M'};
+        uint32_t offset = 54 + extra_len;
+        uint32_t words[] = {54 + extra_len + pixels_len, 0, offset, 40,
+                            (uint32_t)w, (uint32_t)h};
+        for (int i = 0; i < 6; i++) {
+                memcpy(head + 2 + i * 4, &words[i], 4);
+        }
+        head[26] = 1;
+        head[28] = bpp;
+        head[30] = compression;
+
+        FILE *file = fopen(filename, "wb");
+        fwrite(head, 1, sizeof(head), file);
+        fwrite(extra, 1, extra_len, file);
+        fwrite(pixels, 1, pixels_len, file);
+        fclose(file);
+}
+
+void TST_CanvasBmp()
+{
+        // what is exported reads back the same, 32 bit top down
+        struct canvas c = canvas(5, 3);
+        for (int y = 0; y < c.h; y++) {
+                for (int x = 0; x < c.w; x++) {
+                        canvas_write_pixel(c, x, y, color_rgb_int(x * 50,
+                                           y * 100, 255 - x * 9), BLIT_ABS);
+                }
+        }
+        assert(canvas_export_to_bmp(c, "canvastest.bmp"));
+        struct canvas in = canvas_from_bmp("canvastest.bmp");
+        assert(in.w == 5 && in.h == 3);
+        for (int i = 0; i < c.w * c.h; i++) {
+                struct color got = canvas_read_pixel(in, i % 5, i / 5);
+                assert(color_equal(got, canvas_read_pixel(c, i % 5, i / 5)));
+                assert(got.a == 1.0);
+        }
+        canvas_destroy(&in);
+
+        // and so do compressed bitmaps
+        assert(canvas_export_to_bmp(c, "canvastest.bmp.lz"));
+        in = canvas_from_bmp("canvastest.bmp.lz");
+        assert(in.w == 5 && in.h == 3);
+        assert(color_equal(canvas_read_pixel(in, 4, 2),
+                           canvas_read_pixel(c, 4, 2)));
+        canvas_destroy(&in);
+        remove("canvastest.bmp.lz");
+
+        // 24 bit bottom up, each 2 pixel row padded to 8 bytes
+        uint8_t rgb[16] = {255, 0, 0,  0, 255, 0,  9, 9,
+                           0, 0, 255,  10, 20, 30,  9, 9};
+        _write_bmp("canvastest.bmp", 2, 2, 24, 0, NULL, 0, rgb, 16);
+        in = canvas_from_bmp("canvastest.bmp");
+        assert(in.w == 2 && in.h == 2);
+        assert(color_equal(canvas_read_pixel(in, 0, 0), color_rgb(1, 0, 0)));
+        assert(color_equal(canvas_read_pixel(in, 1, 0),
+                           color_rgb_int(30, 20, 10)));
+        assert(color_equal(canvas_read_pixel(in, 0, 1), color_rgb(0, 0, 1)));
+        assert(color_equal(canvas_read_pixel(in, 1, 1), color_rgb(0, 1, 0)));
+        canvas_destroy(&in);
+
+        // 8 bit with a short color table, rows of 3 padded to 4
+        uint8_t table[8] = {0, 0, 255, 0,  255, 255, 255, 0};
+        uint8_t indices[8] = {0, 1, 200, 0,  1, 1, 0, 0};
+        _write_bmp("canvastest.bmp", 3, -2, 8, 0, table, 8, indices, 8);
+        FILE *file = fopen("canvastest.bmp", "r+b");
+        fseek(file, 46, SEEK_SET);
+        fputc(2, file);
+        fclose(file);
+        in = canvas_from_bmp("canvastest.bmp");
+        assert(in.w == 3 && in.h == 2);
+        assert(color_equal(canvas_read_pixel(in, 0, 0), color_rgb(1, 0, 0)));
+        assert(color_equal(canvas_read_pixel(in, 1, 0), color_rgb(1, 1, 1)));
+        assert(color_equal(canvas_read_pixel(in, 2, 0), color_rgb(0, 0, 0)));
+        assert(color_equal(canvas_read_pixel(in, 2, 1), color_rgb(1, 0, 0)));
+        canvas_destroy(&in);
+
+        // 32 bit with 10 bits per component
+        uint32_t masks[3] = {0x3ff00000, 0xffc00, 0x3ff};
+        uint32_t wide = 1023 << 20 | 0 << 10 | 341;
+        _write_bmp("canvastest.bmp", 1, 1, 32, 3, (uint8_t *)masks, 12,
+                   (uint8_t *)&wide, 4);
+        in = canvas_from_bmp("canvastest.bmp");
+        assert(color_equal(canvas_read_pixel(in, 0, 0),
+                           color_rgb(1.0, 0.0, 341.0 / 1023.0)));
+        canvas_destroy(&in);
+
+        // unsupported, truncated, bad and missing files give an empty canvas
+        _write_bmp("canvastest.bmp", 2, 2, 16, 0, NULL, 0, rgb, 16);
+        in = canvas_from_bmp("canvastest.bmp");
+        assert(in.w == 0 && in.h == 0);
+        _write_bmp("canvastest.bmp", 2, 2, 24, 0, NULL, 0, rgb, 15);
+        in = canvas_from_bmp("canvastest.bmp");
+        assert(in.w == 0 && in.h == 0);
+        _write_bmp("canvastest.bmp", 0, 2, 24, 0, NULL, 0, rgb, 16);
+        in = canvas_from_bmp("canvastest.bmp");
+        assert(in.w == 0 && in.h == 0);
+        file = fopen("canvastest.bmp", "w");
+        fprintf(file, "not a bitmap at all, though long enough to be one..");
+        fclose(file);
+        in = canvas_from_bmp("canvastest.bmp");
+        assert(in.w == 0 && in.h == 0);
+        remove("canvastest.bmp");
+        in = canvas_from_bmp("canvastest.bmp");
+        assert(in.w == 0 && in.h == 0);
+        canvas_destroy(&in);
+
+        canvas_destroy(&c);
+
+        printf("[Canvas Bmp] Complete, all tests pass!\n");
+}
+
+static void _write_bytes(const char *filename, const uint8_t *data, int len)
+{
+        FILE *file = fopen(filename, "wb");
+        fwrite(data, 1, len, file);
+        fclose(file);
+}
+
+void TST_CanvasQoi()
+{
+        // runs longer than one op holds, small and larger steps, a few
+        // colours repeated and translucent pixels all read back the same
+        struct canvas c = canvas(70, 20);
+        for (int y = 0; y < c.h; y++) {
+                for (int x = 0; x < c.w; x++) {
+                        struct color col = color_rgb_int(10, 20, 30);
+                        if (y >= 4 && y < 8) {
+                                col = color_rgb_int(x, 100 + x, 200 - x);
+                        } else if (y >= 8 && y < 12) {
+                                col = color_rgb_int(x * 3, x * 2, 255 - x);
+                        } else if (y >= 12 && y < 16) {
+                                col = color_rgb_int((x * 37) & 0xff,
+                                                    (x * 91) & 0xff, y);
+                        } else if (y >= 16) {
+                                col = color_rgba_int(x % 3 * 90, 40, 200,
+                                                     (x % 4) * 85);
+                        }
+                        canvas_write_pixel(c, x, y, col, BLIT_ABS);
+                }
+        }
+
+        assert(canvas_export_to_qoi(c, "canvastest.qoi"));
+        struct canvas in = canvas_from_file("canvastest.qoi");
+        assert(in.w == 70 && in.h == 20);
+        for (int i = 0; i < c.w * c.h; i++) {
+                struct color got = canvas_read_pixel(in, i % 70, i / 70);
+                struct color want = canvas_read_pixel(c, i % 70, i / 70);
+                assert(color_equal(got, want));
+                assert(got.a > want.a - 1e-6 && got.a < want.a + 1e-6);
+        }
+        canvas_destroy(&in);
+
+        // opaque canvases leave out alpha, and compress well
+        canvas_fill(c, color_rgb(0.25, 0.5, 1.0));
+        assert(canvas_export_to_qoi(c, "canvastest.qoi"));
+        FILE *file = fopen("canvastest.qoi", "rb");
+        uint8_t head[14];
+        assert(fread(head, 1, 14, file) == 14);
+        fseek(file, 0, SEEK_END);
+        assert(ftell(file) < 100);
+        fclose(file);
+        assert(memcmp(head, "qoif\0\0\0\x46\0\0\0\x14\x03\0", 14) == 0);
+
+        // alpha below 0.0 or NaN is written as transparent
+        struct canvas odd = canvas(2, 1);
+        struct color *px = canvas_pixels_writable(odd);
+        px[0] = (struct color){0.5, 0.5, 0.5, -0.5};
+        px[1] = (struct color){0.5, 0.5, 0.5, NAN};
+        assert(canvas_export_to_qoi(odd, "canvastest.qoi"));
+        in = canvas_from_qoi("canvastest.qoi");
+        assert(canvas_read_pixel(in, 0, 0).a == 0.0);
+        assert(canvas_read_pixel(in, 1, 0).a == 0.0);
+        canvas_destroy(&in);
+        canvas_destroy(&odd);
+
+        // each kind of op by hand: RGB, DIFF (+1, -1, 0), LUMA (green +10,
+        // red 3 less, blue 2 more), INDEX back to the first and a RUN of 2
+        uint8_t ops[] = {'q', 'o', 'i', 'f',  0, 0, 0, 3,  0, 0, 0, 2,  3, 1,
+                         0xfe, 10, 20, 30,  0x76,  0xaa, 0x5a,  0x09,  0xc1,
+                         0, 0, 0, 0, 0, 0, 0, 1};
+        _write_bytes("canvastest.qoi", ops, sizeof(ops));
+        in = canvas_from_qoi("canvastest.qoi");
+        assert(in.w == 3 && in.h == 2);
+        assert(canvas_color_space(in) == COLOR_LINEAR);
+        assert(color_equal(canvas_read_pixel(in, 0, 0),
+                           color_rgb_int(10, 20, 30)));
+        assert(color_equal(canvas_read_pixel(in, 1, 0),
+                           color_rgb_int(11, 19, 30)));
+        assert(color_equal(canvas_read_pixel(in, 2, 0),
+                           color_rgb_int(18, 29, 42)));
+        for (int x = 0; x < 3; x++) {
+                assert(color_equal(canvas_read_pixel(in, x, 1),
+                                   color_rgb_int(10, 20, 30)));
+        }
+        canvas_destroy(&in);
+
+        // truncated, bad and missing files give an empty canvas
+        _write_bytes("canvastest.qoi", ops, sizeof(ops) - 9);
+        in = canvas_from_qoi("canvastest.qoi");
+        assert(in.w == 0 && in.h == 0);
+        ops[12] = 5;
+        _write_bytes("canvastest.qoi", ops, sizeof(ops));
+        in = canvas_from_qoi("canvastest.qoi");
+        assert(in.w == 0 && in.h == 0);
+        ops[12] = 3;
+        ops[0] = 'Q';
+        _write_bytes("canvastest.qoi", ops, sizeof(ops));
+        in = canvas_from_qoi("canvastest.qoi");
+        assert(in.w == 0 && in.h == 0);
+
+        // a header asking for far more pixels than the data can hold is
+        // refused before anything is allocated, one run op is 62 pixels
+        uint8_t huge[] = {'q', 'o', 'i', 'f', 0, 0, 0x27, 0x10, 0, 0, 0x27,
+                          0x10, 4, 0, 0, 0, 0, 0, 0, 0, 0, 1};
+        _write_bytes("canvastest.qoi", huge, sizeof(huge));
+        in = canvas_from_qoi("canvastest.qoi");
+        assert(in.w == 0 && in.h == 0);
+        uint8_t run[] = {'q', 'o', 'i', 'f', 0, 0, 0, 62, 0, 0, 0, 1, 3, 0,
+                         0xfd, 0, 0, 0, 0, 0, 0, 0, 1};
+        _write_bytes("canvastest.qoi", run, sizeof(run));
+        in = canvas_from_qoi("canvastest.qoi");
+        assert(in.w == 62 && in.h == 1);
+        canvas_destroy(&in);
+        run[11] = 2;
+        _write_bytes("canvastest.qoi", run, sizeof(run));
+        in = canvas_from_qoi("canvastest.qoi");
+        assert(in.w == 0 && in.h == 0);
+
+        remove("canvastest.qoi");
+        in = canvas_from_qoi("canvastest.qoi");
+        assert(in.w == 0 && in.h == 0);
+
+        canvas_destroy(&c);
+
+        printf("[Canvas Qoi] Complete, all tests pass!\n");
+}
+
+void TST_CanvasColorSpace()
+{
+        struct canvas src = canvas(4, 4);
+        struct canvas dst = canvas(4, 4);
+        assert(canvas_color_space(src) == COLOR_SRGB);
+
+        canvas_fill(src, color_rgb(0.5, 0.5, 0.5));
+        canvas_set_color_space(dst, COLOR_LINEAR);
+
+        // sRGB mid grey is about a fifth of the light in a linear canvas
+        canvas_blit(src, 0, 0, 3, 3, dst, 0, 0, BLIT_ABS);
+        assert(color_equal(canvas_read_pixel(dst, 2, 2),
+                           color_rgb(0.214041, 0.214041, 0.214041)));
+
+        // adding two of them in linear light isn't twice as bright in sRGB
+        canvas_blit(src, 0, 0, 1, 1, dst, 0, 0, BLIT_ADD);
+        struct color twice = color_convert(canvas_read_pixel(dst, 0, 0),
+                                           COLOR_LINEAR, COLOR_SRGB);
+        assert(twice.r > 0.68 && twice.r < 0.69);
+
+        canvas_blit_scaled(src, 0, 0, 3, 3, dst, 0, 0, 1, 1, BLIT_ABS);
+        assert(color_equal(canvas_read_pixel(dst, 1, 1),
+                           color_rgb(0.214041, 0.214041, 0.214041)));
+
+        // converting in place round trips, copies keep the space
+        struct canvas copy = canvas_copy(dst);
+        assert(canvas_color_space(copy) == COLOR_LINEAR);
+        canvas_convert_color_space(copy, COLOR_SRGB);
+        assert(color_equal(canvas_read_pixel(copy, 3, 3),
+                           color_rgb(0.5, 0.5, 0.5)));
+        assert(color_equal(canvas_read_pixel(dst, 3, 3),
+                           color_rgb(0.214041, 0.214041, 0.214041)));
+
+        // and exports are encoded to sRGB, 0.5 is right between 127 and 128
+        assert(canvas_export_to_ppm(dst, "canvastest.ppm", PPM_BINARY));
+        struct canvas in = canvas_from_ppm("canvastest.ppm");
+        struct color grey = canvas_read_pixel(in, 3, 3);
+        assert(grey.r * 255.0 > 126.5 && grey.r * 255.0 < 128.5);
+        remove("canvastest.ppm");
+
+        canvas_destroy(&in);
+        canvas_destroy(&copy);
+        canvas_destroy(&src);
+        canvas_destroy(&dst);
+
+        printf("[Canvas Color Space] Complete, all tests pass!\n");
+}
+
+void TST_CanvasEmpty()
+{
+        // as returned for a file that can't be read
+        struct canvas e = canvas_from_file("canvastest_missing.bmp");
+        struct canvas c = canvas(4, 4);
+        assert(e.w == 0 && e.h == 0);
+
+        canvas_fill(e, color_rgb(1.0, 0.0, 0.0));
+        canvas_clear(e);
+        canvas_test(e);
+        assert(!canvas_write_pixel(e, 0, 0, color_rgb(1, 1, 1), BLIT_ABS));
+        assert(color_equal(canvas_read_pixel(e, 0, 0), color_rgb(0, 0, 0)));
+        canvas_blit(e, 0, 0, 3, 3, c, 0, 0, BLIT_ABS);
+        canvas_blit(c, 0, 0, 3, 3, e, 0, 0, BLIT_ABS);
+        canvas_blit_scaled(e, 0, 0, 3, 3, c, 0, 0, 1, 1, BLIT_ABS);
+        canvas_blit_scaled(c, 0, 0, 3, 3, e, 0, 0, 1, 1, BLIT_ABS);
+        canvas_convert_color_space(e, COLOR_LINEAR);
+        assert(canvas_color_space(e) == COLOR_SRGB);
+        assert(canvas_pixels(e) == NULL && canvas_version(e) == 0);
+        assert(!canvas_is_shared(e));
+        assert(canvas_mip(e, 1, MIP_BOX).w == 0);
+
+        struct canvas dup = canvas_copy(e);
+        assert(dup.w == 0 && dup.h == 0);
+        canvas_destroy(&dup);
+
+        assert(!canvas_export_to_bmp(e, "canvastest_empty.bmp"));
+        assert(!canvas_export_to_ppm(e, "canvastest_empty.ppm", PPM_ASCII));
+        assert(!canvas_export_to_qoi(e, "canvastest_empty.qoi"));
+
+        canvas_destroy(&e);
+        canvas_destroy(&c);
+
+        printf("[Canvas Empty] Complete, all tests pass!\n");
+}
+
 int main()
 {
         mem_init(5 * MEM_MEGABYTE);
@@ -97,6 +600,13 @@ int main()
         TST_CanvasReadWrite();
         TST_CanvasFill();
         TST_CanvasBlit();
+        TST_CanvasCopy();
+        TST_CanvasBlitScaled();
+        TST_CanvasPpm();
+        TST_CanvasBmp();
+        TST_CanvasQoi();
+        TST_CanvasColorSpace();
+        TST_CanvasEmpty();
 
         mem_destroy();
 
@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <assert.h>
+
+#include <sys/stat.h>
+
+#include <smallengine/sys/mem.h>
+#include <smallengine/graphics/capture.h>
+#include <smallengine/graphics/canvas.h>
+#include <smallengine/graphics/color.h>
+
+#define FRAMES 12
+#define FIFO "capturetest.fifo"
+
+static void _name(char *buf, int i)
+{
+        snprintf(buf, 64, "capturetest%d.bmp", i);
+}
+
+/*
+ * check a written frame is the canvas it was captured from
+ */
+static void _check(struct canvas want, const char *filename)
+{
+        struct canvas got = canvas_from_bmp(filename);
+        assert(got.w == want.w && got.h == want.h);
+        for (int y = 0; y < want.h; y += 7) {
+                for (int x = 0; x < want.w; x += 5) {
+                        assert(color_equal(canvas_read_pixel(got, x, y),
+                                           canvas_read_pixel(want, x, y)));
+                }
+        }
+        canvas_destroy(&got);
+        remove(filename);
+}
+
+/*
+ * a frame which differs from every other frame
+ */
+static struct canvas _frame(int i)
+{
+        struct canvas c = canvas(320, 200);
+        for (int y = 0; y < c.h; y++) {
+                for (int x = 0; x < c.w; x++) {
+                        canvas_write_pixel(c, x, y, color_rgb_int(x & 0xff,
+                                           y, i * 20), BLIT_ABS);
+                }
+        }
+        return c;
+}
+
+void TST_CaptureSerial()
+{
+        // without a writer thread frames are written straight away
+        struct canvas c = _frame(1);
+        char name[64];
+        _name(name, 0);
+        assert(capture_canvas(c, name));
+        _check(c, name);
+
+        // packed pixels with a pitch wider than the frame
+        uint32_t pixels[4 * 3];
+        for (int i = 0; i < 12; i++) {
+                pixels[i] = color_to_RGBA(color_rgb_int(i * 20, 0, 255 - i));
+        }
+        assert(capture_pixels(pixels, 3, 3, 4, COLOR_RGBA, name));
+        struct canvas got = canvas_from_bmp(name);
+        assert(got.w == 3 && got.h == 3);
+        assert(color_equal(canvas_read_pixel(got, 2, 1),
+                           color_rgb_int(6 * 20, 0, 255 - 6)));
+        canvas_destroy(&got);
+        remove(name);
+
+        assert(capture_pixels(pixels, 3, 3, 3, COLOR_ARGB,
+                              "no/such/dir/capturetest.bmp"));
+        assert(capture_failed() == 1);
+
+        canvas_destroy(&c);
+        capture_quit();
+
+        printf("[Capture Serial] Complete, all tests pass!\n");
+}
+
+void TST_CaptureBlock()
+{
+        // every frame is written when captures wait for room
+        struct canvas frames[FRAMES];
+        char name[64];
+
+        assert(capture_init(2, CAPTURE_BLOCK));
+        for (int i = 0; i < FRAMES; i++) {
+                frames[i] = _frame(i);
+                _name(name, i);
+                assert(capture_canvas(frames[i], name));
+        }
+        capture_flush();
+        assert(capture_dropped() == 0 && capture_failed() == 0);
+
+        for (int i = 0; i < FRAMES; i++) {
+                _name(name, i);
+                _check(frames[i], name);
+                canvas_destroy(&frames[i]);
+        }
+        capture_quit();
+
+        printf("[Capture Block] Complete, all tests pass!\n");
+}
+
+void TST_CaptureDrop()
+{
+        // the writer waits to open a fifo until it is read, so the only
+        // buffer stays full and every capture meanwhile is dropped
+        struct canvas c = _frame(3);
+        char name[64];
+        int queued = 0;
+
+        assert(mkfifo(FIFO, 0600) == 0);
+        assert(capture_init(1, CAPTURE_DROP));
+        assert(capture_canvas(c, FIFO));
+        for (int i = 0; i < FRAMES; i++) {
+                _name(name, i);
+                queued += capture_canvas(c, name);
+        }
+        assert(queued == 0 && capture_dropped() == FRAMES);
+
+        FILE *f = fopen(FIFO, "rb");
+        assert(f != NULL);
+        char buf[4096];
+        size_t size = 0, n;
+        while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+                size += n;
+        }
+        fclose(f);
+        assert(size == 54 + c.w * c.h * 4);
+
+        // once written there is room again
+        capture_flush();
+        _name(name, 0);
+        assert(capture_canvas(c, name));
+        capture_quit();
+        _check(c, name);
+
+        remove(FIFO);
+        canvas_destroy(&c);
+
+        printf("[Capture Drop] Complete, all tests pass!\n");
+}
+
+int main()
+{
+        mem_init(64 * MEM_MEGABYTE);
+
+        TST_CaptureSerial();
+        TST_CaptureBlock();
+        TST_CaptureDrop();
+
+        mem_destroy();
+
+        return 0;
+}
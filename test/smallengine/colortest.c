@@ -1,6 +1,8 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <assert.h>
 #include <stdint.h>
+#include <math.h>
 
 #include <smallengine/maths/maths.h>
 
@@ -58,6 +60,164 @@ void TST_ColorConvert()
         printf("[Color Convert] Complete, all tests pass!\n");
 }
 
+void TST_ColorSpan()
+{
+        struct color src[7] = {
+                color_rgb(2.5, 1.3, -9.0), color_rgb(0.0, 0.0, 0.0),
+                color_rgb(1.0, 0.5, 0.25), color_rgb(0.1, 0.2, 0.3),
+                color_rgb(0.998, 0.002, 0.5), color_rgb(-1.0, 7.0, 0.75),
+                color_rgb(0.33, 0.66, 0.99)
+        };
+        uint32_t rgba[7], argb[7];
+
+        color_span_to_rgba32(src, rgba, 7, COLOR_RGBA);
+        color_span_to_rgba32(src, argb, 7, COLOR_ARGB);
+        for (int i = 0; i < 7; i++) {
+                assert(rgba[i] == color_to_RGBA(src[i]));
+                assert(argb[i] == color_to_ARGB(src[i]));
+        }
+        assert(argb[0] == 0xffffff00);
+
+        // odd lengths and empty spans leave the rest of dst alone
+        argb[1] = 0;
+        color_span_to_rgba32(src, argb, 1, COLOR_ARGB);
+        assert(argb[1] == 0);
+        color_span_to_rgba32(src, argb, 0, COLOR_ARGB);
+
+        printf("[Color Span] Complete, all tests pass!\n");
+}
+
+void TST_ColorSpace()
+{
+        // the tables agree with the exact curves across the range
+        for (int i = 0; i <= 1000; i++) {
+                double v = i / 1000.0;
+                double lin = (v <= 0.04045) ? v / 12.92 :
+                             pow((v + 0.055) / 1.055, 2.4);
+                assert(double_equal(color_srgb_to_linear(v), lin));
+                assert(double_equal(color_linear_to_srgb(lin), v));
+        }
+        assert(double_equal(color_srgb_to_linear(0.5), 0.214041));
+        assert(double_equal(color_srgb_to_linear(2.0),
+                            pow(2.055 / 1.055, 2.4)));
+
+        struct color c = color_rgba(0.5, 1.0, 0.0, 1.0);
+        struct color lin = color_convert(c, COLOR_SRGB, COLOR_LINEAR);
+        assert(color_equal(lin, color_rgb(0.214041, 1.0, 0.0)));
+        assert(color_equal(color_convert(lin, COLOR_LINEAR, COLOR_SRGB), c));
+
+        // linear colors are encoded on the way to packed pixels
+        uint32_t argb;
+        c = color_rgb(0.4, 0.9, 0.1);
+        lin = color_convert(c, COLOR_SRGB, COLOR_LINEAR);
+        color_span_to_srgb32(&lin, &argb, 1, COLOR_ARGB);
+        assert(argb == color_to_ARGB(c));
+
+        printf("[Color Space] Complete, all tests pass!\n");
+}
+
+static int _convert_all(void *ok)
+{
+        for (int i = 0; i <= 1000; i++) {
+                double v = i / 1000.0;
+                double lin = (v <= 0.04045) ? v / 12.92 :
+                             pow((v + 0.055) / 1.055, 2.4);
+                if (!double_equal(color_srgb_to_linear(v), lin)) {
+                        *(int *)ok = 0;
+                }
+        }
+
+        return 0;
+}
+
+void TST_ColorSpaceThreads()
+{
+        // the first conversions race to build the tables, every thread must
+        // see them filled
+        SDL_Thread *threads[4];
+        int ok[4];
+        for (int i = 0; i < 4; i++) {
+                ok[i] = 1;
+                threads[i] = SDL_CreateThread(_convert_all, "color", &ok[i]);
+        }
+        for (int i = 0; i < 4; i++) {
+                SDL_WaitThread(threads[i], NULL);
+                assert(ok[i]);
+        }
+
+        printf("[Color Space Threads] Complete, all tests pass!\n");
+}
+
+static int _avg(int a, int b)
+{
+        return (a + b + 1) / 2;
+}
+
+void TST_ColorYuv()
+{
+        // odd sizes so the last chroma column and row are half blocks
+        enum { W = 37, H = 9, PITCH = 40 };
+        uint32_t src[PITCH * H];
+        uint8_t y[W * H], u[19 * 5], v[19 * 5];
+
+        srand(7);
+        for (int layout = 0; layout < NUM_COLOR_LAYOUTS; layout++) {
+                int rgb[PITCH * H][3];
+                for (int i = 0; i < PITCH * H; i++) {
+                        struct color c = color_rgb_int(rand() % 256,
+                                                       rand() % 256,
+                                                       rand() % 256);
+                        rgb[i][0] = (int)(c.r * 255.0 + 0.5);
+                        rgb[i][1] = (int)(c.g * 255.0 + 0.5);
+                        rgb[i][2] = (int)(c.b * 255.0 + 0.5);
+                        src[i] = (layout == COLOR_ARGB) ? color_to_ARGB(c) :
+                                                          color_to_RGBA(c);
+                }
+
+                color_rgb32_to_yuv420(src, W, H, PITCH, layout, y, u, v);
+
+                for (int j = 0; j < H; j++) {
+                        for (int i = 0; i < W; i++) {
+                                int *p = rgb[j * PITCH + i];
+                                int want = (66 * p[0] + 129 * p[1] +
+                                            25 * p[2] + 128) / 256 + 16;
+                                assert(y[j * W + i] == want);
+                        }
+                }
+
+                for (int j = 0; j < 5; j++) {
+                        for (int i = 0; i < 19; i++) {
+                                int x0 = i * 2, x1 = (x0 + 1 < W) ? x0 + 1 : x0;
+                                int y0 = j * 2, y1 = (y0 + 1 < H) ? y0 + 1 : y0;
+                                int c[3];
+                                for (int k = 0; k < 3; k++) {
+                                        c[k] = _avg(_avg(rgb[y0 * PITCH + x0][k],
+                                                         rgb[y1 * PITCH + x0][k]),
+                                                    _avg(rgb[y0 * PITCH + x1][k],
+                                                         rgb[y1 * PITCH + x1][k]));
+                                }
+                                int wu = (-38 * c[0] - 74 * c[1] + 112 * c[2] +
+                                          128 + 32768) / 256;
+                                int wv = (112 * c[0] - 94 * c[1] - 18 * c[2] +
+                                          128 + 32768) / 256;
+                                assert(u[j * 19 + i] == wu);
+                                assert(v[j * 19 + i] == wv);
+                        }
+                }
+        }
+
+        // black and white sit at the ends of the studio range
+        uint32_t bw[16];
+        for (int i = 0; i < 16; i++) {
+                bw[i] = color_to_RGBA(color_rgb(i < 8, i < 8, i < 8));
+        }
+        color_rgb32_to_yuv420(bw, 16, 1, 16, COLOR_RGBA, y, u, v);
+        assert(y[0] == 235 && y[15] == 16);
+        assert(u[0] == 128 && v[0] == 128 && u[7] == 128 && v[7] == 128);
+
+        printf("[Color YUV] Complete, all tests pass!\n");
+}
+
 void TST_ColorAdd()
 {
         struct color c1 = color_rgb(0.8, 0.1, 0.005);
@@ -111,9 +271,14 @@ void TST_ColorMultiply()
 
 int main()
 {
+        // first, before anything else has built the tables
+        TST_ColorSpaceThreads();
         TST_ColorNew();
         TST_ColorEqual();
         TST_ColorConvert();
+        TST_ColorSpan();
+        TST_ColorSpace();
+        TST_ColorYuv();
         TST_ColorAdd();
         TST_ColorSubtract();
         TST_ColorScale();
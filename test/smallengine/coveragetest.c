@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include <smallengine/sys/mem.h>
+#include <smallengine/graphics/coverage.h>
+#include <smallengine/graphics/canvas.h>
+#include <smallengine/graphics/color.h>
+
+void TST_CoverageNew()
+{
+        struct coverage cov = coverage(130, 3);
+        assert(cov.w == 130 && cov.h == 3);
+        assert(cov.words == 3);
+        assert(coverage_count(cov) == 0);
+
+        coverage_set(cov, 0, 0, 1);
+        coverage_set(cov, 129, 2, 1);
+        coverage_set(cov, 130, 2, 1);
+        coverage_set(cov, -1, 0, 1);
+        assert(coverage_test(cov, 0, 0) && coverage_test(cov, 129, 2));
+        assert(!coverage_test(cov, 1, 0) && !coverage_test(cov, 130, 2));
+        assert(coverage_count(cov) == 2);
+        coverage_set(cov, 0, 0, 0);
+        assert(!coverage_test(cov, 0, 0));
+
+        int mask[8] = {-1, 0, 3, -1, 2, 2, -1, 7};
+        struct coverage m = coverage_from_mask(mask, 4, 2);
+        for (int i = 0; i < 8; i++) {
+                assert(coverage_test(m, i % 4, i / 4) == (mask[i] >= 0));
+        }
+
+        struct color white = color_rgb(1.0, 1.0, 1.0);
+        struct canvas c = canvas(3, 2);
+        canvas_fill(c, white);
+        canvas_write_pixel(c, 1, 1, color_rgb(0.2, 0.3, 0.4), BLIT_ABS);
+        struct coverage cc = coverage_from_canvas(c, &white);
+        assert(coverage_count(cc) == 1 && coverage_test(cc, 1, 1));
+        struct coverage all = coverage_from_canvas(c, NULL);
+        assert(coverage_count(all) == 6);
+
+        coverage_destroy(&all);
+        coverage_destroy(&cc);
+        coverage_destroy(&m);
+        coverage_destroy(&cov);
+        assert(cov.bits == NULL);
+        canvas_destroy(&c);
+
+        printf("[Coverage New] Complete, all tests pass!\n");
+}
+
+void TST_CoverageSpan()
+{
+        // random rows across several words, every span against a pixel walk
+        srand(3);
+        int w = 200;
+        struct coverage cov = coverage(w, 6);
+        int *mask = mem_alloc(w * 6 * sizeof(int));
+        for (int i = 0; i < w * 6; i++) {
+                int y = i / w;
+                // sparse, dense, long runs crossing words, empty and full
+                int odds[6] = {10, 90, 0, 100, 50, 97};
+                int run = (y == 2) ? 0 : ((rand() % 100) < odds[y]);
+                if (y == 4) {
+                        run = (i % w) / 37 % 2;
+                }
+                mask[i] = run ? 1 : -1;
+        }
+        coverage_update(cov, mask, 0, 0, w - 1, 5);
+
+        int ranges[5][2] = {{0, 199}, {5, 130}, {63, 64}, {64, 127},
+                            {150, 300}};
+        for (int y = 0; y < 6; y++) {
+                for (int r = 0; r < 5; r++) {
+                        int x1 = ranges[r][0], x2 = ranges[r][1];
+                        int end = (x2 < w) ? x2 : w - 1;
+                        int x = x1, start, len, seen = 0;
+
+                        while ((len = coverage_span(cov, y, x, x2,
+                                                    &start)) > 0) {
+                                assert(start >= x && start + len - 1 <= end);
+                                for (int i = x; i < start; i++) {
+                                        assert(mask[y * w + i] < 0);
+                                }
+                                for (int i = start; i < start + len; i++) {
+                                        assert(mask[y * w + i] >= 0);
+                                }
+                                // each run is as long as it can be
+                                assert(start + len > end ||
+                                       mask[y * w + start + len] < 0);
+                                seen += len;
+                                x = start + len;
+                        }
+
+                        for (int i = x; i <= end; i++) {
+                                assert(mask[y * w + i] < 0);
+                        }
+
+                        int want = 0;
+                        for (int i = x1; i <= end; i++) {
+                                want += (mask[y * w + i] >= 0);
+                        }
+                        assert(seen == want);
+                }
+        }
+
+        int start;
+        assert(coverage_span(cov, 3, 0, w - 1, &start) == w);
+        assert(coverage_span(cov, 2, 0, w - 1, &start) == 0);
+        assert(coverage_span(cov, 6, 0, w - 1, &start) == 0);
+        assert(coverage_span(cov, 3, 50, 10, &start) == 0);
+
+        mem_free(mask);
+        coverage_destroy(&cov);
+
+        printf("[Coverage Span] Complete, all tests pass!\n");
+}
+
+int main()
+{
+        mem_init(16 * MEM_MEGABYTE);
+
+        TST_CoverageNew();
+        TST_CoverageSpan();
+
+        mem_destroy();
+
+        return 0;
+}
@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <stdint.h>
+
+#include <smallengine/sys/mem.h>
+#include <smallengine/graphics/hdr.h>
+#include <smallengine/graphics/canvas.h>
+#include <smallengine/graphics/color.h>
+
+static struct color16 _c16(int r, int g, int b, int a)
+{
+        struct color16 c = {r, g, b, a};
+        return c;
+}
+
+static int _c16_equal(struct color16 c1, struct color16 c2)
+{
+        return c1.r == c2.r && c1.g == c2.g && c1.b == c2.b && c1.a == c2.a;
+}
+
+void TST_HdrColor()
+{
+        struct color16 c = color16_from_color(color_rgb(0.5, 2.0, -1.0));
+        assert(c.r == 2048 && c.g == 8192 && c.b == 0 && c.a == COLOR16_ONE);
+        assert(color16_from_color(color_rgb(40.0, 0.0, 0.0)).r == 0xffff);
+        assert(color_equal(color16_to_color(c), color_rgb(0.5, 2.0, 0.0)));
+
+        // saturating rather than wrapping
+        struct color16 sum = color16_add(_c16(0xf000, 100, 0, 0),
+                                         _c16(0x2000, 200, 0, 0));
+        assert(_c16_equal(sum, _c16(0xffff, 300, 0, COLOR16_ONE)));
+
+        struct color16 prod = color16_multiply(_c16(8192, 2048, 0xffff, 0),
+                                               _c16(8192, 2048, 0xffff, 0));
+        assert(_c16_equal(prod, _c16(16384, 1024, 0xffff, COLOR16_ONE)));
+
+        printf("[Hdr Color] Complete, all tests pass!\n");
+}
+
+void TST_HdrSpans()
+{
+        // the span kernels must agree with the single color operations
+        struct color16 base[9], src[9], dst[9];
+        srand(7);
+        for (int i = 0; i < 9; i++) {
+                base[i] = _c16(rand() & 0xffff, rand() & 0x3fff,
+                               rand() & 0x0fff, rand() & 0xffff);
+                src[i] = _c16(rand() & 0xffff, rand() & 0x1fff,
+                              rand() & 0x0fff, rand() & 0xffff);
+        }
+
+        for (int mode = BLIT_ADD; mode <= BLIT_MUL; mode++) {
+                for (int i = 0; i < 9; i++) { dst[i] = base[i]; }
+                hdr_blend_span(dst, src, 9, mode);
+                for (int i = 0; i < 9; i++) {
+                        struct color16 want = (mode == BLIT_ADD) ?
+                                color16_add(base[i], src[i]) :
+                                color16_multiply(base[i], src[i]);
+                        assert(_c16_equal(dst[i], want));
+                }
+
+                for (int i = 0; i < 9; i++) { dst[i] = base[i]; }
+                hdr_fill_span(dst, src[4], 9, mode);
+                for (int i = 0; i < 9; i++) {
+                        struct color16 want = (mode == BLIT_ADD) ?
+                                color16_add(base[i], src[4]) :
+                                color16_multiply(base[i], src[4]);
+                        assert(_c16_equal(dst[i], want));
+                }
+        }
+
+        // packed output rounds as the double conversion does
+        uint32_t rgba[9], argb[9];
+        hdr_span_to_rgba32(base, rgba, 9, COLOR_RGBA);
+        hdr_span_to_rgba32(base, argb, 9, COLOR_ARGB);
+        for (int i = 0; i < 9; i++) {
+                struct color c = color16_to_color(base[i]);
+                assert(rgba[i] == color_to_RGBA(c));
+                assert(argb[i] == color_to_ARGB(c));
+        }
+
+        printf("[Hdr Spans] Complete, all tests pass!\n");
+}
+
+void TST_HdrBlit()
+{
+        // many additive lights stay distinguishable above white
+        struct hdr_canvas light = hdr_canvas(4, 4);
+        struct hdr_canvas hdr = hdr_canvas(10, 10);
+        hdr_canvas_fill(light, color16_from_color(color_rgb(0.5, 0.25, 0.0)));
+        hdr_canvas_clear(hdr);
+
+        for (int i = 0; i < 6; i++) {
+                hdr_canvas_blit(light, 0, 0, 3, 3, hdr, 2, 2, BLIT_ADD);
+        }
+        // partly off every edge
+        hdr_canvas_blit(light, 0, 0, 3, 3, hdr, -2, -2, BLIT_ADD);
+        hdr_canvas_blit(light, 0, 0, 3, 3, hdr, 8, 8, BLIT_ADD);
+        hdr_canvas_blit(light, 0, 0, 3, 3, hdr, 20, 0, BLIT_ADD);
+
+        struct canvas out = canvas(10, 10);
+        hdr_canvas_resolve(hdr, out);
+        assert(color_equal(canvas_read_pixel(out, 3, 3),
+                           color_rgb(3.0, 1.5, 0.0)));
+        assert(color_equal(canvas_read_pixel(out, 1, 1),
+                           color_rgb(0.5, 0.25, 0.0)));
+        assert(color_equal(canvas_read_pixel(out, 2, 2),
+                           color_rgb(3.0, 1.5, 0.0)));
+        assert(color_equal(canvas_read_pixel(out, 9, 9),
+                           color_rgb(0.5, 0.25, 0.0)));
+        assert(color_equal(canvas_read_pixel(out, 7, 0),
+                           color_rgb(0.0, 0.0, 0.0)));
+
+        // and back from a canvas, then darkened
+        struct hdr_canvas copy = hdr_canvas_from_canvas(out);
+        struct hdr_canvas half = hdr_canvas(10, 10);
+        hdr_canvas_fill(half, color16_from_color(color_rgb(0.5, 0.5, 0.5)));
+        hdr_canvas_blit(half, 0, 0, 9, 9, copy, 0, 0, BLIT_MUL);
+        hdr_canvas_resolve(copy, out);
+        assert(color_equal(canvas_read_pixel(out, 3, 3),
+                           color_rgb(1.5, 0.75, 0.0)));
+
+        hdr_canvas_destroy(&light);
+        hdr_canvas_destroy(&hdr);
+        hdr_canvas_destroy(&copy);
+        hdr_canvas_destroy(&half);
+        canvas_destroy(&out);
+
+        printf("[Hdr Blit] Complete, all tests pass!\n");
+}
+
+int main()
+{
+        mem_init(8 * MEM_MEGABYTE);
+
+        TST_HdrColor();
+        TST_HdrSpans();
+        TST_HdrBlit();
+
+        mem_destroy();
+
+        return 0;
+}
@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <stdint.h>
+
+#include <smallengine/sys/mem.h>
+#include <smallengine/graphics/indexed.h>
+#include <smallengine/graphics/texture.h>
+#include <smallengine/graphics/palette.h>
+#include <smallengine/graphics/canvas.h>
+#include <smallengine/graphics/color.h>
+
+/*
+ * a sprite of n colors with a transparent white border
+ */
+static struct canvas _sprite(int w, int h, int n)
+{
+        struct canvas c = canvas(w, h);
+        canvas_fill(c, color_rgb(1.0, 1.0, 1.0));
+        for (int y = 1; y < h - 1; y++) {
+                for (int x = 1; x < w - 1; x++) {
+                        int k = (x * 7 + y * 3) % n;
+                        canvas_write_pixel(c, x, y, color_rgb_int(k & 0xff,
+                                           k >> 8, 40), BLIT_ABS);
+                }
+        }
+        return c;
+}
+
+void TST_IndexedNew()
+{
+        struct color white = color_rgb(1.0, 1.0, 1.0);
+        struct canvas c = _sprite(8, 6, 5);
+        struct indexed_texture it = indexed_texture_from_canvas(c, &white);
+
+        assert(it.w == 8 && it.h == 6 && it.wide == 0);
+        assert(it.palette.assigned == 6);
+        assert(indexed_texture_read_index(it, 0, 0) == -1);
+        assert(indexed_texture_read_index(it, 9, 0) == -1);
+        assert(color_equal(palette_get_by_index(it.palette,
+                           indexed_texture_read_index(it, 3, 2)),
+                           canvas_read_pixel(c, 3, 2)));
+
+        // more than 255 colors needs 16 bit indices
+        struct canvas big = _sprite(40, 40, 300);
+        struct indexed_texture wide = indexed_texture_from_canvas(big, &white);
+        assert(wide.wide == 1 && wide.palette.assigned == 301);
+        assert(indexed_texture_read_index(wide, 0, 39) == -1);
+        assert(color_equal(palette_get_by_index(wide.palette,
+                           indexed_texture_read_index(wide, 30, 31)),
+                           canvas_read_pixel(big, 30, 31)));
+
+        indexed_texture_destroy(&it);
+        indexed_texture_destroy(&wide);
+        assert(it.indices == NULL);
+        canvas_destroy(&c);
+        canvas_destroy(&big);
+
+        printf("[Indexed New] Complete, all tests pass!\n");
+}
+
+void TST_IndexedBlit()
+{
+        struct color white = color_rgb(1.0, 1.0, 1.0);
+        struct canvas c = _sprite(12, 9, 4);
+        struct texture tex = texture_from_canvas(c, &white);
+        struct indexed_texture it = indexed_texture_from_texture(tex);
+
+        // the same as the texture, including clipping on every side
+        int spots[5][2] = {{3, 2}, {-4, -3}, {14, 13}, {0, 0}, {-20, 0}};
+        for (int mode = BLIT_ABS; mode <= BLIT_MUL; mode++) {
+                for (int s = 0; s < 5; s++) {
+                        struct canvas a = canvas(20, 16);
+                        struct canvas b = canvas(20, 16);
+                        canvas_pattern(a, color_rgb(0.2, 0.4, 0.6),
+                                       color_rgb(0.5, 0.5, 0.5), 3);
+                        canvas_pattern(b, color_rgb(0.2, 0.4, 0.6),
+                                       color_rgb(0.5, 0.5, 0.5), 3);
+
+                        texture_blit_to_canvas(tex, 1, 0, 10, 8, a,
+                                               spots[s][0], spots[s][1], mode);
+                        indexed_texture_blit(it, 1, 0, 10, 8, b,
+                                             spots[s][0], spots[s][1], mode);
+                        for (int i = 0; i < 20 * 16; i++) {
+                                assert(color_equal(canvas_pixels(a)[i],
+                                                   canvas_pixels(b)[i]));
+                        }
+
+                        canvas_destroy(&a);
+                        canvas_destroy(&b);
+                }
+        }
+
+        // the palette is shared, so swapping a color shows straight away
+        int index = indexed_texture_read_index(it, 1, 1);
+        struct color red = color_rgb(1.0, 0.0, 0.0);
+        palette_replace_index(tex.palette, index, red);
+        struct canvas out = canvas(12, 9);
+        indexed_texture_blit(it, 0, 0, 11, 8, out, 0, 0, BLIT_ABS);
+        assert(color_equal(canvas_read_pixel(out, 1, 1), red));
+
+        // onto a linear canvas the palette is converted as canvas_blit would
+        struct color grey = color_rgb(0.5, 0.5, 0.5);
+        palette_replace_index(tex.palette, index, grey);
+        canvas_set_color_space(out, COLOR_LINEAR);
+        indexed_texture_blit(it, 0, 0, 11, 8, out, 0, 0, BLIT_ABS);
+        assert(color_equal(canvas_read_pixel(out, 1, 1),
+                           color_convert(grey, COLOR_SRGB, COLOR_LINEAR)));
+
+        indexed_texture_destroy(&it);
+        assert(tex.palette.colors != NULL);
+        canvas_destroy(&out);
+        canvas_destroy(&c);
+
+        printf("[Indexed Blit] Complete, all tests pass!\n");
+}
+
+void TST_IndexedBlitRgba32()
+{
+        // a few colors for the shuffle path, many for the table path and
+        // 16 bit indices, all across widths that leave a scalar tail
+        struct color white = color_rgb(1.0, 1.0, 1.0);
+        int colors[4] = {9, 14, 200, 300};
+        int widths[3] = {37, 16, 5};
+
+        for (int n = 0; n < 4; n++) {
+                for (int w = 0; w < 3; w++) {
+                        struct canvas c = _sprite(widths[w], 7, colors[n]);
+                        struct indexed_texture it =
+                                indexed_texture_from_canvas(c, &white);
+
+                        int dw = 50, dh = 12, pitch = 53;
+                        uint32_t *px = mem_alloc(pitch * dh * sizeof(uint32_t));
+                        for (int i = 0; i < pitch * dh; i++) {
+                                px[i] = 0x12345678;
+                        }
+
+                        indexed_texture_blit_rgba32(it, 0, 0, c.w - 1, c.h - 1,
+                                                    px, dw, dh, pitch, 20, 8);
+
+                        for (int y = 0; y < dh; y++) {
+                                for (int x = 0; x < pitch; x++) {
+                                        int sx = x - 20, sy = y - 8;
+                                        int index = indexed_texture_read_index(
+                                                        it, sx, sy);
+                                        uint32_t want = 0x12345678;
+                                        if (x < dw && index >= 0) {
+                                                want = color_to_RGBA(
+                                                        canvas_read_pixel(c,
+                                                                sx, sy));
+                                        }
+                                        assert(px[y * pitch + x] == want);
+                                }
+                        }
+
+                        mem_free(px);
+                        indexed_texture_destroy(&it);
+                        canvas_destroy(&c);
+                }
+        }
+
+        // indices past a small palette are black, the shuffle only looks
+        // at their low bits so 17 must not come out as color 1
+        struct palette pal = palette(4);
+        palette_add_color(&pal, color_rgb(1.0, 0.0, 0.0));
+        palette_add_color(&pal, color_rgb(0.0, 1.0, 0.0));
+        uint8_t indices[48];
+        for (int i = 0; i < 48; i++) {
+                indices[i] = (i % 5 == 4) ? INDEXED_CLEAR_8 : i * 37 % 256;
+        }
+        struct indexed_texture it = {48, 1, 0, indices, pal, 0};
+        uint32_t px[48];
+        for (int i = 0; i < 48; i++) {
+                px[i] = 0x12345678;
+        }
+        indexed_texture_blit_rgba32(it, 0, 0, 47, 0, px, 48, 1, 48, 0, 0);
+        for (int i = 0; i < 48; i++) {
+                uint32_t want = color_to_RGBA(color_rgb(0.0, 0.0, 0.0));
+                if (indices[i] == INDEXED_CLEAR_8) {
+                        want = 0x12345678;
+                } else if (indices[i] < 2) {
+                        want = pal.packed[indices[i]];
+                }
+                assert(px[i] == want);
+        }
+        palette_destroy(&pal);
+
+        printf("[Indexed Blit Rgba32] Complete, all tests pass!\n");
+}
+
+int main()
+{
+        mem_init(16 * MEM_MEGABYTE);
+
+        TST_IndexedNew();
+        TST_IndexedBlit();
+        TST_IndexedBlitRgba32();
+
+        mem_destroy();
+
+        return 0;
+}
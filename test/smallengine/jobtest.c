@@ -0,0 +1,113 @@
+#include <stdio.h>
+#include <assert.h>
+
+#include <SDL2/SDL.h>
+
+#include <smallengine/sys/job.h>
+
+#define JOB_COUNT 1000
+#define JOB_BATCHES 2000
+
+/*
+ * batches alternate between two functions, each checking it was given its
+ * own batch. A worker still holding an old batch would call the wrong one
+ * or take an index from the new batch. Each call yields, so workers run in
+ * between even on a single core
+ */
+struct batch {
+        int id;
+        SDL_atomic_t calls[4];
+};
+
+static void _count_even(void *data, int index)
+{
+        struct batch *b = (struct batch *)data;
+        assert(b->id % 2 == 0);
+        SDL_AtomicAdd(&b->calls[index], 1);
+        SDL_Delay(0);
+}
+
+static void _count_odd(void *data, int index)
+{
+        struct batch *b = (struct batch *)data;
+        assert(b->id % 2 == 1);
+        SDL_AtomicAdd(&b->calls[index], 1);
+        SDL_Delay(0);
+}
+
+static void _run_small(int id)
+{
+        struct batch b = {id};
+        for (int i = 0; i < 4; i++) {
+                SDL_AtomicSet(&b.calls[i], 0);
+        }
+        job_parallel_for(4, (id % 2) ? _count_odd : _count_even, &b);
+        for (int i = 0; i < 4; i++) {
+                assert(SDL_AtomicGet(&b.calls[i]) == 1);
+        }
+}
+
+static void _square(void *data, int index)
+{
+        int *results = (int *)data;
+        results[index] = index * index;
+}
+
+void TST_JobSerial()
+{
+        int results[JOB_COUNT] = {0};
+
+        // without workers everything runs on the calling thread
+        assert(job_workers() == 0);
+        job_parallel_for(JOB_COUNT, _square, results);
+
+        for (int i = 0; i < JOB_COUNT; i++) {
+                assert(results[i] == i * i);
+        }
+
+        printf("[Job Serial] Complete, all tests pass!\n");
+}
+
+void TST_JobParallel()
+{
+        int results[JOB_COUNT] = {0};
+
+        assert(job_init(4) == 4);
+        assert(job_workers() == 4);
+
+        // run a few batches back to back
+        for (int run = 0; run < 20; run++) {
+                for (int i = 0; i < JOB_COUNT; i++) {
+                        results[i] = -1;
+                }
+
+                job_parallel_for(JOB_COUNT, _square, results);
+
+                for (int i = 0; i < JOB_COUNT; i++) {
+                        assert(results[i] == i * i);
+                }
+        }
+
+        job_quit();
+        assert(job_workers() == 0);
+
+        // many more workers than cores, most wake long after their batch
+        // is done
+        assert(job_init(31) == 31);
+        for (int run = 0; run < JOB_BATCHES; run++) {
+                _run_small(run);
+        }
+        job_quit();
+
+        printf("[Job Parallel] Complete, all tests pass!\n");
+}
+
+int main()
+{
+        TST_JobSerial();
+        TST_JobParallel();
+
+        SDL_Quit();
+
+        return 0;
+}
@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <assert.h>
+
+#include <SDL2/SDL.h>
+
+#include <smallengine/sys/mem.h>
+#include <smallengine/graphics/loader.h>
+#include <smallengine/graphics/atlas.h>
+#include <smallengine/graphics/texture.h>
+#include <smallengine/graphics/canvas.h>
+#include <smallengine/graphics/color.h>
+
+#define IMAGES 4
+
+static const char *files[IMAGES] = {"loadertest0.bmp", "loadertest1.bmp",
+                                    "loadertest2.bmp", "loadertest3.bmp"};
+
+/*
+ * images of different sizes, each a shade of its index with a white corner
+ */
+static struct canvas _image(int i)
+{
+        struct canvas c = canvas(8 + i * 40, 6 + i * 30);
+        canvas_fill(c, color_rgb_int(i * 60, 30, 200 - i * 40));
+        canvas_write_pixel(c, 0, 0, color_rgb(1.0, 1.0, 1.0), BLIT_ABS);
+        return c;
+}
+
+/*
+ * poll until n results have been taken, waiting for the loader threads
+ */
+static int _wait(struct loader_result *results, int n)
+{
+        int got = 0;
+        for (int tries = 0; got < n && tries < 5000; tries++) {
+                while (got < n && loader_poll(&results[got])) {
+                        got++;
+                }
+                if (got < n) {
+                        SDL_Delay(1);
+                }
+        }
+
+        return got;
+}
+
+void TST_LoaderLoad()
+{
+        struct color white = color_rgb(1.0, 1.0, 1.0);
+        struct loader_result r[IMAGES + 1];
+        int user[IMAGES];
+
+        for (int i = 0; i < IMAGES; i++) {
+                user[i] = i;
+                assert(loader_request_canvas(files[i], 0, &user[i]) > 0);
+        }
+        assert(loader_request_texture("loadertest_missing.bmp", NULL, 0,
+                                      NULL) > 0);
+        assert(loader_pending() == IMAGES + 1);
+
+        assert(_wait(r, IMAGES + 1) == IMAGES + 1);
+        assert(loader_pending() == 0);
+        assert(!loader_poll(&r[0]));
+
+        int seen = 0;
+        for (int i = 0; i < IMAGES + 1; i++) {
+                if (r[i].type == LOADER_TEXTURE) {
+                        assert(!r[i].ok && r[i].user == NULL);
+                        continue;
+                }
+
+                int k = *(int *)r[i].user;
+                assert(r[i].ok && r[i].type == LOADER_CANVAS);
+                struct canvas want = _image(k);
+                assert(r[i].canvas.w == want.w && r[i].canvas.h == want.h);
+                assert(color_equal(canvas_read_pixel(r[i].canvas, 3, 4),
+                                   canvas_read_pixel(want, 3, 4)));
+                canvas_destroy(&want);
+                canvas_destroy(&r[i].canvas);
+                seen |= 1 << k;
+        }
+        assert(seen == (1 << IMAGES) - 1);
+
+        // textures come back with the transparent pixels cleared
+        loader_request_texture(files[1], &white, 0, NULL);
+        assert(_wait(r, 1) == 1 && r[0].ok);
+        assert(r[0].texture.w == 48 && texture_read_mask(r[0].texture, 0,
+                                                         0) < 0);
+        assert(texture_hit(r[0].texture, 1, 0));
+
+        // sprites added to an atlas by the loader threads
+        struct atlas a = atlas(256, 256, 64, 1);
+        int ids[IMAGES];
+        for (int i = 0; i < IMAGES; i++) {
+                ids[i] = loader_request_atlas(files[i], &a, &white, i, NULL);
+        }
+        assert(_wait(r, IMAGES) == IMAGES);
+        for (int i = 0; i < IMAGES; i++) {
+                int k = 0;
+                while (ids[k] != r[i].id) {
+                        k++;
+                }
+                struct atlas_rect rect = atlas_get_rect(a, r[i].handle);
+                assert(r[i].ok && rect.w == 8 + k * 40);
+                assert(!texture_hit(a.tex, rect.x, rect.y));
+                assert(texture_hit(a.tex, rect.x + 1, rect.y));
+        }
+        atlas_destroy(&a);
+
+        printf("[Loader Load] Complete, all tests pass!\n");
+}
+
+void TST_LoaderOrder()
+{
+        // requests made before the loader starts all wait in the queue, so
+        // the single loader thread takes them strictly by priority
+        struct loader_result r[6];
+        int ids[6];
+        int priorities[6] = {1, 5, 3, 5, 9, 1};
+        for (int i = 0; i < 6; i++) {
+                ids[i] = loader_request_canvas(files[0], priorities[i], NULL);
+        }
+        assert(!loader_poll(&r[0]));
+
+        // cancel one still queued, it is never handed back
+        assert(loader_cancel(ids[2]));
+        assert(!loader_cancel(ids[2]));
+        assert(!loader_cancel(12345));
+        assert(loader_pending() == 5);
+
+        assert(loader_init(1) == 1);
+        assert(_wait(r, 5) == 5);
+        assert(loader_pending() == 0);
+
+        // highest priority first, in the order requested within each
+        int order[5] = {4, 1, 3, 0, 5};
+        for (int i = 0; i < 5; i++) {
+                assert(r[i].id == ids[order[i]]);
+                canvas_destroy(&r[i].canvas);
+        }
+
+        // cancel one that has finished but not been polled, the one behind
+        // it is still handed back
+        size_t used = mem_used();
+        ids[0] = loader_request_canvas(files[1], 0, NULL);
+        ids[1] = loader_request_canvas(files[0], 0, NULL);
+        SDL_Delay(100);
+        assert(loader_cancel(ids[0]));
+        assert(!loader_cancel(ids[0]));
+        assert(_wait(r, 1) == 1 && r[0].id == ids[1]);
+        assert(!loader_poll(&r[1]) && loader_pending() == 0);
+        canvas_destroy(&r[0].canvas);
+        assert(mem_used() == used);
+
+        printf("[Loader Order] Complete, all tests pass!\n");
+}
+
+void TST_LoaderQuit()
+{
+        size_t used = mem_used();
+
+        // anything never polled is freed when the loader stops
+        for (int i = 0; i < 20; i++) {
+                loader_request_texture(files[i % IMAGES], NULL, i % 3, NULL);
+        }
+        SDL_Delay(5);
+        loader_quit();
+
+        assert(mem_used() == used);
+        assert(loader_pending() == 0);
+
+        printf("[Loader Quit] Complete, all tests pass!\n");
+}
+
+int main()
+{
+        mem_init(64 * MEM_MEGABYTE);
+
+        for (int i = 0; i < IMAGES; i++) {
+                struct canvas c = _image(i);
+                canvas_export_to_bmp(c, files[i]);
+                canvas_destroy(&c);
+        }
+
+        TST_LoaderOrder();
+        TST_LoaderLoad();
+        TST_LoaderQuit();
+
+        for (int i = 0; i < IMAGES; i++) {
+                remove(files[i]);
+        }
+
+        mem_destroy();
+
+        return 0;
+}
@@ -0,0 +1,235 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#include <smallengine/sys/mem.h>
+#include <smallengine/sys/file.h>
+#include <smallengine/sys/job.h>
+#include <smallengine/sys/lz.h>
+
+#define GUARD 64
+#define LZ_FILE "lztest.lz"
+
+static uint32_t seed = 12345;
+
+static uint8_t _random(void)
+{
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        return seed & 0xff;
+}
+
+/*
+ * a mix of text, runs, short repeating patterns and noise
+ */
+static void _fill(uint8_t *data, size_t size)
+{
+        const char *text = "the quick brown fox jumps over the lazy dog, ";
+        size_t at = 0;
+
+        while (at < size) {
+                size_t n = 1 + _random() * 4;
+                int kind = _random() % 4;
+                for (size_t i = 0; i < n && at < size; i++, at++) {
+                        if (kind == 0) {
+                                data[at] = text[(at + i) % strlen(text)];
+                        } else if (kind == 1) {
+                                data[at] = 0;
+                        } else if (kind == 2) {
+                                data[at] = "abcdefg"[i % (1 + n % 7)];
+                        } else {
+                                data[at] = _random();
+                        }
+                }
+        }
+}
+
+/*
+ * decompress into exactly size bytes, returning what was written and
+ * checking nothing past the end was touched
+ */
+static size_t _decompress(const uint8_t *src, size_t size, uint8_t *dst,
+                          size_t capacity)
+{
+        memset(dst + capacity, 0xaa, GUARD);
+        size_t n = lz_decompress(src, size, dst, capacity);
+        for (int i = 0; i < GUARD; i++) {
+                assert(dst[capacity + i] == 0xaa);
+        }
+        return n;
+}
+
+static size_t _round_trip(const uint8_t *data, size_t size)
+{
+        uint8_t *packed = mem_alloc(lz_bound(size));
+        uint8_t *out = mem_alloc(size + GUARD);
+
+        size_t n = lz_compress(data, size, packed);
+        assert(n <= lz_bound(size));
+        assert(_decompress(packed, n, out, size) == size);
+        assert(memcmp(out, data, size) == 0);
+        if (size > 0) {
+                assert(_decompress(packed, n, out, size - 1) == 0);
+        }
+
+        mem_free(out);
+        mem_free(packed);
+        return n;
+}
+
+void TST_LzBlock()
+{
+        static uint8_t data[300000];
+
+        // every small size, including those too short for any copy
+        _fill(data, sizeof(data));
+        for (size_t size = 0; size < 64; size++) {
+                _round_trip(data, size);
+        }
+
+        assert(_round_trip(data, sizeof(data)) < sizeof(data) / 2);
+
+        // long runs need many length bytes, noise is stored as literals
+        memset(data, 7, sizeof(data));
+        assert(_round_trip(data, sizeof(data)) < 2000);
+        for (size_t i = 0; i < sizeof(data); i++) {
+                data[i] = _random();
+        }
+        assert(_round_trip(data, sizeof(data)) > sizeof(data));
+
+        printf("[Lz Block] Complete, all tests pass!\n");
+}
+
+void TST_LzCorrupt()
+{
+        static uint8_t data[4000], packed[5000], out[4000 + GUARD];
+
+        _fill(data, sizeof(data));
+        size_t n = lz_compress(data, sizeof(data), packed);
+
+        // cut short, a block never decompresses to its full size
+        for (size_t size = 0; size < n; size++) {
+                assert(_decompress(packed, size, out, sizeof(data)) !=
+                       sizeof(data));
+        }
+
+        // changed bytes never write outside the output
+        for (size_t i = 0; i < n; i++) {
+                for (int bit = 0; bit < 8; bit += 3) {
+                        packed[i] ^= 1 << bit;
+                        _decompress(packed, n, out, sizeof(data));
+                        packed[i] ^= 1 << bit;
+                }
+        }
+
+        // copies from before the start
+        uint8_t bad[] = {0x10, 'a', 0x02, 0x00, 0x10, 'b'};
+        assert(_decompress(bad, sizeof(bad), out, 100) == 0);
+
+        printf("[Lz Corrupt] Complete, all tests pass!\n");
+}
+
+void TST_LzFrame()
+{
+        // several blocks, one of noise which is stored as it is
+        size_t size = 3 * LZ_BLOCK_SIZE + 1000;
+        uint8_t *data = mem_alloc(size);
+        uint8_t *out = mem_alloc(size);
+        _fill(data, size);
+        for (size_t i = LZ_BLOCK_SIZE; i < 2 * LZ_BLOCK_SIZE; i++) {
+                data[i] = _random();
+        }
+
+        for (int workers = 0; workers <= 3; workers += 3) {
+                job_init(workers);
+
+                size_t n;
+                uint8_t *frame = lz_compress_frame(data, size, &n);
+                assert(n < size && lz_frame_size(frame, n) == size);
+                memset(out, 0, size);
+                assert(lz_decompress_frame(frame, n, out, size));
+                assert(memcmp(out, data, size) == 0);
+
+                // too little room, missing bytes and wrong block sizes
+                assert(!lz_decompress_frame(frame, n, out, size - 1));
+                assert(!lz_decompress_frame(frame, n - 1, out, size));
+                assert(lz_frame_size(frame, n - 1) == 0);
+                frame[LZ_HEADER_SIZE] ^= 1;
+                frame[LZ_HEADER_SIZE + 4] ^= 1;
+                assert(!lz_decompress_frame(frame, n, out, size));
+                frame[LZ_HEADER_SIZE] ^= 1;
+                frame[LZ_HEADER_SIZE + 4] ^= 1;
+                frame[0] = 'X';
+                assert(!lz_decompress_frame(frame, n, out, size));
+
+                mem_free(frame);
+                job_quit();
+        }
+
+        // an empty frame is just the header
+        size_t n;
+        uint8_t *frame = lz_compress_frame(data, 0, &n);
+        assert(n == LZ_HEADER_SIZE && lz_frame_size(frame, n) == 0);
+        assert(lz_decompress_frame(frame, n, out, 0));
+        mem_free(frame);
+
+        mem_free(out);
+        mem_free(data);
+
+        printf("[Lz Frame] Complete, all tests pass!\n");
+}
+
+void TST_LzFile()
+{
+        static uint8_t data[100000];
+        _fill(data, sizeof(data));
+
+        // compressed files map to their contents
+        assert(lz_write_file(LZ_FILE, data, sizeof(data)));
+        struct file_map map = file_map(LZ_FILE);
+        assert(map.size < sizeof(data));
+        file_unmap(&map);
+
+        map = lz_map_file(LZ_FILE, 0);
+        assert(map.size == sizeof(data) && !map.mapped);
+        assert(memcmp(map.data, data, sizeof(data)) == 0);
+        file_unmap(&map);
+
+        // other files are mapped as they are
+        FILE *f = fopen(LZ_FILE, "wb");
+        fwrite(data, 1, 1000, f);
+        fclose(f);
+        map = lz_map_file(LZ_FILE, 1);
+        assert(map.size == 1000 && memcmp(map.data, data, 1000) == 0);
+        file_unmap(&map);
+
+        // and broken ones not at all
+        size_t n;
+        uint8_t *frame = lz_compress_frame(data, sizeof(data), &n);
+        f = fopen(LZ_FILE, "wb");
+        fwrite(frame, 1, n / 2, f);
+        fclose(f);
+        map = lz_map_file(LZ_FILE, 0);
+        assert(map.data == NULL && map.size == 0);
+        mem_free(frame);
+
+        remove(LZ_FILE);
+
+        printf("[Lz File] Complete, all tests pass!\n");
+}
+
+int main()
+{
+        mem_init(16 * MEM_MEGABYTE);
+
+        TST_LzBlock();
+        TST_LzCorrupt();
+        TST_LzFrame();
+        TST_LzFile();
+
+        mem_destroy();
+
+        return 0;
+}
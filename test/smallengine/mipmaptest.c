@@ -0,0 +1,166 @@
+#include <stdio.h>
+#include <assert.h>
+
+#include <smallengine/sys/mem.h>
+#include <smallengine/sys/job.h>
+#include <smallengine/maths/maths.h>
+#include <smallengine/graphics/mipmap.h>
+#include <smallengine/graphics/canvas.h>
+#include <smallengine/graphics/color.h>
+
+void TST_MipmapLevels()
+{
+        assert(mipmap_count_levels(8, 8) == 3);
+        assert(mipmap_count_levels(8, 2) == 3);
+        assert(mipmap_count_levels(1, 1) == 0);
+
+        assert(mipmap_select_level(64, 64, 64, 64) == 0);
+        assert(mipmap_select_level(64, 64, 100, 100) == 0);
+        assert(mipmap_select_level(64, 64, 32, 32) == 1);
+        assert(mipmap_select_level(64, 64, 20, 20) == 1);
+        assert(mipmap_select_level(64, 64, 16, 30) == 1);
+        assert(mipmap_select_level(64, 64, 1, 1) == 6);
+
+        printf("[Mipmap Levels] Complete, all tests pass!\n");
+}
+
+void TST_MipmapBox()
+{
+        struct color white = color_rgb(1.0, 1.0, 1.0);
+        struct color black = color_rgb(0.0, 0.0, 0.0);
+        struct color grey = color_rgb(0.5, 0.5, 0.5);
+
+        // single pixel squares average to grey
+        struct canvas c = canvas(64, 32);
+        canvas_pattern(c, white, black, 1);
+
+        struct canvas half = canvas_mip(c, 1, MIP_BOX);
+        assert(half.w == 32);
+        assert(half.h == 16);
+        assert(color_equal(canvas_read_pixel(half, 0, 0), grey) == 1);
+        assert(color_equal(canvas_read_pixel(half, 31, 15), grey) == 1);
+
+        struct canvas smallest = canvas_mip(c, 20, MIP_BOX);
+        assert(smallest.w == 1);
+        assert(smallest.h == 1);
+        assert(color_equal(canvas_read_pixel(smallest, 0, 0), grey) == 1);
+
+        // levels are kept until the canvas changes
+        assert(canvas_pixels(canvas_mip(c, 1, MIP_BOX)) == canvas_pixels(half));
+
+        canvas_fill(c, white);
+        half = canvas_mip(c, 1, MIP_BOX);
+        assert(color_equal(canvas_read_pixel(half, 5, 5), white) == 1);
+
+        canvas_destroy(&c);
+
+        printf("[Mipmap Box] Complete, all tests pass!\n");
+}
+
+void TST_MipmapKaiser()
+{
+        struct color white = color_rgb(1.0, 1.0, 1.0);
+        struct color black = color_rgb(0.0, 0.0, 0.0);
+
+        // a flat image stays flat
+        struct canvas c = canvas(33, 17);
+        canvas_fill(c, white);
+        struct canvas half = canvas_mip(c, 1, MIP_KAISER);
+        assert(half.w == 16);
+        assert(half.h == 8);
+        assert(color_equal(canvas_read_pixel(half, 0, 0), white) == 1);
+        assert(color_equal(canvas_read_pixel(half, 15, 7), white) == 1);
+        assert(double_equal(canvas_read_pixel(half, 7, 3).a, 1.0) == 1);
+
+        // left half white, right half black, the edge is kept
+        canvas_fill(c, black);
+        for (int x = 0; x < 16; x++) {
+                for (int y = 0; y < 17; y++) {
+                        canvas_write_pixel(c, x, y, white, BLIT_ABS);
+                }
+        }
+        half = canvas_mip(c, 1, MIP_KAISER);
+        assert(color_equal(canvas_read_pixel(half, 2, 2), white) == 1);
+        assert(color_equal(canvas_read_pixel(half, 13, 2), black) == 1);
+
+        canvas_destroy(&c);
+
+        printf("[Mipmap Kaiser] Complete, all tests pass!\n");
+}
+
+void TST_MipmapOddScaled()
+{
+        struct color white = color_rgb(1.0, 1.0, 1.0);
+        struct color black = color_rgb(0.0, 0.0, 0.0);
+
+        // levels of sizes that don't halve evenly are rounded down, every
+        // pixel drawn from them still lands inside the level
+        int sizes[3][4] = {{11, 11, 2, 2}, {13, 7, 3, 2}, {9, 30, 4, 7}};
+        for (int i = 0; i < 3; i++) {
+                struct canvas src = canvas(sizes[i][0], sizes[i][1]);
+                struct canvas dst = canvas(8, 8);
+                canvas_fill(src, white);
+                canvas_fill(dst, black);
+
+                canvas_blit_scaled(src, 0, 0, src.w - 1, src.h - 1, dst, 0, 0,
+                                   sizes[i][2] - 1, sizes[i][3] - 1, BLIT_ABS);
+                for (int y = 0; y < 8; y++) {
+                        for (int x = 0; x < 8; x++) {
+                                int in = (x < sizes[i][2] && y < sizes[i][3]);
+                                assert(color_equal(canvas_read_pixel(dst, x, y),
+                                                   in ? white : black));
+                        }
+                }
+
+                canvas_destroy(&src);
+                canvas_destroy(&dst);
+        }
+
+        printf("[Mipmap Odd Scaled] Complete, all tests pass!\n");
+}
+
+void TST_MipmapParallel()
+{
+        struct color white = color_rgb(1.0, 1.0, 1.0);
+        struct color red = color_rgb(1.0, 0.0, 0.0);
+
+        struct canvas c = canvas(256, 200);
+        canvas_pattern(c, white, red, 3);
+
+        // build serially, then in parallel, both must agree
+        struct canvas serial = canvas(128, 100);
+        mipmap_downsample(c, serial, MIP_KAISER);
+
+        job_init(3);
+        struct canvas parallel = canvas(128, 100);
+        mipmap_downsample(c, parallel, MIP_KAISER);
+        job_quit();
+
+        for (int y = 0; y < 100; y++) {
+                for (int x = 0; x < 128; x++) {
+                        assert(color_equal(canvas_read_pixel(serial, x, y),
+                                canvas_read_pixel(parallel, x, y)) == 1);
+                }
+        }
+
+        canvas_destroy(&c);
+        canvas_destroy(&serial);
+        canvas_destroy(&parallel);
+
+        printf("[Mipmap Parallel] Complete, all tests pass!\n");
+}
+
+int main()
+{
+        mem_init(32 * MEM_MEGABYTE);
+
+        TST_MipmapLevels();
+        TST_MipmapBox();
+        TST_MipmapKaiser();
+        TST_MipmapOddScaled();
+        TST_MipmapParallel();
+
+        mem_destroy();
+
+        return 0;
+}
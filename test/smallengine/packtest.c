@@ -0,0 +1,262 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <smallengine/sys/mem.h>
+#include <smallengine/graphics/pack.h>
+#include <smallengine/graphics/atlas.h>
+#include <smallengine/graphics/texture.h>
+#include <smallengine/graphics/palette.h>
+#include <smallengine/graphics/canvas.h>
+#include <smallengine/graphics/color.h>
+#include <smallengine/graphics/coverage.h>
+
+#define PACK_FILE "packtest.pack"
+
+/*
+ * a canvas of a few colors with a white border to be made transparent
+ */
+static struct canvas _image(int w, int h, int seed)
+{
+        struct canvas c = canvas(w, h);
+        for (int y = 0; y < h; y++) {
+                for (int x = 0; x < w; x++) {
+                        struct color col = color_rgb_int((x * 3 + seed) % 5 *
+                                                         50, y % 3 * 80, 60);
+                        if (x == 0 || y == 0) {
+                                col = color_rgb(1.0, 1.0, 1.0);
+                        }
+                        canvas_write_pixel(c, x, y, col, BLIT_ABS);
+                }
+        }
+        return c;
+}
+
+static int _same(struct canvas a, struct canvas b)
+{
+        if (a.w != b.w || a.h != b.h) {
+                return 0;
+        }
+        for (int y = 0; y < a.h; y++) {
+                for (int x = 0; x < a.w; x++) {
+                        if (!color_equal(canvas_read_pixel(a, x, y),
+                                         canvas_read_pixel(b, x, y))) {
+                                return 0;
+                        }
+                }
+        }
+        return 1;
+}
+
+/*
+ * draw a texture over green, as the tests compare what is drawn
+ */
+static struct canvas _drawn(struct texture tex)
+{
+        struct canvas out = canvas(tex.w + 2, tex.h + 2);
+        canvas_fill(out, color_rgb(0.0, 1.0, 0.0));
+        texture_blit_to_canvas(tex, 0, 0, tex.w - 1, tex.h - 1, out, 1, 1,
+                               BLIT_ABS);
+        return out;
+}
+
+void TST_PackRoundTrip()
+{
+        struct color white = color_rgb(1.0, 1.0, 1.0);
+        struct canvas img = _image(70, 9, 1);
+        struct texture tex = texture_from_canvas(img, &white);
+        struct palette pal = palette_from_canvas(img);
+
+        struct canvas sprites[3] = {_image(5, 7, 2), _image(12, 4, 3),
+                                    _image(9, 9, 4)};
+        struct atlas a = atlas(32, 32, 256, 1);
+        int handles[3];
+        for (int i = 0; i < 3; i++) {
+                handles[i] = atlas_add_canvas(&a, sprites[i], &white);
+                assert(handles[i] >= 0);
+        }
+
+        struct pack_writer w = pack_writer(PACK_FILE);
+        assert(w.ok);
+        assert(pack_add_canvas(&w, "image", img));
+        assert(pack_add_texture(&w, "image", tex));
+        assert(pack_add_palette(&w, "colors", pal));
+        assert(pack_add_atlas(&w, "sprites", a));
+        char long_name[PACK_NAME_SIZE + 1];
+        memset(long_name, 'x', PACK_NAME_SIZE);
+        long_name[PACK_NAME_SIZE] = '\0';
+        assert(!pack_add_canvas(&w, long_name, img));
+        assert(pack_writer_finish(&w));
+
+        struct pack p = pack_open(PACK_FILE);
+        assert(p.count == 4);
+        for (int i = 0; i < p.count; i++) {
+                assert(p.entries[i].offset % PACK_ALIGN == 0);
+        }
+
+        // the same name can be used by different types
+        assert(pack_find(p, "image", PACK_CANVAS) >= 0);
+        assert(pack_find(p, "image", PACK_TEXTURE) >= 0);
+        assert(pack_find(p, "image", PACK_ATLAS) < 0);
+        assert(pack_find(p, "missing", PACK_CANVAS) < 0);
+        assert(pack_get_canvas(p, "missing").w == 0);
+        assert(pack_get_texture(p, "colors").mask == NULL);
+
+        struct canvas c = pack_get_canvas(p, "image");
+        assert(_same(c, img));
+        canvas_destroy(&c);
+
+        struct texture t = pack_get_texture(p, "image");
+        assert(t.w == tex.w && t.h == tex.h);
+        assert(t.palette.assigned == tex.palette.assigned);
+        assert(memcmp(t.mask, tex.mask, tex.w * tex.h * sizeof(int)) == 0);
+        assert(coverage_count(t.coverage) == coverage_count(tex.coverage));
+        assert(!texture_hit(t, 0, 3) && texture_hit(t, 69, 8));
+        struct canvas want = _drawn(tex), got = _drawn(t);
+        assert(_same(want, got));
+        canvas_destroy(&want);
+        canvas_destroy(&got);
+
+        struct palette q = pack_get_palette(p, "colors");
+        assert(q.assigned == pal.assigned && q.size == q.assigned);
+        for (int i = 0; i < pal.assigned; i++) {
+                assert(color_equal(palette_get_by_index(q, i),
+                                   palette_get_by_index(pal, i)));
+                assert(q.packed[i] == pal.packed[i]);
+        }
+
+        // atlases come back read only but draw the same
+        struct atlas b = pack_get_atlas(p, "sprites");
+        assert(b.count == a.count && b.skyline == NULL);
+        for (int i = 0; i < 3; i++) {
+                struct atlas_rect r = atlas_get_rect(a, handles[i]);
+                struct atlas_rect s = atlas_get_rect(b, handles[i]);
+                assert(r.x == s.x && r.y == s.y && r.w == s.w && r.h == s.h);
+
+                struct canvas out1 = canvas(r.w, r.h);
+                struct canvas out2 = canvas(r.w, r.h);
+                canvas_fill(out1, color_rgb(0.0, 1.0, 0.0));
+                canvas_fill(out2, color_rgb(0.0, 1.0, 0.0));
+                atlas_blit(a, handles[i], out1, 0, 0, BLIT_ABS);
+                atlas_blit(b, handles[i], out2, 0, 0, BLIT_ABS);
+                assert(_same(out1, out2));
+                canvas_destroy(&out1);
+                canvas_destroy(&out2);
+        }
+        assert(atlas_add_canvas(&b, sprites[0], &white) < 0);
+        assert(!atlas_repack(&b, 64, 64));
+        atlas_remove(&b, handles[0]);
+        assert(atlas_get_rect(b, handles[0]).w == sprites[0].w);
+
+        // releasing what is returned frees only what wasn't in the file
+        size_t used = mem_used();
+        for (int i = 0; i < 100; i++) {
+                struct texture u = pack_get_texture(p, "image");
+                texture_mip(u, 1, MIP_BOX);
+                struct atlas v = pack_get_atlas(p, "sprites");
+                texture_destroy(&u);
+                atlas_destroy(&v);
+        }
+        assert(mem_used() == used);
+
+        // writing to what is returned doesn't change the file
+        canvas_fill(t.canvas, color_rgb(0.0, 0.0, 0.0));
+        texture_destroy(&t);
+        atlas_destroy(&b);
+        pack_close(&p);
+        assert(p.count == 0);
+
+        p = pack_open(PACK_FILE);
+        c = pack_get_canvas(p, "image");
+        assert(_same(c, img));
+        canvas_destroy(&c);
+        size_t size = p.map.size;
+        pack_close(&p);
+
+        // a compressed pack is smaller and opens the same
+        assert(pack_compress(PACK_FILE));
+        p = pack_open(PACK_FILE);
+        assert(p.count == 4 && !p.map.mapped && p.map.size == size);
+        c = pack_get_canvas(p, "image");
+        assert(_same(c, img));
+        canvas_destroy(&c);
+        t = pack_get_texture(p, "image");
+        assert(!texture_hit(t, 0, 3) && texture_hit(t, 69, 8));
+        texture_destroy(&t);
+        pack_close(&p);
+        struct file_map map = file_map(PACK_FILE);
+        assert(map.size < size / 2);
+        file_unmap(&map);
+
+        atlas_destroy(&a);
+        texture_destroy(&tex);
+        for (int i = 0; i < 3; i++) {
+                canvas_destroy(&sprites[i]);
+        }
+        palette_destroy(&pal);
+        canvas_destroy(&img);
+        remove(PACK_FILE);
+
+        printf("[Pack Round Trip] Complete, all tests pass!\n");
+}
+
+void TST_PackBadFile()
+{
+        struct pack p = pack_open("packtest_missing.pack");
+        assert(p.count == 0 && pack_find(p, "x", PACK_CANVAS) < 0);
+
+        // not a pack
+        FILE *f = fopen(PACK_FILE, "wb");
+        fputs("this is not a pack file, but it is long enough to be one", f);
+        fclose(f);
+        p = pack_open(PACK_FILE);
+        assert(p.count == 0);
+
+        // an index that runs past the end of the file
+        struct canvas img = _image(4, 4, 0);
+        struct pack_writer w = pack_writer(PACK_FILE);
+        assert(pack_add_canvas(&w, "image", img));
+        assert(pack_writer_finish(&w));
+
+        f = fopen(PACK_FILE, "r+b");
+        struct pack_header head;
+        assert(fread(&head, sizeof(head), 1, f) == 1);
+        head.count = 1000;
+        fseek(f, 0, SEEK_SET);
+        fwrite(&head, sizeof(head), 1, f);
+        fclose(f);
+        p = pack_open(PACK_FILE);
+        assert(p.count == 0);
+
+        // an asset that runs past the end of the file
+        f = fopen(PACK_FILE, "r+b");
+        head.count = 1;
+        fwrite(&head, sizeof(head), 1, f);
+        struct pack_entry e;
+        fseek(f, head.index, SEEK_SET);
+        assert(fread(&e, sizeof(e), 1, f) == 1);
+        e.h = 4000;
+        fseek(f, head.index, SEEK_SET);
+        fwrite(&e, sizeof(e), 1, f);
+        fclose(f);
+        p = pack_open(PACK_FILE);
+        assert(p.count == 0);
+
+        canvas_destroy(&img);
+        remove(PACK_FILE);
+
+        printf("[Pack Bad File] Complete, all tests pass!\n");
+}
+
+int main()
+{
+        mem_init(16 * MEM_MEGABYTE);
+
+        TST_PackRoundTrip();
+        TST_PackBadFile();
+
+        mem_destroy();
+
+        return 0;
+}
@@ -25,13 +25,13 @@ void TST_PaletteAddColor()
         struct color c = color_rgb(0.5, 0.25, 0.0);
         palette_add_color(&p, c);
 
-        assert(color_equal(*(p.colors[0]), c) == 1);
+        assert(color_equal(p.colors[0], c) == 1);
         assert(p.assigned == 1);
 
         struct color c1 = color_rgb(1.0, 1.0, 1.0);
         palette_add_color(&p, c1);
 
-        assert(color_equal(*(p.colors[1]), c1) == 1);
+        assert(color_equal(p.colors[1], c1) == 1);
         assert(p.assigned == 2);
 
         assert(palette_add_color(&p, c1) == 0);
@@ -155,6 +155,93 @@ void TST_PaletteFromCanvas()
         printf("[Palette From Canvas] Complete, all tests pass!\n");
 }
 
+void TST_PaletteFromCanvasIndexed()
+{
+        // enough colors to grow the hash several times, each used twice
+        struct canvas c = canvas(256, 64);
+        for (int y = 0; y < c.h; y++) {
+                for (int x = 0; x < c.w; x++) {
+                        int n = (y % 32) * c.w + x;
+                        canvas_write_pixel(c, x, y, color_rgb_int(n & 0xff,
+                                           n >> 8, 7), BLIT_ABS);
+                }
+        }
+        // a color within color_equal's threshold of another is the same one
+        canvas_write_pixel(c, 5, 40, color_rgb(5.0 / 255.0 + 0.000001,
+                           8.0 / 255.0, 7.0 / 255.0), BLIT_ABS);
+
+        int *indices = (int *)mem_alloc(c.w * c.h * sizeof(int));
+        struct palette pal = palette_from_canvas_indexed(c, indices);
+
+        assert(pal.assigned == 256 * 32);
+        for (int i = 0; i < c.w * c.h; i++) {
+                assert(indices[i] == i % (256 * 32));
+                assert(color_equal(palette_get_by_index(pal, indices[i]),
+                                   canvas_read_pixel(c, i % c.w, i / c.w)));
+        }
+        assert(palette_check_color(pal, color_rgb_int(255, 31, 7)) ==
+               256 * 32 - 1);
+
+        palette_destroy(&pal);
+        mem_free(indices);
+        canvas_destroy(&c);
+
+        // colors within the threshold but either side of a rounding boundary
+        // are still the same, and one equal to two others takes the first as
+        // palette_check_color would
+        double r[7] = {1000.5 / 65536 - 0.000003, 1000.5 / 65536 + 0.000003,
+                       100.0 / 4096 - 0.000003, 100.0 / 4096 + 0.000003,
+                       0.5, 0.5 + 0.000016, 0.5 + 0.000008};
+        int expect[7] = {0, 0, 1, 1, 2, 3, 2};
+        c = canvas(7, 1);
+        for (int x = 0; x < c.w; x++) {
+                canvas_write_pixel(c, x, 0, color_rgb(r[x], 0.0, 0.0),
+                                   BLIT_ABS);
+        }
+
+        int near[7];
+        pal = palette_from_canvas_indexed(c, near);
+        assert(pal.assigned == 4);
+        for (int x = 0; x < c.w; x++) {
+                assert(near[x] == expect[x]);
+                assert(palette_check_color(pal, color_rgb(r[x], 0.0, 0.0)) ==
+                       expect[x]);
+        }
+
+        palette_destroy(&pal);
+        canvas_destroy(&c);
+
+        printf("[Palette From Canvas Indexed] Complete, all tests pass!\n");
+}
+
+void TST_PalettePacked()
+{
+        struct palette p = palette(3);
+        struct color r = color_rgb(1.0, 0.0, 0.0);
+        struct color g = color_rgb(0.0, 1.0, 0.0);
+        struct color b = color_rgb(0.0, 0.0, 1.0);
+
+        palette_add_color(&p, r);
+        palette_add_color(&p, g);
+
+        // the colors sit side by side with their packed copies kept in step
+        assert(&p.colors[1] == &p.colors[0] + 1);
+        assert(p.packed[0] == color_to_RGBA(r));
+        assert(palette_get_packed(p, 1) == color_to_RGBA(g));
+        assert(palette_get_packed(p, 2) == color_to_RGBA(color_rgb(0, 0, 0)));
+
+        palette_replace_color(p, g, b);
+        assert(palette_get_packed(p, 1) == color_to_RGBA(b));
+        palette_replace_index(p, 0, g);
+        assert(p.packed[0] == color_to_RGBA(g));
+        assert(color_equal(p.colors[0], g));
+
+        palette_destroy(&p);
+        assert(p.colors == NULL && p.packed == NULL);
+
+        printf("[Palette Packed] Complete, all tests pass!\n");
+}
+
 int main()
 {
         mem_init(MEM_MEGABYTE * 50);
@@ -166,6 +253,8 @@ int main()
         TST_ReplaceColor();
         TST_ReplaceIndex();
         TST_PaletteFromCanvas();
+        TST_PaletteFromCanvasIndexed();
+        TST_PalettePacked();
 
         mem_destroy();
 
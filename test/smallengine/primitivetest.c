@@ -0,0 +1,162 @@
+#include <stdio.h>
+#include <assert.h>
+
+#include <smallengine/sys/mem.h>
+#include <smallengine/maths/maths.h>
+#include <smallengine/maths/tuple.h>
+#include <smallengine/graphics/primitive.h>
+#include <smallengine/graphics/canvas.h>
+#include <smallengine/graphics/color.h>
+
+/*
+ * shapes are drawn additively at 0.25 so any pixel written twice shows up,
+ * returns the number of pixels written
+ */
+static int _count_pixels(struct canvas c)
+{
+        int count = 0;
+        for (int y = 0; y < c.h; y++) {
+                for (int x = 0; x < c.w; x++) {
+                        double r = canvas_read_pixel(c, x, y).r;
+                        assert(double_equal(r, 0.0) || double_equal(r, 0.25));
+                        count += double_equal(r, 0.25);
+                }
+        }
+
+        return count;
+}
+
+void TST_PrimitiveLine()
+{
+        struct canvas c = canvas(40, 40);
+        struct color col = color_rgb(0.25, 0.25, 0.25);
+
+        primitive_line(c, 2, 3, 30, 10, col, BLIT_ADD);
+        assert(_count_pixels(c) == 29);
+        assert(double_equal(canvas_read_pixel(c, 2, 3).r, 0.25) == 1);
+        assert(double_equal(canvas_read_pixel(c, 30, 10).r, 0.25) == 1);
+
+        canvas_clear(c);
+        primitive_line(c, 5, 35, 8, 1, col, BLIT_ADD);
+        assert(_count_pixels(c) == 35);
+
+        // clipped against the canvas
+        canvas_clear(c);
+        primitive_line(c, -10, 5, 100, 5, col, BLIT_ADD);
+        assert(_count_pixels(c) == 40);
+
+        canvas_destroy(&c);
+
+        printf("[Primitive Line] Complete, all tests pass!\n");
+}
+
+void TST_PrimitiveRect()
+{
+        struct canvas c = canvas(40, 40);
+        struct color col = color_rgb(0.25, 0.25, 0.25);
+
+        primitive_rect(c, 30, 20, 5, 5, col, BLIT_ADD);
+        assert(_count_pixels(c) == 2 * 26 + 2 * 14);
+        assert(double_equal(canvas_read_pixel(c, 10, 10).r, 0.0) == 1);
+
+        canvas_clear(c);
+        primitive_rect_fill(c, 5, 5, 30, 20, col, BLIT_ADD);
+        assert(_count_pixels(c) == 26 * 16);
+
+        canvas_clear(c);
+        primitive_rect_fill(c, -5, -5, 4, 4, col, BLIT_ADD);
+        assert(_count_pixels(c) == 25);
+
+        canvas_destroy(&c);
+
+        printf("[Primitive Rect] Complete, all tests pass!\n");
+}
+
+void TST_PrimitiveCircle()
+{
+        struct canvas c = canvas(60, 60);
+        struct color col = color_rgb(0.25, 0.25, 0.25);
+
+        primitive_circle_fill(c, 30, 30, 20, col, BLIT_ADD);
+        int area = _count_pixels(c);
+        assert(area > 1250 && area < 1350);
+        assert(double_equal(canvas_read_pixel(c, 30, 10).r, 0.25) == 1);
+        assert(double_equal(canvas_read_pixel(c, 50, 30).r, 0.25) == 1);
+        assert(double_equal(canvas_read_pixel(c, 45, 45).r, 0.0) == 1);
+
+        canvas_clear(c);
+        primitive_circle(c, 30, 30, 20, col, BLIT_ADD);
+        int edge = _count_pixels(c);
+        assert(edge > 100 && edge < 130);
+        assert(double_equal(canvas_read_pixel(c, 30, 30).r, 0.0) == 1);
+        assert(double_equal(canvas_read_pixel(c, 10, 30).r, 0.25) == 1);
+
+        canvas_clear(c);
+        primitive_ellipse_fill(c, 30, 30, 25, 10, col, BLIT_ADD);
+        area = _count_pixels(c);
+        assert(area > 800 && area < 880);
+        assert(double_equal(canvas_read_pixel(c, 55, 30).r, 0.25) == 1);
+        assert(double_equal(canvas_read_pixel(c, 30, 41).r, 0.0) == 1);
+
+        canvas_clear(c);
+        primitive_ellipse(c, 30, 30, 25, 10, col, BLIT_ADD);
+        edge = _count_pixels(c);
+        assert(edge > 100 && edge < 140);
+
+        canvas_clear(c);
+        primitive_ellipse(c, 30, 30, 5, 0, col, BLIT_ADD);
+        assert(_count_pixels(c) == 11);
+
+        canvas_destroy(&c);
+
+        printf("[Primitive Circle] Complete, all tests pass!\n");
+}
+
+void TST_PrimitivePolygon()
+{
+        struct canvas c = canvas(40, 40);
+        struct color col = color_rgb(0.25, 0.25, 0.25);
+
+        point square[4] = {point_2d(2.0, 2.0), point_2d(12.0, 2.0),
+                           point_2d(12.0, 12.0), point_2d(2.0, 12.0)};
+        primitive_polygon_fill(c, square, 4, col, BLIT_ADD);
+        assert(_count_pixels(c) == 100);
+
+        // two triangles sharing an edge cover each pixel once
+        point tri1[3] = {point_2d(0.0, 0.0), point_2d(37.0, 3.0), 
+                         point_2d(5.0, 31.0)};
+        point tri2[3] = {point_2d(37.0, 3.0), point_2d(30.0, 39.0), 
+                         point_2d(5.0, 31.0)};
+        canvas_clear(c);
+        primitive_polygon_fill(c, tri1, 3, col, BLIT_ADD);
+        primitive_polygon_fill(c, tri2, 3, col, BLIT_ADD);
+        assert(_count_pixels(c) > 0);
+
+        // a star uses the even-odd rule, the centre is left empty
+        point star[5] = {point_2d(20.0, 2.0), point_2d(31.0, 36.0),
+                         point_2d(2.0, 14.0), point_2d(38.0, 14.0),
+                         point_2d(9.0, 36.0)};
+        canvas_clear(c);
+        primitive_polygon_fill(c, star, 5, col, BLIT_ADD);
+        _count_pixels(c);
+        assert(double_equal(canvas_read_pixel(c, 20, 20).r, 0.0) == 1);
+        assert(double_equal(canvas_read_pixel(c, 20, 8).r, 0.25) == 1);
+
+        canvas_destroy(&c);
+
+        printf("[Primitive Polygon] Complete, all tests pass!\n");
+}
+
+int main()
+{
+        mem_init(8 * MEM_MEGABYTE);
+
+        TST_PrimitiveLine();
+        TST_PrimitiveRect();
+        TST_PrimitiveCircle();
+        TST_PrimitivePolygon();
+
+        mem_destroy();
+
+        return 0;
+}
@@ -0,0 +1,187 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <stdint.h>
+
+#include <smallengine/sys/mem.h>
+#include <smallengine/sys/job.h>
+#include <smallengine/graphics/quantise.h>
+#include <smallengine/graphics/palette.h>
+#include <smallengine/graphics/canvas.h>
+#include <smallengine/graphics/color.h>
+
+static struct palette _black_white()
+{
+        struct palette p = palette(2);
+        palette_add_color(&p, color_rgb(0.0, 0.0, 0.0));
+        palette_add_color(&p, color_rgb(1.0, 1.0, 1.0));
+        return p;
+}
+
+static double _white_share(struct canvas c)
+{
+        int white = 0;
+        for (int y = 0; y < c.h; y++) {
+                for (int x = 0; x < c.w; x++) {
+                        white += (canvas_read_pixel(c, x, y).r > 0.5);
+                }
+        }
+        return (double)white / (c.w * c.h);
+}
+
+void TST_QuantiseNearest()
+{
+        // the corners of the RGB cube
+        struct palette p = palette(8);
+        for (int i = 0; i < 8; i++) {
+                palette_add_color(&p, color_rgb(i & 1, (i >> 1) & 1,
+                                                (i >> 2) & 1));
+        }
+
+        struct quantiser q = quantiser(p);
+        assert(q.count == 8);
+        for (int i = 0; i < 8; i++) {
+                assert(quantiser_nearest(q, palette_get_by_index(p, i)) == i);
+        }
+        assert(quantiser_nearest(q, color_rgb(0.9, 0.2, 0.6)) == 5);
+        assert(quantiser_nearest(q, color_rgb(-3.0, 0.2, 7.0)) == 4);
+
+        // a gradient without dithering splits at the half way point
+        struct canvas src = canvas(64, 4);
+        struct canvas dst = canvas(64, 4);
+        for (int x = 0; x < 64; x++) {
+                for (int y = 0; y < 4; y++) {
+                        canvas_write_pixel(src, x, y, color_rgb(x / 63.0, 0.0,
+                                           0.0), BLIT_ABS);
+                }
+        }
+
+        uint16_t indices[64 * 4];
+        quantiser_canvas(q, src, dst, indices, DITHER_NONE);
+        for (int x = 0; x < 64; x++) {
+                int want = (x < 32) ? 0 : 1;
+                assert(indices[x] == want);
+                assert(color_equal(canvas_read_pixel(dst, x, 3),
+                                   palette_get_by_index(p, want)));
+        }
+
+        struct palette empty = palette(4);
+        struct quantiser none = quantiser(empty);
+        assert(quantiser_nearest(none, color_rgb(1.0, 1.0, 1.0)) == -1);
+        quantiser_canvas(none, src, dst, NULL, DITHER_NONE);
+
+        quantiser_destroy(&none);
+        quantiser_destroy(&q);
+        palette_destroy(&empty);
+        palette_destroy(&p);
+        canvas_destroy(&src);
+        canvas_destroy(&dst);
+
+        printf("[Quantise Nearest] Complete, all tests pass!\n");
+}
+
+void TST_QuantiseDither()
+{
+        struct palette p = _black_white();
+        struct quantiser q = quantiser(p);
+        struct canvas src = canvas(100, 100);
+        struct canvas dst = canvas(100, 100);
+
+        // flat greys come out as the matching share of white pixels
+        double greys[3] = {0.25, 0.5, 0.8};
+        for (int i = 0; i < 3; i++) {
+                canvas_fill(src, color_rgb(greys[i], greys[i], greys[i]));
+
+                quantiser_canvas(q, src, dst, NULL, DITHER_NONE);
+                assert(_white_share(dst) == ((greys[i] < 0.5) ? 0.0 : 1.0) ||
+                       greys[i] == 0.5);
+
+                quantiser_canvas(q, src, dst, NULL, DITHER_BAYER);
+                double share = _white_share(dst);
+                assert(share > greys[i] - 0.03 && share < greys[i] + 0.03);
+
+                quantiser_canvas(q, src, dst, NULL, DITHER_FLOYD_STEINBERG);
+                share = _white_share(dst);
+                assert(share > greys[i] - 0.03 && share < greys[i] + 0.03);
+        }
+
+        // quantising a canvas onto itself
+        quantiser_canvas(q, src, src, NULL, DITHER_FLOYD_STEINBERG);
+        assert(color_equal(canvas_read_pixel(src, 50, 50),
+                           canvas_read_pixel(dst, 50, 50)));
+
+        quantiser_destroy(&q);
+        palette_destroy(&p);
+        canvas_destroy(&src);
+        canvas_destroy(&dst);
+
+        printf("[Quantise Dither] Complete, all tests pass!\n");
+}
+
+void TST_QuantiseParallel()
+{
+        // a random palette and image, the workers must match a serial run
+        srand(11);
+        struct palette p = palette(64);
+        for (int i = 0; i < 64; i++) {
+                palette_add_color(&p, color_rgb(rand() / (double)RAND_MAX,
+                                                rand() / (double)RAND_MAX,
+                                                rand() / (double)RAND_MAX));
+        }
+
+        struct canvas src = canvas(200, 150);
+        for (int y = 0; y < src.h; y++) {
+                for (int x = 0; x < src.w; x++) {
+                        canvas_write_pixel(src, x, y, color_rgb(x / 200.0,
+                                           y / 150.0, rand() & 1), BLIT_ABS);
+                }
+        }
+
+        for (int dither = DITHER_NONE; dither < NUM_DITHER_MODES; dither++) {
+                struct quantiser serial = quantiser(p);
+                uint16_t *a = mem_alloc(src.w * src.h * sizeof(uint16_t));
+                uint16_t *b = mem_alloc(src.w * src.h * sizeof(uint16_t));
+                struct canvas out = canvas(src.w, src.h);
+
+                quantiser_canvas(serial, src, out, a, dither);
+
+                job_init(3);
+                struct quantiser parallel = quantiser(p);
+                quantiser_canvas(parallel, src, out, b, dither);
+                job_quit();
+
+                for (int i = 0; i < QUANTISE_CUBE_SIZE * QUANTISE_CUBE_SIZE *
+                                    QUANTISE_CUBE_SIZE; i++) {
+                        assert(serial.cube[i] == parallel.cube[i]);
+                }
+                for (int i = 0; i < src.w * src.h; i++) {
+                        assert(a[i] == b[i]);
+                        assert(color_equal(canvas_pixels(out)[i],
+                                           palette_get_by_index(p, a[i])));
+                }
+
+                quantiser_destroy(&serial);
+                quantiser_destroy(&parallel);
+                canvas_destroy(&out);
+                mem_free(a);
+                mem_free(b);
+        }
+
+        palette_destroy(&p);
+        canvas_destroy(&src);
+
+        printf("[Quantise Parallel] Complete, all tests pass!\n");
+}
+
+int main()
+{
+        mem_init(16 * MEM_MEGABYTE);
+
+        TST_QuantiseNearest();
+        TST_QuantiseDither();
+        TST_QuantiseParallel();
+
+        mem_destroy();
+
+        return 0;
+}
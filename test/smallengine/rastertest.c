@@ -0,0 +1,247 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <math.h>
+
+#include <smallengine/sys/mem.h>
+#include <smallengine/sys/job.h>
+#include <smallengine/maths/maths.h>
+#include <smallengine/maths/tuple.h>
+#include <smallengine/graphics/raster.h>
+#include <smallengine/graphics/texture.h>
+#include <smallengine/graphics/canvas.h>
+#include <smallengine/graphics/color.h>
+
+static struct raster_vertex _vert(double x, double y, double z, 
+                                  struct color col)
+{
+        return raster_vertex(point_3d(x, y, z), col, 0.0, 0.0);
+}
+
+void TST_RasterShared()
+{
+        struct canvas c = canvas(64, 64);
+        struct raster r = raster(16);
+        struct color col = color_rgb(0.25, 0.25, 0.25);
+
+        // two halves of a square and a fan meeting at an odd point, no pixel
+        // may be drawn twice or left out
+        raster_triangle(&r, _vert(4.0, 4.0, 0.0, col), 
+                        _vert(40.0, 4.0, 0.0, col), 
+                        _vert(40.0, 30.0, 0.0, col), BLIT_ADD);
+        raster_triangle(&r, _vert(4.0, 4.0, 0.0, col),
+                        _vert(4.0, 30.0, 0.0, col), 
+                        _vert(40.0, 30.0, 0.0, col), BLIT_ADD);
+        raster_triangle(&r, _vert(10.3, 40.7, 0.0, col), 
+                        _vert(50.1, 35.2, 0.0, col), 
+                        _vert(33.3, 50.5, 0.0, col), BLIT_ADD);
+        raster_triangle(&r, _vert(50.1, 35.2, 0.0, col), 
+                        _vert(60.9, 62.0, 0.0, col), 
+                        _vert(33.3, 50.5, 0.0, col), BLIT_ADD);
+        raster_draw(&r, c, NULL);
+
+        int count = 0;
+        for (int y = 0; y < 64; y++) {
+                for (int x = 0; x < 64; x++) {
+                        double v = canvas_read_pixel(c, x, y).r;
+                        assert(double_equal(v, 0.0) || double_equal(v, 0.25));
+                        count += (y < 32 && double_equal(v, 0.25));
+                }
+        }
+        assert(count == 36 * 26);
+
+        raster_destroy(&r);
+        canvas_destroy(&c);
+
+        printf("[Raster Shared Edges] Complete, all tests pass!\n");
+}
+
+void TST_RasterDepth()
+{
+        struct canvas c = canvas(32, 32);
+        struct depth_buffer db = depth_buffer(32, 32);
+        struct raster r = raster(4);
+
+        struct color red = color_rgb(1.0, 0.0, 0.0);
+        struct color green = color_rgb(0.0, 1.0, 0.0);
+        struct color blue = color_rgb(0.0, 0.0, 1.0);
+
+        raster_triangle(&r, _vert(0.0, 0.0, 0.8, red), 
+                        _vert(32.0, 0.0, 0.8, red), 
+                        _vert(0.0, 32.0, 0.8, red), BLIT_ABS);
+        raster_triangle(&r, _vert(0.0, 0.0, 0.2, blue), 
+                        _vert(16.0, 0.0, 0.2, blue), 
+                        _vert(0.0, 16.0, 0.2, blue), BLIT_ABS);
+        raster_triangle(&r, _vert(0.0, 0.0, 0.5, green), 
+                        _vert(32.0, 0.0, 0.5, green), 
+                        _vert(0.0, 32.0, 0.5, green), BLIT_ABS);
+        raster_draw(&r, c, &db);
+
+        assert(color_equal(canvas_read_pixel(c, 2, 2), blue) == 1);
+        assert(color_equal(canvas_read_pixel(c, 20, 2), green) == 1);
+        assert(double_equal(db.depth[2 * 32 + 2], 0.2) == 1);
+
+        depth_buffer_destroy(&db);
+        raster_destroy(&r);
+        canvas_destroy(&c);
+
+        printf("[Raster Depth] Complete, all tests pass!\n");
+}
+
+void TST_RasterPerspective()
+{
+        struct canvas c = canvas(64, 64);
+        struct raster r = raster(4);
+        struct color black = color_rgb(0.0, 0.0, 0.0);
+        struct color white = color_rgb(1.0, 1.0, 1.0);
+
+        // the right hand side is four times further away, half way across
+        // the screen is only a fifth of the way along the surface
+        struct raster_vertex v0 = raster_vertex(tuple(0.0, 0.0, 0.0, 1.0), 
+                                                black, 0.0, 0.0);
+        struct raster_vertex v1 = raster_vertex(tuple(64.0, 0.0, 0.0, 4.0), 
+                                                white, 1.0, 0.0);
+        struct raster_vertex v2 = raster_vertex(tuple(0.0, 64.0, 0.0, 1.0), 
+                                                black, 0.0, 1.0);
+        struct raster_vertex v3 = raster_vertex(tuple(64.0, 64.0, 0.0, 4.0), 
+                                                white, 1.0, 1.0);
+        raster_triangle(&r, v0, v1, v2, BLIT_ABS);
+        raster_triangle(&r, v1, v3, v2, BLIT_ABS);
+        raster_draw(&r, c, NULL);
+
+        double mid = canvas_read_pixel(c, 32, 32).r;
+        assert(fabs(mid - 0.2) < 0.01);
+        assert(canvas_read_pixel(c, 63, 20).r > 0.9);
+
+        raster_destroy(&r);
+        canvas_destroy(&c);
+
+        printf("[Raster Perspective] Complete, all tests pass!\n");
+}
+
+void TST_RasterTextured()
+{
+        struct color white = color_rgb(1.0, 1.0, 1.0);
+        struct color red = color_rgb(1.0, 0.0, 0.0);
+        struct color blue = color_rgb(0.0, 0.0, 1.0);
+
+        // left half red, right half blue
+        struct canvas img = canvas(2, 1);
+        canvas_write_pixel(img, 0, 0, red, BLIT_ABS);
+        canvas_write_pixel(img, 1, 0, blue, BLIT_ABS);
+        struct texture tex = texture_from_canvas(img, NULL);
+
+        struct canvas c = canvas(32, 32);
+        struct raster r = raster(2);
+        raster_triangle_textured(&r, 
+                raster_vertex(point_2d(0.0, 0.0), white, 0.0, 0.0),
+                raster_vertex(point_2d(32.0, 0.0), white, 1.0, 0.0),
+                raster_vertex(point_2d(0.0, 32.0), white, 0.0, 1.0),
+                tex, BLIT_ABS);
+        raster_draw(&r, c, NULL);
+
+        assert(color_equal(canvas_read_pixel(c, 2, 2), red) == 1);
+        assert(color_equal(canvas_read_pixel(c, 20, 2), blue) == 1);
+
+        // coordinates far past an int once scaled still repeat the texture
+        double far = 4e9;
+        canvas_fill(c, white);
+        raster_clear(&r);
+        raster_triangle_textured(&r,
+                raster_vertex(point_2d(0.0, 0.0), white, far, far),
+                raster_vertex(point_2d(32.0, 0.0), white, far + 1.0, far),
+                raster_vertex(point_2d(0.0, 32.0), white, far, far + 1.0),
+                tex, BLIT_ABS);
+        raster_draw(&r, c, NULL);
+        assert(color_equal(canvas_read_pixel(c, 2, 2), red) == 1);
+        assert(color_equal(canvas_read_pixel(c, 20, 2), blue) == 1);
+
+        // texels are converted into the space of a linear canvas
+        struct canvas grey = canvas(2, 2);
+        canvas_fill(grey, color_rgb(0.5, 0.5, 0.5));
+        struct texture gtex = texture_from_canvas(grey, NULL);
+        canvas_set_color_space(c, COLOR_LINEAR);
+        raster_clear(&r);
+        raster_triangle_textured(&r,
+                raster_vertex(point_2d(0.0, 0.0), white, 0.0, 0.0),
+                raster_vertex(point_2d(32.0, 0.0), white, 1.0, 0.0),
+                raster_vertex(point_2d(0.0, 32.0), white, 0.0, 1.0),
+                gtex, BLIT_ABS);
+        raster_draw(&r, c, NULL);
+        assert(color_equal(canvas_read_pixel(c, 2, 2),
+                           color_rgb(0.214041, 0.214041, 0.214041)));
+        texture_destroy(&gtex);
+        canvas_destroy(&grey);
+
+        // an empty texture, as from a file that failed to load, is refused
+        struct texture none = texture_from_canvas(canvas_from_bmp(
+                                                  "rastertest_missing.bmp"),
+                                                  NULL);
+        assert(!raster_triangle_textured(&r, _vert(0.0, 0.0, 0.0, white),
+                                         _vert(8.0, 0.0, 0.0, white),
+                                         _vert(0.0, 8.0, 0.0, white),
+                                         none, BLIT_ABS));
+        texture_destroy(&none);
+
+        raster_destroy(&r);
+        canvas_destroy(&c);
+
+        printf("[Raster Textured] Complete, all tests pass!\n");
+}
+
+void TST_RasterParallel()
+{
+        struct canvas serial = canvas(200, 150);
+        struct canvas parallel = canvas(200, 150);
+        struct depth_buffer db = depth_buffer(200, 150);
+        struct raster r = raster(500);
+
+        srand(7);
+        for (int i = 0; i < 500; i++) {
+                struct raster_vertex v[3];
+                for (int k = 0; k < 3; k++) {
+                        struct color col = color_rgb(rand() % 100 / 100.0, 
+                                rand() % 100 / 100.0, rand() % 100 / 100.0);
+                        v[k] = _vert(rand() % 260 - 30, rand() % 200 - 25,
+                                     rand() % 100 / 100.0, col);
+                }
+                raster_triangle(&r, v[0], v[1], v[2], 
+                                (i % 3) ? BLIT_ABS : BLIT_ADD);
+        }
+
+        raster_draw(&r, serial, &db);
+
+        job_init(4);
+        depth_buffer_clear(db, 1.0f);
+        raster_draw(&r, parallel, &db);
+        job_quit();
+
+        for (int y = 0; y < 150; y++) {
+                for (int x = 0; x < 200; x++) {
+                        assert(color_equal(canvas_read_pixel(serial, x, y),
+                                canvas_read_pixel(parallel, x, y)) == 1);
+                }
+        }
+
+        depth_buffer_destroy(&db);
+        raster_destroy(&r);
+        canvas_destroy(&serial);
+        canvas_destroy(&parallel);
+
+        printf("[Raster Parallel] Complete, all tests pass!\n");
+}
+
+int main()
+{
+        mem_init(32 * MEM_MEGABYTE);
+
+        TST_RasterShared();
+        TST_RasterDepth();
+        TST_RasterPerspective();
+        TST_RasterTextured();
+        TST_RasterParallel();
+
+        mem_destroy();
+
+        return 0;
+}
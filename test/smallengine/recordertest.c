@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <SDL2/SDL.h>
+
+#include <smallengine/sys/mem.h>
+#include <smallengine/graphics/recorder.h>
+#include <smallengine/graphics/color.h>
+
+#define W 320
+#define H 200
+#define FRAME_SIZE (6 + W * H + 2 * (W / 2) * (H / 2))
+#define FIFO "recordertest.fifo"
+
+static uint32_t frames[4][W * H];
+
+static void _make_frames()
+{
+        for (int i = 0; i < 4; i++) {
+                for (int p = 0; p < W * H; p++) {
+                        frames[i][p] = color_to_RGBA(color_rgb_int(
+                                        p % W, p / W, i * 60));
+                }
+        }
+}
+
+/*
+ * wait for the writer to catch up, so no frames are dropped
+ */
+static void _wait_written(int n)
+{
+        for (int tries = 0; recorder_frames() < n && tries < 5000; tries++) {
+                SDL_Delay(1);
+        }
+        assert(recorder_frames() == n);
+}
+
+/*
+ * check a Y4M frame is frame i converted
+ */
+static void _check_y4m(const uint8_t *data, int i)
+{
+        static uint8_t want[W * H * 3 / 2];
+        color_rgb32_to_yuv420(frames[i], W, H, W, COLOR_RGBA, want,
+                              want + W * H, want + W * H + W * H / 4);
+        assert(memcmp(data, "FRAME\n", 6) == 0);
+        assert(memcmp(data + 6, want, sizeof(want)) == 0);
+}
+
+static uint8_t *_read_all(const char *filename, size_t *size)
+{
+        FILE *f = fopen(filename, "rb");
+        assert(f != NULL);
+        fseek(f, 0, SEEK_END);
+        *size = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        uint8_t *data = malloc(*size);
+        assert(fread(data, 1, *size, f) == *size);
+        fclose(f);
+        return data;
+}
+
+void TST_RecorderY4m()
+{
+        assert(!recorder_active());
+        assert(recorder_start("recordertest.y4m", W, H, 60, RECORDER_Y4M));
+        assert(recorder_active());
+        assert(!recorder_start("recordertest.y4m", W, H, 60, RECORDER_Y4M));
+
+        // frames of the wrong size are refused
+        assert(!recorder_frame(frames[0], W - 1, H, W, COLOR_RGBA));
+
+        for (int i = 0; i < 4; i++) {
+                assert(recorder_frame(frames[i], W, H, W, COLOR_RGBA));
+                _wait_written(i + 1);
+        }
+        assert(recorder_stop());
+        assert(!recorder_active());
+        assert(recorder_frames() == 4 && recorder_dropped() == 0);
+
+        size_t size;
+        uint8_t *data = _read_all("recordertest.y4m", &size);
+        const char *header = "YUV4MPEG2 W320 H200 F60:1 Ip A1:1 C420jpeg\n";
+        assert(memcmp(data, header, strlen(header)) == 0);
+        assert(size == strlen(header) + 4 * FRAME_SIZE);
+        for (int i = 0; i < 4; i++) {
+                _check_y4m(data + strlen(header) + i * FRAME_SIZE, i);
+        }
+
+        free(data);
+        remove("recordertest.y4m");
+
+        printf("[Recorder Y4M] Complete, all tests pass!\n");
+}
+
+void TST_RecorderRaw()
+{
+        // ARGB pixels with a pitch wider than the frame
+        uint32_t *argb = mem_alloc((W + 8) * H * sizeof(uint32_t));
+        for (int y = 0; y < H; y++) {
+                for (int x = 0; x < W; x++) {
+                        argb[y * (W + 8) + x] = color_to_ARGB(color_rgb_int(
+                                                x % 256, y, 99));
+                }
+        }
+
+        assert(recorder_start("recordertest.rgba", W, H, 30,
+                              RECORDER_RGBA));
+        assert(recorder_frame(argb, W, H, W + 8, COLOR_ARGB));
+        _wait_written(1);
+        assert(recorder_frame(frames[2], W, H, W, COLOR_RGBA));
+        assert(recorder_stop());
+
+        size_t size;
+        uint8_t *data = _read_all("recordertest.rgba", &size);
+        assert(size == 2 * W * H * 4);
+        const uint8_t *p = data + (7 * W + 300) * 4;
+        assert(p[0] == 300 % 256 && p[1] == 7 && p[2] == 99 && p[3] == 0xff);
+        assert(memcmp(data + W * H * 4, frames[2], W * H * 4) == 0);
+
+        free(data);
+        mem_free(argb);
+        remove("recordertest.rgba");
+
+        printf("[Recorder Raw] Complete, all tests pass!\n");
+}
+
+void TST_RecorderDrop()
+{
+        // a frame is larger than a fifo holds, so the writer stalls on the
+        // first until it is read and both buffers stay full meanwhile
+        assert(mkfifo(FIFO, 0600) == 0);
+        int fd = open(FIFO, O_RDONLY | O_NONBLOCK);
+        assert(fd >= 0);
+
+        assert(recorder_start(FIFO, W, H, 60, RECORDER_Y4M));
+        assert(recorder_frame(frames[0], W, H, W, COLOR_RGBA));
+        assert(recorder_frame(frames[1], W, H, W, COLOR_RGBA));
+        for (int i = 0; i < 5; i++) {
+                assert(!recorder_frame(frames[3], W, H, W, COLOR_RGBA));
+        }
+        assert(recorder_dropped() == 5);
+
+        // the dropped frames are filled by the one before them
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+        const char *header = "YUV4MPEG2 W320 H200 F60:1 Ip A1:1 C420jpeg\n";
+        size_t want = strlen(header) + 7 * FRAME_SIZE, got = 0;
+        uint8_t *data = malloc(want);
+        while (got < want) {
+                ssize_t n = read(fd, data + got, want - got);
+                assert(n > 0);
+                got += n;
+        }
+
+        assert(recorder_stop());
+        assert(read(fd, data, 1) == 0);
+        close(fd);
+        assert(recorder_frames() == 7);
+
+        _check_y4m(data + strlen(header), 0);
+        for (int i = 1; i < 7; i++) {
+                _check_y4m(data + strlen(header) + i * FRAME_SIZE, 1);
+        }
+
+        free(data);
+        remove(FIFO);
+
+        printf("[Recorder Drop] Complete, all tests pass!\n");
+}
+
+int main()
+{
+        mem_init(64 * MEM_MEGABYTE);
+
+        _make_frames();
+        TST_RecorderY4m();
+        TST_RecorderRaw();
+        TST_RecorderDrop();
+
+        mem_destroy();
+
+        return 0;
+}
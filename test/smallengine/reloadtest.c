@@ -0,0 +1,163 @@
+#include <stdio.h>
+#include <assert.h>
+
+#include <SDL2/SDL.h>
+
+#include <smallengine/sys/mem.h>
+#include <smallengine/graphics/reload.h>
+#include <smallengine/graphics/atlas.h>
+#include <smallengine/graphics/canvas.h>
+#include <smallengine/graphics/color.h>
+#include <smallengine/graphics/texture.h>
+
+#define FILE_A "reloadtest_a.bmp"
+#define FILE_B "reloadtest_b.bmp"
+
+static struct color magenta;
+
+/*
+ * a w x h image of one color with a magenta corner
+ */
+static struct canvas _image(int w, int h, struct color col)
+{
+        struct canvas c = canvas(w, h);
+        canvas_fill(c, col);
+        canvas_write_pixel(c, 0, 0, magenta, BLIT_ABS);
+        return c;
+}
+
+static void _write(const char *filename, int w, int h, struct color col)
+{
+        struct canvas c = _image(w, h, col);
+        assert(canvas_export_to_bmp(c, filename));
+        canvas_destroy(&c);
+}
+
+/*
+ * apply changes until n have been applied
+ */
+static void _wait_applied(int n)
+{
+        int applied = 0;
+        for (int tries = 0; applied < n && tries < 5000; tries++) {
+                applied += reload_apply();
+                SDL_Delay(1);
+        }
+        assert(applied == n);
+}
+
+void TST_ReloadTexture()
+{
+        _write(FILE_A, 8, 4, color_rgb(1.0, 0.0, 0.0));
+        struct canvas c = canvas_from_bmp(FILE_A);
+        struct texture tex = texture_from_canvas(c, &magenta);
+        canvas_destroy(&c);
+
+        int id = reload_watch_texture(FILE_A, &tex, &magenta);
+        assert(id > 0);
+        assert(reload_apply() == 0);
+
+        // written in place, at a new size
+        _write(FILE_A, 16, 6, color_rgb(0.0, 0.0, 1.0));
+        _wait_applied(1);
+        assert(tex.w == 16 && tex.h == 6);
+        assert(texture_read_mask(tex, 0, 0) < 0);
+        assert(color_equal(texture_read_pixel(tex, 3, 3),
+                           color_rgb(0.0, 0.0, 1.0)));
+
+        // replaced by renaming another file over it
+        _write("reloadtest_tmp.bmp", 16, 6, color_rgb(0.0, 1.0, 0.0));
+        assert(rename("reloadtest_tmp.bmp", FILE_A) == 0);
+        _wait_applied(1);
+        assert(color_equal(texture_read_pixel(tex, 3, 3),
+                           color_rgb(0.0, 1.0, 0.0)));
+
+        // a file that can't be read leaves the texture as it was
+        FILE *f = fopen(FILE_A, "wb");
+        fputs("not an image", f);
+        fclose(f);
+        for (int tries = 0; reload_failed() == 0 && tries < 5000; tries++) {
+                SDL_Delay(1);
+        }
+        assert(reload_failed() == 1 && reload_apply() == 0);
+        assert(color_equal(texture_read_pixel(tex, 3, 3),
+                           color_rgb(0.0, 1.0, 0.0)));
+
+        reload_unwatch(id);
+        texture_destroy(&tex);
+        remove(FILE_A);
+
+        printf("[Reload Texture] Complete, all tests pass!\n");
+}
+
+void TST_ReloadAtlas()
+{
+        // the files are only written once watched, the directory is still
+        // watched from before so earlier writes could be seen late
+        struct atlas a = atlas(64, 64, 64, 1);
+        struct canvas c = _image(8, 8, color_rgb(1.0, 1.0, 0.0));
+        int first = atlas_add_canvas(&a, c, &magenta);
+        canvas_destroy(&c);
+        c = _image(8, 8, color_rgb(0.0, 1.0, 1.0));
+        int second = atlas_add_canvas(&a, c, &magenta);
+        canvas_destroy(&c);
+
+        int id = reload_watch_atlas(FILE_A, &a, first, &magenta);
+        assert(id > 0);
+        assert(reload_watch_atlas(FILE_B, &a, second, &magenta) > 0);
+
+        // the same size is drawn where it was
+        struct atlas_rect r = atlas_get_rect(a, first);
+        _write(FILE_A, 8, 8, color_rgb(1.0, 1.0, 1.0));
+        _wait_applied(1);
+        struct atlas_rect s = atlas_get_rect(a, first);
+        assert(s.x == r.x && s.y == r.y && s.w == 8);
+        assert(texture_read_mask(a.tex, r.x, r.y) < 0);
+        assert(color_equal(texture_read_pixel(a.tex, r.x + 4, r.y + 4),
+                           color_rgb(1.0, 1.0, 1.0)));
+
+        // a new size moves it, the handle stays the same
+        _write(FILE_A, 12, 10, color_rgb(1.0, 0.0, 0.0));
+        _wait_applied(1);
+        s = atlas_get_rect(a, first);
+        assert(s.w == 12 && s.h == 10 && (s.x != r.x || s.y != r.y));
+        assert(texture_read_mask(a.tex, r.x + 4, r.y + 4) < 0);
+
+        // changes to an unwatched file are ignored, events arrive in order
+        // so once the next change is applied it has been seen
+        reload_unwatch(id);
+        _write(FILE_A, 12, 10, color_rgb(0.0, 0.0, 0.0));
+        _write(FILE_B, 8, 8, color_rgb(0.0, 0.0, 1.0));
+        _wait_applied(1);
+        assert(color_equal(texture_read_pixel(a.tex, s.x + 4, s.y + 4),
+                           color_rgb(1.0, 0.0, 0.0)));
+        r = atlas_get_rect(a, second);
+        assert(color_equal(texture_read_pixel(a.tex, r.x + 4, r.y + 4),
+                           color_rgb(0.0, 0.0, 1.0)));
+
+        reload_quit();
+        atlas_destroy(&a);
+        remove(FILE_A);
+        remove(FILE_B);
+
+        printf("[Reload Atlas] Complete, all tests pass!\n");
+}
+
+int main()
+{
+        mem_init(16 * MEM_MEGABYTE);
+
+        magenta = color_rgb(1.0, 0.0, 1.0);
+
+        // nothing is watched before starting
+        struct texture tex;
+        assert(reload_watch_texture(FILE_A, &tex, NULL) == 0);
+        assert(reload_init());
+
+        TST_ReloadTexture();
+        TST_ReloadAtlas();
+
+        mem_destroy();
+
+        return 0;
+}
@@ -6,6 +6,9 @@
 #include <smallengine/sys/mem.h>
 #include <smallengine/graphics/renderer.h>
 #include <smallengine/graphics/canvas.h>
+#include <smallengine/graphics/color.h>
+#include <smallengine/graphics/indexed.h>
+#include <smallengine/graphics/palette.h>
 #include <smallengine/sys/timer.h>
 
 void TST_RenderInit()
@@ -19,11 +22,77 @@ void TST_RenderInit()
         printf("[Render Init] Complete, all tests pass!\n");
 }        
         
+void TST_RenderIndexed()
+{
+        struct palette pal = palette(4);
+        palette_add_color(&pal, color_rgb(0.0, 0.0, 0.0));
+        palette_add_color(&pal, color_rgb(1.0, 0.0, 0.0));
+        palette_add_color(&pal, color_rgb(0.0, 0.0, 1.0));
+
+        assert(renderer_set_mode(RENDERER_INDEXED));
+        assert(renderer_get_mode() == RENDERER_INDEXED);
+        renderer_set_palette(pal);
+
+        struct indexed_texture screen = renderer_get_indexed_screen();
+        assert(screen.w == 128);
+        assert(screen.h == 128);
+        assert(!screen.wide);
+        assert(screen.palette.colors == pal.colors);
+        assert(renderer_get_window_canvas().image == NULL);
+        assert(indexed_texture_read_index(screen, 5, 5) == 0);
+
+        // a sprite quantised to the screen palette, white is transparent
+        struct color white = color_rgb(1.0, 1.0, 1.0);
+        struct canvas c = canvas(4, 4);
+        canvas_fill(c, white);
+        canvas_write_pixel(c, 1, 1, color_rgb(0.9, 0.1, 0.0), BLIT_ABS);
+        canvas_write_pixel(c, 2, 1, color_rgb(0.1, 0.0, 0.8), BLIT_ABS);
+        struct indexed_texture sprite = indexed_texture_from_palette(c, pal,
+                                                                     &white);
+        assert(sprite.palette.colors == pal.colors);
+        assert(indexed_texture_read_index(sprite, 0, 0) == -1);
+
+        indexed_texture_fill(screen, 2);
+        indexed_texture_blit_indices(sprite, 0, 0, 3, 3, screen, 126, 10);
+        assert(indexed_texture_read_index(screen, 126, 10) == 2);
+        assert(indexed_texture_read_index(screen, 127, 11) == 1);
+        indexed_texture_blit_indices(sprite, 0, 0, 3, 3, screen, -2, -1);
+        assert(indexed_texture_read_index(screen, 0, 0) == 2);
+
+        renderer_update_display();
+
+        // fading the palette needs no change to the screen
+        palette_replace_index(pal, 1, color_rgb(0.5, 0.0, 0.0));
+        renderer_update_display();
+
+        // a capture is of the frame as shown, through the palette
+        assert(renderer_capture("renderertest.bmp"));
+        struct canvas shot = canvas_from_bmp("renderertest.bmp");
+        assert(shot.w == 128 && shot.h == 128);
+        assert(color_equal(canvas_read_pixel(shot, 126, 10),
+                           color_rgb(0.0, 0.0, 1.0)));
+        assert(color_equal(canvas_read_pixel(shot, 127, 11),
+                           color_rgb_int(128, 0, 0)));
+        canvas_destroy(&shot);
+        remove("renderertest.bmp");
+
+        assert(renderer_set_mode(RENDERER_COLOR));
+        assert(renderer_get_window_canvas().w == 128);
+        renderer_update_display();
+
+        indexed_texture_destroy(&sprite);
+        canvas_destroy(&c);
+        palette_destroy(&pal);
+
+        printf("[Render Indexed] Complete, all tests pass!\n");
+}
+
 int main()
 {
         mem_init(100 * MEM_MEGABYTE);
 
         TST_RenderInit();
+        TST_RenderIndexed();
 
         SDL_VideoQuit();
         SDL_Quit();
@@ -0,0 +1,149 @@
+#include <stdio.h>
+#include <assert.h>
+
+#include <smallengine/sys/mem.h>
+#include <smallengine/graphics/rle.h>
+#include <smallengine/graphics/texture.h>
+#include <smallengine/graphics/canvas.h>
+#include <smallengine/graphics/color.h>
+
+/*
+ * a ring of colors on a transparent white background
+ */
+static struct canvas _ring(int size)
+{
+        struct canvas c = canvas(size, size);
+        canvas_fill(c, color_rgb(1.0, 1.0, 1.0));
+
+        int r = size / 2;
+        for (int y = 0; y < size; y++) {
+                for (int x = 0; x < size; x++) {
+                        int d = (x - r) * (x - r) + (y - r) * (y - r);
+                        if (d < r * r && d > r * r / 4) {
+                                canvas_write_pixel(c, x, y, color_rgb(
+                                        x / (double)size, y / (double)size,
+                                        0.25), BLIT_ABS);
+                        }
+                }
+        }
+        return c;
+}
+
+void TST_RleNew()
+{
+        struct color white = color_rgb(1.0, 1.0, 1.0);
+        struct canvas c = canvas(6, 3);
+        canvas_fill(c, white);
+        canvas_write_pixel(c, 1, 0, color_rgb(1.0, 0.0, 0.0), BLIT_ABS);
+        canvas_write_pixel(c, 2, 0, color_rgb(0.0, 1.0, 0.0), BLIT_ABS);
+        canvas_write_pixel(c, 5, 0, color_rgb(0.0, 0.0, 1.0), BLIT_ABS);
+        canvas_write_pixel(c, 0, 2, color_rgb(0.0, 0.0, 0.0), BLIT_ABS);
+
+        struct rle_sprite s = rle_sprite_from_canvas(c, &white);
+        assert(s.w == 6 && s.h == 3);
+        assert(rle_sprite_opaque(s) == 4);
+
+        // row 0 skips one then draws two, skips two then draws one
+        assert(s.rows[0].span == 0 && s.rows[1].span == 2);
+        assert(s.spans[0].skip == 1 && s.spans[0].len == 2);
+        assert(s.spans[1].skip == 2 && s.spans[1].len == 1);
+        assert(color_equal(s.pixels[2], color_rgb(0.0, 0.0, 1.0)));
+
+        // row 1 is empty, row 2 starts opaque
+        assert(s.rows[2].span == 2 && s.rows[3].span == 3);
+        assert(s.spans[2].skip == 0 && s.spans[2].len == 1);
+
+        // without a transparent color every row is one run
+        struct rle_sprite all = rle_sprite_from_canvas(c, NULL);
+        assert(rle_sprite_opaque(all) == 18);
+        assert(all.rows[3].span == 3);
+
+        // a texture compiles the same as its canvas
+        struct texture tex = texture_from_canvas(c, &white);
+        struct rle_sprite from_tex = rle_sprite_from_texture(tex);
+        assert(rle_sprite_opaque(from_tex) == 4);
+        for (int i = 0; i < 4; i++) {
+                assert(color_equal(from_tex.pixels[i], s.pixels[i]));
+        }
+
+        rle_sprite_destroy(&from_tex);
+        rle_sprite_destroy(&all);
+        rle_sprite_destroy(&s);
+        assert(s.rows == NULL && rle_sprite_opaque(s) == 0);
+        canvas_destroy(&c);
+
+        printf("[Rle New] Complete, all tests pass!\n");
+}
+
+void TST_RleBlit()
+{
+        struct color white = color_rgb(1.0, 1.0, 1.0);
+        struct color grey = color_rgb(0.5, 0.25, 0.75);
+        struct canvas c = _ring(21);
+        struct rle_sprite s = rle_sprite_from_canvas(c, &white);
+
+        // every mode at positions clipped on each side, against drawing the
+        // opaque pixels one at a time
+        int at[7][2] = {{3, 4}, {-5, 2}, {2, -7}, {25, 10}, {-15, -12},
+                        {35, 3}, {-30, 0}};
+        struct canvas got = canvas(40, 30);
+        struct canvas want = canvas(40, 30);
+
+        for (int mode = BLIT_ABS; mode < NUM_BLIT_MODES; mode++) {
+                for (int p = 0; p < 7; p++) {
+                        canvas_fill(got, grey);
+                        canvas_fill(want, grey);
+
+                        rle_sprite_blit(s, got, at[p][0], at[p][1], mode);
+                        for (int y = 0; y < c.h; y++) {
+                                for (int x = 0; x < c.w; x++) {
+                                        struct color col = canvas_read_pixel(
+                                                        c, x, y);
+                                        if (!color_equal(col, white)) {
+                                                canvas_write_pixel(want,
+                                                        at[p][0] + x,
+                                                        at[p][1] + y, col,
+                                                        mode);
+                                        }
+                                }
+                        }
+
+                        for (int y = 0; y < got.h; y++) {
+                                for (int x = 0; x < got.w; x++) {
+                                        assert(color_equal(
+                                                canvas_read_pixel(got, x, y),
+                                                canvas_read_pixel(want, x,
+                                                                  y)));
+                                }
+                        }
+                }
+        }
+
+        // the pixels keep the space of their source, onto a linear canvas
+        // they are converted as canvas_blit would
+        canvas_set_color_space(got, COLOR_LINEAR);
+        canvas_set_color_space(want, COLOR_LINEAR);
+        rle_sprite_blit(s, got, 0, 0, BLIT_ABS);
+        canvas_blit(c, 0, 0, c.w - 1, c.h - 1, want, 0, 0, BLIT_ABS);
+        assert(color_equal(canvas_read_pixel(got, 4, 10),
+                           canvas_read_pixel(want, 4, 10)));
+
+        rle_sprite_destroy(&s);
+        canvas_destroy(&got);
+        canvas_destroy(&want);
+        canvas_destroy(&c);
+
+        printf("[Rle Blit] Complete, all tests pass!\n");
+}
+
+int main()
+{
+        mem_init(16 * MEM_MEGABYTE);
+
+        TST_RleNew();
+        TST_RleBlit();
+
+        mem_destroy();
+
+        return 0;
+}
@@ -2,6 +2,7 @@
 #include <assert.h>
 
 #include <smallengine/sys/mem.h>
+#include <smallengine/maths/maths.h>
 #include <smallengine/graphics/texture.h>
 #include <smallengine/graphics/canvas.h>
 #include <smallengine/graphics/color.h>
@@ -78,6 +79,184 @@ void TST_TextureBlit()
         printf("[Texture Blit] Complete, all tests pass!\n");
 }
 
+void TST_TextureBlitScaled()
+{
+        struct color black = color_rgb(0.0, 0.0, 0.0);
+        struct color white = color_rgb(1.0, 1.0, 1.0);
+        struct color red = color_rgb(1.0, 0.0, 0.0);
+        struct color green = color_rgb(0.0, 1.0, 0.0);
+
+        // red square on the left, white (transparent) elsewhere
+        struct canvas c = canvas(32, 32);
+        canvas_fill(c, white);
+        for (int y = 0; y < 32; y++) {
+                for (int x = 0; x < 16; x++) {
+                        canvas_write_pixel(c, x, y, red, BLIT_ABS);
+                }
+        }
+        struct texture tex = texture_from_canvas(c, &white);
+
+        struct canvas half = texture_mip(tex, 1, MIP_BOX);
+        assert(half.w == 16);
+        assert(double_equal(canvas_read_pixel(half, 2, 2).a, 1.0) == 1);
+        assert(double_equal(canvas_read_pixel(half, 12, 2).a, 0.0) == 1);
+
+        struct canvas dst = canvas(20, 20);
+        canvas_fill(dst, black);
+        texture_blit_scaled(tex, 0, 0, 31, 31, dst, 0, 0, 7, 7, BLIT_ABS);
+        assert(color_equal(canvas_read_pixel(dst, 1, 1), red) == 1);
+        assert(color_equal(canvas_read_pixel(dst, 6, 1), black) == 1);
+        assert(color_equal(canvas_read_pixel(dst, 9, 1), black) == 1);
+
+        // swapping palette colours is picked up by the reduced copies
+        palette_replace_color(tex.palette, red, green);
+        texture_blit_scaled(tex, 0, 0, 31, 31, dst, 0, 0, 7, 7, BLIT_ABS);
+        assert(color_equal(canvas_read_pixel(dst, 1, 1), green) == 1);
+        assert(color_equal(canvas_read_pixel(dst, 6, 1), black) == 1);
+
+        // odd sizes read levels rounded down in size, nothing is missed or
+        // drawn black past their edges
+        struct canvas odd = canvas(11, 11);
+        canvas_fill(odd, red);
+        struct texture otex = texture_from_canvas(odd, &white);
+        canvas_fill(dst, black);
+        texture_blit_scaled(otex, 0, 0, 10, 10, dst, 0, 0, 1, 1, BLIT_ABS);
+        for (int i = 0; i < 4; i++) {
+                assert(color_equal(canvas_read_pixel(dst, i % 2, i / 2),
+                                   red) == 1);
+        }
+        assert(color_equal(canvas_read_pixel(dst, 2, 2), black) == 1);
+
+        // full size, only the opaque runs are drawn and each is stretched
+        canvas_write_pixel(odd, 1, 0, white, BLIT_ABS);
+        texture_destroy(&otex);
+        otex = texture_from_canvas(odd, &white);
+        canvas_fill(dst, black);
+        texture_blit_scaled(otex, 0, 0, 2, 0, dst, 0, 0, 5, 0, BLIT_ABS);
+        struct color row[7] = {red, red, black, black, red, red, black};
+        for (int x = 0; x < 7; x++) {
+                assert(color_equal(canvas_read_pixel(dst, x, 0), row[x]));
+        }
+
+        texture_destroy(&otex);
+        canvas_destroy(&odd);
+
+        printf("[Texture Blit Scaled] Complete, all tests pass!\n");
+}
+
+void TST_TextureColorSpace()
+{
+        // sRGB mid grey is converted on its way onto a linear canvas, at
+        // full size and from the reduced copies
+        struct color lin = color_rgb(0.214041, 0.214041, 0.214041);
+        struct canvas c = canvas(8, 8);
+        canvas_fill(c, color_rgb(0.5, 0.5, 0.5));
+        struct texture tex = texture_from_canvas(c, NULL);
+        struct canvas dst = canvas(16, 16);
+        canvas_set_color_space(dst, COLOR_LINEAR);
+
+        texture_blit_to_canvas(tex, 0, 0, 7, 7, dst, 0, 0, BLIT_ABS);
+        texture_blit_scaled(tex, 0, 0, 7, 7, dst, 8, 0, 15, 15, BLIT_ABS);
+        texture_blit_scaled(tex, 0, 0, 7, 7, dst, 0, 8, 3, 11, BLIT_ABS);
+        assert(color_equal(canvas_read_pixel(dst, 3, 3), lin));
+        assert(color_equal(canvas_read_pixel(dst, 12, 12), lin));
+        assert(color_equal(canvas_read_pixel(dst, 2, 10), lin));
+
+        texture_destroy(&tex);
+        canvas_destroy(&dst);
+        canvas_destroy(&c);
+
+        printf("[Texture Color Space] Complete, all tests pass!\n");
+}
+
+void TST_TextureHit()
+{
+        struct color black = color_rgb(0.0, 0.0, 0.0);
+        struct color white = color_rgb(1.0, 1.0, 1.0);
+        struct color red = color_rgb(1.0, 0.0, 0.0);
+
+        // a red cross on a transparent background
+        struct canvas c = canvas(70, 9);
+        canvas_fill(c, white);
+        for (int i = 0; i < 70; i++) {
+                canvas_write_pixel(c, i, 4, red, BLIT_ABS);
+        }
+        for (int i = 0; i < 9; i++) {
+                canvas_write_pixel(c, 66, i, red, BLIT_ABS);
+        }
+        struct texture tex = texture_from_canvas(c, &white);
+
+        assert(texture_hit(tex, 0, 4) == 1);
+        assert(texture_hit(tex, 66, 0) == 1);
+        assert(texture_hit(tex, 65, 0) == 0);
+        assert(texture_hit(tex, -1, 4) == 0);
+        assert(texture_hit(tex, 70, 4) == 0);
+
+        // clipped on the left and top, only the cross is drawn
+        struct canvas dst = canvas(40, 10);
+        canvas_fill(dst, black);
+        texture_blit_to_canvas(tex, 0, 0, 69, 8, dst, -40, -2, BLIT_ABS);
+        for (int y = 0; y < dst.h; y++) {
+                for (int x = 0; x < dst.w; x++) {
+                        int drawn = (y == 2 && x < 30) || (x == 26 && y < 7);
+                        assert(color_equal(canvas_read_pixel(dst, x, y),
+                                           drawn ? red : black) == 1);
+                }
+        }
+
+        // changing the mask directly needs the coverage updated
+        tex.mask[0] = 1;
+        assert(texture_hit(tex, 0, 0) == 0);
+        texture_update_coverage(tex, 0, 0, 0, 0);
+        assert(texture_hit(tex, 0, 0) == 1);
+
+        canvas_destroy(&dst);
+        canvas_destroy(&c);
+
+        printf("[Texture Hit] Complete, all tests pass!\n");
+}
+
+void TST_TextureDestroy()
+{
+        size_t used = mem_used();
+
+        // everything a texture holds is freed, including its reduced copies
+        struct canvas c = canvas(16, 16);
+        canvas_test(c);
+        struct texture t = texture_from_canvas(c, NULL);
+        canvas_destroy(&c);
+        texture_mip(t, 2, MIP_BOX);
+        texture_destroy(&t);
+        assert(t.mask == NULL && t.mips == NULL && t.w == 0);
+
+        t = texture(8, 8);
+        texture_destroy(&t);
+        assert(mem_used() == used);
+
+        printf("[Texture Destroy] Complete, all tests pass!\n");
+}
+
+void TST_TextureMaskEdit()
+{
+        struct canvas c = canvas(8, 8);
+        canvas_fill(c, color_rgb(1.0, 0.0, 0.0));
+        struct texture t = texture_from_canvas(c, NULL);
+        assert(canvas_read_pixel(texture_mip(t, 1, MIP_BOX), 1, 1).a > 0.99);
+
+        // clearing the mask leaves the canvas alone, the reduced copies
+        // still follow once the coverage is updated
+        for (int i = 0; i < 8 * 8; i++) {
+                t.mask[i] = -1;
+        }
+        texture_update_coverage(t, 0, 0, 7, 7);
+        assert(canvas_read_pixel(texture_mip(t, 1, MIP_BOX), 1, 1).a < 0.01);
+
+        texture_destroy(&t);
+        canvas_destroy(&c);
+
+        printf("[Texture Mask Edit] Complete, all tests pass!\n");
+}
+
 int main()
 {
         mem_init(32 * MEM_MEGABYTE);
@@ -85,6 +264,11 @@ int main()
         TST_TextureNew();
         TST_TextureFromCanvas();
         TST_TextureBlit();
+        TST_TextureBlitScaled();
+        TST_TextureColorSpace();
+        TST_TextureHit();
+        TST_TextureDestroy();
+        TST_TextureMaskEdit();
 
         mem_destroy();
 